@@ -0,0 +1,98 @@
+//
+//  AllocationCounter.cpp
+//  segmenthreetion
+//
+//
+
+#include "AllocationCounter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    volatile size_t g_NumOfAllocations = 0;
+    volatile size_t g_AllocatedBytes = 0;
+
+    // Initial-exec, so that accessing them never allocates (from within the allocator)
+    __thread size_t t_NumOfAllocations __attribute__((tls_model("initial-exec"))) = 0;
+    __thread size_t t_AllocatedBytes __attribute__((tls_model("initial-exec"))) = 0;
+
+    inline void countAllocation(size_t size)
+    {
+        __sync_fetch_and_add(&g_NumOfAllocations, 1);
+        __sync_fetch_and_add(&g_AllocatedBytes, size);
+        t_NumOfAllocations++;
+        t_AllocatedBytes += size;
+    }
+}
+
+size_t AllocationCounter::getNumOfAllocations()
+{
+    return g_NumOfAllocations;
+}
+
+size_t AllocationCounter::getAllocatedBytes()
+{
+    return g_AllocatedBytes;
+}
+
+size_t AllocationCounter::getThreadNumOfAllocations()
+{
+    return t_NumOfAllocations;
+}
+
+size_t AllocationCounter::getThreadAllocatedBytes()
+{
+    return t_AllocatedBytes;
+}
+
+#ifdef __GLIBC__
+extern "C"
+{
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t n, size_t size);
+    void* __libc_realloc(void* ptr, size_t size);
+
+    void* malloc(size_t size)
+    {
+        countAllocation(size);
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t n, size_t size)
+    {
+        countAllocation(n * size);
+        return __libc_calloc(n, size);
+    }
+
+    void* realloc(void* ptr, size_t size)
+    {
+        countAllocation(size);
+        return __libc_realloc(ptr, size);
+    }
+}
+#else
+void* operator new(size_t size) throw(std::bad_alloc)
+{
+    countAllocation(size);
+    void* ptr = std::malloc(size > 0 ? size : 1);
+    if (ptr == NULL) throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[](size_t size) throw(std::bad_alloc)
+{
+    return operator new(size);
+}
+
+void operator delete(void* ptr) throw()
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) throw()
+{
+    std::free(ptr);
+}
+#endif
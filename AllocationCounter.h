@@ -0,0 +1,27 @@
+//
+//  AllocationCounter.h
+//  segmenthreetion
+//
+//
+
+#ifndef __segmenthreetion__AllocationCounter__
+#define __segmenthreetion__AllocationCounter__
+
+#include <cstddef>
+
+/*
+ * Heap allocations made so far (number and bytes requested), by the whole process
+ * and by the calling thread. Linking AllocationCounter.cpp interposes the allocator
+ * to count them: malloc on glibc, so that OpenCV's buffers (cv::fastMalloc) are
+ * counted as well as the C++ ones, and operator new only elsewhere.
+ */
+namespace AllocationCounter
+{
+    size_t getNumOfAllocations();
+    size_t getAllocatedBytes();
+
+    size_t getThreadNumOfAllocations();
+    size_t getThreadAllocatedBytes();
+}
+
+#endif /* defined(__segmenthreetion__AllocationCounter__) */
@@ -0,0 +1,257 @@
+//
+//  ArtifactCache.cpp
+//  segmenthreetion
+//
+//
+
+#include "ArtifactCache.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+
+namespace fs = boost::filesystem;
+
+namespace
+{
+    // Version of the computations of the stages, salting every key. To be bumped whenever
+    // a stage produces different outputs from the same parameters and inputs (e.g. a fix
+    // in a feature extractor or a classifier), so that the entries of older builds miss
+    const int kArtifactsVersion = 2;
+    
+    // Paths are given with or without trailing slash for directories
+    fs::path canonicalPath(std::string path)
+    {
+        while (path.size() > 1 && path[path.size()-1] == '/')
+            path.erase(path.size()-1);
+
+        return fs::path(path);
+    }
+
+    void copyRecursively(fs::path src, fs::path dst)
+    {
+        if (fs::is_directory(src))
+        {
+            fs::create_directories(dst);
+            for (fs::directory_iterator it (src); it != fs::directory_iterator(); ++it)
+                copyRecursively(it->path(), dst / it->path().filename());
+        }
+        else
+        {
+            if (dst.has_parent_path())
+                fs::create_directories(dst.parent_path());
+            fs::copy_file(src, dst, fs::copy_option::overwrite_if_exists);
+        }
+    }
+}
+
+//
+// ArtifactKey
+//
+
+ArtifactKey::ArtifactKey(std::string stage)
+    : m_Stage(stage), m_Hash(14695981039346656037ULL)
+{
+    *this << stage << kArtifactsVersion;
+}
+
+void ArtifactKey::hash(const void* data, size_t size)
+{
+    const unsigned char* p = (const unsigned char*) data;
+    for (size_t b = 0; b < size; b++)
+    {
+        m_Hash ^= p[b];
+        m_Hash *= 1099511628211ULL;
+    }
+}
+
+ArtifactKey& ArtifactKey::operator<<(std::string value)
+{
+    *this << (int) value.size(); // so that "ab","c" and "a","bc" differ
+    hash(value.data(), value.size());
+
+    return *this;
+}
+
+ArtifactKey& ArtifactKey::operator<<(const char* value)
+{
+    return *this << std::string(value);
+}
+
+ArtifactKey& ArtifactKey::operator<<(int value)
+{
+    hash(&value, sizeof(int));
+
+    return *this;
+}
+
+ArtifactKey& ArtifactKey::operator<<(double value)
+{
+    hash(&value, sizeof(double));
+
+    return *this;
+}
+
+ArtifactKey& ArtifactKey::addFile(std::string path)
+{
+    fs::path p = canonicalPath(path);
+
+    if (fs::is_directory(p))
+    {
+        std::vector<fs::path> entries;
+        for (fs::directory_iterator it (p); it != fs::directory_iterator(); ++it)
+            entries.push_back(it->path());
+        std::sort(entries.begin(), entries.end()); // not in a particular order otherwise
+
+        *this << "directory" << (int) entries.size();
+        for (int i = 0; i < entries.size(); i++)
+        {
+            *this << entries[i].filename().string();
+            addFile(entries[i].string());
+        }
+    }
+    else if (fs::is_regular_file(p))
+    {
+        std::ifstream file (p.string().c_str(), std::ios::binary);
+
+        *this << "file";
+        char buffer[65536];
+        while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0)
+            hash(buffer, file.gcount());
+    }
+    else
+    {
+        *this << "missing";
+    }
+
+    return *this;
+}
+
+std::string ArtifactKey::getStage()
+{
+    return m_Stage;
+}
+
+std::string ArtifactKey::str()
+{
+    std::stringstream ss;
+    ss << std::hex;
+    ss.width(16);
+    ss.fill('0');
+    ss << m_Hash;
+
+    return ss.str();
+}
+
+//
+// ArtifactCache
+//
+
+ArtifactCache::ArtifactCache(std::string dir)
+    : m_Dir(dir)
+{
+    if (!m_Dir.empty() && m_Dir[m_Dir.size()-1] != '/')
+        m_Dir += "/";
+}
+
+std::string ArtifactCache::getEntryPath(ArtifactKey key)
+{
+    std::string stage = key.getStage();
+    std::replace(stage.begin(), stage.end(), ' ', '_');
+    std::replace(stage.begin(), stage.end(), '/', '_');
+
+    return m_Dir + stage + "/" + key.str() + "/";
+}
+
+bool ArtifactCache::restore(ArtifactKey key, std::vector<std::string> outputs)
+{
+    if (m_Dir.empty())
+        return false;
+
+    std::string entry = getEntryPath(key);
+
+    // The manifest is the last written, an entry without it was not completed
+    std::ifstream manifest ((entry + "paths").c_str());
+    if (!manifest.is_open())
+        return false;
+
+    std::vector<bool> presences;
+    std::string line;
+    while (std::getline(manifest, line))
+    {
+        if (line.size() < 2 || presences.size() >= outputs.size() || line.substr(2) != outputs[presences.size()])
+            return false;
+
+        presences.push_back(line[0] == '1');
+    }
+    if (presences.size() != outputs.size())
+        return false;
+
+    try
+    {
+        for (int i = 0; i < outputs.size(); i++)
+        {
+            fs::path target = canonicalPath(outputs[i]);
+            fs::remove_all(target); // stale files of a previous run would remain otherwise
+
+            std::stringstream ss;
+            ss << i;
+            if (presences[i])
+                copyRecursively(fs::path(entry) / ss.str(), target);
+        }
+    }
+    catch (fs::filesystem_error& e)
+    {
+        std::cerr << "[ArtifactCache] " << e.what() << std::endl;
+        return false;
+    }
+
+    std::cout << "[ArtifactCache] " << key.getStage() << " cached (" << key.str() << ")" << std::endl;
+
+    return true;
+}
+
+void ArtifactCache::store(ArtifactKey key, std::vector<std::string> outputs)
+{
+    if (m_Dir.empty())
+        return;
+
+    fs::path entry = canonicalPath(getEntryPath(key));
+
+    // Copied aside and renamed, so that a concurrent or interrupted run never sees it half-written
+    fs::path tmp = entry.string() + fs::unique_path(".%%%%-%%%%").string();
+
+    try
+    {
+        fs::create_directories(tmp);
+
+        std::ofstream manifest ((tmp / "paths").string().c_str());
+        for (int i = 0; i < outputs.size(); i++)
+        {
+            fs::path src = canonicalPath(outputs[i]);
+            bool bPresent = fs::exists(src);
+
+            std::stringstream ss;
+            ss << i;
+            if (bPresent)
+                copyRecursively(src, tmp / ss.str());
+
+            manifest << (bPresent ? '1' : '0') << ' ' << outputs[i] << std::endl;
+        }
+        manifest.close();
+
+        if (fs::exists(entry))
+            fs::remove_all(tmp); // stored by someone else meanwhile
+        else
+            fs::rename(tmp, entry);
+    }
+    catch (fs::filesystem_error& e)
+    {
+        std::cerr << "[ArtifactCache] Could not store " << key.getStage() << ": " << e.what() << std::endl;
+
+        boost::system::error_code ec;
+        fs::remove_all(tmp, ec);
+    }
+}
@@ -0,0 +1,89 @@
+//
+//  ArtifactCache.h
+//  segmenthreetion
+//
+//
+
+#ifndef __segmenthreetion__ArtifactCache__
+#define __segmenthreetion__ArtifactCache__
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+/*
+ * Key of what a stage's outputs were produced from: the stage, its parametrization,
+ * and the contents of its input files (FNV-1a, chained in the order they are added).
+ * The inputs are typically the outputs of the stages upstream, so that a stage is
+ * keyed by what these actually contain rather than by how they were computed.
+ */
+class ArtifactKey
+{
+public:
+    ArtifactKey(std::string stage);
+
+    ArtifactKey& operator<<(std::string value);
+    ArtifactKey& operator<<(const char* value);
+    ArtifactKey& operator<<(int value);
+    ArtifactKey& operator<<(double value);
+    template<typename T>
+    ArtifactKey& operator<<(const std::vector<T>& values)
+    {
+        *this << (int) values.size();
+        for (int i = 0; i < values.size(); i++)
+            *this << values[i];
+        return *this;
+    }
+
+    // The contents of a file, or the names and contents of the files within a directory
+    ArtifactKey& addFile(std::string path);
+
+    std::string getStage();
+    std::string str(); // hexadecimal
+
+private:
+    void hash(const void* data, size_t size);
+
+    std::string m_Stage;
+    uint64 m_Hash;
+};
+
+/*
+ * Content-addressed cache of the files produced by the stages of the pipeline
+ * (descriptions, predictions, goodnesses, masks). An entry holds the outputs of
+ * a stage and is addressed by the stage's ArtifactKey. On a hit, the outputs are
+ * restored in place, so that the files of other runs (other parameters, other
+ * inputs) are never reused; on a miss, the stage runs and its outputs are stored:
+ *
+ *   ArtifactKey key ("Color description");
+ *   key << hp << wp << config.describe("features.color");
+ *   key.addFile(scenePath + "Masks/Color.yml");
+ *
+ *   if (!cache.restore(key, outputs))
+ *   {
+ *       ... // produce the outputs
+ *       cache.store(key, outputs);
+ *   }
+ *
+ * A stage downstream adds these outputs to its key, so it reruns only if they
+ * changed. The outputs can be files or directories. An empty cache directory
+ * disables the cache (nothing is restored nor stored).
+ */
+class ArtifactCache
+{
+public:
+    ArtifactCache(std::string dir = "Cache/");
+
+    // Restores the outputs of the entry of key, returns whether there was one
+    bool restore(ArtifactKey key, std::vector<std::string> outputs);
+    void store(ArtifactKey key, std::vector<std::string> outputs);
+
+private:
+    std::string getEntryPath(ArtifactKey key);
+
+    std::string m_Dir;
+};
+
+#endif /* defined(__segmenthreetion__ArtifactCache__) */
@@ -0,0 +1,71 @@
+//
+//  BoundedQueue.hpp
+//  segmenthreetion
+//
+//
+
+#ifndef __segmenthreetion__BoundedQueue__
+#define __segmenthreetion__BoundedQueue__
+
+#include <deque>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+/*
+ * Blocking FIFO with a maximum capacity, used to connect the stages of
+ * a producer/consumer pipeline. push() blocks while the queue is full and
+ * pop() blocks while it is empty. Once close() has been called, pop()
+ * drains the remaining items and then returns false.
+ */
+template<typename T>
+class BoundedQueue
+{
+public:
+    BoundedQueue(unsigned int capacity = 8) : m_Capacity(capacity > 0 ? capacity : 1), m_bClosed(false) {}
+
+    void push(const T& item)
+    {
+        boost::unique_lock<boost::mutex> lock (m_Mutex);
+        while (m_Items.size() >= m_Capacity && !m_bClosed)
+            m_NotFull.wait(lock);
+
+        if (m_bClosed) return;
+
+        m_Items.push_back(item);
+        m_NotEmpty.notify_one();
+    }
+
+    bool pop(T& item)
+    {
+        boost::unique_lock<boost::mutex> lock (m_Mutex);
+        while (m_Items.empty() && !m_bClosed)
+            m_NotEmpty.wait(lock);
+
+        if (m_Items.empty()) return false; // closed and drained
+
+        item = m_Items.front();
+        m_Items.pop_front();
+        m_NotFull.notify_one();
+
+        return true;
+    }
+
+    void close()
+    {
+        boost::unique_lock<boost::mutex> lock (m_Mutex);
+        m_bClosed = true;
+        m_NotEmpty.notify_all();
+        m_NotFull.notify_all();
+    }
+
+private:
+    std::deque<T> m_Items;
+    unsigned int m_Capacity;
+    bool m_bClosed;
+
+    boost::mutex m_Mutex;
+    boost::condition_variable m_NotEmpty, m_NotFull;
+};
+
+#endif /* defined(__segmenthreetion__BoundedQueue__) */
@@ -0,0 +1,128 @@
+//
+//  DepthBackgroundModel.cpp
+//  segmenthreetion
+//
+//
+
+#include "DepthBackgroundModel.h"
+
+#include <opencv2/core/internal.hpp>
+
+#include <algorithm>
+
+#if CV_SSE2
+#include <emmintrin.h>
+#endif
+
+DepthBackgroundModel::DepthBackgroundModel()
+: m_Threshold(768), m_LearningStep(64)
+{ }
+
+DepthBackgroundModel::DepthBackgroundModel(unsigned short threshold, unsigned short learningStep)
+: m_Threshold(threshold), m_LearningStep(learningStep)
+{ }
+
+void DepthBackgroundModel::setThreshold(unsigned short threshold)
+{
+    m_Threshold = threshold;
+}
+
+void DepthBackgroundModel::setLearningStep(unsigned short learningStep)
+{
+    m_LearningStep = learningStep;
+}
+
+void DepthBackgroundModel::operator()(cv::Mat depth, cv::Mat& fgMask, bool update)
+{
+    CV_Assert (depth.type() == CV_16UC1);
+
+    fgMask.create(depth.rows, depth.cols, CV_8UC1);
+
+    if (m_Background.empty() || m_Background.size() != depth.size())
+    {
+        depth.copyTo(m_Background); // invalid (0) pixels remain uninitialized
+        fgMask.setTo(0);
+        return;
+    }
+
+    for (int i = 0; i < depth.rows; i++)
+    {
+        processRow(depth.ptr<unsigned short>(i), m_Background.ptr<unsigned short>(i),
+                   fgMask.ptr<unsigned char>(i), depth.cols, update);
+    }
+}
+
+void DepthBackgroundModel::getBackgroundDepth(cv::Mat& background)
+{
+    m_Background.copyTo(background);
+}
+
+void DepthBackgroundModel::release()
+{
+    m_Background.release();
+}
+
+void DepthBackgroundModel::processRow(const unsigned short* depth, unsigned short* background, unsigned char* mask, int n, bool update)
+{
+    int j = 0;
+
+#if CV_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i thresh = _mm_set1_epi16((short) m_Threshold);
+    const __m128i step = _mm_set1_epi16((short) m_LearningStep);
+
+    // SSE2 has no unsigned 16-bit comparisons: a > b iff subs_epu16(a,b) != 0
+    for ( ; j <= n - 8; j += 8)
+    {
+        __m128i d = _mm_loadu_si128((const __m128i*)(depth + j));
+        __m128i b = _mm_loadu_si128((const __m128i*)(background + j));
+
+        __m128i dValid = _mm_xor_si128(_mm_cmpeq_epi16(d, zero), _mm_set1_epi16(-1));
+        __m128i bValid = _mm_xor_si128(_mm_cmpeq_epi16(b, zero), _mm_set1_epi16(-1));
+
+        // foreground: valid, and closer than the background by more than the threshold
+        __m128i closer = _mm_subs_epu16(_mm_subs_epu16(b, d), thresh);
+        __m128i fg = _mm_and_si128(_mm_and_si128(dValid, bValid),
+                                   _mm_xor_si128(_mm_cmpeq_epi16(closer, zero), _mm_set1_epi16(-1)));
+
+        _mm_storel_epi64((__m128i*)(mask + j), _mm_packs_epi16(fg, zero));
+
+        if (update)
+        {
+            // move the background one step towards the observed depth
+            __m128i up = _mm_subs_epu16(d, b);   // d - b if d > b, else 0
+            __m128i down = _mm_subs_epu16(b, d); // b - d if b > d, else 0
+
+            // clamp the increments to the learning step (unsigned min via subs)
+            up = _mm_subs_epu16(up, _mm_subs_epu16(up, step));
+            down = _mm_subs_epu16(down, _mm_subs_epu16(down, step));
+
+            __m128i nb = _mm_subs_epu16(_mm_adds_epu16(b, up), down);
+
+            // uninitialized background takes the observed depth, invalid depth keeps the model
+            nb = _mm_or_si128(_mm_and_si128(bValid, nb), _mm_andnot_si128(bValid, d));
+            nb = _mm_or_si128(_mm_and_si128(dValid, nb), _mm_andnot_si128(dValid, b));
+
+            _mm_storeu_si128((__m128i*)(background + j), nb);
+        }
+    }
+#endif
+
+    for ( ; j < n; j++)
+    {
+        unsigned short d = depth[j];
+        unsigned short b = background[j];
+
+        mask[j] = (d > 0 && b > 0 && b > d && (b - d) > m_Threshold) ? 255 : 0;
+
+        if (update && d > 0)
+        {
+            if (b == 0)
+                background[j] = d;
+            else if (d > b)
+                background[j] = b + std::min<int>(d - b, m_LearningStep);
+            else if (d < b)
+                background[j] = b - std::min<int>(b - d, m_LearningStep);
+        }
+    }
+}
@@ -0,0 +1,51 @@
+//
+//  DepthBackgroundModel.h
+//  segmenthreetion
+//
+//
+
+#ifndef __segmenthreetion__DepthBackgroundModel__
+#define __segmenthreetion__DepthBackgroundModel__
+
+#include <iostream>
+
+#include <opencv2/core/core.hpp>
+
+/*
+ * Per-pixel background model working directly on raw 16-bit single-channel
+ * depth frames. The background depth of each pixel is estimated as a running
+ * (approximate) median: each update moves it one learning step towards the
+ * observed depth. Pixels with invalid depth (0) neither update the model nor
+ * are marked as foreground. A pixel is foreground when it is closer to the
+ * camera than its background depth by more than the threshold.
+ *
+ * The output mask follows the contract of cv::BackgroundSubtractorMOG2 without
+ * shadow detection: CV_8UC1 with 255 in the foreground and 0 elsewhere.
+ */
+class DepthBackgroundModel
+{
+public:
+    DepthBackgroundModel();
+    DepthBackgroundModel(unsigned short threshold, unsigned short learningStep);
+
+    void setThreshold(unsigned short threshold);
+    void setLearningStep(unsigned short learningStep);
+
+    // Computes the foreground mask of depth (CV_16UC1) and, if update is true,
+    // updates the model with it. The first frame always initializes the model.
+    void operator()(cv::Mat depth, cv::Mat& fgMask, bool update = true);
+
+    void getBackgroundDepth(cv::Mat& background);
+
+    void release();
+
+private:
+    cv::Mat m_Background; // CV_16UC1, 0 where never observed
+
+    unsigned short m_Threshold;
+    unsigned short m_LearningStep;
+
+    void processRow(const unsigned short* depth, unsigned short* background, unsigned char* mask, int n, bool update);
+};
+
+#endif /* defined(__segmenthreetion__DepthBackgroundModel__) */
@@ -8,11 +8,16 @@
 
 #include "BackgroundSubtractor.h"
 #include "DepthBackgroundSubtractor.h"
+#include "DepthBackgroundModel.h"
 #include "StatTools.h"
+#include "MaskLabelling.h"
 #include "DebugTools.h"
 
 #include <opencv2/opencv.hpp>
 
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
 DepthBackgroundSubtractor::DepthBackgroundSubtractor()
 : BackgroundSubtractor()
 { }
@@ -41,53 +46,151 @@ DepthBackgroundSubtractor::DepthBackgroundSubtractor(ForegroundParametrization f
 
 void DepthBackgroundSubtractor::getMasks(ModalityData& md) {
     
-    vector<cv::Mat> masks;
-    
-    //Per scene
+    // Frames of different scenes are stored contiguously in md, the i-th
+    // scene starting at sceneOffsets[i]
+    vector<int> sceneOffsets (md.getNumScenes(), 0);
+    int nFrames = 0;
     for(int scene = 0; scene < md.getNumScenes(); scene++) {
+        sceneOffsets[scene] = nFrames;
+        nFrames += md.getSceneSize(scene);
+    }
+    
+    vector<cv::Mat> masks (nFrames);
+    vector<vector<cv::Rect> > boundingRects (nFrames);
+    
+    //Per scene (each one with its own background model)
+    parallelFor(md.getNumScenes(), boost::bind(&DepthBackgroundSubtractor::getSceneMasks, this, boost::ref(md), _1,
+                                               boost::cref(sceneOffsets), boost::ref(masks), boost::ref(boundingRects)));
+    
+    md.setPredictedMasks(masks);
+    md.setPredictedBoundingRects(boundingRects);
+    
+}
+
+/*
+ * Background subtraction of a scene run as a pipeline of four stages, each
+ * one in its own thread and connected through bounded queues:
+ * decode -> 16-bit depth background model -> Otsu refinement -> bounding rects.
+ * The results are written in the positions [offset, offset + sceneSize) of masks
+ * and boundingRects, offset being the scene's one. If a stage throws, the others
+ * stop, and the exception is rethrown once they are joined.
+ */
+void DepthBackgroundSubtractor::getSceneMasks(ModalityData& md, int scene, const vector<int>& sceneOffsets,
+                                              vector<cv::Mat>& masks, vector<vector<cv::Rect> >& boundingRects)
+{
+    const unsigned int queueCapacity = 16;
+    int offset = sceneOffsets[scene];
+    
+    BoundedQueue<DepthPipelineItem> decodedQueue (queueCapacity);
+    BoundedQueue<DepthPipelineItem> subtractedQueue (queueCapacity);
+    BoundedQueue<DepthPipelineItem> refinedQueue (queueCapacity);
+    
+    ParallelError error;
+    boost::thread_group stagesThreads;
+    try
+    {
+        stagesThreads.create_thread(boost::bind(&DepthBackgroundSubtractor::decodeStage, this,
+                                                boost::ref(md), scene, boost::ref(decodedQueue), boost::ref(error)));
+        stagesThreads.create_thread(boost::bind(&DepthBackgroundSubtractor::subtractionStage, this,
+                                                m_fParam.numFramesToLearn[scene],
+                                                boost::ref(decodedQueue), boost::ref(subtractedQueue), boost::ref(error)));
+        stagesThreads.create_thread(boost::bind(&DepthBackgroundSubtractor::refinementStage, this,
+                                                boost::ref(subtractedQueue), boost::ref(refinedQueue), boost::ref(error)));
         
-        //Initialize BackgroundSubtractorMOG2 class
-        int history = m_fParam.numFramesToLearn[scene];
-        float varThreshold = 3;
-        cv::BackgroundSubtractorMOG2 bgsubtractor(history, varThreshold, false);
-        cv::Mat frame;
+        // Bounding rects stage (in the calling thread)
+        DepthPipelineItem item;
+        while (!error.hasFailed() && refinedQueue.pop(item))
+        {
+            this->getFrameBoundingRects(item.mask, boundingRects[offset + item.f]);
+            masks[offset + item.f] = item.mask;
+        }
+    }
+    catch (...)
+    {
+        error.capture();
+    }
+    
+    // Once closed, the stages still running do not block on a full queue anymore
+    decodedQueue.close();
+    subtractedQueue.close();
+    refinedQueue.close();
+    
+    stagesThreads.join_all();
+    error.rethrow();
+}
+
+void DepthBackgroundSubtractor::decodeStage(ModalityData& md, int scene, BoundedQueue<DepthPipelineItem>& output, ParallelError& error)
+{
+    try
+    {
+        for(int f = 0; f < md.getSceneSize(scene) && !error.hasFailed(); f++) {
+            
+            DepthPipelineItem item;
+            item.f = f;
+            
+            item.depth = md.getFrameInScene(scene, f);
+            item.depth.convertTo(item.frame, CV_8UC1, 0.00390625); // for the Otsu refinement
+            
+            output.push(item);
+        }
+    }
+    catch (...)
+    {
+        error.capture();
+    }
+    output.close();
+}
+
+void DepthBackgroundSubtractor::subtractionStage(int history, BoundedQueue<DepthPipelineItem>& input, BoundedQueue<DepthPipelineItem>& output, ParallelError& error)
+{
+    try
+    {
+        // Background model on the raw 16-bit depth
+        DepthBackgroundModel bgmodel (m_fParam.depthThreshold, m_fParam.depthLearningStep);
         
-        //Per frame in scene
-        for(int f = 0; f < md.getSceneSize(scene); f++) {
+        DepthPipelineItem item;
+        while (!error.hasFailed() && input.pop(item))
+        {
+            cv::Mat fgMask;
             
-            vector<cv::Mat> outputMasksTemp;
+            item.bLearning = (item.f < history);
+            bgmodel(item.depth, fgMask, item.bLearning);
             
-            cv::Mat output, realFrame (md.getFrameInScene(scene, f));
-            //cout << realFrame.type() << " " << realFrame.dims << " ";
-            realFrame.convertTo(realFrame, CV_8UC3, 0.00390625);
-            cvtColor(realFrame, frame, CV_GRAY2BGR,3);
-            cout << frame.depth() << " " << frame.type() << " " << frame.channels() << endl;
+            item.mask = fgMask;
+            item.depth.release();
             
-            if(f < history)
-            {
-                bgsubtractor(frame, output, f == 0 ? 1 : 0.02);
-                output = cv::Mat::zeros(frame.rows, frame.cols, CV_8UC1);
-                outputMasksTemp.push_back(cv::Mat::zeros(frame.rows, frame.cols, CV_8UC1));
-            }
+            output.push(item);
+        }
+    }
+    catch (...)
+    {
+        error.capture();
+    }
+    output.close();
+}
+
+void DepthBackgroundSubtractor::refinementStage(BoundedQueue<DepthPipelineItem>& input, BoundedQueue<DepthPipelineItem>& output, ParallelError& error)
+{
+    try
+    {
+        DepthPipelineItem item;
+        while (!error.hasFailed() && input.pop(item))
+        {
+            if (item.bLearning)
+                item.mask = cv::Mat::zeros(item.frame.rows, item.frame.cols, CV_8UC1);
             else
-            {
-                output = cv::Mat::zeros(frame.rows, frame.cols, CV_8UC1);
-                bgsubtractor(frame, output, 0);
-                this->extractItemsFromMask(frame, output);
-                
-            }
-            masks.push_back(output);
+                this->extractItemsFromMask(item.frame, item.mask);
+            
+            item.frame.release(); // not needed anymore
             
-            //Debug -  visualization purposes
-            cv::imshow("output", output);
-            cv::imshow("frame", frame);
-            cv::waitKey(10);
+            output.push(item);
         }
-        
     }
-    
-    md.setPredictedMasks(masks);
-    
+    catch (...)
+    {
+        error.capture();
+    }
+    output.close();
 }
 
 void DepthBackgroundSubtractor::getBoundingRects(ModalityData& md) {
@@ -96,28 +199,7 @@ void DepthBackgroundSubtractor::getBoundingRects(ModalityData& md) {
     
     for(unsigned int f = 0; f < md.getFrames().size(); f++)
     {
-        vector<int> uniqueValuesMask;
-        cv::Mat predMask = md.getPredictedMask(f);
-        findUniqueValues(predMask, uniqueValuesMask);
-        
-        for(unsigned int i = 0; i < uniqueValuesMask.size(); i++)
-        {
-            cv::Rect bigBoundingBox;
-            vector<cv::Rect> maskBoundingBoxes;
-            this->getMaskBoundingBoxes(md.getPredictedMask(f, i) , maskBoundingBoxes);
-            
-            if(!maskBoundingBoxes.empty()) {
-                this->getMaximalBoundingBox(maskBoundingBoxes, predMask.size(), bigBoundingBox);
-                
-                if(!this->checkMinimumBoundingBoxes(bigBoundingBox, 4)) {
-                    boundingRects[f].push_back(getMinimumBoundingBox(bigBoundingBox, 4));
-                } else {
-                    boundingRects[f].push_back(bigBoundingBox);
-                }
-            }
-            
-        }
-        
+        this->getFrameBoundingRects(md.getPredictedMask(f), boundingRects[f]);
     }
     
     md.setPredictedBoundingRects(boundingRects);
@@ -128,6 +210,28 @@ void DepthBackgroundSubtractor::getBoundingRects(ModalityData& md) {
     
 }
 
+void DepthBackgroundSubtractor::getFrameBoundingRects(cv::Mat predMask, vector<cv::Rect>& boundingRects)
+{
+    vector<LabelStats> labelsStats;
+    computeLabelStatistics(predMask, labelsStats);
+    
+    for(unsigned int i = 0; i < labelsStats.size(); i++)
+    {
+        if (labelsStats[i].label < this->getMasksOffset())
+            continue;
+        
+        cv::Rect bigBoundingBox;
+        vector<cv::Rect> maskBoundingBoxes (1, labelsStats[i].boundingRect);
+        this->getMaximalBoundingBox(maskBoundingBoxes, predMask.size(), bigBoundingBox);
+        
+        if(!this->checkMinimumBoundingBoxes(bigBoundingBox, 4)) {
+            boundingRects.push_back(getMinimumBoundingBox(bigBoundingBox, 4));
+        } else {
+            boundingRects.push_back(bigBoundingBox);
+        }
+    }
+}
+
 void DepthBackgroundSubtractor::extractItemsFromMask(cv::Mat frame, cv::Mat & mask){
     
     cv::Mat valuedMask = cv::Mat::zeros(mask.rows, mask.cols, CV_8UC1);
@@ -203,8 +307,7 @@ void DepthBackgroundSubtractor::extractItemsFromMask(cv::Mat frame, cv::Mat & ma
            ((boundRect[i].tl().x < 55 || boundRect[i].br().x > frame.cols - 15) && blobArea > bbMinArea/2))
 		{
             cv::Mat roiMask, frameGray, otsuMask;
-            //frameGray.convertTo(frameGray, CV_8UC1);
-            cvtColor(frame,frameGray,CV_RGB2GRAY,1);
+            frameGray = frame; // already 8-bit single-channel
 			roiMask = cv::Mat::zeros(frame.size(),CV_8UC1);
             
 			drawContours( roiMask, contours, i, cv::Scalar::all(255), CV_FILLED, 8, vector<cv::Vec4i>());
@@ -217,7 +320,6 @@ void DepthBackgroundSubtractor::extractItemsFromMask(cv::Mat frame, cv::Mat & ma
             cv::Mat roi, contourRegion, whiteRegion, blackRegion;
 			frameGray.copyTo(roi,roiMask);
             roi.convertTo(roi, CV_8UC1);
-            cout << "thresh " << roi.type() << " " << roi.dims << endl;
 			threshold(roi,blackRegion,200,255,CV_THRESH_TOZERO_INV);
 			threshold(roi,whiteRegion,200,255,CV_THRESH_BINARY);
             
@@ -390,23 +492,11 @@ void DepthBackgroundSubtractor::extractItemsFromMask(cv::Mat frame, cv::Mat & ma
             
             add(valuedMask, item[o].first, valuedMask);
             
-            //Debug purposes - show mask unique valuess
-            vector<int> uniqueValues;
-            findUniqueValues(item[o].first, uniqueValues);
-            //for (auto c : uniqueValues)
-            //    cout << c << ' ';
-            
             nItem++;
         }
     }
     
     valuedMask.copyTo(mask);
-    
-    //Debug purposes - show mask unique values
-    vector<int> uniqueValues;
-    findUniqueValues(mask, uniqueValues);
-    //for (auto c : uniqueValues)
-    //    cout << c << ' ';
 }
 
 void DepthBackgroundSubtractor::adaptGroundTruthToReg(ModalityData& md) {
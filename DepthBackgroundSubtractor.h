@@ -14,6 +14,18 @@
 #include "BackgroundSubtractor.h"
 #include "ModalityData.hpp"
 #include "ForegroundParametrization.hpp"
+#include "BoundedQueue.hpp"
+#include "ParallelFor.h"
+
+// Frame travelling through the stages of the depth background subtraction pipeline
+struct DepthPipelineItem
+{
+    int f; // frame index within the scene
+    bool bLearning; // the frame was used to learn the background model
+    cv::Mat depth; // raw 16-bit depth
+    cv::Mat frame; // 8-bit depth
+    cv::Mat mask;
+};
 
 class DepthBackgroundSubtractor : public BackgroundSubtractor {
 
@@ -24,6 +36,14 @@ private:
     
     void extractItemsFromMask(cv::Mat frame, cv::Mat & output);
     
+    void getFrameBoundingRects(cv::Mat predMask, vector<cv::Rect>& boundingRects);
+    
+    // Pipelined per-scene background subtraction
+    void getSceneMasks(ModalityData& md, int scene, const vector<int>& sceneOffsets, vector<cv::Mat>& masks, vector<vector<cv::Rect> >& boundingRects);
+    void decodeStage(ModalityData& md, int scene, BoundedQueue<DepthPipelineItem>& output, ParallelError& error);
+    void subtractionStage(int history, BoundedQueue<DepthPipelineItem>& input, BoundedQueue<DepthPipelineItem>& output, ParallelError& error);
+    void refinementStage(BoundedQueue<DepthPipelineItem>& input, BoundedQueue<DepthPipelineItem>& output, ParallelError& error);
+    
 public:
     
     DepthBackgroundSubtractor();
@@ -36,6 +56,8 @@ public:
     
     //void setMasksOffset(unsigned char masksOffset);
     
+    // Computes the masks and the bounding rects of the foreground items. Scenes are
+    // processed in parallel
     void getMasks(ModalityData& md);
     
     void getBoundingRects(ModalityData& md);
@@ -7,6 +7,7 @@
 //
 
 #include "FeatureExtractor.h"
+#include "Trace.h"
 
 
 FeatureExtractor::FeatureExtractor()
@@ -15,6 +16,9 @@ FeatureExtractor::FeatureExtractor()
 
 void FeatureExtractor::describe(ModalityGridData& data)
 {
+    TRACE_SCOPE("FeatureExtractor::describe (" + data.getModality() + ")");
+    TRACE_ITEMS(data.getGridsFrames().size());
+    
 	for (int k = 0; k < data.getGridsFrames().size(); k++)
 	{
         if (k % 1000 == 0) cout << 100.0 * k / data.getGridsFrames().size() << "%" <<  endl; // debug
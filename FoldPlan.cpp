@@ -0,0 +1,459 @@
+//
+//  FoldPlan.cpp
+//  segmenthreetion
+//
+//
+
+#include "FoldPlan.h"
+#include "StatTools.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+#include <boost/thread/mutex.hpp>
+
+//
+// FoldPartition
+//
+
+namespace
+{
+    // The shared partitions, by their labels' hash (if labelled), k and seed
+    struct PartitionKey
+    {
+        bool bLabelled;
+        uint64 hash;
+        int n, k, seed;
+
+        bool operator<(const PartitionKey& other) const
+        {
+            if (bLabelled != other.bLabelled) return bLabelled < other.bLabelled;
+            if (hash != other.hash) return hash < other.hash;
+            if (n != other.n) return n < other.n;
+            if (k != other.k) return k < other.k;
+            return seed < other.seed;
+        }
+    };
+
+    typedef std::multimap<PartitionKey, boost::shared_ptr<const FoldPartition> > PartitionsCache;
+
+    const int g_MaxCachedPartitions = 256; // beyond, the cache starts over
+
+    boost::mutex g_PartitionsMutex;
+    PartitionsCache g_Partitions;
+
+    // The labels as a continuous n x 1 vector of ints
+    cv::Mat labelsColumn(cv::Mat labels)
+    {
+        if (labels.empty())
+            return cv::Mat(0, 1, cv::DataType<int>::type);
+
+        cv::Mat column = labels;
+        if (labels.type() != cv::DataType<int>::type)
+            labels.convertTo(column, cv::DataType<int>::type);
+        if (!column.isContinuous())
+            column = column.clone();
+
+        return column.reshape(1, column.total());
+    }
+
+    uint64 hashLabels(cv::Mat labels)
+    {
+        uint64 hash = 14695981039346656037ULL; // FNV-1a, as ArtifactKey
+        const unsigned char* p = labels.ptr();
+        for (size_t i = 0; i < labels.total() * labels.elemSize(); i++)
+        {
+            hash ^= p[i];
+            hash *= 1099511628211ULL;
+        }
+
+        return hash;
+    }
+
+    // Fisher-Yates shuffle of [0,n)
+    void shuffle(int n, cv::RNG& rng, std::vector<int>& shuffled)
+    {
+        shuffled.resize(n);
+        for (int i = 0; i < n; i++) shuffled[i] = i;
+        for (int i = n - 1; i > 0; i--)
+            std::swap(shuffled[i], shuffled[rng.uniform(0, i + 1)]);
+    }
+
+    // Deals n shuffled rows to k folds, the first n % k of the folds in a shuffled order
+    // taking one more row than the others (cvpartition of n elements)
+    void dealRows(const int* rows, int n, int k, int seed, int* partitions, std::vector<int>& shuffled, std::vector<int>& folds)
+    {
+        cv::RNG rng (seed);
+        shuffle(n, rng, shuffled);
+        shuffle(k, rng, folds);
+
+        int foldElems = n / k;
+        int extraElems = n - k * foldElems;
+
+        std::vector<bool> bExtra (k, false);
+        for (int f = 0; f < extraElems; f++) bExtra[folds[f]] = true;
+
+        int c = 0;
+        for (int f = 0; f < k; f++)
+        {
+            int ifoldElems = bExtra[f] ? (foldElems + 1) : foldElems;
+            for (int j = 0; j < ifoldElems; j++)
+                partitions[rows[shuffled[c+j]]] = f;
+            c += ifoldElems;
+        }
+    }
+}
+
+FoldPartition::FoldPartition()
+: m_NumOfFolds(0), m_Seed(0), m_MinLabel(0)
+{ }
+
+FoldPartition::FoldPartition(cv::Mat labels, int k, int seed)
+{
+    create(labels, k, seed);
+}
+
+void FoldPartition::create(cv::Mat labels, int k, int seed)
+{
+    CV_Assert (k > 0);
+
+    m_Labels = labelsColumn(labels).clone(); // kept, to tell apart the labels hashing alike
+    m_NumOfFolds = k;
+    m_Seed = seed;
+
+    int n = m_Labels.rows;
+    const int* l = m_Labels.ptr<int>(0);
+
+    // Labels do not need to be in [0, #classes - 1], but are supposed to be consecutive
+    double minVal = 0, maxVal = -1;
+    if (n > 0) cv::minMaxIdx(m_Labels, &minVal, &maxVal);
+    m_MinLabel = minVal;
+    int nclasses = maxVal - minVal + 1;
+
+    // The rows of each class, contiguously by class
+    std::vector<int> classOffsets (nclasses + 1, 0);
+    for (int i = 0; i < n; i++) classOffsets[l[i] - m_MinLabel + 1]++;
+    for (int c = 0; c < nclasses; c++) classOffsets[c+1] += classOffsets[c];
+
+    std::vector<int> classesRows (n);
+    std::vector<int> next (classOffsets.begin(), classOffsets.end() - 1);
+    for (int i = 0; i < n; i++) classesRows[next[l[i] - m_MinLabel]++] = i;
+
+    // Partition separately the rows of each class
+    m_Partitions.create(n, 1, cv::DataType<int>::type);
+    m_Strata.create(k, nclasses, cv::DataType<int>::type);
+    m_Strata.setTo(0);
+
+    std::vector<int> shuffled, folds; // dealRows' buffers
+    for (int c = 0; c < nclasses; c++)
+    {
+        const int* rows = &classesRows[0] + classOffsets[c];
+        int nrows = classOffsets[c+1] - classOffsets[c];
+        dealRows(rows, nrows, k, seed, m_Partitions.ptr<int>(0), shuffled, folds);
+
+        for (int i = 0; i < nrows; i++)
+            m_Strata.at<int>(m_Partitions.at<int>(rows[i],0), c)++;
+    }
+
+    index();
+}
+
+void FoldPartition::index()
+{
+    int k = m_NumOfFolds;
+    int n = m_Partitions.rows;
+    const int* p = m_Partitions.ptr<int>(0);
+
+    m_Offsets.assign(k + 1, 0);
+    for (int i = 0; i < n; i++) m_Offsets[p[i] + 1]++;
+    for (int f = 0; f < k; f++) m_Offsets[f+1] += m_Offsets[f];
+
+    // Counting sort by fold, stable, so the rows of a fold are in ascending order
+    m_Indices.resize(n);
+    std::vector<int> next (m_Offsets.begin(), m_Offsets.end() - 1);
+    for (int i = 0; i < n; i++) m_Indices[next[p[i]]++] = i;
+}
+
+boost::shared_ptr<const FoldPartition> FoldPartition::get(cv::Mat labels, int k, int seed)
+{
+    cv::Mat column = labelsColumn(labels);
+
+    PartitionKey key;
+    key.bLabelled = true;
+    key.hash = hashLabels(column);
+    key.n = column.rows;
+    key.k = k;
+    key.seed = seed;
+
+    {
+        boost::mutex::scoped_lock lock (g_PartitionsMutex);
+
+        std::pair<PartitionsCache::iterator, PartitionsCache::iterator> range = g_Partitions.equal_range(key);
+        for (PartitionsCache::iterator it = range.first; it != range.second; ++it)
+        {
+            const cv::Mat& cached = it->second->m_Labels;
+            if (column.rows == 0 || memcmp(cached.ptr(), column.ptr(), column.rows * sizeof(int)) == 0)
+                return it->second;
+        }
+    }
+
+    // Computed outside the lock; two callers racing for the same one compute it twice
+    boost::shared_ptr<const FoldPartition> pPartition (new FoldPartition(column, k, seed));
+
+    boost::mutex::scoped_lock lock (g_PartitionsMutex);
+    if (g_Partitions.size() >= g_MaxCachedPartitions)
+        g_Partitions.clear();
+    g_Partitions.insert(std::make_pair(key, pPartition));
+
+    return pPartition;
+}
+
+boost::shared_ptr<const FoldPartition> FoldPartition::get(int n, int k, int seed)
+{
+    PartitionKey key;
+    key.bLabelled = false;
+    key.hash = 0;
+    key.n = n;
+    key.k = k;
+    key.seed = seed;
+
+    {
+        boost::mutex::scoped_lock lock (g_PartitionsMutex);
+
+        PartitionsCache::iterator it = g_Partitions.find(key);
+        if (it != g_Partitions.end())
+            return it->second;
+    }
+
+    boost::shared_ptr<const FoldPartition> pPartition (new FoldPartition(cv::Mat::zeros(n, 1, cv::DataType<int>::type), k, seed));
+
+    boost::mutex::scoped_lock lock (g_PartitionsMutex);
+    if (g_Partitions.size() >= g_MaxCachedPartitions)
+        g_Partitions.clear();
+    g_Partitions.insert(std::make_pair(key, pPartition));
+
+    return pPartition;
+}
+
+int FoldPartition::getNumOfFolds() const
+{
+    return m_NumOfFolds;
+}
+
+int FoldPartition::getNumOfRows() const
+{
+    return m_Partitions.rows;
+}
+
+int FoldPartition::getSeed() const
+{
+    return m_Seed;
+}
+
+cv::Mat FoldPartition::getPartitions() const
+{
+    return m_Partitions;
+}
+
+const int* FoldPartition::begin(int k) const
+{
+    return m_Indices.empty() ? NULL : &m_Indices[0] + m_Offsets[k];
+}
+
+const int* FoldPartition::end(int k) const
+{
+    return m_Indices.empty() ? NULL : &m_Indices[0] + m_Offsets[k+1];
+}
+
+int FoldPartition::size(int k) const
+{
+    return m_Offsets[k+1] - m_Offsets[k];
+}
+
+int FoldPartition::getMinLabel() const
+{
+    return m_MinLabel;
+}
+
+cv::Mat FoldPartition::getStrata() const
+{
+    return m_Strata;
+}
+
+bool FoldPartition::save(std::string file) const
+{
+    cv::FileStorage fs (file, cv::FileStorage::WRITE);
+    if (!fs.isOpened())
+        return false;
+
+    fs << "k" << m_NumOfFolds;
+    fs << "seed" << m_Seed;
+    fs << "minLabel" << m_MinLabel;
+    fs << "labels" << m_Labels;
+    fs << "partitions" << m_Partitions;
+    fs << "strata" << m_Strata;
+
+    return true;
+}
+
+bool FoldPartition::load(std::string file)
+{
+    cv::FileStorage fs (file, cv::FileStorage::READ);
+    if (!fs.isOpened())
+        return false;
+
+    fs["k"] >> m_NumOfFolds;
+    fs["seed"] >> m_Seed;
+    fs["minLabel"] >> m_MinLabel;
+    fs["labels"] >> m_Labels;
+    fs["partitions"] >> m_Partitions;
+    fs["strata"] >> m_Strata;
+
+    if (m_NumOfFolds <= 0 || m_Partitions.rows != m_Labels.rows || m_Strata.rows != m_NumOfFolds)
+        return false;
+
+    index();
+
+    return true;
+}
+
+//
+// FoldPlan
+//
+
+FoldPlan::FoldPlan()
+{ }
+
+FoldPlan::FoldPlan(cv::Mat partitions, cv::Mat responses, int k)
+{
+    create(partitions, responses, k);
+}
+
+void FoldPlan::create(cv::Mat partitions, cv::Mat responses, int k)
+{
+    CV_Assert (partitions.rows == responses.rows);
+
+    m_Partitions = partitions;
+    m_Responses = responses;
+
+    m_Train.assign(k, std::vector<int>());
+    m_Val.assign(k, std::vector<int>());
+    m_Test.assign(k, std::vector<int>());
+
+    m_InnerTrain.clear();
+    m_InnerVal.clear();
+
+    for (int i = 0; i < partitions.rows; i++)
+    {
+        int p = partitions.at<int>(i,0);
+
+        m_Test[p].push_back(i);
+        m_Val[(p + k - 1) % k].push_back(i); // partition p validates the outer fold p-1
+
+        if (responses.at<int>(i,0) < 0)
+            continue; // -1 labels not used in training
+
+        for (int f = 0; f < k; f++)
+            if (p != f && p != (f+1) % k) m_Train[f].push_back(i);
+    }
+}
+
+void FoldPlan::createInnerFolds(int k, int seed)
+{
+    int K = m_Test.size();
+
+    m_InnerTrain.assign(K, std::vector<std::vector<int> >(k));
+    m_InnerVal.assign(K, std::vector<std::vector<int> >(k));
+
+    for (int f = 0; f < K; f++)
+    {
+        // all the training rows of the outer fold, unknown category included
+        std::vector<int> rows;
+        for (int i = 0; i < m_Partitions.rows; i++)
+        {
+            int p = m_Partitions.at<int>(i,0);
+            if (p != f && p != (f+1) % K) rows.push_back(i);
+        }
+
+        cv::Mat responses;
+        gather(m_Responses, rows, responses);
+        boost::shared_ptr<const FoldPartition> pPartition = FoldPartition::get(responses, k, seed);
+        const int* partitions = pPartition->getPartitions().ptr<int>(0);
+
+        for (int i = 0; i < rows.size(); i++)
+        {
+            int p = partitions[i];
+
+            m_InnerVal[f][p].push_back(rows[i]);
+
+            if (responses.at<int>(i,0) < 0)
+                continue; // ignore unknown category (class -1) in training
+
+            for (int j = 0; j < k; j++)
+                if (j != p) m_InnerTrain[f][j].push_back(rows[i]);
+        }
+    }
+}
+
+int FoldPlan::getNumOfFolds() const
+{
+    return m_Test.size();
+}
+
+int FoldPlan::getNumOfInnerFolds() const
+{
+    return m_InnerVal.empty() ? 0 : m_InnerVal[0].size();
+}
+
+const std::vector<int>& FoldPlan::getTrainIndices(int k) const
+{
+    return m_Train[k];
+}
+
+const std::vector<int>& FoldPlan::getValidationIndices(int k) const
+{
+    return m_Val[k];
+}
+
+const std::vector<int>& FoldPlan::getTestIndices(int k) const
+{
+    return m_Test[k];
+}
+
+const std::vector<int>& FoldPlan::getInnerTrainIndices(int k, int j) const
+{
+    return m_InnerTrain[k][j];
+}
+
+const std::vector<int>& FoldPlan::getInnerValidationIndices(int k, int j) const
+{
+    return m_InnerVal[k][j];
+}
+
+void FoldPlan::gather(cv::Mat src, const std::vector<int>& indices, cv::Mat& dst)
+{
+    const int* begin = indices.empty() ? NULL : &indices[0];
+    gather(src, begin, begin + indices.size(), dst);
+}
+
+void FoldPlan::gather(cv::Mat src, const int* begin, const int* end, cv::Mat& dst)
+{
+    dst.create(end - begin, src.cols, src.type());
+
+    size_t rowSize = src.cols * src.elemSize();
+    for (int i = 0; begin + i != end; i++)
+        memcpy(dst.ptr(i), src.ptr(begin[i]), rowSize);
+}
+
+void FoldPlan::scatter(cv::Mat src, const std::vector<int>& indices, cv::Mat& dst)
+{
+    CV_Assert (src.rows == indices.size() && src.cols == dst.cols);
+
+    for (int i = 0; i < indices.size(); i++)
+    {
+        cv::Mat row = dst.row(indices[i]);
+        src.row(i).convertTo(row, dst.type());
+    }
+}
+
@@ -0,0 +1,123 @@
+//
+//  FoldPlan.h
+//  segmenthreetion
+//
+//
+
+#ifndef __segmenthreetion__FoldPlan__
+#define __segmenthreetion__FoldPlan__
+
+#include <iostream>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include <boost/shared_ptr.hpp>
+
+/*
+ * The stratified k-fold partition of a vector of labels (cvpartition's). The rows
+ * of each class are shuffled with the seed and dealt to the folds, the folds taking
+ * the remaining ones in a shuffled order too. It is the same for the same (labels,
+ * k, seed), so get() computes it once and shares it among its callers (modalities,
+ * grid cells, fusion classifiers, folds' model selections).
+ *
+ * Besides the fold of each row, it keeps the rows of each fold sorted, contiguously,
+ * to be gathered directly (see FoldPlan::gather), and the number of rows of each
+ * class in each fold. It is saved and loaded with cv::FileStorage.
+ */
+class FoldPartition
+{
+public:
+    FoldPartition();
+    FoldPartition(cv::Mat labels, int k, int seed);
+
+    void create(cv::Mat labels, int k, int seed);
+
+    // Computed on the first request of these (labels, k, seed), shared afterwards
+    static boost::shared_ptr<const FoldPartition> get(cv::Mat labels, int k, int seed);
+    // Same, of n elements of a single class (by (n, k, seed), without labels to hash)
+    static boost::shared_ptr<const FoldPartition> get(int n, int k, int seed);
+
+    int getNumOfFolds() const;
+    int getNumOfRows() const;
+    int getSeed() const;
+
+    cv::Mat getPartitions() const; // n x 1, the fold of each row (shared, not to be modified)
+
+    // The rows of the fold k, in ascending order: [begin(k), end(k))
+    const int* begin(int k) const;
+    const int* end(int k) const;
+    int size(int k) const;
+
+    int getMinLabel() const; // of the class 0
+    cv::Mat getStrata() const; // k x #classes, the rows of each class in each fold
+
+    bool save(std::string file) const;
+    bool load(std::string file);
+
+private:
+    void index(); // m_Indices and m_Offsets from m_Partitions
+
+    int m_NumOfFolds;
+    int m_Seed;
+    int m_MinLabel;
+
+    cv::Mat m_Labels; // n x 1, to tell these labels from others with the same hash
+    cv::Mat m_Partitions;
+    cv::Mat m_Strata;
+
+    std::vector<int> m_Indices; // the rows sorted by fold, and by row within a fold
+    std::vector<int> m_Offsets; // k + 1, where each fold's rows begin in m_Indices
+};
+
+/*
+ * Row indices of the splits of an out-of-sample k-fold cross-validation. They
+ * are computed once from the partitions' vector, so every stage of the CV
+ * (coarse and narrow model selection, out-of-sample prediction) gathers its
+ * rows directly instead of indexing the data with boolean masks.
+ *
+ * In the outer fold k, the test rows are those in partition k, the validation
+ * rows those in partition (k+1) % K, and the training rows the remaining ones
+ * but the ones with negative responses (unknown category).
+ *
+ * For model selection, the training rows of each outer fold (including the
+ * negative ones) are partitioned again in stratified inner folds, as
+ * cvpartition would do on them. The inner training rows discard the negative
+ * responses; the inner validation rows keep them.
+ *
+ * All the indices refer to rows of the original data.
+ */
+class FoldPlan
+{
+public:
+    FoldPlan();
+    FoldPlan(cv::Mat partitions, cv::Mat responses, int k);
+
+    void create(cv::Mat partitions, cv::Mat responses, int k);
+    void createInnerFolds(int k, int seed);
+
+    int getNumOfFolds() const;
+    int getNumOfInnerFolds() const;
+
+    const std::vector<int>& getTrainIndices(int k) const;
+    const std::vector<int>& getValidationIndices(int k) const;
+    const std::vector<int>& getTestIndices(int k) const;
+
+    const std::vector<int>& getInnerTrainIndices(int k, int j) const;
+    const std::vector<int>& getInnerValidationIndices(int k, int j) const;
+
+    // Copy the indexed rows of src to dst
+    static void gather(cv::Mat src, const std::vector<int>& indices, cv::Mat& dst);
+    static void gather(cv::Mat src, const int* begin, const int* end, cv::Mat& dst);
+    // Copy the rows of src to the indexed rows of (allocated) dst, converting them to dst's type
+    static void scatter(cv::Mat src, const std::vector<int>& indices, cv::Mat& dst);
+
+private:
+    cv::Mat m_Partitions;
+    cv::Mat m_Responses;
+
+    std::vector<std::vector<int> > m_Train, m_Val, m_Test;
+    std::vector<std::vector<std::vector<int> > > m_InnerTrain, m_InnerVal;
+};
+
+#endif /* defined(__segmenthreetion__FoldPlan__) */
@@ -12,7 +12,7 @@
 class ForegroundParametrization
 {
 public:
-    ForegroundParametrization() {}
+    ForegroundParametrization() : depthThreshold(768), depthLearningStep(64) {}
     
     std::vector<int> numFramesToLearn;
     
@@ -20,6 +20,9 @@ public:
     float otsuMinArea;
     float otsuMinVariance1;
     float otsuMinVariance2;
+    
+    unsigned short depthThreshold; // min. distance to the background depth (raw depth units)
+    unsigned short depthLearningStep; // max. change of the background depth per learning frame
 };
 
 
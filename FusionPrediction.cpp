@@ -8,6 +8,9 @@
 
 #include "FusionPrediction.h"
 #include "StatTools.h"
+#include "ParallelFor.h"
+#include "GridSearch.h"
+#include "Trace.h"
 #include <boost/assign/std/vector.hpp>
 
 #include <boost/thread.hpp>
@@ -18,46 +21,54 @@ using namespace boost::assign;
 // Instantiation of template member functions
 // -----------------------------------------------------------------------------
 
-template void ClassifierFusionPredictionBase<cv::EM40,CvBoost>::setData(vector<ModalityGridData> mgds, vector<GridMat> distsToMargin, vector<cv::Mat> predictions);
+template void ClassifierFusionPredictionBase<cv::EM40,CvBoost>::setData(const vector<ModalityGridData>& mgds, const vector<GridMat>& distsToMargin, const vector<cv::Mat>& predictions);
 //template void ClassifierFusionPredictionBase<cv::EM40,CvBoost>::setResponses(cv::Mat);
 template void ClassifierFusionPredictionBase<cv::EM40,CvBoost>::setModelSelection(bool flag);
 template void ClassifierFusionPredictionBase<cv::EM40,CvBoost>::setModelSelectionParameters(int, int, bool);
 template void ClassifierFusionPredictionBase<cv::EM40,CvBoost>::setTrainMirrored(bool flag);
 template void ClassifierFusionPredictionBase<cv::EM40,CvBoost>::setValidationParameters(int);
 template void ClassifierFusionPredictionBase<cv::EM40,CvBoost>::setStackedPrediction(bool flag);
+template void ClassifierFusionPredictionBase<cv::EM40,CvBoost>::setSuccessiveHalving(int eta);
 template cv::Mat ClassifierFusionPredictionBase<cv::EM40,CvBoost>::getAccuracies();
+template void ClassifierFusionPredictionBase<cv::EM40,CvBoost>::modelSelection(cv::Mat data, cv::Mat responses, cv::Mat params, cv::Mat& goodnesses);
 //template void ClassifierFusionPredictionBase<cv::EM40,CvBoost>::setPartitions(cv::Mat partitions);
 
 
-template void ClassifierFusionPredictionBase<cv::EM40,CvANN_MLP>::setData(vector<ModalityGridData> mgds, vector<GridMat> distsToMargin, vector<cv::Mat> predictions);
+template void ClassifierFusionPredictionBase<cv::EM40,CvANN_MLP>::setData(const vector<ModalityGridData>& mgds, const vector<GridMat>& distsToMargin, const vector<cv::Mat>& predictions);
 //template void ClassifierFusionPredictionBase<cv::EM40,CvANN_MLP>::setResponses(cv::Mat);
 template void ClassifierFusionPredictionBase<cv::EM40,CvANN_MLP>::setModelSelection(bool flag);
 template void ClassifierFusionPredictionBase<cv::EM40,CvANN_MLP>::setModelSelectionParameters(int, int, bool);
 template void ClassifierFusionPredictionBase<cv::EM40,CvANN_MLP>::setTrainMirrored(bool flag);
 template void ClassifierFusionPredictionBase<cv::EM40,CvANN_MLP>::setValidationParameters(int);
 template void ClassifierFusionPredictionBase<cv::EM40,CvANN_MLP>::setStackedPrediction(bool flag);
+template void ClassifierFusionPredictionBase<cv::EM40,CvANN_MLP>::setSuccessiveHalving(int eta);
 template cv::Mat ClassifierFusionPredictionBase<cv::EM40,CvANN_MLP>::getAccuracies();
+template void ClassifierFusionPredictionBase<cv::EM40,CvANN_MLP>::modelSelection(cv::Mat data, cv::Mat responses, cv::Mat params, cv::Mat& goodnesses);
 //template void ClassifierFusionPredictionBase<cv::EM40,CvANN_MLP>::setPartitions(cv::Mat partitions);
 
 
-template void ClassifierFusionPredictionBase<cv::EM40,CvSVM>::setData(vector<ModalityGridData> mgds, vector<GridMat> distsToMargin, vector<cv::Mat> predictions);
+template void ClassifierFusionPredictionBase<cv::EM40,CvSVM>::setData(const vector<ModalityGridData>& mgds, const vector<GridMat>& distsToMargin, const vector<cv::Mat>& predictions);
 //template void ClassifierFusionPredictionBase<cv::EM40,CvSVM>::setResponses(cv::Mat);
 template void ClassifierFusionPredictionBase<cv::EM40,CvSVM>::setModelSelection(bool flag);
 template void ClassifierFusionPredictionBase<cv::EM40,CvSVM>::setModelSelectionParameters(int, int, bool);
 template void ClassifierFusionPredictionBase<cv::EM40,CvSVM>::setTrainMirrored(bool flag);
 template void ClassifierFusionPredictionBase<cv::EM40,CvSVM>::setValidationParameters(int);
 template void ClassifierFusionPredictionBase<cv::EM40,CvSVM>::setStackedPrediction(bool flag);
+template void ClassifierFusionPredictionBase<cv::EM40,CvSVM>::setSuccessiveHalving(int eta);
 template cv::Mat ClassifierFusionPredictionBase<cv::EM40,CvSVM>::getAccuracies();
+template void ClassifierFusionPredictionBase<cv::EM40,CvSVM>::modelSelection(cv::Mat data, cv::Mat responses, cv::Mat params, cv::Mat& goodnesses);
 //template void ClassifierFusionPredictionBase<cv::EM40,CvSVM>::setPartitions(cv::Mat partitions);
 
-template void ClassifierFusionPredictionBase<cv::EM40,CvRTrees>::setData(vector<ModalityGridData> mgds, vector<GridMat> distsToMargin, vector<cv::Mat> predictions);
+template void ClassifierFusionPredictionBase<cv::EM40,CvRTrees>::setData(const vector<ModalityGridData>& mgds, const vector<GridMat>& distsToMargin, const vector<cv::Mat>& predictions);
 //template void ClassifierFusionPredictionBase<cv::EM40,CvRTrees>::setResponses(cv::Mat);
 template void ClassifierFusionPredictionBase<cv::EM40,CvRTrees>::setModelSelection(bool flag);
 template void ClassifierFusionPredictionBase<cv::EM40,CvRTrees>::setModelSelectionParameters(int, int, bool);
 template void ClassifierFusionPredictionBase<cv::EM40,CvRTrees>::setTrainMirrored(bool flag);
 template void ClassifierFusionPredictionBase<cv::EM40,CvRTrees>::setValidationParameters(int);
 template void ClassifierFusionPredictionBase<cv::EM40,CvRTrees>::setStackedPrediction(bool flag);
+template void ClassifierFusionPredictionBase<cv::EM40,CvRTrees>::setSuccessiveHalving(int eta);
 template cv::Mat ClassifierFusionPredictionBase<cv::EM40,CvRTrees>::getAccuracies();
+template void ClassifierFusionPredictionBase<cv::EM40,CvRTrees>::modelSelection(cv::Mat data, cv::Mat responses, cv::Mat params, cv::Mat& goodnesses);
 //template void ClassifierFusionPredictionBase<cv::EM40,CvRTrees>::setPartitions(cv::Mat partitions);
 
 // -----------------------------------------------------------------------------
@@ -68,7 +79,7 @@ SimpleFusionPrediction::SimpleFusionPrediction()
     
 }
 
-void SimpleFusionPrediction::setModalitiesData(vector<ModalityGridData> mgds)
+void SimpleFusionPrediction::setModalitiesData(const vector<ModalityGridData>& mgds)
 {
     m_mgds = mgds;
     m_partitions = m_mgds[0].getPartitions();
@@ -85,69 +96,12 @@ void SimpleFusionPrediction::setModalitiesData(vector<ModalityGridData> mgds)
 void SimpleFusionPrediction::predict(vector<cv::Mat> allPredictions, vector<cv::Mat> allDistsToMargin,
                                      cv::Mat& fusionPredictions, cv::Mat& fusionDistsToMargin)
 {
-    // Concatenate along the horizontal direction all the modalities' predictions in a GridMat,
-    // and the same for the distsToMargin
+    TRACE_SCOPE("SimpleFusionPrediction::predict");
+    TRACE_ITEMS(allDistsToMargin[0].rows);
     
-    cv::Mat predictions = allPredictions[0];
-    cv::Mat distsToMargin = allDistsToMargin[0];
-    
-    for (int i = 1; i < allPredictions.size(); i++)
-    {
-        cv::hconcat(predictions,   allPredictions[i],   predictions);
-        cv::hconcat(distsToMargin, allDistsToMargin[i], distsToMargin);
-    }
-    
-    int n = predictions.rows;
-    
-    fusionPredictions.create(predictions.rows, 1, predictions.type());
-    fusionDistsToMargin.create(distsToMargin.rows, 1, distsToMargin.type());
-    
-    for (int k = 0; k < n; k++)
-    {
-        int pos = 0;
-        int neg = 0;
-        float accPosDists = 0;
-        float accNegDists = 0;
-        for (int m = 0; m < predictions.cols; m++)
-        {
-            float dist = distsToMargin.at<float>(k,m);
-            if (predictions.at<int>(k,m) == 0)
-            {
-                neg++;
-                accNegDists += dist;
-            }
-            else
-            {
-                pos++;
-                accPosDists += dist;
-            }
-        }
-        
-        if (pos < neg)
-        {
-            fusionPredictions.at<int>(k,0) = 0;
-            fusionDistsToMargin.at<float>(k,0) = accNegDists/neg;
-        }
-        else if (pos > neg)
-        {
-            fusionPredictions.at<int>(k,0) = 1;
-            fusionDistsToMargin.at<float>(k,0) = accPosDists/pos;
-        }
-        else
-        {
-            if (accPosDists/pos < abs(accNegDists/neg))
-            {
-                fusionPredictions.at<int>(k,0) = 0;
-                fusionDistsToMargin.at<float>(k,0) = accNegDists/neg;
-            }
-            else
-            {
-                fusionPredictions.at<int>(k,0) = 1;
-                fusionDistsToMargin.at<float>(k,0) = accPosDists/pos;
-            }
-                
-        }
-    }
+    // The modalities' predictions vote, all of them but 0 positive ones
+    vote(allPredictions, allDistsToMargin, fusionPredictions, fusionDistsToMargin,
+         VOTE_NONZERO_POSITIVE | VOTE_TIE_POSITIVE);
     
     m_fusionPredictions = fusionPredictions;
     m_fusionDistsToMargin = fusionDistsToMargin;
@@ -155,30 +109,12 @@ void SimpleFusionPrediction::predict(vector<cv::Mat> allPredictions, vector<cv::
 
 void SimpleFusionPrediction::predict(vector<GridMat> allPredictions, vector<GridMat> allDistsToMargin, cv::Mat& fusionPredictions, cv::Mat& fusionDistsToMargin)
 {
-    GridMat fusionPredictionsGrid, fusionDistsToMarginGrid;
-    
-    int hp = allPredictions[0].crows();
-    int wp = allPredictions[0].ccols();
-    for (int m = 1; m < allPredictions.size(); m++)
-    {
-        assert (allPredictions[m].crows() == hp || allPredictions[m].ccols() == wp);
-        assert (allDistsToMargin[m].crows() == hp || allDistsToMargin[m].ccols() == wp);
-    }
+    TRACE_SCOPE("SimpleFusionPrediction::predict (grid)");
+    TRACE_ITEMS(allDistsToMargin[0].at(0,0).rows);
     
-    fusionPredictionsGrid.create(hp, wp);
-    fusionDistsToMarginGrid.create(hp, wp);
-    
-    for (int i = 0; i < hp; i++) for (int j = 0; j < wp; j++)
-    {
-        vector<cv::Mat> predictions, distsToMargin;
-        for (int m = 0; m < allPredictions.size(); m++)
-        {
-            predictions += allPredictions[m].at(i,j);
-            distsToMargin += allDistsToMargin[m].at(i,j);
-        }
-
-        predict(predictions, distsToMargin, fusionPredictionsGrid.at(i,j), fusionDistsToMarginGrid.at(i,j));
-    }
+    GridMat fusionPredictionsGrid, fusionDistsToMarginGrid;
+    predict(allPredictions, allDistsToMargin, VOTE_NONZERO_POSITIVE | VOTE_TIE_POSITIVE,
+            fusionPredictionsGrid, fusionDistsToMarginGrid);
     
     computeGridConsensusPredictions(fusionPredictionsGrid, fusionDistsToMarginGrid, fusionPredictions, fusionDistsToMargin);
     
@@ -188,18 +124,12 @@ void SimpleFusionPrediction::predict(vector<GridMat> allPredictions, vector<Grid
 
 void SimpleFusionPrediction::predict(vector<GridMat> allDistsToMargin, cv::Mat& fusionPredictions, cv::Mat& fusionDistsToMargin)
 {
-    // Concatenate along the horizontal direction all the modalities' predictions in a GridMat,
-    // and the same for the distsToMargin
-    
-    GridMat concatDistsToMarginGrid;
-    
-    for (int i = 0; i < allDistsToMargin.size(); i++)
-    {
-        concatDistsToMarginGrid.hconcat(allDistsToMargin[i]);
-    }
+    TRACE_SCOPE("SimpleFusionPrediction::predict (grid)");
+    TRACE_ITEMS(allDistsToMargin[0].at(0,0).rows);
     
+    // The modalities' distances vote by their sign
     GridMat fusionPredictionsGrid, fusionDistsToMarginGrid;
-    predict(concatDistsToMarginGrid, fusionPredictionsGrid, fusionDistsToMarginGrid);
+    predict(vector<GridMat>(), allDistsToMargin, 0, fusionPredictionsGrid, fusionDistsToMarginGrid);
     
     computeGridConsensusPredictions(fusionPredictionsGrid, fusionDistsToMarginGrid, fusionPredictions, fusionDistsToMargin);
     
@@ -207,70 +137,31 @@ void SimpleFusionPrediction::predict(vector<GridMat> allDistsToMargin, cv::Mat&
     m_fusionDistsToMargin = fusionDistsToMargin;
 }
 
-void SimpleFusionPrediction::predict(GridMat distsToMarginGrid, GridMat& fusionPredictionsGrid, GridMat& fusionDistsToMarginGrid)
+void SimpleFusionPrediction::predict(const vector<GridMat>& allPredictions, const vector<GridMat>& allDistsToMargin, int flags,
+                                     GridMat& fusionPredictionsGrid, GridMat& fusionDistsToMarginGrid)
 {
-    int hp = distsToMarginGrid.crows();
-    int wp = distsToMarginGrid.ccols();
-    int n = distsToMarginGrid.at(0,0).rows;
-    
-    for (int i = 0; i < hp; i++) for (int j = 0; j < wp; j++)
+    int hp = allDistsToMargin[0].crows();
+    int wp = allDistsToMargin[0].ccols();
+    for (int m = 1; m < allDistsToMargin.size(); m++)
     {
-        assert (n == distsToMarginGrid.at(i,j).rows);
+        assert (allDistsToMargin[m].crows() == hp && allDistsToMargin[m].ccols() == wp);
     }
     
-    fusionPredictionsGrid.create<int>(hp, wp, n, 1);
-    fusionDistsToMarginGrid.create<float>(hp, wp, n, 1);
+    fusionPredictionsGrid.create(hp, wp);
+    fusionDistsToMarginGrid.create(hp, wp);
     
-    for (int k = 0; k < n; k++)
+    // Each cell is voted by the modalities, straight from their grids
+    for (int i = 0; i < hp; i++) for (int j = 0; j < wp; j++)
     {
-        for (int i = 0; i < hp; i++) for (int j = 0; j < wp; j++)
+        vector<cv::Mat> predictions, distsToMargin;
+        for (int m = 0; m < allDistsToMargin.size(); m++)
         {
-            int pos = 0;
-            int neg = 0;
-            float accPosDists = 0;
-            float accNegDists = 0;
-            for (int m = 0; m < distsToMarginGrid.at(i,j).cols; m++)
-            {
-                float dist = distsToMarginGrid.at<float>(i,j,k,m);
-                if (distsToMarginGrid.at<int>(i,j,k,m) < 0)
-                {
-                    neg++;
-                    accNegDists += dist;
-                }
-                else
-                {
-                    pos++;
-                    accPosDists += dist;
-                }
-            }
-            
-            if (pos < neg)
-            {
-                fusionPredictionsGrid.at<int>(i,j,k,0) = 0;
-                fusionDistsToMarginGrid.at<float>(i,j,k,0) = accNegDists/neg;
-            }
-            else if (pos > neg)
-            {
-                fusionPredictionsGrid.at<int>(i,j,k,0) = 1;
-                fusionDistsToMarginGrid.at<float>(i,j,k,0) = accPosDists/pos;
-            }
-            else
-            {
-                float meanNeg = accNegDists/neg;
-                float meanPos = accPosDists/pos;
-                if (meanPos > abs(meanNeg))
-                {
-                    fusionPredictionsGrid.at<int>(i,j,k,0) = 1;
-                    fusionDistsToMarginGrid.at<float>(i,j,k,0) = accPosDists/pos;
-                }
-                else
-                {
-                    fusionPredictionsGrid.at<int>(i,j,k,0) = 0;
-                    fusionDistsToMarginGrid.at<float>(i,j,k,0) = accNegDists/neg;
-                }
-            }
+            if (!allPredictions.empty())
+                predictions.push_back(allPredictions[m].at(i,j));
+            distsToMargin.push_back(allDistsToMargin[m].at(i,j));
         }
         
+        vote(predictions, distsToMargin, fusionPredictionsGrid.at(i,j), fusionDistsToMarginGrid.at(i,j), flags);
     }
 }
 
@@ -279,56 +170,7 @@ void SimpleFusionPrediction::computeGridConsensusPredictions(GridMat fusionPredi
                                                              cv::Mat& consensusfusionPredictions,
                                                              cv::Mat& consensusfusionDistsToMargin)
 {
-    consensusfusionPredictions.create(m_tags.rows, 1, cv::DataType<int>::type);
-    consensusfusionDistsToMargin.create(m_tags.rows, 1, cv::DataType<float>::type);
-    
-    //    cv::Mat partitions;
-    //    cvpartition(tags, m_testK, m_seed, partitions);
-    
-    for (int r = 0; r < m_tags.rows; r++)
-    {
-        int pos = 0;
-        int neg = 0;
-        float accPosDists = 0;
-        float accNegDists = 0;
-        for (int i = 0; i < fusionPredictionsGrid.crows(); i++) for (int j = 0; j < fusionPredictionsGrid.ccols(); j++)
-        {
-            if (fusionPredictionsGrid.at<int>(i,j,r,0) == 0)
-            {
-                neg++;
-                accNegDists += fusionDistsToMarginGrid.at<float>(i,j,r,0);
-            }
-            else if (fusionPredictionsGrid.at<int>(i,j,r,0) == 1)
-            {
-                pos++;
-                accPosDists += fusionDistsToMarginGrid.at<float>(i,j,r,0);
-            }
-        }
-        
-        if (pos > neg)
-        {
-            consensusfusionPredictions.at<int>(r,0) = 1;
-            consensusfusionDistsToMargin.at<float>(r,0) = accPosDists / pos;
-        }
-        else if (pos < neg)
-        {
-            consensusfusionPredictions.at<int>(r,0) = 0;
-            consensusfusionDistsToMargin.at<float>(r,0) = accNegDists / neg;
-        }
-        else // pos == neg
-        {
-            if (accPosDists > abs(accNegDists)) // most confident towards positive classification
-            {
-                consensusfusionPredictions.at<int>(r,0) = 1;
-                consensusfusionDistsToMargin.at<float>(r,0) = accPosDists / pos;
-            }
-            else
-            {
-                consensusfusionPredictions.at<int>(r,0) = 0;
-                consensusfusionDistsToMargin.at<float>(r,0) = accNegDists / neg;
-            }
-        }
-    }
+    vote(fusionPredictionsGrid, fusionDistsToMarginGrid, consensusfusionPredictions, consensusfusionDistsToMargin);
 }
 
 cv::Mat SimpleFusionPrediction::getAccuracies()
@@ -359,7 +201,7 @@ ClassifierFusionPredictionBase<cv::EM40, ClassifierT>::ClassifierFusionPredictio
 //}
 
 template<typename ClassifierT>
-void ClassifierFusionPredictionBase<cv::EM40, ClassifierT>::setData(vector<ModalityGridData> mgds, vector<GridMat> distsToMargin, vector<cv::Mat> predictions)
+void ClassifierFusionPredictionBase<cv::EM40, ClassifierT>::setData(const vector<ModalityGridData>& mgds, const vector<GridMat>& distsToMargin, const vector<cv::Mat>& predictions)
 {
     m_mgds = mgds;
     m_partitions = m_mgds[0].getPartitions();
@@ -456,256 +298,265 @@ cv::Mat ClassifierFusionPredictionBase<cv::EM40,ClassifierT>::getAccuracies()
     return accuracies;
 }
 
-//
-// ClassifierFusionPrediction class templates' specialization
-//
+template<typename ClassifierT>
+void ClassifierFusionPredictionBase<cv::EM40,ClassifierT>::setSuccessiveHalving(int eta)
+{
+    m_gridSearch.setReductionFactor(eta);
+}
 
-// SVM
+template<typename ClassifierT>
+void ClassifierFusionPredictionBase<cv::EM40,ClassifierT>::planFolds(std::string searchLogFile)
+{
+    m_foldPlan.create(m_partitions, m_responses, m_testK);
+    m_foldPlan.createInnerFolds(m_modelSelecK, m_seed);
+    
+    // Evaluations logged on other data or folds are stale
+    uint64 h = GridSearch::hash(m_data, GridSearch::hash(m_responses, GridSearch::hash(m_partitions)));
+    h = GridSearch::hash(m_testK, GridSearch::hash(m_modelSelecK, GridSearch::hash(m_seed, h)));
+    
+    std::stringstream fingerprint;
+    fingerprint << std::hex << h;
+    
+    m_gridSearch.setLog(searchLogFile, fingerprint.str());
+    m_gridSearch.setResumeOnly(!m_bModelSelection); // only reuse the logged evaluations
+}
 
-ClassifierFusionPrediction<cv::EM40,CvSVM>::ClassifierFusionPrediction()
-: m_numItersSVM(10000)
+template<typename ClassifierT>
+void ClassifierFusionPredictionBase<cv::EM40,ClassifierT>::modelSelection(cv::Mat data, cv::Mat responses, cv::Mat expandedParams, cv::Mat& goodnesses)
 {
+    TRACE_SCOPE("ClassifierFusionPrediction::modelSelection");
+    TRACE_ITEMS(expandedParams.rows);
+    
+    goodnesses.release();
+    
+    // Partitionate the data in folds, shared with the other classifiers on these responses
+    boost::shared_ptr<const FoldPartition> pPartition = FoldPartition::get(responses, m_modelSelecK, m_seed);
+    const int* partitions = pPartition->getPartitions().ptr<int>(0);
     
+    vector<cv::Mat> trData (m_modelSelecK), trResponses (m_modelSelecK), valData (m_modelSelecK), valResponses (m_modelSelecK);
+    for (int k = 0; k < m_modelSelecK; k++)
+    {
+        vector<int> trIndices;
+        for (int i = 0; i < responses.rows; i++)
+            if (partitions[i] != k && responses.at<int>(i,0) >= 0) trIndices.push_back(i); // ignore unknown category (class -1) in training
+        
+        FoldPlan::gather(data, trIndices, trData[k]);
+        FoldPlan::gather(responses, trIndices, trResponses[k]);
+        FoldPlan::gather(data, pPartition->begin(k), pPartition->end(k), valData[k]);
+        FoldPlan::gather(responses, pPartition->begin(k), pPartition->end(k), valResponses[k]);
+    }
+    
+    // A single outer fold, not logged
+    GridSearch search;
+    search.setReductionFactor(m_gridSearch.getReductionFactor());
+    
+    vector<cv::Mat> foldsGoodnesses;
+    search.search("", expandedParams, 1, m_modelSelecK,
+                  boost::bind(&ClassifierFusionPredictionBase::_validateSplit, this, _1, _2, _3, m_modelSelecK, boost::cref(trData), boost::cref(trResponses), boost::cref(valData), boost::cref(valResponses)),
+                  foldsGoodnesses);
+    
+    goodnesses = foldsGoodnesses[0];
 }
 
-void ClassifierFusionPrediction<cv::EM40,CvSVM>::setKernelType(int type)
+template<typename ClassifierT>
+void ClassifierFusionPredictionBase<cv::EM40,ClassifierT>::modelSelection(std::string stage, cv::Mat expandedParams, vector<cv::Mat>& goodnesses)
 {
-    m_kernelType = type;
+    TRACE_SCOPE("ClassifierFusionPrediction::modelSelection");
+    TRACE_ITEMS(expandedParams.rows);
+    
+    int K = m_foldPlan.getNumOfFolds();
+    int J = m_foldPlan.getNumOfInnerFolds();
+    
+    // Gather once the data of the inner splits of all the outer folds
+    vector<cv::Mat> trData (K*J), trResponses (K*J), valData (K*J), valResponses (K*J);
+    if (m_bModelSelection)
+    {
+        for (int k = 0; k < K; k++) for (int j = 0; j < J; j++)
+        {
+            FoldPlan::gather(m_data, m_foldPlan.getInnerTrainIndices(k,j), trData[k*J+j]);
+            FoldPlan::gather(m_responses, m_foldPlan.getInnerTrainIndices(k,j), trResponses[k*J+j]);
+            FoldPlan::gather(m_data, m_foldPlan.getInnerValidationIndices(k,j), valData[k*J+j]);
+            FoldPlan::gather(m_responses, m_foldPlan.getInnerValidationIndices(k,j), valResponses[k*J+j]);
+        }
+    }
+    
+    m_gridSearch.search(stage, expandedParams, K, J,
+                        boost::bind(&ClassifierFusionPredictionBase::_validateSplit, this, _1, _2, _3, J, boost::cref(trData), boost::cref(trResponses), boost::cref(valData), boost::cref(valResponses)),
+                        goodnesses);
 }
 
-void ClassifierFusionPrediction<cv::EM40,CvSVM>::setCs(vector<float> cs)
+template<typename ClassifierT>
+float ClassifierFusionPredictionBase<cv::EM40,ClassifierT>::_validateSplit(int k, int j, cv::Mat params, int J, const vector<cv::Mat>& trData, const vector<cv::Mat>& trResponses, const vector<cv::Mat>& valData, const vector<cv::Mat>& valResponses)
 {
-    m_cs = cs;
+    int s = k * J + j; // split
+    
+    return validate(trData[s], trResponses[s], valData[s], valResponses[s], params);
 }
 
-void ClassifierFusionPrediction<cv::EM40,CvSVM>::setGammas(vector<float> gammas)
+template<typename ClassifierT>
+void ClassifierFusionPredictionBase<cv::EM40,ClassifierT>::outOfSample(cv::Mat expandedParams, cv::Mat goodnesses, cv::Mat& fusionPredictions)
 {
-    m_gammas = gammas;
+    fusionPredictions.create(m_responses.rows, 1, cv::DataType<int>::type);
+    
+    // folds' test rows are disjoint, no need to lock
+    parallelFor(m_foldPlan.getNumOfFolds(),
+                  boost::bind(&ClassifierFusionPredictionBase::_outOfSample, this, _1, expandedParams, goodnesses, fusionPredictions));
+    cout << endl;
 }
 
-void ClassifierFusionPrediction<cv::EM40,CvSVM>::predict(cv::Mat& fusionPredictions)
+template<typename ClassifierT>
+void ClassifierFusionPredictionBase<cv::EM40,ClassifierT>::_outOfSample(int k, cv::Mat expandedParams, cv::Mat goodnesses, cv::Mat fusionPredictions)
 {
-    formatData();
+    cv::Mat trData, trResponses, valData, valResponses, teData;
+    FoldPlan::gather(m_data, m_foldPlan.getTrainIndices(k), trData); // -1 labels not used in training
+    FoldPlan::gather(m_responses, m_foldPlan.getTrainIndices(k), trResponses);
+    FoldPlan::gather(m_data, m_foldPlan.getValidationIndices(k), valData);
+    FoldPlan::gather(m_responses, m_foldPlan.getValidationIndices(k), valResponses);
+    FoldPlan::gather(m_data, m_foldPlan.getTestIndices(k), teData);
     
-    // Prepare parameters' combinations
-    vector<vector<float> > params;
-    params.push_back(m_cs);
-    if (m_kernelType == CvSVM::RBF)
-        params.push_back(m_gammas);
+    cv::Mat goodness;
+    if (m_bGlobalBest)
+        cv::reduce(goodnesses, goodness, 1, CV_REDUCE_AVG);
+    else
+        goodness = goodnesses.col(k);
+    
+    // Find best parameters (using goodnesses) to train the final model
+    double minVal, maxVal;
+    cv::Point worst, best;
+    cv::minMaxLoc(goodness, &minVal, &maxVal, &worst, &best);
+    
+    cv::Mat tePredictions;
+    trainAndPredict(trData, trResponses, valData, valResponses, expandedParams.row(best.y), teData, tePredictions);
+    
+    FoldPlan::scatter(tePredictions, m_foldPlan.getTestIndices(k), fusionPredictions);
+    
+    m_mutex.lock();
+    cout << k << " ";
+    m_mutex.unlock();
+}
+
+template<typename ClassifierT>
+void ClassifierFusionPredictionBase<cv::EM40,ClassifierT>::searchAndPredict(string name, const vector<vector<float> >& params, vector<int> discretes, cv::Mat& fusionPredictions)
+{
+    formatData();
+    planFolds(name + "_search" + (m_bTrainMirrored ? "m" : "") + ".log");
     
     // create a list of parameters' variations
     cv::Mat coarseExpandedParameters;
     expandParameters(params, coarseExpandedParameters);
     
-    //    cv::Mat partitions;
-    //    cvpartition(m_responses, m_testK, m_seed, partitions);
+    cout << "Coarse model selection CVs [" << m_testK << "]: " << endl;
     
-    if (m_bModelSelection)
-    {
-        cout << "Coarse model selection CVs [" << m_testK << "]: " << endl;
-        
-        for (int k = 0; k < m_testK; k++)
-        {
-            cout << k << " " << endl;
-            
-            cv::Mat trData = cvx::indexMat(m_data, (m_partitions != k) & (m_partitions != ((k+1) % m_testK)));
-            cv::Mat teData = cvx::indexMat(m_data, m_partitions == k);
-            cv::Mat valData = cvx::indexMat(m_data, m_partitions == ((k+1) % m_testK));
-            cv::Mat trResponses = cvx::indexMat(m_responses, (m_partitions != k) & (m_partitions != ((k+1) % m_testK)));
-            cv::Mat teResponses = cvx::indexMat(m_responses, m_partitions == k);
-            cv::Mat valResponses = cvx::indexMat(m_responses, m_partitions == ((k+1) % m_testK));
-            
-            // Coarse search
-            cv::Mat coarseGoodnesses; // for instance: accuracies
-            modelSelection(trData, trResponses, coarseExpandedParameters, coarseGoodnesses);
-            
-            std::stringstream coarsess;
-            coarsess << "svm_" << m_distsToMargin.size() << "_" << m_kernelType << (m_bStackPredictions ? "_s" : "") << "_coarse-goodnesses_" << k << (m_bTrainMirrored ? "m" : "") << ".yml";
-            cv::hconcat(coarseExpandedParameters, coarseGoodnesses, coarseGoodnesses);
-            cvx::save(coarsess.str(), coarseGoodnesses);
-        }
-        cout << endl;
-    }
+    vector<cv::Mat> coarseFoldsGoodnesses; // for instance: accuracies
+    modelSelection("coarse", coarseExpandedParameters, coarseFoldsGoodnesses);
     
     cv::Mat coarseGoodnesses, aux;
-    for (int k = 0; k < m_testK; k++)
-    {
-        cv::Mat aux;
-        std::stringstream ss;
-        ss << "svm_" << m_distsToMargin.size() << "_" << m_kernelType << (m_bStackPredictions ? "_s" : "") << "_coarse-goodnesses_" << k << (m_bTrainMirrored ? "m" : "") << ".yml";
-        cvx::load(ss.str(), aux);
-        if (coarseGoodnesses.empty()) coarseGoodnesses = aux.col(params.size());
-        else cv::hconcat(coarseGoodnesses, aux.col(params.size()), coarseGoodnesses);
-    }
+    cv::hconcat(coarseFoldsGoodnesses, coarseGoodnesses);
     cv::reduce(coarseGoodnesses, aux, 1, CV_REDUCE_AVG);
     cv::hconcat(coarseExpandedParameters, aux, coarseGoodnesses);
     
     cv::Mat narrowExpandedParameters;
-    int discretes[] = {0,0};
-    narrow<float>(coarseExpandedParameters, coarseGoodnesses, m_narrowSearchSteps, discretes, narrowExpandedParameters);
+    narrow<float>(coarseExpandedParameters, coarseGoodnesses, m_narrowSearchSteps, &discretes[0], narrowExpandedParameters);
     
-    if (m_bModelSelection)
-    {
-        cout << "Narrow model selection CVs [" << m_testK << "]: " << endl;
-        
-        for (int k = 0; k < m_testK; k++)
-        {
-            cout << k << " " << endl;
-            
-            cv::Mat trData = cvx::indexMat(m_data, (m_partitions != k) & (m_partitions != ((k+1) % m_testK)));
-            cv::Mat teData = cvx::indexMat(m_data, m_partitions == k);
-            cv::Mat valData = cvx::indexMat(m_data, m_partitions == ((k+1) % m_testK));
-            cv::Mat trResponses = cvx::indexMat(m_responses, (m_partitions != k) & (m_partitions != ((k+1) % m_testK)));
-            cv::Mat teResponses = cvx::indexMat(m_responses, m_partitions == k);
-            cv::Mat valResponses = cvx::indexMat(m_responses, m_partitions == ((k+1) % m_testK));
-            
-            // Narrow search
-            
-            cv::Mat narrowGoodnesses;
-            modelSelection(trData, trResponses, narrowExpandedParameters, narrowGoodnesses);
-            
-            std::stringstream narrowss;
-            narrowss << "svm_" << m_distsToMargin.size() << "_" << m_kernelType << (m_bStackPredictions ? "_s" : "") << "_narrow-goodnesses_" << k << (m_bTrainMirrored ? "m" : "") << ".yml";
-            cv::hconcat(narrowExpandedParameters, narrowGoodnesses, narrowGoodnesses);
-            cvx::save(narrowss.str(), narrowGoodnesses);
-        }
-        cout << endl;
-    }
+    cout << "Narrow model selection CVs [" << m_testK << "]: " << endl;
     
-    cv::Mat goodnesses;
-    for (int k = 0; k < m_testK; k++)
-    {
-        cv::Mat aux;
-        std::stringstream ss;
-        ss << "svm_" << m_distsToMargin.size() << "_" << m_kernelType << (m_bStackPredictions ? "_s" : "") << "_narrow-goodnesses_" << k << (m_bTrainMirrored ? "m" : "") << ".yml";
-        cvx::load(ss.str(), aux);
-        if (goodnesses.empty()) goodnesses = aux.col(params.size());
-        else cv::hconcat(goodnesses, aux.col(params.size()), goodnesses);
-    }
-    //    cv::reduce(goodnesses, aux, 1, CV_REDUCE_AVG);
-    //    cv::hconcat(coarseExpandedParameters, aux, goodnesses);
+    vector<cv::Mat> narrowFoldsGoodnesses;
+    modelSelection("narrow", narrowExpandedParameters, narrowFoldsGoodnesses);
     
+    cv::Mat goodnesses;
+    cv::hconcat(narrowFoldsGoodnesses, goodnesses);
     
     cout << "Out-of-sample CV [" << m_testK << "] : " << endl;
     
-    fusionPredictions.create(m_responses.rows, 1, cv::DataType<int>::type);
-    
-    for (int k = 0; k < m_testK; k++)
-    {
-        cout << k << " ";
-        
-        cv::Mat trData = cvx::indexMat(m_data, (m_partitions != k) & (m_partitions != ((k+1) % m_testK)));
-        cv::Mat teData = cvx::indexMat(m_data, m_partitions == k);
-        cv::Mat valData = cvx::indexMat(m_data, m_partitions == ((k+1) % m_testK));
-        cv::Mat trResponses = cvx::indexMat(m_responses, (m_partitions != k) & (m_partitions != ((k+1) % m_testK)));
-        cv::Mat teResponses = cvx::indexMat(m_responses, m_partitions == k);
-        cv::Mat valResponses = cvx::indexMat(m_responses, m_partitions == ((k+1) % m_testK));
-        
-        cv::Mat validTrData = cvx::indexMat(trData, trResponses >= 0); // -1 labels not used in training
-        cv::Mat validTrResponses = cvx::indexMat(trResponses, trResponses >= 0);
-        
-        cv::Mat goodness;
-        if (m_bGlobalBest)
-        {
-            GridMat globalMean;
-            cv::reduce(goodnesses, goodness, 1, CV_REDUCE_AVG);
-        }
-        else
-        {
-            goodness = goodnesses.col(k);
-        }
-        
-        // Find best parameters (using goodnesses) to train the final model
-        double minVal, maxVal;
-        cv::Point worst, best;
-        cv::minMaxLoc(goodness, &minVal, &maxVal, &worst, &best);
-        
-        // Training phase
-        float bestC     = narrowExpandedParameters.row(best.y).at<float>(0,0);
-        float bestGamma = narrowExpandedParameters.row(best.y).at<float>(0,1);
-        
-        CvSVMParams svmParams (CvSVM::C_SVC, m_kernelType, 0, bestGamma, 0, bestC, 0, 0, 0,
-                               cvTermCriteria( CV_TERMCRIT_ITER+CV_TERMCRIT_EPS, m_numItersSVM, 1e-2 ));
-        m_pClassifier->train(validTrData, validTrResponses, cv::Mat(), cv::Mat(), svmParams);
-        
-        // Prediction phase
-        cv::Mat tePredictions;
-        m_pClassifier->predict(teData, tePredictions);
-        
-        cvx::setMat(tePredictions, fusionPredictions, m_partitions == k);
-    }
-    cout << endl;
+    outOfSample(narrowExpandedParameters, goodnesses, fusionPredictions);
     
     m_fusionPredictions = fusionPredictions;
 }
 
-void ClassifierFusionPrediction<cv::EM40,CvSVM>::_modelSelection(cv::Mat& descriptorsTr, cv::Mat& responsesTr, cv::Mat& descriptorsVal, cv::Mat& responsesVal, int k, cv::Mat& expandedParams, cv::Mat& accuracies)
+//
+// ClassifierFusionPrediction class templates' specialization
+//
+
+// SVM
+
+ClassifierFusionPrediction<cv::EM40,CvSVM>::ClassifierFusionPrediction()
+: m_numItersSVM(10000)
 {
-    cv::Mat foldAccs (expandedParams.rows, 1, cv::DataType<float>::type); // results
     
-    for (int m = 0; m < expandedParams.rows; m++)
-    {
-        // Training phase
-        cv::Mat selectedParams = expandedParams.row(m);
-        
-        float C = selectedParams.at<float>(0,0);
-        
-        float gamma = 0;
-        if (m_kernelType == CvSVM::RBF)
-            gamma = selectedParams.at<float>(0,1); // indeed, gamma not used if not RBF kernel
-        
-        CvSVM classifier;
-        CvSVMParams params (CvSVM::C_SVC, m_kernelType, 0, gamma, 0, C, 0, 0, 0,
-                            cvTermCriteria( CV_TERMCRIT_ITER+CV_TERMCRIT_EPS, m_numItersSVM, 1e-2 ));
-        
-        classifier.train(descriptorsTr, responsesTr, cv::Mat(), cv::Mat(), params);
-        
-        // Test phase
-        cv::Mat predictionsVal;
-        classifier.predict(descriptorsVal, predictionsVal);
-        
-        // Compute an accuracy measure
-        foldAccs.at<float>(m,0) = accuracy(responsesVal, predictionsVal);
-    }
+}
+
+void ClassifierFusionPrediction<cv::EM40,CvSVM>::setKernelType(int type)
+{
+    m_kernelType = type;
+}
+
+void ClassifierFusionPrediction<cv::EM40,CvSVM>::setCs(vector<float> cs)
+{
+    m_cs = cs;
+}
+
+void ClassifierFusionPrediction<cv::EM40,CvSVM>::setGammas(vector<float> gammas)
+{
+    m_gammas = gammas;
+}
+
+void ClassifierFusionPrediction<cv::EM40,CvSVM>::predict(cv::Mat& fusionPredictions)
+{
+    TRACE_SCOPE("ClassifierFusionPrediction<SVM>::predict");
     
-    m_mutex.lock();
-    foldAccs.copyTo(accuracies.col(k));
-    m_mutex.unlock();
+    // Prepare parameters' combinations
+    vector<vector<float> > params;
+    params.push_back(m_cs);
+    if (m_kernelType == CvSVM::RBF)
+        params.push_back(m_gammas);
+    
+    vector<int> discretes;
+    discretes += 0, 0;
+    
+    std::stringstream name;
+    name << "svm_" << m_distsToMargin.size() << "_" << m_kernelType << (m_bStackPredictions ? "_s" : "");
+    
+    searchAndPredict(name.str(), params, discretes, fusionPredictions);
 }
 
-void ClassifierFusionPrediction<cv::EM40,CvSVM>::modelSelection(cv::Mat data, cv::Mat responses, cv::Mat expandedParams, cv::Mat& goodnesses)
+float ClassifierFusionPrediction<cv::EM40,CvSVM>::validate(cv::Mat trData, cv::Mat trResponses, cv::Mat valData, cv::Mat valResponses, cv::Mat params)
 {
-    goodnesses.release();
+    // Training phase
+    float C = params.at<float>(0,0);
+    
+    float gamma = 0;
+    if (m_kernelType == CvSVM::RBF)
+        gamma = params.at<float>(0,1); // indeed, gamma not used if not RBF kernel
     
-    // Partitionate the data in folds
-    cv::Mat partitions;
-    cvpartition(responses, m_modelSelecK, m_seed, partitions);
+    CvSVM classifier;
+    CvSVMParams svmParams (CvSVM::C_SVC, m_kernelType, 0, gamma, 0, C, 0, 0, 0,
+                           cvTermCriteria( CV_TERMCRIT_ITER+CV_TERMCRIT_EPS, m_numItersSVM, 1e-2 ));
     
-    cv::Mat accuracies (expandedParams.rows, m_modelSelecK, cv::DataType<float>::type);
+    classifier.train(trData, trResponses, cv::Mat(), cv::Mat(), svmParams);
     
-    boost::thread_group tg;
-    cout << "(";
-    for (int k = 0; k < m_modelSelecK; k++)
-    {
-        cout << k;
-        
-        // Get fold's data
-        
-        cv::Mat trData = cvx::indexMat(data, partitions != k);
-        cv::Mat valData = cvx::indexMat(data, partitions == k);
-        cv::Mat trResponses = cvx::indexMat(responses, partitions != k);
-        cv::Mat valResponses = cvx::indexMat(responses, partitions == k);
-        
-        cv::Mat trSbjObjData = cvx::indexMat(trData, trResponses >= 0); // ignore unknown category (class -1) in training
-        cv::Mat trSbjObjResponses = cvx::indexMat(trResponses, trResponses >= 0);
-        
-        tg.add_thread(new boost::thread( boost::bind(&ClassifierFusionPrediction::_modelSelection, this, trSbjObjData, trSbjObjResponses, valData, valResponses, k, expandedParams, accuracies) ));
-    }
-    tg.join_all();
-    cout << ") " << endl;
+    // Test phase
+    cv::Mat valPredictions;
+    classifier.predict(valData, valPredictions);
     
-    // mean along the horizontal direction
-    cvx::hmean(accuracies, goodnesses); // one column of m accuracies evaluation the m combinations is left
+    // Compute an accuracy measure
+    return accuracy(valResponses, valPredictions);
+}
+
+void ClassifierFusionPrediction<cv::EM40,CvSVM>::trainAndPredict(cv::Mat trData, cv::Mat trResponses, cv::Mat valData, cv::Mat valResponses, cv::Mat params, cv::Mat teData, cv::Mat& tePredictions)
+{
+    // Training phase
+    float bestC     = params.at<float>(0,0);
+    float bestGamma = 0;
+    if (m_kernelType == CvSVM::RBF)
+        bestGamma = params.at<float>(0,1);
+    
+    CvSVM classifier;
+    CvSVMParams svmParams (CvSVM::C_SVC, m_kernelType, 0, bestGamma, 0, bestC, 0, 0, 0,
+                           cvTermCriteria( CV_TERMCRIT_ITER+CV_TERMCRIT_EPS, m_numItersSVM, 1e-2 ));
+    classifier.train(trData, trResponses, cv::Mat(), cv::Mat(), svmParams);
+    
+    // Prediction phase
+    classifier.predict(teData, tePredictions);
 }
 
 // CvBoost
@@ -732,7 +583,7 @@ void ClassifierFusionPrediction<cv::EM40,CvBoost>::setWeightTrimRate(vector<floa
 
 void ClassifierFusionPrediction<cv::EM40,CvBoost>::predict(cv::Mat& fusionPredictions)
 {
-    formatData();
+    TRACE_SCOPE("ClassifierFusionPrediction<Boost>::predict");
     
     // Prepare parameters' combinations
     vector<vector<float> > params;
@@ -740,222 +591,50 @@ void ClassifierFusionPrediction<cv::EM40,CvBoost>::predict(cv::Mat& fusionPredic
     if (m_boostType == CvBoost::GENTLE)
         params.push_back(m_weightTrimRate);
     
-    // create a list of parameters' variations
-    cv::Mat coarseExpandedParameters;
-    expandParameters(params, coarseExpandedParameters);
+    vector<int> discretes;
+    discretes += 1, 0; // the number of weak classifiers is integer
     
-//    cv::Mat partitions;
-//    cvpartition(m_responses, m_testK, m_seed, partitions);
+    std::stringstream name;
+    name << "boost_" << m_distsToMargin.size() << "_" << m_boostType << (m_bStackPredictions ? "_s" : "");
     
-    if (m_bModelSelection)
-    {
-        cout << "Coarse model selection CVs [" << m_testK << "]: " << endl;
-        
-        for (int k = 0; k < m_testK; k++)
-        {
-            cout << k << " " << endl;
-            
-            cv::Mat trData = cvx::indexMat(m_data, (m_partitions != k) & (m_partitions != ((k+1) % m_testK)));
-            cv::Mat teData = cvx::indexMat(m_data, m_partitions == k);
-            cv::Mat valData = cvx::indexMat(m_data, m_partitions == ((k+1) % m_testK));
-            cv::Mat trResponses = cvx::indexMat(m_responses, (m_partitions != k) & (m_partitions != ((k+1) % m_testK)));
-            cv::Mat teResponses = cvx::indexMat(m_responses, m_partitions == k);
-            cv::Mat valResponses = cvx::indexMat(m_responses, m_partitions == ((k+1) % m_testK));
-            
-            // Coarse search
-            cv::Mat coarseGoodnesses; // for instance: accuracies
-            modelSelection(trData, trResponses, coarseExpandedParameters, coarseGoodnesses);
-            
-            std::stringstream coarsess;
-            coarsess << "boost_" << m_distsToMargin.size() << "_" << m_boostType << (m_bStackPredictions ? "_s" : "") << "_coarse-goodnesses_" << k << (m_bTrainMirrored ? "m" : "") << ".yml";
-            cv::hconcat(coarseExpandedParameters, coarseGoodnesses, coarseGoodnesses);
-            cvx::save(coarsess.str(), coarseGoodnesses);
-        }
-        cout << endl;
-    }
-    
-    cv::Mat coarseGoodnesses, aux;
-    for (int k = 0; k < m_testK; k++)
-    {
-        cv::Mat aux;
-        std::stringstream ss;
-        ss << "boost_" << m_distsToMargin.size() << "_" << m_boostType << (m_bStackPredictions ? "_s" : "") << "_coarse-goodnesses_" << k << (m_bTrainMirrored ? "m" : "") << ".yml";
-        cvx::load(ss.str(), aux);
-        if (coarseGoodnesses.empty()) coarseGoodnesses = aux.col(params.size());
-        else cv::hconcat(coarseGoodnesses, aux.col(params.size()), coarseGoodnesses);
-    }
-    cv::reduce(coarseGoodnesses, aux, 1, CV_REDUCE_AVG);
-    cv::hconcat(coarseExpandedParameters, aux, coarseGoodnesses);
-    
-    cv::Mat narrowExpandedParameters;
-    int discretes[] = {1,0};
-    narrow<float>(coarseExpandedParameters, coarseGoodnesses, m_narrowSearchSteps, discretes, narrowExpandedParameters);
-    
-    if (m_bModelSelection)
-    {
-        cout << "Narrow model selection CVs [" << m_testK << "]: " << endl;
-        
-        for (int k = 0; k < m_testK; k++)
-        {
-            cout << k << " " << endl;
-            
-            cv::Mat trData = cvx::indexMat(m_data, (m_partitions != k) & (m_partitions != ((k+1) % m_testK)));
-            cv::Mat teData = cvx::indexMat(m_data, m_partitions == k);
-            cv::Mat valData = cvx::indexMat(m_data, m_partitions == ((k+1) % m_testK));
-            cv::Mat trResponses = cvx::indexMat(m_responses, (m_partitions != k) & (m_partitions != ((k+1) % m_testK)));
-            cv::Mat teResponses = cvx::indexMat(m_responses, m_partitions == k);
-            cv::Mat valResponses = cvx::indexMat(m_responses, m_partitions == ((k+1) % m_testK));
-
-            // Narrow search
-            cv::Mat narrowGoodnesses;
-            modelSelection(trData, trResponses, narrowExpandedParameters, narrowGoodnesses);
-            
-            std::stringstream narrowss;
-            narrowss << "boost_" << m_distsToMargin.size() << "_" << m_boostType << (m_bStackPredictions ? "_s" : "") << "_narrow-goodnesses_" << k << (m_bTrainMirrored ? "m" : "") << ".yml";
-            cv::hconcat(narrowExpandedParameters, narrowGoodnesses, narrowGoodnesses);
-            cvx::save(narrowss.str(), narrowGoodnesses);
-        }
-        cout << endl;
-    }
-    
-    cv::Mat goodnesses;
-    for (int k = 0; k < m_testK; k++)
-    {
-        cv::Mat aux;
-        std::stringstream ss;
-        ss << "boost_" << m_distsToMargin.size() << "_" << m_boostType << (m_bStackPredictions ? "_s" : "") << "_narrow-goodnesses_" << k << (m_bTrainMirrored ? "m" : "") << ".yml";
-        cvx::load(ss.str(), aux);
-        if (goodnesses.empty()) goodnesses = aux.col(params.size());
-        else cv::hconcat(goodnesses, aux.col(params.size()), goodnesses);
-    }
-//    cv::reduce(goodnesses, aux, 1, CV_REDUCE_AVG);
-//    cv::hconcat(coarseExpandedParameters, aux, goodnesses);
-    
-    
-    cout << "Out-of-sample CV [" << m_testK << "] : " << endl;
-    
-    fusionPredictions.create(m_responses.rows, 1, cv::DataType<int>::type);
-    
-    for (int k = 0; k < m_testK; k++)
-    {
-        cout << k << " ";
-        
-        cv::Mat trData = cvx::indexMat(m_data, (m_partitions != k) & (m_partitions != ((k+1) % m_testK)));
-        cv::Mat teData = cvx::indexMat(m_data, m_partitions == k);
-        cv::Mat valData = cvx::indexMat(m_data, m_partitions == ((k+1) % m_testK));
-        cv::Mat trResponses = cvx::indexMat(m_responses, (m_partitions != k) & (m_partitions != ((k+1) % m_testK)));
-        cv::Mat teResponses = cvx::indexMat(m_responses, m_partitions == k);
-        cv::Mat valResponses = cvx::indexMat(m_responses, m_partitions == ((k+1) % m_testK));
-        
-        cv::Mat validTrData = cvx::indexMat(trData, trResponses >= 0); // -1 labels not used in training
-        cv::Mat validTrResponses = cvx::indexMat(trResponses, trResponses >= 0);
-        
-        cv::Mat goodness;
-        if (m_bGlobalBest)
-        {
-            GridMat globalMean;
-            cv::reduce(goodnesses, goodness, 1, CV_REDUCE_AVG);
-        }
-        else
-        {
-            goodness = goodnesses.col(k);
-        }
-        
-        // Find best parameters (using goodnesses) to train the final model
-        double minVal, maxVal;
-        cv::Point worst, best;
-        cv::minMaxLoc(goodness, &minVal, &maxVal, &worst, &best);
-        
-        // Training phase
-        float bestNumOfWeaks     = narrowExpandedParameters.row(best.y).at<float>(0,0);
-        float bestWeightTrimRate = narrowExpandedParameters.row(best.y).at<float>(0,1);
-        
-        CvBoostParams boostParams (m_boostType, bestNumOfWeaks, bestWeightTrimRate, 1, 0, NULL);
-        
-        m_pClassifier->train(validTrData, CV_ROW_SAMPLE, validTrResponses,
-                             cv::Mat(), cv::Mat(), cv::Mat(), cv::Mat(),
-                             boostParams);
-        
-        // Test phase
-        cv::Mat tePredictions (teResponses.rows, teResponses.cols, teResponses.type());
-        for (int d = 0; d < teData.rows; d++)
-            tePredictions.at<int>(d,0) = (int) m_pClassifier->predict(teData.row(d));
-        
-        cvx::setMat(tePredictions, fusionPredictions, m_partitions == k);
-    }
-    cout << endl;
-    
-    // Mat to GridMat
-    m_fusionPredictions = fusionPredictions;
+    searchAndPredict(name.str(), params, discretes, fusionPredictions);
 }
 
-void ClassifierFusionPrediction<cv::EM40,CvBoost>::_modelSelection(cv::Mat& descriptorsTr, cv::Mat& responsesTr, cv::Mat& descriptorsVal, cv::Mat& responsesVal, int k, cv::Mat& expandedParams, cv::Mat& accuracies)
+float ClassifierFusionPrediction<cv::EM40,CvBoost>::validate(cv::Mat trData, cv::Mat trResponses, cv::Mat valData, cv::Mat valResponses, cv::Mat params)
 {
-    cv::Mat foldAccs (expandedParams.rows, 1, cv::DataType<float>::type); // results
+    // Training phase
+    float numOfWeaks = params.at<float>(0,0);
+    float weightTrimRate = (params.cols > 1) ? params.at<float>(0,1) : 0; // only searched for gentle boost
     
-    for (int m = 0; m < expandedParams.rows; m++)
-    {
-        // Training phase
-        cv::Mat selectedParams = expandedParams.row(m);
-        
-        float bestNumOfWeaks = selectedParams.at<float>(0,0);
-        float bestWeightTrimRate = selectedParams.at<float>(0,1); // indeed, gamma not used if not RBF kernel
-        
-        CvBoostParams boostParams (m_boostType, (int) bestNumOfWeaks, bestWeightTrimRate, 1, 0, NULL);
-        CvBoost classifier (descriptorsTr, CV_ROW_SAMPLE, responsesTr,
-                             cv::Mat(), cv::Mat(), cv::Mat(), cv::Mat(),
-                             boostParams);
-        
-        // Test phase
-        cv::Mat predictionsVal (responsesVal.rows, responsesVal.cols, responsesVal.type());
-        for (int d = 0; d < descriptorsVal.rows; d++)
-        {
-            int prediction = classifier.predict(descriptorsVal.row(d));
-            predictionsVal.at<int>(d,0) = prediction;
-        }
-        
-        // Compute an accuracy measure
-        foldAccs.at<float>(m,0) = accuracy(responsesVal, predictionsVal);
-    }
+    CvBoostParams boostParams (m_boostType, (int) numOfWeaks, weightTrimRate, 1, 0, NULL);
+    CvBoost classifier (trData, CV_ROW_SAMPLE, trResponses,
+                        cv::Mat(), cv::Mat(), cv::Mat(), cv::Mat(),
+                        boostParams);
     
-    m_mutex.lock();
-    foldAccs.copyTo(accuracies.col(k));
-    m_mutex.unlock();
+    // Test phase
+    cv::Mat valPredictions (valResponses.rows, valResponses.cols, valResponses.type());
+    for (int d = 0; d < valData.rows; d++)
+        valPredictions.at<int>(d,0) = (int) classifier.predict(valData.row(d));
+    
+    // Compute an accuracy measure
+    return accuracy(valResponses, valPredictions);
 }
 
-void ClassifierFusionPrediction<cv::EM40,CvBoost>::modelSelection(cv::Mat data, cv::Mat responses, cv::Mat expandedParams, cv::Mat& goodnesses)
+void ClassifierFusionPrediction<cv::EM40,CvBoost>::trainAndPredict(cv::Mat trData, cv::Mat trResponses, cv::Mat valData, cv::Mat valResponses, cv::Mat params, cv::Mat teData, cv::Mat& tePredictions)
 {
-    goodnesses.release();
+    // Training phase
+    float bestNumOfWeaks     = params.at<float>(0,0);
+    float bestWeightTrimRate = (params.cols > 1) ? params.at<float>(0,1) : 0;
     
-    // Partitionate the data in folds
-    cv::Mat partitions;
-    cvpartition(responses, m_modelSelecK, m_seed, partitions);
-    
-    cv::Mat accuracies (expandedParams.rows, m_modelSelecK, cv::DataType<float>::type);
-    
-    cout << "(";
-    boost::thread_group tg;
-    for (int k = 0; k < m_modelSelecK; k++)
-    {
-        cout << k;
-        
-        // Get fold's data
-        
-        cv::Mat trData = cvx::indexMat(data, partitions != k);
-        cv::Mat valData = cvx::indexMat(data, partitions == k);
-        cv::Mat trResponses = cvx::indexMat(responses, partitions != k);
-        cv::Mat valResponses = cvx::indexMat(responses, partitions == k);
-        
-        cv::Mat trSbjObjData = cvx::indexMat(trData, trResponses >= 0); // ignore unknown category (class -1) in training
-        cv::Mat trSbjObjResponses = cvx::indexMat(trResponses, trResponses >= 0);
-        
-        tg.add_thread(new boost::thread( boost::bind(&ClassifierFusionPrediction::_modelSelection, this, trSbjObjData, trSbjObjResponses, valData, valResponses, k, expandedParams, accuracies) ));
-    }
-    tg.join_all();
-    cout << ") " << endl;
+    CvBoostParams boostParams (m_boostType, (int) bestNumOfWeaks, bestWeightTrimRate, 1, 0, NULL);
+    CvBoost classifier (trData, CV_ROW_SAMPLE, trResponses,
+                        cv::Mat(), cv::Mat(), cv::Mat(), cv::Mat(),
+                        boostParams);
     
-    // mean along the horizontal direction
-    cvx::hmean(accuracies, goodnesses); // one column of m accuracies evaluation the m combinations is left
+    // Test phase
+    tePredictions.create(teData.rows, 1, cv::DataType<int>::type);
+    for (int d = 0; d < teData.rows; d++)
+        tePredictions.at<int>(d,0) = (int) classifier.predict(teData.row(d));
 }
 
 // CvANN_MLP
@@ -1016,298 +695,133 @@ void ClassifierFusionPrediction<cv::EM40,CvANN_MLP>::setHiddenLayerSizes(vector<
 
 void ClassifierFusionPrediction<cv::EM40,CvANN_MLP>::predict(cv::Mat& fusionPredictions)
 {
+    TRACE_SCOPE("ClassifierFusionPrediction<MLP>::predict");
+    
     m_pClassifier->clear();
-    formatData();
     
     // Prepare parameters' combinations
     vector<vector<float> > params;
     params.push_back(m_hiddenLayerSizes);
     
-    // create a list of parameters' variations
-    cv::Mat coarseExpandedParameters;
-    expandParameters(params, coarseExpandedParameters);
-    
-    if (m_bModelSelection)
-    {
-        cout << "Coarse model selection CVs [" << m_testK << "]: " << endl;
-        
-        for (int k = 0; k < m_testK; k++)
-        {
-            cout << k << " " << endl;
-            
-            cv::Mat trData = cvx::indexMat(m_data, (m_partitions != k) & (m_partitions != ((k+1) % m_testK)));
-            cv::Mat teData = cvx::indexMat(m_data, m_partitions == k);
-            cv::Mat valData = cvx::indexMat(m_data, m_partitions == ((k+1) % m_testK));
-            cv::Mat trResponses = cvx::indexMat(m_responses, (m_partitions != k) & (m_partitions != ((k+1) % m_testK)));
-            cv::Mat teResponses = cvx::indexMat(m_responses, m_partitions == k);
-            cv::Mat valResponses = cvx::indexMat(m_responses, m_partitions == ((k+1) % m_testK));
-            
-            // Coarse search
-            cv::Mat coarseGoodnesses; // for instance: accuracies
-            modelSelection(trData, trResponses, coarseExpandedParameters, coarseGoodnesses);
-            
-            std::stringstream coarsess;
-            coarsess << "mlp_" << m_distsToMargin.size() << "_" << m_actFcnType << (m_bStackPredictions ? "_s" : "") << "_coarse-goodnesses_" << k << (m_bTrainMirrored ? "m" : "") << ".yml";
-            cv::hconcat(coarseExpandedParameters, coarseGoodnesses, coarseGoodnesses);
-            cvx::save(coarsess.str(), coarseGoodnesses);
-        }
-        cout << endl;
-    }
-    
-    cv::Mat coarseGoodnesses, aux;
-    for (int k = 0; k < m_testK; k++)
-    {
-        cv::Mat aux;
-        std::stringstream ss;
-        ss << "mlp_" << m_distsToMargin.size() << "_" << m_actFcnType << (m_bStackPredictions ? "_s" : "") << "_coarse-goodnesses_" << k << (m_bTrainMirrored ? "m" : "") << ".yml";
-        cvx::load(ss.str(), aux);
-        if (coarseGoodnesses.empty()) coarseGoodnesses = aux.col(params.size());
-        else cv::hconcat(coarseGoodnesses, aux.col(params.size()), coarseGoodnesses);
-    }
-    cv::reduce(coarseGoodnesses, aux, 1, CV_REDUCE_AVG);
-    cv::hconcat(coarseExpandedParameters, aux, coarseGoodnesses);
-    
-    cv::Mat narrowExpandedParameters;
-    int discretes[] = {1};
-    narrow<float>(coarseExpandedParameters, coarseGoodnesses, m_narrowSearchSteps, discretes, narrowExpandedParameters);
-    
-    if (m_bModelSelection)
-    {
-        cout << "Narrow model selection CVs [" << m_testK << "]: " << endl;
-        
-        for (int k = 0; k < m_testK; k++)
-        {
-            cout << k << " " << endl;
-            
-            cv::Mat trData = cvx::indexMat(m_data, (m_partitions != k) & (m_partitions != ((k+1) % m_testK)));
-            cv::Mat teData = cvx::indexMat(m_data, m_partitions == k);
-            cv::Mat valData = cvx::indexMat(m_data, m_partitions == ((k+1) % m_testK));
-            cv::Mat trResponses = cvx::indexMat(m_responses, (m_partitions != k) & (m_partitions != ((k+1) % m_testK)));
-            cv::Mat teResponses = cvx::indexMat(m_responses, m_partitions == k);
-            cv::Mat valResponses = cvx::indexMat(m_responses, m_partitions == ((k+1) % m_testK));
-            
-            // Narrow search
-            cv::Mat narrowGoodnesses;
-            modelSelection(trData, trResponses, narrowExpandedParameters, narrowGoodnesses);
-            
-            std::stringstream narrowss;
-            narrowss << "mlp_" << m_distsToMargin.size() << "_" << m_actFcnType << (m_bStackPredictions ? "_s" : "") << "_narrow-goodnesses_" << k << (m_bTrainMirrored ? "m" : "") << ".yml";
-            cv::hconcat(narrowExpandedParameters, narrowGoodnesses, narrowGoodnesses);
-            cvx::save(narrowss.str(), narrowGoodnesses);
-        }
-        cout << endl;
-    }
-    
-    cv::Mat goodnesses;
-    for (int k = 0; k < m_testK; k++)
-    {
-        cv::Mat aux;
-        std::stringstream ss;
-        ss << "mlp_" << m_distsToMargin.size() << "_" << m_actFcnType << (m_bStackPredictions ? "_s" : "") << "_narrow-goodnesses_" << k << (m_bTrainMirrored ? "m" : "") << ".yml";
-        cvx::load(ss.str(), aux);
-        if (goodnesses.empty()) goodnesses = aux.col(params.size());
-        else cv::hconcat(goodnesses, aux.col(params.size()), goodnesses);
-    }
-//    cv::reduce(goodnesses, aux, 1, CV_REDUCE_AVG);
-//    cv::hconcat(coarseExpandedParameters, aux, goodnesses);
+    vector<int> discretes;
+    discretes += 1; // the hidden layer size is integer
     
+    std::stringstream name;
+    name << "mlp_" << m_distsToMargin.size() << "_" << m_actFcnType << (m_bStackPredictions ? "_s" : "");
     
-    cout << "Out-of-sample CV [" << m_testK << "] : " << endl;
+    searchAndPredict(name.str(), params, discretes, fusionPredictions);
+}
+
+float ClassifierFusionPrediction<cv::EM40,CvANN_MLP>::validate(cv::Mat trData, cv::Mat trResponses, cv::Mat valData, cv::Mat valResponses, cv::Mat params)
+{
+    float hiddenSize = params.at<float>(0,0);
     
-    fusionPredictions.create(m_responses.rows, 1, cv::DataType<int>::type);
+    cv::Mat layerSizes (3, 1, cv::DataType<int>::type);
+    layerSizes.at<int>(0,0) = trData.cols; // as many inputs as feature vectors' num of dimensions
+    layerSizes.at<int>(1,0) = hiddenSize; // num of hidden neurons experimentally selected
+    layerSizes.at<int>(2,0) = 2; // one output neuron
     
-    for (int k = 0; k < m_testK; k++)
+    float accSum = 0;
+    for (int r = 0; r < m_numOfRepetitions; r++)
     {
-        cout << k << " ";
-        
-        cv::Mat trData = cvx::indexMat(m_data, (m_partitions != k) & (m_partitions != ((k+1) % m_testK)));
-        cv::Mat teData = cvx::indexMat(m_data, m_partitions == k);
-        cv::Mat valData = cvx::indexMat(m_data, m_partitions == ((k+1) % m_testK));
-        cv::Mat trResponses = cvx::indexMat(m_responses, (m_partitions != k) & (m_partitions != ((k+1) % m_testK)));
-        cv::Mat teResponses = cvx::indexMat(m_responses, m_partitions == k);
-        cv::Mat valResponses = cvx::indexMat(m_responses, m_partitions == ((k+1) % m_testK));
-        
-        cv::Mat validTrData = cvx::indexMat(trData, trResponses >= 0); // -1 labels not used in training
-        cv::Mat validTrResponses = cvx::indexMat(trResponses, trResponses >= 0);
-        
-        cv::Mat goodness;
-        if (m_bGlobalBest)
-        {
-            GridMat globalMean;
-            cv::reduce(goodnesses, goodness, 1, CV_REDUCE_AVG);
-        }
-        else
-        {
-            goodness = goodnesses.col(k);
-        }
-        
-        // Find best parameters (using goodnesses) to train the final model
-        double minVal, maxVal;
-        cv::Point worst, best;
-        cv::minMaxLoc(goodness, &minVal, &maxVal, &worst, &best);
-        
         // Training phase
-        float bestHiddenSize    = narrowExpandedParameters.row(best.y).at<float>(0,0);
-        
-        cv::Mat layerSizes (3, 1, cv::DataType<int>::type);
-        layerSizes.at<int>(0,0) = trData.cols; // as many inputs as feature vectors' num of dimensions
-        layerSizes.at<int>(1,0) = bestHiddenSize; // num of hidden neurons experimentally selected
-        layerSizes.at<int>(2,0) = 2; // one output neuron
-        
-        CvANN_MLP classifier;
-        classifier.create(layerSizes, m_actFcnType);
+        CvANN_MLP classifier (layerSizes, m_actFcnType);
         
         CvANN_MLP_TrainParams mlpParams (cv::TermCriteria(CV_TERMCRIT_ITER + CV_TERMCRIT_EPS, 1, 1e-2), CvANN_MLP_TrainParams::BACKPROP, 0.1, 0.1);
-                
-        classifier.train(validTrData, encode(validTrResponses), cv::Mat(), cv::Mat(),
-                             mlpParams);
+        
+        classifier.train(trData, encode(trResponses), cv::Mat(), cv::Mat(),
+                         mlpParams);
         
         cv::Mat valPredictions;
         classifier.predict(valData, valPredictions);
-
-        float bestValAcc, prevAcc;
-        prevAcc = bestValAcc = accuracy(valResponses, decode(valPredictions));
         
-        cv::Mat tePredictions;
-        classifier.predict(teData, tePredictions);
+        float prevAcc, bestAcc;
+        prevAcc = bestAcc = accuracy(valResponses, decode(valPredictions));
         
         bool overfitting = false; // wheter performance in validation keeps decreasing
         int counter = 0; // number of iterations the performance in validation is getting worse
+        
         bool saturation = false; // performance in training is saturated
         
-        int e;
-        for (e = 0; e < m_numOfEpochs && !overfitting && !saturation; e++)
+        for (int e = 0; e < m_numOfEpochs && !overfitting && !saturation; e++)
         {
-            int iters = classifier.train(validTrData, encode(validTrResponses), cv::Mat(), cv::Mat(),
-                                             mlpParams, CvANN_MLP::UPDATE_WEIGHTS);
+            int iters = classifier.train(trData, encode(trResponses), cv::Mat(), cv::Mat(),
+                                         mlpParams, CvANN_MLP::UPDATE_WEIGHTS);
             saturation = (iters < 1);
             
             // Test phase
-            cv::Mat valPredictions;
             classifier.predict(valData, valPredictions);
             
             float acc = accuracy(valResponses, decode(valPredictions));
-            if (acc > bestValAcc)
-            {
-                bestValAcc = acc;
-                classifier.predict(teData, tePredictions);
-            }
+            if (acc > bestAcc) bestAcc = acc;
             
             if (acc > prevAcc) counter = 0;
-            else overfitting = (++counter == 3); // last e consecutive epochs getting worse
+            else overfitting = (++counter == 3);
             
             prevAcc = acc;
         }
-
-        cvx::setMat(decode(tePredictions), fusionPredictions, m_partitions == k);
+        
+        accSum += bestAcc;
     }
-    cout << endl;
     
-    m_fusionPredictions = fusionPredictions;
+    // Compute an accuracy measure (mean over the repetitions)
+    return accSum / m_numOfRepetitions;
 }
 
-void ClassifierFusionPrediction<cv::EM40,CvANN_MLP>::_modelSelection(cv::Mat& descriptorsTr, cv::Mat& responsesTr, cv::Mat& descriptorsVal, cv::Mat& responsesVal, int k, cv::Mat& expandedParams, cv::Mat& accuracies)
+void ClassifierFusionPrediction<cv::EM40,CvANN_MLP>::trainAndPredict(cv::Mat trData, cv::Mat trResponses, cv::Mat valData, cv::Mat valResponses, cv::Mat params, cv::Mat teData, cv::Mat& tePredictions)
 {
-    cv::Mat foldAccs (expandedParams.rows, m_numOfRepetitions, cv::DataType<float>::type); // results
+    // Training phase
+    float bestHiddenSize = params.at<float>(0,0);
     
-    for (int m = 0; m < expandedParams.rows; m++)
-    {
-        // Training phase
-        cv::Mat selectedParams = expandedParams.row(m);
-        
-        float hiddenSize     = selectedParams.at<float>(0,0);
-        
-        cv::Mat layerSizes (3, 1, cv::DataType<int>::type);
-        layerSizes.at<int>(0,0) = descriptorsTr.cols; // as many inputs as feature vectors' num of dimensions
-        layerSizes.at<int>(1,0) = hiddenSize; // num of hidden neurons experimentally selected
-        layerSizes.at<int>(2,0) = 2; // one output neuron
-        
-        for (int r = 0; r < m_numOfRepetitions; r++)
-        {
-            CvANN_MLP classifer (layerSizes, m_actFcnType);
-            
-            CvANN_MLP_TrainParams mlpParams (cv::TermCriteria(CV_TERMCRIT_ITER + CV_TERMCRIT_EPS, 1, 1e-2), CvANN_MLP_TrainParams::BACKPROP, 0.1, 0.1);
-            
-            classifer.train(descriptorsTr, encode(responsesTr), cv::Mat(), cv::Mat(),
-                                 mlpParams);
-            
-            cv::Mat predictionsVal;
-            classifer.predict(descriptorsVal, predictionsVal);
-            
-            float prevAcc, bestAcc;
-            prevAcc = bestAcc = accuracy(responsesVal, decode(predictionsVal));
-            
-            bool overfitting = false; // wheter performance in validation keeps decreasing
-            int counter = 0; // number of iterations the performance in validation is getting worse
-            
-            bool saturation = false; // performance in training is saturated
-            
-            int e;
-            for (e = 0; e < m_numOfEpochs && !overfitting && !saturation; e++)
-            {
-                int iters = classifer.train(descriptorsTr, encode(responsesTr), cv::Mat(), cv::Mat(),
-                                                 mlpParams, CvANN_MLP::UPDATE_WEIGHTS);
-                saturation = (iters < 1);
-                
-                // Test phase
-                cv::Mat predictionsVal;
-                classifer.predict(descriptorsVal, predictionsVal);
-                
-                float acc = accuracy(responsesVal, decode(predictionsVal));
-                if (acc > bestAcc) bestAcc = acc;
-                
-                if (acc > prevAcc) counter = 0;
-                else overfitting = (++counter == 3);
-                
-                prevAcc = acc;
-            }
-            
-            // Compute an accuracy measure
-            foldAccs.at<float>(m,r) = bestAcc;
-        }
-    }
+    cv::Mat layerSizes (3, 1, cv::DataType<int>::type);
+    layerSizes.at<int>(0,0) = trData.cols; // as many inputs as feature vectors' num of dimensions
+    layerSizes.at<int>(1,0) = bestHiddenSize; // num of hidden neurons experimentally selected
+    layerSizes.at<int>(2,0) = 2; // one output neuron
     
-    cv::Mat tmp;
-    cvx::hmean(foldAccs, tmp);
+    CvANN_MLP classifier;
+    classifier.create(layerSizes, m_actFcnType);
     
-    m_mutex.lock();
-    tmp.copyTo(accuracies.col(k));
-    m_mutex.unlock();
-}
-
-void ClassifierFusionPrediction<cv::EM40,CvANN_MLP>::modelSelection(cv::Mat data, cv::Mat responses, cv::Mat expandedParams, cv::Mat& goodnesses)
-{
-    goodnesses.release();
+    CvANN_MLP_TrainParams mlpParams (cv::TermCriteria(CV_TERMCRIT_ITER + CV_TERMCRIT_EPS, 1, 1e-2), CvANN_MLP_TrainParams::BACKPROP, 0.1, 0.1);
     
-    // Partitionate the data in folds
-    cv::Mat partitions;
-    cvpartition(responses, m_modelSelecK, m_seed, partitions);
+    classifier.train(trData, encode(trResponses), cv::Mat(), cv::Mat(),
+                     mlpParams);
     
-    cv::Mat accuracies (expandedParams.rows, m_modelSelecK, cv::DataType<float>::type);
+    cv::Mat valPredictions;
+    classifier.predict(valData, valPredictions);
     
-    cout << "(";
-    boost::thread_group tg;
-    for (int k = 0; k < m_modelSelecK; k++)
+    float bestValAcc, prevAcc;
+    prevAcc = bestValAcc = accuracy(valResponses, decode(valPredictions));
+    
+    cv::Mat teOutputs;
+    classifier.predict(teData, teOutputs);
+    
+    bool overfitting = false; // wheter performance in validation keeps decreasing
+    int counter = 0; // number of iterations the performance in validation is getting worse
+    bool saturation = false; // performance in training is saturated
+    
+    for (int e = 0; e < m_numOfEpochs && !overfitting && !saturation; e++)
     {
-        cout << k;
+        int iters = classifier.train(trData, encode(trResponses), cv::Mat(), cv::Mat(),
+                                     mlpParams, CvANN_MLP::UPDATE_WEIGHTS);
+        saturation = (iters < 1);
         
-        // Get fold's data
+        // Test phase
+        classifier.predict(valData, valPredictions);
         
-        cv::Mat trData = cvx::indexMat(data, partitions != k);
-        cv::Mat valData = cvx::indexMat(data, partitions == k);
-        cv::Mat trResponses = cvx::indexMat(responses, partitions != k);
-        cv::Mat valResponses = cvx::indexMat(responses, partitions == k);
+        float acc = accuracy(valResponses, decode(valPredictions));
+        if (acc > bestValAcc)
+        {
+            bestValAcc = acc;
+            classifier.predict(teData, teOutputs);
+        }
         
-        cv::Mat trSbjObjData = cvx::indexMat(trData, trResponses >= 0); // ignore unknown category (class -1) in training
-        cv::Mat trSbjObjResponses = cvx::indexMat(trResponses, trResponses >= 0);
+        if (acc > prevAcc) counter = 0;
+        else overfitting = (++counter == 3); // last e consecutive epochs getting worse
         
-        tg.add_thread(new boost::thread( boost::bind(&ClassifierFusionPrediction::_modelSelection, this, trSbjObjData, trSbjObjResponses, valData, valResponses, k, expandedParams, accuracies) ));
+        prevAcc = acc;
     }
-    tg.join_all();
-    cout << ") " << endl;
     
-    // mean along the horizontal direction
-    cvx::hmean(accuracies, goodnesses); // one column of m accuracies evaluation the m combinations is left
+    tePredictions = decode(teOutputs);
 }
 
 //
@@ -1336,7 +850,7 @@ void ClassifierFusionPrediction<cv::EM40,CvRTrees>::setNoVars(vector<float> n)
 
 void ClassifierFusionPrediction<cv::EM40,CvRTrees>::predict(cv::Mat& fusionPredictions)
 {
-    formatData();
+    TRACE_SCOPE("ClassifierFusionPrediction<RTrees>::predict");
     
     // Prepare parameters' combinations
     vector<vector<float> > params;
@@ -1344,228 +858,58 @@ void ClassifierFusionPrediction<cv::EM40,CvRTrees>::predict(cv::Mat& fusionPredi
     params.push_back(m_MaxNoTrees);
     params.push_back(m_NoVars);
     
-    // create a list of parameters' variations
-    cv::Mat coarseExpandedParameters;
-    expandParameters(params, coarseExpandedParameters);
+    vector<int> discretes;
+    discretes += 0, 0, 0;
     
-    //    cv::Mat partitions;
-    //    cvpartition(m_responses, m_testK, m_seed, partitions);
+    std::stringstream name;
+    name << "rf_" << m_distsToMargin.size() << (m_bStackPredictions ? "_s" : "");
     
-    if (m_bModelSelection)
-    {
-        cout << "Coarse model selection CVs [" << m_testK << "]: " << endl;
-        
-        for (int k = 0; k < m_testK; k++)
-        {
-            cout << k << " " << endl;
-            
-            cv::Mat trData = cvx::indexMat(m_data, (m_partitions != k) & (m_partitions != ((k+1) % m_testK)));
-            cv::Mat teData = cvx::indexMat(m_data, m_partitions == k);
-            cv::Mat valData = cvx::indexMat(m_data, m_partitions == ((k+1) % m_testK));
-            cv::Mat trResponses = cvx::indexMat(m_responses, (m_partitions != k) & (m_partitions != ((k+1) % m_testK)));
-            cv::Mat teResponses = cvx::indexMat(m_responses, m_partitions == k);
-            cv::Mat valResponses = cvx::indexMat(m_responses, m_partitions == ((k+1) % m_testK));
-            
-            // Coarse search
-            cv::Mat coarseGoodnesses; // for instance: accuracies
-            modelSelection(trData, trResponses, coarseExpandedParameters, coarseGoodnesses);
-            
-            std::stringstream coarsess;
-            coarsess << "rf_" << m_distsToMargin.size() << (m_bStackPredictions ? "_s" : "") << "_coarse-goodnesses_" << k << (m_bTrainMirrored ? "m" : "") << ".yml";
-            cv::hconcat(coarseExpandedParameters, coarseGoodnesses, coarseGoodnesses);
-            cvx::save(coarsess.str(), coarseGoodnesses);
-        }
-        cout << endl;
-    }
-    
-    cv::Mat coarseGoodnesses, aux;
-    for (int k = 0; k < m_testK; k++)
-    {
-        cv::Mat aux;
-        std::stringstream ss;
-        ss << "rf_" << m_distsToMargin.size() << (m_bStackPredictions ? "_s" : "") << "_coarse-goodnesses_" << k << (m_bTrainMirrored ? "m" : "") << ".yml";
-        cvx::load(ss.str(), aux);
-        if (coarseGoodnesses.empty()) coarseGoodnesses = aux.col(params.size());
-        else cv::hconcat(coarseGoodnesses, aux.col(params.size()), coarseGoodnesses);
-    }
-    cv::reduce(coarseGoodnesses, aux, 1, CV_REDUCE_AVG);
-    cv::hconcat(coarseExpandedParameters, aux, coarseGoodnesses);
-    
-    cv::Mat narrowExpandedParameters;
-    int discretes[] = {0,0};
-    narrow<float>(coarseExpandedParameters, coarseGoodnesses, m_narrowSearchSteps, discretes, narrowExpandedParameters);
-    
-    if (m_bModelSelection)
-    {
-        cout << "Narrow model selection CVs [" << m_testK << "]: " << endl;
-        
-        for (int k = 0; k < m_testK; k++)
-        {
-            cout << k << " " << endl;
-            
-            cv::Mat trData = cvx::indexMat(m_data, (m_partitions != k) & (m_partitions != ((k+1) % m_testK)));
-            cv::Mat teData = cvx::indexMat(m_data, m_partitions == k);
-            cv::Mat valData = cvx::indexMat(m_data, m_partitions == ((k+1) % m_testK));
-            cv::Mat trResponses = cvx::indexMat(m_responses, (m_partitions != k) & (m_partitions != ((k+1) % m_testK)));
-            cv::Mat teResponses = cvx::indexMat(m_responses, m_partitions == k);
-            cv::Mat valResponses = cvx::indexMat(m_responses, m_partitions == ((k+1) % m_testK));
-            
-            // Narrow search
-            
-            cv::Mat narrowGoodnesses;
-            modelSelection(trData, trResponses, narrowExpandedParameters, narrowGoodnesses);
-            
-            std::stringstream narrowss;
-            narrowss << "rf_" << m_distsToMargin.size() << (m_bStackPredictions ? "_s" : "") << "_narrow-goodnesses_" << k << (m_bTrainMirrored ? "m" : "") << ".yml";
-            cv::hconcat(narrowExpandedParameters, narrowGoodnesses, narrowGoodnesses);
-            cvx::save(narrowss.str(), narrowGoodnesses);
-        }
-        cout << endl;
-    }
-    
-    cv::Mat goodnesses;
-    for (int k = 0; k < m_testK; k++)
-    {
-        cv::Mat aux;
-        std::stringstream ss;
-        ss << "rf_" << m_distsToMargin.size() << (m_bStackPredictions ? "_s" : "") << "_narrow-goodnesses_" << k << (m_bTrainMirrored ? "m" : "") << ".yml";
-        cvx::load(ss.str(), aux);
-        if (goodnesses.empty()) goodnesses = aux.col(params.size());
-        else cv::hconcat(goodnesses, aux.col(params.size()), goodnesses);
-    }
-    //    cv::reduce(goodnesses, aux, 1, CV_REDUCE_AVG);
-    //    cv::hconcat(coarseExpandedParameters, aux, goodnesses);
-    
-    
-    cout << "Out-of-sample CV [" << m_testK << "] : " << endl;
-    
-    fusionPredictions.create(m_responses.rows, 1, cv::DataType<int>::type);
-    
-    for (int k = 0; k < m_testK; k++)
-    {
-        cout << k << " ";
-        
-        cv::Mat trData = cvx::indexMat(m_data, (m_partitions != k) & (m_partitions != ((k+1) % m_testK)));
-        cv::Mat teData = cvx::indexMat(m_data, m_partitions == k);
-        cv::Mat valData = cvx::indexMat(m_data, m_partitions == ((k+1) % m_testK));
-        cv::Mat trResponses = cvx::indexMat(m_responses, (m_partitions != k) & (m_partitions != ((k+1) % m_testK)));
-        cv::Mat teResponses = cvx::indexMat(m_responses, m_partitions == k);
-        cv::Mat valResponses = cvx::indexMat(m_responses, m_partitions == ((k+1) % m_testK));
-        
-        cv::Mat validTrData = cvx::indexMat(trData, trResponses >= 0); // -1 labels not used in training
-        cv::Mat validTrResponses = cvx::indexMat(trResponses, trResponses >= 0);
-        
-        cv::Mat goodness;
-        if (m_bGlobalBest)
-        {
-            GridMat globalMean;
-            cv::reduce(goodnesses, goodness, 1, CV_REDUCE_AVG);
-        }
-        else
-        {
-            goodness = goodnesses.col(k);
-        }
-        
-        // Find best parameters (using goodnesses) to train the final model
-        double minVal, maxVal;
-        cv::Point worst, best;
-        cv::minMaxLoc(goodness, &minVal, &maxVal, &worst, &best);
-        
-        // Training phase
-        float bestMaxDepth   = narrowExpandedParameters.row(best.y).at<float>(0,0);
-        float bestMaxNoTrees = narrowExpandedParameters.row(best.y).at<float>(0,1);
-        float bestNoVars = narrowExpandedParameters.row(best.y).at<float>(0,2);
-        
-        CvRTParams params;
-        params.max_depth = bestMaxDepth;
-        params.min_sample_count = validTrData.rows * 0.01f;
-        params.nactive_vars = bestNoVars * validTrData.cols;
-        params.term_crit = cvTermCriteria(CV_TERMCRIT_ITER, bestMaxNoTrees, 0);
-        
-        m_pClassifier->train(validTrData, CV_ROW_SAMPLE, validTrResponses, cv::Mat(), cv::Mat(), cv::Mat(), cv::Mat(), params);
-        
-        // Prediction phase
-        cv::Mat tePredictions (teData.rows, 1, cv::DataType<float>::type);
-        for (int i = 0; i < teData.rows; i++)
-            tePredictions.at<float>(i,0) = m_pClassifier->predict(teData.row(i));
-        
-        cvx::setMat(tePredictions, fusionPredictions, m_partitions == k);
-    }
-    cout << endl;
-    
-    m_fusionPredictions = fusionPredictions;
+    searchAndPredict(name.str(), params, discretes, fusionPredictions);
 }
 
-void ClassifierFusionPrediction<cv::EM40,CvRTrees>::_modelSelection(cv::Mat& descriptorsTr, cv::Mat& responsesTr, cv::Mat& descriptorsVal, cv::Mat& responsesVal, int k, cv::Mat& expandedParams, cv::Mat& accuracies)
+float ClassifierFusionPrediction<cv::EM40,CvRTrees>::validate(cv::Mat trData, cv::Mat trResponses, cv::Mat valData, cv::Mat valResponses, cv::Mat params)
 {
-    cv::Mat foldAccs (expandedParams.rows, 1, cv::DataType<float>::type); // results
+    // Training phase
+    float maxDepth = params.at<float>(0,0);
+    float maxNoTrees = params.at<float>(0,1);
+    float noVars = params.at<float>(0,2);
     
-    for (int m = 0; m < expandedParams.rows; m++)
-    {
-        // Training phase
-        cv::Mat selectedParams = expandedParams.row(m);
-        
-        float maxDepth = selectedParams.at<float>(0,0);
-        float maxNoTrees = selectedParams.at<float>(0,1); // indeed, gamma not used if not RBF kernel
-        float noVars = selectedParams.at<float>(0,2);
-        
-        CvRTParams params;
-        params.max_depth = maxDepth;
-        params.min_sample_count = descriptorsTr.rows * 0.01f;
-        params.nactive_vars = noVars * descriptorsTr.cols;
-        params.term_crit = cvTermCriteria(CV_TERMCRIT_ITER, maxNoTrees, 0);
-        
-        CvRTrees classifier;
-        classifier.train(descriptorsTr, CV_ROW_SAMPLE, responsesTr, cv::Mat(), cv::Mat(), cv::Mat(), cv::Mat(), params);
-        
-        // Test phase
-        cv::Mat predictionsVal (descriptorsVal.rows, 1, cv::DataType<float>::type);
-        for (int i = 0; i < descriptorsVal.rows; i++)
-        {
-            float p = classifier.predict(descriptorsVal.row(i));
-            predictionsVal.at<float>(i,0) = p;
-        }
-        
-        // Compute an accuracy measure
-        foldAccs.at<float>(m,0) = accuracy(responsesVal, predictionsVal);
-    }
+    CvRTParams rtParams;
+    rtParams.max_depth = maxDepth;
+    rtParams.min_sample_count = trData.rows * 0.01f;
+    rtParams.nactive_vars = noVars * trData.cols;
+    rtParams.term_crit = cvTermCriteria(CV_TERMCRIT_ITER, maxNoTrees, 0);
     
-    m_mutex.lock();
-    foldAccs.copyTo(accuracies.col(k));
-    m_mutex.unlock();
+    CvRTrees classifier;
+    classifier.train(trData, CV_ROW_SAMPLE, trResponses, cv::Mat(), cv::Mat(), cv::Mat(), cv::Mat(), rtParams);
+    
+    // Test phase
+    cv::Mat valPredictions (valData.rows, 1, cv::DataType<float>::type);
+    for (int i = 0; i < valData.rows; i++)
+        valPredictions.at<float>(i,0) = classifier.predict(valData.row(i));
+    
+    // Compute an accuracy measure
+    return accuracy(valResponses, valPredictions);
 }
 
-void ClassifierFusionPrediction<cv::EM40,CvRTrees>::modelSelection(cv::Mat data, cv::Mat responses, cv::Mat expandedParams, cv::Mat& goodnesses)
+void ClassifierFusionPrediction<cv::EM40,CvRTrees>::trainAndPredict(cv::Mat trData, cv::Mat trResponses, cv::Mat valData, cv::Mat valResponses, cv::Mat params, cv::Mat teData, cv::Mat& tePredictions)
 {
-    goodnesses.release();
-    
-    // Partitionate the data in folds
-    cv::Mat partitions;
-    cvpartition(responses, m_modelSelecK, m_seed, partitions);
+    // Training phase
+    float bestMaxDepth   = params.at<float>(0,0);
+    float bestMaxNoTrees = params.at<float>(0,1);
+    float bestNoVars     = params.at<float>(0,2);
     
-    cv::Mat accuracies (expandedParams.rows, m_modelSelecK, cv::DataType<float>::type);
+    CvRTParams rtParams;
+    rtParams.max_depth = bestMaxDepth;
+    rtParams.min_sample_count = trData.rows * 0.01f;
+    rtParams.nactive_vars = bestNoVars * trData.cols;
+    rtParams.term_crit = cvTermCriteria(CV_TERMCRIT_ITER, bestMaxNoTrees, 0);
     
-    boost::thread_group tg;
-    cout << "(";
-    for (int k = 0; k < m_modelSelecK; k++)
-    {
-        cout << k;
-        
-        // Get fold's data
-        
-        cv::Mat trData = cvx::indexMat(data, partitions != k);
-        cv::Mat valData = cvx::indexMat(data, partitions == k);
-        cv::Mat trResponses = cvx::indexMat(responses, partitions != k);
-        cv::Mat valResponses = cvx::indexMat(responses, partitions == k);
-        
-        cv::Mat trSbjObjData = cvx::indexMat(trData, trResponses >= 0); // ignore unknown category (class -1) in training
-        cv::Mat trSbjObjResponses = cvx::indexMat(trResponses, trResponses >= 0);
-        
-        tg.add_thread(new boost::thread( boost::bind(&ClassifierFusionPrediction::_modelSelection, this, trSbjObjData, trSbjObjResponses, valData, valResponses, k, expandedParams, accuracies) ));
-    }
-    tg.join_all();
-    cout << ") " << endl;
+    CvRTrees classifier;
+    classifier.train(trData, CV_ROW_SAMPLE, trResponses, cv::Mat(), cv::Mat(), cv::Mat(), cv::Mat(), rtParams);
     
-    // mean along the horizontal direction
-    cvx::hmean(accuracies, goodnesses); // one column of m accuracies evaluation the m combinations is left
+    // Prediction phase
+    tePredictions.create(teData.rows, 1, cv::DataType<float>::type);
+    for (int i = 0; i < teData.rows; i++)
+        tePredictions.at<float>(i,0) = classifier.predict(teData.row(i));
 }
\ No newline at end of file
@@ -18,6 +18,8 @@
 #include "ModalityGridData.hpp"
 #include "GridMat.h"
 #include "em.h"
+#include "FoldPlan.h"
+#include "GridSearch.h"
 
 #include <boost/thread.hpp>
 
@@ -34,7 +36,7 @@ public:
     
     SimpleFusionPrediction();
     
-    void setModalitiesData(vector<ModalityGridData> mgds);
+    void setModalitiesData(const vector<ModalityGridData>& mgds);
     
     // Cells' preconsensus
 
@@ -50,7 +52,9 @@ public:
     
 private:
     
-    void predict(GridMat distsToMarginGrid, GridMat& fusionPredictions, GridMat& fusionDistsToMargin);
+    // Cells' fusion, the modalities' predictions (or distances, if no predictions) voting on every cell
+    void predict(const vector<GridMat>& allPredictions, const vector<GridMat>& allDistsToMargin, int flags,
+                 GridMat& fusionPredictions, GridMat& fusionDistsToMargin);
     void computeGridConsensusPredictions(GridMat fusionPredictionsGrid,
                                          GridMat fusionDistsToMarginGrid,
                                          cv::Mat& consensusfusionPredictions,
@@ -85,8 +89,9 @@ class ClassifierFusionPredictionBase<cv::EM40, ClassifierT>
 public:
     
     ClassifierFusionPredictionBase();
+    virtual ~ClassifierFusionPredictionBase() {}
     
-    void setData(vector<ModalityGridData> mgds, vector<GridMat> distsToMargin, vector<cv::Mat> predictions);
+    void setData(const vector<ModalityGridData>& mgds, const vector<GridMat>& distsToMargin, const vector<cv::Mat>& predictions);
     
     void setModelSelection(bool flag);
     void setModelSelectionParameters(int k, int seed, bool bGlobalBest);
@@ -97,11 +102,33 @@ public:
     
     void setStackedPrediction(bool flag);
     
+    void setSuccessiveHalving(int eta); // eta < 2 for exhaustive grid searches
+    
     cv::Mat getAccuracies();
     
+    void modelSelection(cv::Mat data, cv::Mat responses, cv::Mat params, cv::Mat& goodnesses);
+    
 protected:
     
     void formatData();
+    void planFolds(std::string searchLogFile);
+    
+    // Fold-parallel CV over the fold plan: the grid search of a model selection stage
+    // runs for all the outer folds at once, the out-of-sample prediction one job per outer fold
+    void modelSelection(std::string stage, cv::Mat expandedParams, vector<cv::Mat>& goodnesses);
+    void outOfSample(cv::Mat expandedParams, cv::Mat goodnesses, cv::Mat& fusionPredictions);
+    
+    // The specializations' predict(): coarse model selection on the combinations of params, narrow model
+    // selection around the best one (discretes flagging the integer parameters) and out-of-sample prediction.
+    // name prefixes the file logging the evaluations
+    void searchAndPredict(string name, const vector<vector<float> >& params, vector<int> discretes, cv::Mat& fusionPredictions);
+    
+    float _validateSplit(int k, int j, cv::Mat params, int J, const vector<cv::Mat>& trData, const vector<cv::Mat>& trResponses, const vector<cv::Mat>& valData, const vector<cv::Mat>& valResponses);
+    void _outOfSample(int k, cv::Mat expandedParams, cv::Mat goodnesses, cv::Mat fusionPredictions);
+    
+    // Classifier-specific parts, called concurrently from the CV jobs
+    virtual float validate(cv::Mat trData, cv::Mat trResponses, cv::Mat valData, cv::Mat valResponses, cv::Mat params) = 0;
+    virtual void trainAndPredict(cv::Mat trData, cv::Mat trResponses, cv::Mat valData, cv::Mat valResponses, cv::Mat params, cv::Mat teData, cv::Mat& tePredictions) = 0;
 
     // Attributes
     
@@ -123,6 +150,8 @@ protected:
     
     int m_seed;
     cv::Mat m_partitions;
+    FoldPlan m_foldPlan;
+    GridSearch m_gridSearch;
     
     bool m_bStackPredictions;
     
@@ -151,12 +180,11 @@ public:
     void setCs(vector<float> cs);
     void setGammas(vector<float> gammas);
     
-    void modelSelection(cv::Mat data, cv::Mat responses, cv::Mat params, cv::Mat& goodnesses);
-    
     void predict(cv::Mat& fusionPredictions);
 
 private:
-    void _modelSelection(cv::Mat& descriptorsTr, cv::Mat& responsesTr, cv::Mat& descriptorsVal, cv::Mat& responsesVal, int k, cv::Mat& expandedParams, cv::Mat& accuracies);
+    float validate(cv::Mat trData, cv::Mat trResponses, cv::Mat valData, cv::Mat valResponses, cv::Mat params);
+    void trainAndPredict(cv::Mat trData, cv::Mat trResponses, cv::Mat valData, cv::Mat valResponses, cv::Mat params, cv::Mat teData, cv::Mat& tePredictions);
     
     // Attributes
     
@@ -180,12 +208,11 @@ public:
     void setNumOfWeaks(vector<float> numOfWeaks);
     void setWeightTrimRate(vector<float> weightTrimRates);
     
-    void modelSelection(cv::Mat data, cv::Mat responses, cv::Mat params, cv::Mat& goodnesses);
-    
     void predict(cv::Mat& fusionPredictions);
     
 private:
-    void _modelSelection(cv::Mat& descriptorsTr, cv::Mat& responsesTr, cv::Mat& descriptorsVal, cv::Mat& responsesVal, int k, cv::Mat& expandedParams, cv::Mat& accuracies);
+    float validate(cv::Mat trData, cv::Mat trResponses, cv::Mat valData, cv::Mat valResponses, cv::Mat params);
+    void trainAndPredict(cv::Mat trData, cv::Mat trResponses, cv::Mat valData, cv::Mat valResponses, cv::Mat params, cv::Mat teData, cv::Mat& tePredictions);
     
     // Attributes
     
@@ -211,12 +238,11 @@ public:
     //void setBackpropDecayWeightScales(vector<float> dwScales);
     //void setBackpropMomentScales(vector<float> momScales);
     
-    void modelSelection(cv::Mat data, cv::Mat responses, cv::Mat params, cv::Mat& goodnesses);
-    
     void predict(cv::Mat& fusionPredictions);
     
 private:
-    void _modelSelection(cv::Mat& descriptorsTr, cv::Mat& responsesTr, cv::Mat& descriptorsVal, cv::Mat& responsesVal, int k, cv::Mat& expandedParams, cv::Mat& accuracies);
+    float validate(cv::Mat trData, cv::Mat trResponses, cv::Mat valData, cv::Mat valResponses, cv::Mat params);
+    void trainAndPredict(cv::Mat trData, cv::Mat trResponses, cv::Mat valData, cv::Mat valResponses, cv::Mat params, cv::Mat teData, cv::Mat& tePredictions);
     
     // Attributes
     int m_actFcnType; // activation function type
@@ -241,12 +267,11 @@ public:
     void setMaxNoTrees(vector<float> n);
     void setNoVars(vector<float> n);
     
-    void modelSelection(cv::Mat data, cv::Mat responses, cv::Mat params, cv::Mat& goodnesses);
-    
     void predict(cv::Mat& fusionPredictions);
     
 private:
-    void _modelSelection(cv::Mat& descriptorsTr, cv::Mat& responsesTr, cv::Mat& descriptorsVal, cv::Mat& responsesVal, int k, cv::Mat& expandedParams, cv::Mat& accuracies);
+    float validate(cv::Mat trData, cv::Mat trResponses, cv::Mat valData, cv::Mat valResponses, cv::Mat params);
+    void trainAndPredict(cv::Mat trData, cv::Mat trResponses, cv::Mat valData, cv::Mat valResponses, cv::Mat params, cv::Mat teData, cv::Mat& tePredictions);
     
     // Attributes
     
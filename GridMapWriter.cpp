@@ -7,6 +7,8 @@
 //
 
 #include "GridMapWriter.h"
+#include "BoundedQueue.hpp"
+#include "ParallelFor.h"
 
 #include <sys/stat.h>
 #include <string>
@@ -15,8 +17,12 @@
 #include <boost/filesystem/operations.hpp>
 #include <boost/filesystem/fstream.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
 
-#include <set>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
 
 using namespace boost::filesystem;
 
@@ -40,13 +46,13 @@ GridMapWriter::GridMapWriter()
     
 }
 
-GridMapWriter::GridMapWriter(ModalityGridData& mgd, GridMat& values)
+GridMapWriter::GridMapWriter(const ModalityGridData& mgd, GridMat& values)
 : m_mgd(mgd), m_values(values)
 {
     
 }
 
-void GridMapWriter::setModalityGridData(ModalityGridData& mgd)
+void GridMapWriter::setModalityGridData(const ModalityGridData& mgd)
 {
     m_mgd = mgd;
 }
@@ -62,137 +68,188 @@ void GridMapWriter::write(std::string outputDir)
     write<T>(m_mgd, m_values, outputDir);
 }
 
-unsigned char colors[][3] = {{255,0,0},{0,255,0},{0,0,255},{255,255,0},{255,0,255},{0,255,255}};
-template<typename T>
-void GridMapWriter::write(ModalityGridData& mgd, GridMat& gvalues, string outputDir)
+//
+// Map rendering
+//
+
+namespace
 {
-    cv::Mat gridsScenesIDs = mgd.getSceneIDsMat();
-    cv::Mat gridsFramesIDs = mgd.getFrameIDsMat();
+    struct EncodedMap
+    {
+        std::string path;
+        std::vector<uchar> png;
+    };
     
-    cv::Mat counts (mgd.getHp(), mgd.getWp(), cv::DataType<int>::type);
-    counts.setTo(0);
+    // Sorts the grids by scene, frame and index, the order their values are in the cells
+    struct GridOrder
+    {
+        GridOrder(const vector<int>& sceneIDs, const vector<int>& frameIDs) : scenes(sceneIDs), frames(frameIDs) {}
+        
+        bool operator()(int a, int b) const
+        {
+            if (scenes[a] != scenes[b]) return scenes[a] < scenes[b];
+            if (frames[a] != frames[b]) return frames[a] < frames[b];
+            return a < b;
+        }
+        
+        const vector<int>& scenes;
+        const vector<int>& frames;
+    };
+    
+    struct MapJobs
+    {
+        ModalityGridData* pMgd;
+        GridMat values;
+        string outputDir;
+        string masksModality;
+        
+        vector<int> order; // grids' indices in GridOrder
+        vector<int> frameBegins; // the grids of the f-th frame are order[frameBegins[f]] ... order[frameBegins[f+1]-1]
+        
+        ParallelError error; // the first one of the renderers or the writer
+        
+        BoundedQueue<EncodedMap> encoded;
+    };
     
-    for (int s = 0; s < mgd.getNumOfScenes(); s++)
+    // Renders the f-th frame's map, encoded as PNG to the writer
+    template<typename T>
+    void renderMap(MapJobs& jobs, int f)
     {
-        cv::Mat framesInSceneIndices;
-        cv::findNonZero(gridsScenesIDs == s, framesInSceneIndices);
+        ModalityGridData& mgd = *jobs.pMgd;
+        int hp = mgd.getHp();
+        int wp = mgd.getWp();
+        
+        int idx0 = jobs.order[jobs.frameBegins[f]];
         
-        int begin   = framesInSceneIndices.at<int>(0,1);
-        int end     = framesInSceneIndices.at<int>(framesInSceneIndices.rows-1, 1);
+        string frameFilename = mgd.getFrameFilename(idx0);
+        string frameFilePath = mgd.getFramePath(idx0);
+        cv::Point2d res = mgd.getFrameResolution(idx0);
         
-        set<int> e (mgd.getFrameIDs().begin() + begin,
-                    mgd.getFrameIDs().begin() + end);
-        vector<int> uniqueFrameIDs (e.begin(), e.end());
+        cv::Mat mask = cv::imread(frameFilePath + "Masks/" + jobs.masksModality + "/" + frameFilename + ".png",
+                                  CV_LOAD_IMAGE_ANYDEPTH | CV_LOAD_IMAGE_ANYCOLOR);
+        if (mask.empty())
+            CV_Error(CV_StsObjectNotFound, "Could not read the mask of " + frameFilePath + frameFilename);
         
-        for (int f = 0; f < uniqueFrameIDs.size(); f++)
+        cv::Mat map (res.y, res.x, cv::DataType<T>::type, cv::Scalar(0));
+        cv::Mat indexed (map.rows, map.cols, cv::DataType<unsigned char>::type);
+        
+        for (int p = jobs.frameBegins[f]; p < jobs.frameBegins[f+1]; p++)
         {
-            int fid = uniqueFrameIDs[f];
+            int idx = jobs.order[p];
+            cv::Rect r = mgd.getGridBoundingRect(idx);
             
-            cv::Mat gridsInFrameIndices, aux;
-            cv::bitwise_and(gridsScenesIDs == s, gridsFramesIDs == fid, aux);
-            cv::findNonZero(aux, gridsInFrameIndices);
-
-            int idx0 = gridsInFrameIndices.at<int>(0,1);
+            // pixels of the grid's person
+            cv::Mat roiIndexed (indexed, cv::Rect(0, 0, r.width, r.height));
+            cv::compare(cv::Mat(mask, r), cv::Scalar(mgd.getGridMaskOffset(idx)), roiIndexed, cv::CMP_EQ);
             
-            string frameFilename = mgd.getFrameFilename(idx0);
-            string frameFilePath = mgd.getFramePath(idx0);
-            cv::Point2d res = mgd.getFrameResolution(idx0);
+            // cells partitioned as in GridMat(cv::Mat, crows, ccols)
+            int a = floorf(((float) r.height) / hp);
+            int b = floorf(((float) r.width) / wp);
+            int ra = r.height - a * hp;
+            int rb = r.width - b * wp;
             
-            string modality = mgd.getModality();
-            if (modality.compare("Motion") == 0 || modality.compare("Ramanan") == 0)
+            for (int i = 0; i < hp; i++) for (int j = 0; j < wp; j++)
             {
-                modality = "Color";
+                cv::Rect cell ((j * b), (i * a), (j < rb) ? b+1 : b, (i < ra) ? a+1 : a);
+                
+                T value = jobs.values.at<T>(i, j, p, 0);
+                cv::Mat(map, cell + r.tl()).setTo(value, cv::Mat(roiIndexed, cell));
             }
-            cv::Mat mask = cv::imread(frameFilePath + "Masks/" + modality + "/" + frameFilename + ".png",
-                                      CV_LOAD_IMAGE_ANYDEPTH | CV_LOAD_IMAGE_ANYCOLOR);
-            
-//            // DEBUG
-//            // +----------------------------------------------------------------
-//            cv::Mat drawableMask;
-//            cv::cvtColor(mask.clone(), drawableMask, CV_GRAY2BGR);
-//            // +----------------------------------------------------------------
-            
-            cv::Mat map (res.y, res.x, cv::DataType<T>::type);
-            map.setTo(0);
-            
-            for (int k = 0; k < gridsInFrameIndices.rows; k++)
+        }
+        
+        // check: the map only contains 0s or 1s. Their added countings must coincide with #pixels in map
+        assert( cv::sum(map == 0).val[0]/255 + cv::sum(map == 1).val[0]/255 == (map.rows * map.cols) );
+        
+        cv::Mat map8;
+        map.convertTo(map8, cv::DataType<unsigned char>::type, 255);
+        
+        EncodedMap encoded;
+        encoded.path = frameFilePath + "Maps/" + jobs.outputDir + frameFilename + ".png";
+        cv::imencode(".png", map8, encoded.png);
+        
+        jobs.encoded.push(encoded);
+    }
+    
+    void writeMaps(MapJobs& jobs)
+    {
+        try
+        {
+            EncodedMap map;
+            while (jobs.encoded.pop(map))
             {
-                //cout << "scene " << s << ", filename " << frameFilename << ", rect " << k << "/" << gridsInFrameIndices.rows << endl;
-                int idx = gridsInFrameIndices.at<int>(k,1);
-                
-                cv::Rect r = mgd.getGridBoundingRect(idx);
-                cv::Mat validnesses = mgd.getValidnesses(idx).clone();
+                std::ofstream ofs (map.path.c_str(), std::ios::out | std::ios::binary);
+                if (!map.png.empty())
+                    ofs.write((const char*) &map.png[0], map.png.size());
                 
-//                // DEBUG
-//                // +----------------------------------------------------------------
-//                unsigned char red, green, blue;
-//                red = colors[k][0];
-//                green = colors[k][1];
-//                blue = colors[k][2];
-//                cv::rectangle(drawableMask, cv::Point(r.x, r.y), cv::Point(r.x+r.width, r.y+r.height),
-//                              cv::Scalar(red,green,blue,0),1,8,0);
-//                // +----------------------------------------------------------------
-                
-                cv::Mat roiMap (map, r);
-                GridMat gRoiMap (roiMap, mgd.getHp(), mgd.getWp());
-
-                cv::Mat roiMask (mask, r);
-                cv::Mat indexedmaskroi;
-                roiMask.copyTo(indexedmaskroi, roiMask == mgd.getGridMaskOffset(idx));
-                GridMat gRoiMask (indexedmaskroi, mgd.getHp(), mgd.getWp());
-
-                for (int i = 0; i < mgd.getHp(); i++) for (int j = 0; j < mgd.getWp(); j++)
-                {
-                    T value = gvalues.at<T>(i, j, counts.at<int>(i,j)++, 0);
-                    gRoiMap.setTo(value, i, j, gRoiMask.at(i,j));
-                }
-                
-                gRoiMap.convertToMat<T>().copyTo(roiMap, roiMask);
+                if (!ofs)
+                    std::cerr << "Could not write " << map.path << std::endl;
             }
-            
-            string mapPath = frameFilePath + "Maps/" + outputDir + frameFilename + ".png";
-
-            // check: the map only contains 0s or 1s. Their added countings must coincide with #pixels in map
-            assert( cv::sum(map == 0).val[0]/255 + cv::sum(map == 1).val[0]/255 == (map.rows * map.cols) );
-            
-            cv::imwrite(mapPath, map * 255);
-            
-//            // DEBUG
-//            // +----------------------------------------------------------------
-//            cv::Mat drawableMap;
-//            cv::cvtColor(map, drawableMap, CV_GRAY2BGR);
-//            for (int k = 0; k < gridsInFrameIndices.rows; k++)
-//            {
-//                cout << frameFilename << ", " << k << "/" << gridsInFrameIndices.rows << endl;
-//                int idx = gridsInFrameIndices.at<int>(k,1);
-//                
-//                cv::Rect r = mgd.getGridBoundingRect(idx);
-//                unsigned char red, green, blue;
-//                red = colors[k][0];
-//                green = colors[k][1];
-//                blue = colors[k][2];
-//                cv::rectangle(drawableMap, cv::Point(r.x, r.y), cv::Point(r.x+r.width, r.y+r.height),
-//                              cv::Scalar(red,green,blue,0),1,8,0);
-//            }
-//            
-//            cv::namedWindow("a");
-//            cv::imshow("a", drawableMap);
-//            cv::waitKey();
-//            // +----------------------------------------------------------------
-           
-//            // DEBUG
-//            // +----------------------------------------------------------------
-//            int predsHistSize[] = { 20 };
-//            int channels[] = { 0 }; // 1 channel, number 0
-//            float pranges[] = { 0, 256 };
-//            const float* ranges[] = { pranges };
-//            
-//            cv::Mat predictionsHist;
-//            cv::calcHist(&map, 1, channels, cv::Mat(), predictionsHist, 1, predsHistSize, ranges, true, false);
-//            cout << predictionsHist << endl;
-//            // +----------------------------------------------------------------
         }
+        catch (...)
+        {
+            jobs.error.capture();
+            jobs.encoded.close(); // for the renderers not to block on it
+        }
+    }
+}
+
+/*
+ * Maps of the frames, where the pixels of every person in a cell take the value of
+ * the cell (the values of the cells are in the order of the grids sorted by scene,
+ * frame and index). The frames are rendered concurrently, within the ThreadBudget,
+ * while a writer thread saves the already encoded ones.
+ */
+template<typename T>
+void GridMapWriter::write(ModalityGridData& mgd, GridMat& gvalues, string outputDir)
+{
+    MapJobs jobs;
+    jobs.pMgd = &mgd;
+    jobs.values = gvalues;
+    jobs.outputDir = outputDir;
+    
+    jobs.masksModality = mgd.getModality();
+    if (jobs.masksModality.compare("Motion") == 0 || jobs.masksModality.compare("Ramanan") == 0)
+    {
+        jobs.masksModality = "Color";
     }
+    
+    // Group the grids by frame, once
+    
+    const vector<int>& sceneIDs = mgd.getSceneIDs();
+    const vector<int>& frameIDs = mgd.getFrameIDs();
+    
+    jobs.order.resize(sceneIDs.size());
+    for (int k = 0; k < jobs.order.size(); k++)
+        jobs.order[k] = k;
+    std::sort(jobs.order.begin(), jobs.order.end(), GridOrder(sceneIDs, frameIDs));
+    
+    for (int p = 0; p < jobs.order.size(); p++)
+    {
+        if (p == 0 || sceneIDs[jobs.order[p]] != sceneIDs[jobs.order[p-1]] || frameIDs[jobs.order[p]] != frameIDs[jobs.order[p-1]])
+            jobs.frameBegins.push_back(p);
+    }
+    jobs.frameBegins.push_back(jobs.order.size());
+    
+    int nFrames = jobs.frameBegins.size() - 1;
+    
+    // Render and write
+    
+    boost::thread writer (boost::bind(&writeMaps, boost::ref(jobs)));
+    
+    try
+    {
+        parallelFor(nFrames, boost::bind(&renderMap<T>, boost::ref(jobs), _1));
+    }
+    catch (...)
+    {
+        jobs.error.capture(); // e.g. a missing mask
+    }
+    
+    // The writer saves the maps left in the queue
+    jobs.encoded.close();
+    writer.join();
+    
+    jobs.error.rethrow();
 }
 
 
@@ -18,9 +18,9 @@ class GridMapWriter
 {
 public:
     GridMapWriter();
-    GridMapWriter(ModalityGridData& mgd, GridMat& values);
+    GridMapWriter(const ModalityGridData& mgd, GridMat& values);
     
-    void setModalityGridData(ModalityGridData& mgd);
+    void setModalityGridData(const ModalityGridData& mgd);
     void setGridCellValues(GridMat& values);
     
     template<typename T>
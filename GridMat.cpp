@@ -14,6 +14,28 @@
 
 #include "CvExtraTools.h"
 
+namespace
+{
+    // Whether a cell has a positive element, with the element type known at compile
+    // time so that the scan has neither type dispatch nor bounds checks
+    template<typename T>
+    bool hasPositive(const cv::Mat& cell)
+    {
+        CV_Assert(cell.depth() == cv::DataType<T>::depth); // the rows are read as T
+        
+        for (int row = 0; row < cell.rows; row++)
+        {
+            const T* p = cell.ptr<T>(row);
+            for (int col = 0; col < cell.cols; col++)
+            {
+                if (p[col] > 0) return true;
+            }
+        }
+        
+        return false;
+    }
+}
+
 GridMat::GridMat(unsigned int crows, unsigned int ccols) : m_crows(crows), m_ccols(ccols)
 {    
     m_grid.resize(m_crows * m_ccols);
@@ -354,17 +376,6 @@ GridMat GridMat::col(unsigned int i)
     return g;
 }
 
-cv::Mat& GridMat::at(unsigned int i, unsigned int j)
-{
-    return m_grid[i * m_ccols + j];
-}
-
-template<typename T>
-T& GridMat::at(unsigned int i, unsigned int j, unsigned int row, unsigned int col)
-{
-    return m_grid[i * m_ccols + j].template at<T>(row,col);
-}
-
 
 cv::Mat GridMat::get(unsigned int i, unsigned int j) const
 {
@@ -539,12 +550,9 @@ void GridMat::setTo(T value, unsigned int i, unsigned int j)
 {
     if (this->at(i,j).type() != cv::DataType<T>::type)
         return;
-        
-    cv::Mat tmp (this->at(i,j).rows, this->at(i,j).cols, cv::DataType<T>::type);
-    tmp.setTo(value);
     
-    this->at(i,j).release();
-    tmp.copyTo(this->at(i,j));
+    // a new buffer, the cell's could be shared with other grids
+    this->at(i,j) = cv::Mat(this->at(i,j).rows, this->at(i,j).cols, cv::DataType<T>::type, cv::Scalar(value));
 }
 
 template<typename T>
@@ -553,11 +561,7 @@ void GridMat::setTo(T value, unsigned int i, unsigned int j, cv::Mat mask)
     if (this->at(i,j).type() != cv::DataType<T>::type)
         return;
     
-    cv::Mat tmp (this->at(i,j).rows, this->at(i,j).cols, cv::DataType<T>::type);
-    tmp.setTo(value);
-    
-    //this->at(i,j).release();
-    tmp.copyTo(this->at(i,j), mask);
+    this->at(i,j).setTo(cv::Scalar(value), mask);
 }
 
 template<typename T>
@@ -638,6 +642,7 @@ void GridMat::convertToSparse(GridMat indices, GridMat& sparseGridMat)
             sparseGridMat.at(i,j).create(indices.at(i,j).rows, this->at(i,j).cols, this->at(i,j).type());
         else
             sparseGridMat.at(i,j).create(this->at(i,j).rows, indices.at(i,j).cols, this->at(i,j).type());
+        sparseGridMat.at(i,j).setTo(0); // the non-indexed rows (or cols)
         
         for (int k = 0; k < indices.at(i,j).rows; k++)
         {
@@ -648,22 +653,6 @@ void GridMat::convertToSparse(GridMat indices, GridMat& sparseGridMat)
                 else
                     this->at(i,j).col(counts.at<int>(i,j)++).copyTo(sparseGridMat.at(i,j).col(k));
             }
-            else
-            {
-                cv::Mat mat;
-                if (indices.at(i,j).rows > 1)
-                {
-                    mat.create(1, this->at(i,j).cols, this->at(i,j).type());
-                    mat.setTo(0);
-                    mat.copyTo(sparseGridMat.at(i,j).row(k));
-                }
-                else
-                {
-                    mat.create(this->at(i,j).rows, 1, this->at(i,j).type());
-                    mat.setTo(0);
-                    mat.copyTo(sparseGridMat.at(i,j).col(k));
-                }
-            }
         }
     }
 }
@@ -1415,12 +1404,7 @@ cv::Mat GridMat::findNonZero()
     
     for (unsigned int i = 0; i < m_crows; i++) for (unsigned int j = 0; j < m_ccols; j++)
     {
-        bool nonZeroFound = false;
-        for (unsigned int row = 0; row < this->at(i,j).rows && !nonZeroFound; row++)
-            for (unsigned int col = 0; col < this->at(i,j).cols && !nonZeroFound; col++)
-                nonZeroFound = this->at(i,j).at<T>(row,col) > 0;
-        
-        nonZeroFound ? nonZerosMat.at<unsigned char>(i,j) = 1 : nonZerosMat.at<unsigned char>(i,j) = 0;
+        nonZerosMat.at<unsigned char>(i,j) = hasPositive<T>(this->at(i,j)) ? 1 : 0;
     }
     
     return nonZerosMat;
@@ -1587,11 +1571,6 @@ template void GridMat::create<int>(unsigned int crows, unsigned int ccols, unsig
 template void GridMat::create<float>(unsigned int crows, unsigned int ccols, unsigned int helems, unsigned int welems);
 template void GridMat::create<double>(unsigned int crows, unsigned int ccols, unsigned int helems, unsigned int welems);
 
-template unsigned char& GridMat::at<unsigned char>(unsigned int i, unsigned int j, unsigned int row, unsigned int col);
-template int& GridMat::at<int>(unsigned int i, unsigned int j, unsigned int row, unsigned int col);
-template float& GridMat::at<float>(unsigned int i, unsigned int j, unsigned int row, unsigned int col);
-template double& GridMat::at<double>(unsigned int i, unsigned int j, unsigned int row, unsigned int col);
-
 template void GridMat::setTo<int>(int value);
 template void GridMat::setTo<float>(float value);
 template void GridMat::setTo<double>(double value);
@@ -201,4 +201,17 @@ private:
 //    void setIndexedCellElementsPositionally(GridMat& grid, cv::Mat indices, int dim = 0);
 };
 
+// The accessors are inlined, they are called element by element in the callers' loops
+
+inline cv::Mat& GridMat::at(unsigned int i, unsigned int j)
+{
+    return m_grid[i * m_ccols + j];
+}
+
+template<typename T>
+inline T& GridMat::at(unsigned int i, unsigned int j, unsigned int row, unsigned int col)
+{
+    return m_grid[i * m_ccols + j].template ptr<T>(row)[col];
+}
+
 #endif /* defined(__Segmenthreetion__GridMat__) */
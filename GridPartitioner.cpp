@@ -55,6 +55,26 @@ void GridPartitioner::grid(ModalityData& md, ModalityGridData& mgd)
     mgd.setTags(tags);
 }
 
+void GridPartitioner::grid(cv::Mat frame, cv::Mat mask, vector<cv::Rect> rects, unsigned char masksOffset,
+                           vector<GridMat>& gframes, vector<GridMat>& gmasks, vector<int>& indices)
+{
+    for (unsigned int r = 0; r < rects.size(); r++)
+    {
+        if (rects[r].height >= m_hp && rects[r].width >= m_wp)
+        {
+            cv::Mat subject (frame, rects[r]); // Get a roi in frame defined by the rectangle.
+            gframes.push_back( GridMat(subject, m_hp, m_wp) );
+            
+            cv::Mat maskroi (mask, rects[r]);
+            cv::Mat indexedmaskroi;
+            maskroi.copyTo(indexedmaskroi, maskroi == (masksOffset + r));
+            gmasks.push_back( GridMat(indexedmaskroi, m_hp, m_wp) );
+            
+            indices.push_back(r);
+        }
+    }
+}
+
 /*
  * Trim subimages, defined by rects (bounding boxes), from image frames
  */
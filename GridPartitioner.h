@@ -25,6 +25,11 @@ public:
     void setGridPartitions(unsigned int hp, unsigned int wp);
 
     void grid(ModalityData& md, ModalityGridData& mgd);
+    // Grid the people in a single frame: the r-th rect's region, and the pixels labelled
+    // masksOffset + r in its mask. Rects too small to be gridded are skipped, and the indices
+    // of the gridded ones are returned.
+    void grid(cv::Mat frame, cv::Mat mask, vector<cv::Rect> rects, unsigned char masksOffset,
+              vector<GridMat>& gframes, vector<GridMat>& gmasks, vector<int>& indices);
     
 private:
     
@@ -9,6 +9,12 @@
 #include "GridPredictor.h"
 #include "StatTools.h"
 #include "CvExtraTools.h"
+#include "Trace.h"
+
+#include <fstream>
+#include <cstring>
+#include <climits>
+#include <cfloat>
 
 
 template GridPredictorBase<cv::EM40>::~GridPredictorBase();
@@ -66,8 +72,10 @@ GridPredictorBase<PredictorT>::~GridPredictorBase()
 
 
 GridPredictor<cv::EM40>::GridPredictor(int hp, int wp)
-: GridPredictorBase<cv::EM40>(hp, wp)
+: GridPredictorBase<cv::EM40>(hp, wp), m_refitRatio(1.f), m_numOfFitSamples(0), m_numOfUpdateSamples(0)
 {
+    m_llMeans.resize(m_hp * m_wp);
+    m_llStddevs.resize(m_hp * m_wp);
 }
 
 //void GridPredictor<cv::EM40>::setParameters(GridMat parameters)
@@ -121,8 +129,16 @@ void GridPredictor<cv::EM40>::setLoglikelihoodThreshold(cv::Mat loglikes)
     m_logthreshold = loglikes;
 }
 
+void GridPredictor<cv::EM40>::setRefitRatio(float ratio)
+{
+    m_refitRatio = ratio;
+}
+
 void GridPredictor<cv::EM40>::train(GridMat data)
 {
+    TRACE_SCOPE("GridPredictor<EM40>::train");
+    TRACE_ITEMS(data.at(0,0).rows);
+    
     m_data = data;
     
     m_projData.create(m_hp, m_wp);
@@ -142,7 +158,64 @@ void GridPredictor<cv::EM40>::train(GridMat data)
         }
         
         at(i,j)->train(cellData);
+        at(i,j)->releaseStatistics(); // computed on the first update
+        
+        computeReferenceStatistics(i, j, cellData);
     }
+    
+    m_numOfFitSamples = m_data.at(0,0).rows;
+    m_numOfUpdateSamples = 0;
+}
+
+void GridPredictor<cv::EM40>::update(GridMat data)
+{
+    TRACE_SCOPE("GridPredictor<EM40>::update");
+    TRACE_ITEMS(data.at(0,0).rows);
+    
+    int n = data.at(0,0).rows;
+    if (n == 0) return;
+    
+    // Nothing to update or refit, train on the new data
+    if (m_numOfFitSamples == 0)
+    {
+        train(data);
+        return;
+    }
+    
+    // Periodic full refit, incremental EM only approximates it (not for a loaded predictor, without the data to refit on)
+    if (m_refitRatio > 0 && !m_data.isEmpty() && (m_numOfUpdateSamples + n) > m_refitRatio * m_numOfFitSamples)
+    {
+        GridMat allData;
+        allData.create(m_hp, m_wp);
+        for (int i = 0; i < m_hp; i++) for (int j = 0; j < m_wp; j++)
+            cv::vconcat(m_data.at(i,j), data.at(i,j), allData.at(i,j));
+        
+        train(allData);
+        return;
+    }
+    
+    for (int i = 0; i < m_hp; i++) for (int j = 0; j < m_wp; j++)
+    {
+        cv::Mat newCellData = data.at(i,j);
+        if (m_bDimReduction)
+            newCellData = getPCA(i,j)->project(data.at(i,j)); // the projection of the last fit
+        
+        // the statistics of the fit data are computed once, on the first update
+        if (!at(i,j)->hasStatistics())
+            at(i,j)->initStatistics(m_bDimReduction ? m_projData.at(i,j) : m_data.at(i,j));
+        
+        at(i,j)->update(newCellData);
+        
+        // keep all the data for the periodic refits
+        if (!m_data.isEmpty())
+        {
+            m_data.at(i,j).push_back(data.at(i,j));
+            if (m_bDimReduction)
+                m_projData.at(i,j).push_back(newCellData);
+        }
+    }
+    
+    m_numOfUpdateSamples += n;
 }
 
 /*
@@ -150,6 +223,9 @@ void GridPredictor<cv::EM40>::train(GridMat data)
  */
 void GridPredictor<cv::EM40>::predict(GridMat data, GridMat& loglikelihoods)
 {
+    TRACE_SCOPE("GridPredictor<EM40>::predict");
+    TRACE_ITEMS(data.at(0,0).rows);
+    
     for (int i = 0; i < m_hp; i++) for (int j = 0; j < m_wp; j++)
     {
         cv::Mat& cell = data.at(i,j);
@@ -182,6 +258,9 @@ void GridPredictor<cv::EM40>::predict(GridMat data, GridMat& loglikelihoods)
  */
 void GridPredictor<cv::EM40>::predict(GridMat data, GridMat& predictions, GridMat& loglikelihoods, GridMat& distsToMargin)
 {
+    TRACE_SCOPE("GridPredictor<EM40>::predict");
+    TRACE_ITEMS(data.at(0,0).rows);
+    
     for (int i = 0; i < m_hp; i++) for (int j = 0; j < m_wp; j++)
     {
         cv::Mat& cell = data.at(i,j);
@@ -236,3 +315,360 @@ void GridPredictor<cv::EM40>::predict(GridMat data, GridMat& predictions, GridMa
         distsToMargin.assign(cellsDistsToMargin, i, j);
     }
 }
+
+
+/*
+ * Returns predictions of the cells, the loglikelihoods standardized with the training statistics
+ */
+void GridPredictor<cv::EM40>::predictOnline(GridMat data, GridMat& predictions, GridMat& loglikelihoods, GridMat& distsToMargin)
+{
+    TRACE_SCOPE("GridPredictor<EM40>::predictOnline");
+    TRACE_ITEMS(data.at(0,0).rows);
+    
+    for (int i = 0; i < m_hp; i++) for (int j = 0; j < m_wp; j++)
+    {
+        cv::Mat& cell = data.at(i,j);
+        cv::Mat_<int> cellPredictions (cell.rows, 1);
+        cv::Mat_<float> stdCellLoglikelihoods (cell.rows, 1);
+        cv::Mat_<float> cellsDistsToMargin (cell.rows, 1);
+        
+        const cv::Mat& llMeans = m_llMeans[i * m_wp + j];
+        const cv::Mat& llStddevs = m_llStddevs[i * m_wp + j];
+        float logthreshold = m_logthreshold.at<float>(i,j);
+        
+        // The standardized training loglikelihoods have zero mean and unit variance, so the
+        // scale of their distances to the threshold (as in predict) is sqrt(1 + threshold^2)
+        float scale = sqrt(1.f + logthreshold * logthreshold);
+        
+        for (int d = 0; d < cell.rows; d++)
+        {
+            cv::Mat descriptor = cell.row(d);
+            
+            if (m_bDimReduction)
+                descriptor = getPCA(i,j)->project(descriptor);
+            
+            cv::Vec3d res = at(i,j)->predict(descriptor);
+            int l = static_cast<int>(res.val[2]);
+            
+            float z = static_cast<float>((res.val[1] - llMeans.at<double>(l)) / llStddevs.at<double>(l));
+            
+            stdCellLoglikelihoods.at<float>(d,0) = z;
+            cellPredictions.at<int>(d,0) = (z > logthreshold) ? 1 : 0;
+            cellsDistsToMargin.at<float>(d,0) = (z - logthreshold) / scale;
+        }
+        
+        predictions.assign(cellPredictions, i, j);
+        loglikelihoods.assign(stdCellLoglikelihoods, i, j);
+        distsToMargin.assign(cellsDistsToMargin, i, j);
+    }
+}
+
+void GridPredictor<cv::EM40>::computeReferenceStatistics(unsigned int i, unsigned int j, cv::Mat cellData)
+{
+    int nclusters = at(i,j)->get<int>("nclusters");
+    
+    cv::Mat sums = cv::Mat::zeros(1, nclusters, CV_64FC1);
+    cv::Mat sqsums = cv::Mat::zeros(1, nclusters, CV_64FC1);
+    cv::Mat counts = cv::Mat::zeros(1, nclusters, CV_64FC1);
+    
+    for (int d = 0; d < cellData.rows; d++)
+    {
+        cv::Vec3d res = at(i,j)->predict(cellData.row(d));
+        int l = static_cast<int>(res.val[2]);
+        
+        sums.at<double>(l) += res.val[1];
+        sqsums.at<double>(l) += res.val[1] * res.val[1];
+        counts.at<double>(l) += 1;
+    }
+    
+    cv::Mat& llMeans = m_llMeans[i * m_wp + j];
+    cv::Mat& llStddevs = m_llStddevs[i * m_wp + j];
+    llMeans.create(1, nclusters, CV_64FC1);
+    llStddevs.create(1, nclusters, CV_64FC1);
+    
+    for (int l = 0; l < nclusters; l++)
+    {
+        double n = counts.at<double>(l);
+        double mean = (n > 0) ? sums.at<double>(l) / n : 0;
+        double var = (n > 0) ? sqsums.at<double>(l) / n - mean * mean : 0;
+        
+        llMeans.at<double>(l) = mean;
+        llStddevs.at<double>(l) = (var > FLT_EPSILON) ? sqrt(var) : 1; // a cluster without spread does not scale
+    }
+}
+
+//
+// Models' file
+//
+// A header (with the number of samples behind the models), followed by one entry per cell
+// (row-major), and the arrays of the cells' models.
+// The arrays are raw, contiguous and in native byte order, and each one starts at an offset
+// multiple of 64 bytes, so that they are used in place once the file is read (or mapped)
+// in memory: loading does not parse nor copy anything. The arrays of a cell, from the
+// offset of its entry, are
+//   weights (1 x nclusters), means (nclusters x dim), logWeightDivDet (1 x nclusters),
+//   llMeans (1 x nclusters), llStddevs (1 x nclusters),
+//   invCovsEigenValues (1 x dim, or 1 x 1 if spherical, per cluster),
+//   covsRotateMats (dim x dim per cluster, only for generic covariances),
+// all of them of doubles, and, only if the dimensionality is reduced,
+//   PCA mean (1 x inputDim), eigenvectors (dim x inputDim), eigenvalues (dim x 1)
+// of pcaType.
+//
+
+namespace
+{
+    const size_t MODELS_ALIGNMENT = 64;
+    
+    struct GridPredictorFileHeader
+    {
+        char magic[4];
+        int version;
+        int hp, wp;
+        int dimReduction;
+        int dataOffset;
+        long long fileSize;
+        long long numOfSamples; // the models have been fit or updated on
+    };
+    
+    struct GridPredictorCellEntry
+    {
+        long long offset;
+        double variance;
+        int nclusters, covMatType, dim, inputDim, pcaType;
+        float nmixtures, epsilon, logthreshold;
+    };
+    
+    struct CellModel
+    {
+        int covMatType;
+        cv::Mat weights, means, logWeightDivDet;
+        cv::Mat llMeans, llStddevs;
+        vector<cv::Mat> invCovsEigenValues, covsRotateMats;
+        cv::Mat pcaMean, pcaEigenvectors, pcaEigenvalues;
+    };
+    
+    size_t alignedSize(size_t size)
+    {
+        return (size + MODELS_ALIGNMENT - 1) & ~(MODELS_ALIGNMENT - 1);
+    }
+    
+    bool writeArray(ofstream& ofs, const cv::Mat& array)
+    {
+        static const char padding[MODELS_ALIGNMENT] = {0};
+        
+        cv::Mat continuousArray = array.isContinuous() ? array : array.clone();
+        size_t size = continuousArray.total() * continuousArray.elemSize();
+        
+        ofs.write((const char*) continuousArray.data, size);
+        ofs.write(padding, alignedSize(size) - size);
+        return ofs.good();
+    }
+    
+    // Wraps the array at offset in the buffer, and moves offset past it
+    bool mapArray(const cv::Mat& buffer, size_t& offset, int rows, int cols, int type, cv::Mat& array)
+    {
+        size_t size = (size_t) rows * cols * CV_ELEM_SIZE(type);
+        if (rows <= 0 || cols <= 0 || offset > buffer.total() || size > buffer.total() - offset)
+            return false;
+        
+        array = cv::Mat(rows, cols, type, buffer.data + offset);
+        offset += alignedSize(size);
+        return true;
+    }
+    
+    bool mapCellModel(const cv::Mat& buffer, long long dataOffset, const GridPredictorCellEntry& entry, bool bDimReduction, CellModel& model)
+    {
+        // covMatType indexes EM40's probabilities kernels, and pcaType sizes the PCA's arrays
+        if (entry.nclusters <= 0 || entry.dim <= 0 || entry.inputDim <= 0
+            || entry.covMatType < cv::EM::COV_MAT_SPHERICAL || entry.covMatType > cv::EM::COV_MAT_GENERIC
+            || (entry.pcaType != CV_32FC1 && entry.pcaType != CV_64FC1)
+            || entry.offset < dataOffset)
+            return false;
+        
+        model.covMatType = entry.covMatType;
+        
+        size_t offset = entry.offset;
+        if (offset % MODELS_ALIGNMENT != 0
+            || !mapArray(buffer, offset, 1, entry.nclusters, CV_64FC1, model.weights)
+            || !mapArray(buffer, offset, entry.nclusters, entry.dim, CV_64FC1, model.means)
+            || !mapArray(buffer, offset, 1, entry.nclusters, CV_64FC1, model.logWeightDivDet)
+            || !mapArray(buffer, offset, 1, entry.nclusters, CV_64FC1, model.llMeans)
+            || !mapArray(buffer, offset, 1, entry.nclusters, CV_64FC1, model.llStddevs))
+            return false;
+        
+        int eigenDim = (entry.covMatType == cv::EM::COV_MAT_SPHERICAL) ? 1 : entry.dim;
+        model.invCovsEigenValues.resize(entry.nclusters);
+        for (int c = 0; c < entry.nclusters; c++)
+            if (!mapArray(buffer, offset, 1, eigenDim, CV_64FC1, model.invCovsEigenValues[c]))
+                return false;
+        
+        model.covsRotateMats.clear();
+        if (entry.covMatType == cv::EM::COV_MAT_GENERIC)
+        {
+            model.covsRotateMats.resize(entry.nclusters);
+            for (int c = 0; c < entry.nclusters; c++)
+                if (!mapArray(buffer, offset, entry.dim, entry.dim, CV_64FC1, model.covsRotateMats[c]))
+                    return false;
+        }
+        
+        if (bDimReduction)
+        {
+            if (!mapArray(buffer, offset, 1, entry.inputDim, entry.pcaType, model.pcaMean)
+                || !mapArray(buffer, offset, entry.dim, entry.inputDim, entry.pcaType, model.pcaEigenvectors)
+                || !mapArray(buffer, offset, entry.dim, 1, entry.pcaType, model.pcaEigenvalues))
+                return false;
+        }
+        
+        return true;
+    }
+}
+
+bool GridPredictor<cv::EM40>::save(std::string file)
+{
+    ofstream ofs(file.c_str(), ios::out | ios::binary | ios::trunc);
+    if (!ofs.is_open())
+        return false;
+    
+    GridPredictorFileHeader header;
+    memcpy(header.magic, "S3GP", 4);
+    header.version = 2;
+    header.hp = m_hp;
+    header.wp = m_wp;
+    header.dimReduction = int(m_bDimReduction);
+    header.dataOffset = alignedSize(sizeof(header) + m_hp * m_wp * sizeof(GridPredictorCellEntry));
+    header.fileSize = 0;
+    header.numOfSamples = m_numOfFitSamples + m_numOfUpdateSamples;
+    
+    vector<GridPredictorCellEntry> entries (m_hp * m_wp);
+    
+    // the entries are rewritten once the offsets of the cells are known
+    ofs.seekp(header.dataOffset);
+    
+    bool bSuccess = true;
+    for (int i = 0; i < m_hp && bSuccess; i++) for (int j = 0; j < m_wp && bSuccess; j++)
+    {
+        CellModel model;
+        model.covMatType = at(i,j)->get<int>("covMatType");
+        at(i,j)->getPredictionParams(model.weights, model.means, model.logWeightDivDet,
+                                     model.invCovsEigenValues, model.covsRotateMats);
+        
+        GridPredictorCellEntry& entry = entries[i * m_wp + j];
+        entry.offset = ofs.tellp();
+        entry.variance = m_bDimReduction ? m_variances.at<double>(i,j) : 0;
+        entry.nclusters = model.means.rows;
+        entry.covMatType = model.covMatType;
+        entry.dim = model.means.cols;
+        entry.inputDim = m_bDimReduction ? getPCA(i,j)->mean.cols : entry.dim;
+        entry.pcaType = m_bDimReduction ? getPCA(i,j)->mean.type() : CV_64FC1;
+        entry.nmixtures = m_nmixtures.empty() ? entry.nclusters : m_nmixtures.at<float>(i,j);
+        entry.epsilon = m_epsilons.empty() ? at(i,j)->get<double>("epsilon") : m_epsilons.at<float>(i,j);
+        entry.logthreshold = m_logthreshold.empty() ? 0 : m_logthreshold.at<float>(i,j);
+        
+        model.llMeans = m_llMeans[i * m_wp + j];
+        model.llStddevs = m_llStddevs[i * m_wp + j];
+        CV_Assert (model.llMeans.cols == entry.nclusters && model.llStddevs.cols == entry.nclusters);
+        
+        bSuccess = writeArray(ofs, model.weights) && writeArray(ofs, model.means) && writeArray(ofs, model.logWeightDivDet)
+                && writeArray(ofs, model.llMeans) && writeArray(ofs, model.llStddevs);
+        for (int c = 0; c < model.invCovsEigenValues.size() && bSuccess; c++)
+            bSuccess = writeArray(ofs, model.invCovsEigenValues[c]);
+        for (int c = 0; c < model.covsRotateMats.size() && bSuccess; c++)
+            bSuccess = writeArray(ofs, model.covsRotateMats[c]);
+        
+        if (m_bDimReduction && bSuccess)
+        {
+            cv::PCA* pca = getPCA(i,j);
+            CV_Assert (pca->eigenvectors.type() == entry.pcaType && pca->eigenvalues.type() == entry.pcaType);
+            bSuccess = writeArray(ofs, pca->mean) && writeArray(ofs, pca->eigenvectors) && writeArray(ofs, pca->eigenvalues);
+        }
+    }
+    
+    if (!bSuccess)
+        return false;
+    
+    header.fileSize = ofs.tellp();
+    
+    ofs.seekp(0);
+    ofs.write((const char*) &header, sizeof(header));
+    ofs.write((const char*) &entries[0], entries.size() * sizeof(GridPredictorCellEntry));
+    
+    return ofs.good();
+}
+
+bool GridPredictor<cv::EM40>::load(std::string file)
+{
+    ifstream ifs(file.c_str(), ios::in | ios::binary | ios::ate);
+    if (!ifs.is_open())
+        return false;
+    
+    long long fileSize = ifs.tellg();
+    if (fileSize < (long long) sizeof(GridPredictorFileHeader))
+        return false;
+    
+    cv::Mat buffer (1, fileSize, CV_8UC1);
+    ifs.seekg(0);
+    ifs.read((char*) buffer.data, fileSize);
+    if (!ifs.good())
+        return false;
+    
+    const GridPredictorFileHeader& header = *((const GridPredictorFileHeader*) buffer.data);
+    if (strncmp(header.magic, "S3GP", 4) != 0 || header.version != 2 || header.fileSize != fileSize
+        || header.hp != m_hp || header.wp != m_wp
+        || header.dataOffset < (long long) (sizeof(header) + m_hp * m_wp * sizeof(GridPredictorCellEntry))
+        || header.dataOffset > fileSize || header.numOfSamples <= 0 || header.numOfSamples > INT_MAX)
+        return false;
+    
+    const GridPredictorCellEntry* entries = (const GridPredictorCellEntry*) (buffer.data + sizeof(header));
+    
+    // Validate all the cells before replacing the current models
+    vector<CellModel> models (m_hp * m_wp);
+    for (int i = 0; i < m_hp * m_wp; i++)
+    {
+        if (!mapCellModel(buffer, header.dataOffset, entries[i], header.dimReduction, models[i]))
+            return false;
+    }
+    
+    m_bDimReduction = header.dimReduction;
+    m_nmixtures.create(m_hp, m_wp, cv::DataType<float>::type);
+    m_epsilons.create(m_hp, m_wp, cv::DataType<float>::type);
+    m_logthreshold.create(m_hp, m_wp, cv::DataType<float>::type);
+    m_variances.create(m_hp, m_wp, cv::DataType<double>::type);
+    
+    for (int i = 0; i < m_hp; i++) for (int j = 0; j < m_wp; j++)
+    {
+        const GridPredictorCellEntry& entry = entries[i * m_wp + j];
+        CellModel& model = models[i * m_wp + j];
+        
+        m_nmixtures.at<float>(i,j) = entry.nmixtures;
+        m_epsilons.at<float>(i,j) = entry.epsilon;
+        m_logthreshold.at<float>(i,j) = entry.logthreshold;
+        m_variances.at<double>(i,j) = entry.variance;
+        
+        at(i,j)->setPredictionParams(model.covMatType, model.weights, model.means, model.logWeightDivDet,
+                                     model.invCovsEigenValues, model.covsRotateMats);
+        at(i,j)->set("epsilon", entry.epsilon);
+        at(i,j)->initStatistics((double) header.numOfSamples); // for the updates to go on incrementally
+        
+        m_llMeans[i * m_wp + j] = model.llMeans;
+        m_llStddevs[i * m_wp + j] = model.llStddevs;
+        
+        cv::PCA* pca = getPCA(i,j);
+        *pca = cv::PCA();
+        if (m_bDimReduction)
+        {
+            pca->mean = model.pcaMean;
+            pca->eigenvectors = model.pcaEigenvectors;
+            pca->eigenvalues = model.pcaEigenvalues;
+        }
+    }
+    
+    m_modelsBuffer = buffer;
+    
+    // the training data is not stored, the models' statistics stand for it
+    m_data = GridMat();
+    m_projData = GridMat();
+    m_numOfFitSamples = header.numOfSamples;
+    m_numOfUpdateSamples = 0;
+    
+    return true;
+}
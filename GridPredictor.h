@@ -66,15 +66,43 @@ public:
     void setNumOfMixtures(cv::Mat nmixtures);
     void setEpsilons(cv::Mat epsilons);
     void setLoglikelihoodThreshold(cv::Mat loglikes);
+    void setRefitRatio(float ratio);
     
     void train(GridMat data);
+    // Absorbs new data into the trained cells' GMMs by incremental EM. Once the data absorbed
+    // exceeds the refit ratio times the data of the last full fit, all the data is refit instead.
+    void update(GridMat data);
     void predict(GridMat data, GridMat& loglikelihoods);
     void predict(GridMat data, GridMat& predictions, GridMat& loglikelihoods, GridMat& distsToMargin);
+    // Same as above, but the loglikelihoods are standardized with the statistics of the training ones
+    // instead of the ones in data, so that every descriptor is predicted independently of the others
+    // (e.g. the few ones of a single frame)
+    void predictOnline(GridMat data, GridMat& predictions, GridMat& loglikelihoods, GridMat& distsToMargin);
+    
+    // Binary storage of the trained cells' models (GMMs, PCAs and thresholds), so as to predict
+    // without training again. See GridPredictor.cpp for the layout of the file. A loaded predictor
+    // does not keep the training data, only the number of samples behind the models: its updates
+    // go on incrementally from the models' parameters, but are never refit on all the data.
+    bool save(std::string file);
+    bool load(std::string file);
     
 private:
+    void computeReferenceStatistics(unsigned int i, unsigned int j, cv::Mat cellData);
+    
     cv::Mat m_nmixtures;
     cv::Mat m_epsilons;
     cv::Mat m_logthreshold;
+    
+    float m_refitRatio; // 0 never refits
+    int m_numOfFitSamples;
+    int m_numOfUpdateSamples;
+    
+    // Mean and stddev of the training loglikelihoods of each cell's clusters (1 x nclusters),
+    // kept from the last full fit
+    vector<cv::Mat> m_llMeans;
+    vector<cv::Mat> m_llStddevs;
+    
+    cv::Mat m_modelsBuffer; // contents of the loaded file, the cells' models point into it
 };
 
 #endif /* defined(__segmenthreetion__GridPredictor__) */
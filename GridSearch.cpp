@@ -0,0 +1,305 @@
+//
+//  GridSearch.cpp
+//  segmenthreetion
+//
+//
+
+#include "GridSearch.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+#include <limits>
+#include <iomanip>
+#include <sstream>
+
+#include <boost/bind.hpp>
+
+//
+// GridSearchLog
+//
+
+GridSearchLog::GridSearchLog()
+{ }
+
+GridSearchLog::~GridSearchLog()
+{
+    close();
+}
+
+void GridSearchLog::open(std::string file, std::string fingerprint)
+{
+    close();
+
+    std::ifstream in (file.c_str());
+    if (in.is_open())
+    {
+        std::string line;
+        if (std::getline(in, line) && line == "# " + fingerprint)
+        {
+            while (std::getline(in, line) && !in.eof()) // an unterminated line was being written when interrupted
+            {
+                size_t sep = line.rfind(" : ");
+                if (sep != std::string::npos)
+                    m_Entries[line.substr(0, sep)] = atof(line.substr(sep + 3).c_str());
+            }
+
+            std::cout << "Resuming grid search from " << file << " (" << m_Entries.size() << " evaluations)" << std::endl;
+        }
+        else
+        {
+            std::cout << "Discarding stale grid search log " << file << std::endl;
+        }
+        in.close();
+    }
+
+    // rewrite the log with the valid entries only
+    m_File.open(file.c_str(), std::ios::out | std::ios::trunc);
+    m_File << "# " << fingerprint << "\n" << std::setprecision(9);
+    for (std::map<std::string, float>::iterator it = m_Entries.begin(); it != m_Entries.end(); ++it)
+        m_File << it->first << " : " << it->second << "\n";
+    m_File.flush();
+}
+
+void GridSearchLog::close()
+{
+    if (m_File.is_open())
+        m_File.close();
+
+    m_Entries.clear();
+}
+
+bool GridSearchLog::isOpen()
+{
+    return m_File.is_open();
+}
+
+bool GridSearchLog::find(std::string stage, int k, int j, cv::Mat params, float& goodness)
+{
+    boost::mutex::scoped_lock lock (m_Mutex);
+
+    std::map<std::string, float>::iterator it = m_Entries.find(key(stage, k, j, params));
+    if (it == m_Entries.end())
+        return false;
+
+    goodness = it->second;
+    return true;
+}
+
+void GridSearchLog::append(std::string stage, int k, int j, cv::Mat params, float goodness)
+{
+    std::string entry = key(stage, k, j, params);
+
+    boost::mutex::scoped_lock lock (m_Mutex);
+
+    m_Entries[entry] = goodness;
+
+    m_File << entry << " : " << goodness << "\n";
+    m_File.flush();
+}
+
+std::string GridSearchLog::key(std::string stage, int k, int j, cv::Mat params)
+{
+    std::stringstream ss;
+    ss << std::setprecision(9) << stage << " " << k << " " << j;
+    for (int p = 0; p < params.cols; p++)
+        ss << " " << params.at<float>(0,p);
+
+    return ss.str();
+}
+
+//
+// GridSearch
+//
+
+namespace
+{
+    bool betterRanked(const std::pair<float,int>& a, const std::pair<float,int>& b)
+    {
+        return a.first > b.first;
+    }
+
+    // Mean of the evaluated (not NaN) goodnesses in a row
+    float evaluatedMean(cv::Mat accuracies, int m)
+    {
+        float sum = 0;
+        int n = 0;
+        for (int j = 0; j < accuracies.cols; j++)
+        {
+            float acc = accuracies.at<float>(m,j);
+            if (acc == acc)
+            {
+                sum += acc;
+                n++;
+            }
+        }
+
+        return (n > 0) ? (sum / n) : std::numeric_limits<float>::quiet_NaN();
+    }
+}
+
+GridSearch::GridSearch()
+: m_Eta(2), m_bResumeOnly(false)
+{ }
+
+void GridSearch::setReductionFactor(int eta)
+{
+    m_Eta = eta;
+}
+
+int GridSearch::getReductionFactor()
+{
+    return m_Eta;
+}
+
+void GridSearch::setLog(std::string file, std::string fingerprint)
+{
+    if (file.empty())
+        m_Log.close();
+    else
+        m_Log.open(file, fingerprint);
+}
+
+void GridSearch::setResumeOnly(bool flag)
+{
+    m_bResumeOnly = flag;
+}
+
+void GridSearch::search(std::string stage, cv::Mat expandedParams, int K, int J,
+                        boost::function<float (int, int, cv::Mat)> evaluate, std::vector<cv::Mat>& goodnesses)
+{
+    int M = expandedParams.rows;
+
+    // goodnesses of each outer fold, NaN where not evaluated
+    std::vector<cv::Mat> accuracies (K);
+    std::vector<std::vector<int> > survivors (K);
+    for (int k = 0; k < K; k++)
+    {
+        accuracies[k].create(M, J, cv::DataType<float>::type);
+        accuracies[k].setTo(std::numeric_limits<float>::quiet_NaN());
+
+        for (int m = 0; m < M; m++)
+            survivors[k].push_back(m);
+    }
+
+    int evaluated = 0; // inner folds the survivors have been evaluated on
+    int budget = (m_Eta < 2) ? J : 1;
+
+    while (true)
+    {
+        std::vector<Evaluation> pending;
+        for (int k = 0; k < K; k++) for (int i = 0; i < survivors[k].size(); i++) for (int j = evaluated; j < budget; j++)
+        {
+            int m = survivors[k][i];
+
+            float goodness;
+            if (m_Log.isOpen() && m_Log.find(stage, k, j, expandedParams.row(m), goodness))
+            {
+                accuracies[k].at<float>(m,j) = goodness;
+            }
+            else
+            {
+                Evaluation e = {k, j, m};
+                pending.push_back(e);
+            }
+        }
+
+        if (!pending.empty())
+        {
+            if (m_bResumeOnly)
+                CV_Error(CV_StsError, "GridSearch: " + stage + " evaluations missing in the log");
+
+            // every job writes its own goodness, no need to lock
+            parallelFor(pending.size(), boost::bind(&GridSearch::_evaluate, this, _1, stage, boost::cref(pending), expandedParams, evaluate, boost::ref(accuracies)));
+        }
+
+        evaluated = budget;
+        if (evaluated >= J) break;
+
+        // Successive halving: keep the best 1/eta of each outer fold
+        for (int k = 0; k < K; k++)
+        {
+            std::vector<std::pair<float,int> > ranking;
+            for (int i = 0; i < survivors[k].size(); i++)
+            {
+                float mean = evaluatedMean(accuracies[k], survivors[k][i]);
+                ranking.push_back(std::pair<float,int>(mean == mean ? mean : -std::numeric_limits<float>::max(), survivors[k][i]));
+            }
+            std::stable_sort(ranking.begin(), ranking.end(), betterRanked);
+
+            int n = std::max(1, (int) std::ceil(ranking.size() / (float) m_Eta));
+
+            survivors[k].clear();
+            for (int i = 0; i < n; i++)
+                survivors[k].push_back(ranking[i].second);
+            std::sort(survivors[k].begin(), survivors[k].end());
+        }
+
+        budget = std::min(J, budget * m_Eta);
+    }
+
+    goodnesses.resize(K);
+    for (int k = 0; k < K; k++)
+    {
+        goodnesses[k].create(M, 1, cv::DataType<float>::type);
+
+        std::vector<bool> survived (M, false);
+        float worstSurvivor = std::numeric_limits<float>::max();
+        for (int i = 0; i < survivors[k].size(); i++)
+        {
+            survived[survivors[k][i]] = true;
+            worstSurvivor = std::min(worstSurvivor, evaluatedMean(accuracies[k], survivors[k][i]));
+        }
+
+        // strictly below every survivor, so that no tie lets a terminated combination be selected
+        float belowSurvivors = nextafterf(worstSurvivor, -std::numeric_limits<float>::infinity());
+
+        for (int m = 0; m < M; m++)
+        {
+            float mean = evaluatedMean(accuracies[k], m);
+            goodnesses[k].at<float>(m,0) = (survived[m] || mean < belowSurvivors) ? mean : belowSurvivors;
+        }
+    }
+}
+
+void GridSearch::_evaluate(int i, std::string stage, const std::vector<Evaluation>& evaluations, cv::Mat expandedParams,
+                           boost::function<float (int, int, cv::Mat)> evaluate, std::vector<cv::Mat>& accuracies)
+{
+    const Evaluation& e = evaluations[i];
+
+    float goodness = evaluate(e.k, e.j, expandedParams.row(e.m));
+    accuracies[e.k].at<float>(e.m, e.j) = goodness;
+
+    if (m_Log.isOpen())
+        m_Log.append(stage, e.k, e.j, expandedParams.row(e.m), goodness);
+}
+
+uint64 GridSearch::hash(cv::Mat mat, uint64 h)
+{
+    h = hash(mat.type(), hash(mat.cols, hash(mat.rows, h)));
+
+    size_t rowSize = mat.cols * mat.elemSize();
+    for (int i = 0; i < mat.rows; i++)
+    {
+        const unsigned char* p = mat.ptr(i);
+        for (size_t b = 0; b < rowSize; b++)
+        {
+            h ^= p[b];
+            h *= 1099511628211ULL;
+        }
+    }
+
+    return h;
+}
+
+uint64 GridSearch::hash(int value, uint64 h)
+{
+    for (int b = 0; b < sizeof(int); b++)
+    {
+        h ^= (value >> (8*b)) & 0xff;
+        h *= 1099511628211ULL;
+    }
+
+    return h;
+}
@@ -0,0 +1,97 @@
+//
+//  GridSearch.h
+//  segmenthreetion
+//
+//
+
+#ifndef __segmenthreetion__GridSearch__
+#define __segmenthreetion__GridSearch__
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+
+#include <opencv2/core/core.hpp>
+
+#include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
+
+/*
+ * Log of the completed evaluations of a grid search, one line per evaluation
+ * (stage, outer fold, inner fold, parameters' combination and goodness). Lines
+ * are appended and flushed as soon as the evaluations finish, so an interrupted
+ * search resumes from where it was left. The first line holds a fingerprint of
+ * the data the evaluations were computed on: a log with a different one is
+ * stale, and it is discarded instead of reused.
+ */
+class GridSearchLog
+{
+public:
+    GridSearchLog();
+    ~GridSearchLog();
+
+    void open(std::string file, std::string fingerprint);
+    void close();
+    bool isOpen();
+
+    bool find(std::string stage, int k, int j, cv::Mat params, float& goodness);
+    void append(std::string stage, int k, int j, cv::Mat params, float goodness); // thread-safe
+
+private:
+    std::string key(std::string stage, int k, int j, cv::Mat params);
+
+    std::ofstream m_File;
+    std::map<std::string, float> m_Entries;
+
+    boost::mutex m_Mutex;
+};
+
+/*
+ * Grid search of the parameters' combinations of a classifier over K outer
+ * folds, each one cross-validated in J inner folds. The evaluations of all the
+ * outer folds run in parallel, one job per (outer fold, inner fold, combination).
+ *
+ * Poor combinations are terminated early by successive halving: all of them
+ * are evaluated on the first inner fold, then the best 1/eta of each outer
+ * fold on eta times more inner folds, and so on until the survivors have been
+ * evaluated on all the J inner folds. The goodness of a combination is its
+ * mean over the evaluated inner folds, and a terminated one ranks strictly
+ * below every survivor. An eta lower than 2 evaluates the whole grid.
+ */
+class GridSearch
+{
+public:
+    GridSearch();
+
+    void setReductionFactor(int eta);
+    int getReductionFactor();
+    void setLog(std::string file, std::string fingerprint); // empty file for no log
+    void setResumeOnly(bool flag); // not evaluate, only read the log
+
+    // evaluate(k, j, params) computes the goodness of params in the inner fold j of the outer fold k.
+    // goodnesses[k] is a column with the goodness of each of the expandedParams' rows.
+    void search(std::string stage, cv::Mat expandedParams, int K, int J,
+                boost::function<float (int, int, cv::Mat)> evaluate, std::vector<cv::Mat>& goodnesses);
+
+    // FNV-1a hashes to fingerprint the data of a search, chainable over several matrices
+    static uint64 hash(cv::Mat mat, uint64 h = 14695981039346656037ULL);
+    static uint64 hash(int value, uint64 h = 14695981039346656037ULL);
+
+private:
+    struct Evaluation
+    {
+        int k, j, m;
+    };
+
+    void _evaluate(int i, std::string stage, const std::vector<Evaluation>& evaluations, cv::Mat expandedParams,
+                   boost::function<float (int, int, cv::Mat)> evaluate, std::vector<cv::Mat>& accuracies);
+
+    int m_Eta;
+    bool m_bResumeOnly;
+
+    GridSearchLog m_Log;
+};
+
+#endif /* defined(__segmenthreetion__GridSearch__) */
@@ -0,0 +1,83 @@
+//
+//  MaskLabelling.cpp
+//  segmenthreetion
+//
+//
+
+#include "MaskLabelling.h"
+
+#include <limits.h>
+
+void computeLabelStatistics(cv::Mat mask, vector<LabelStats>& stats)
+{
+    vector<int> lookup;
+    computeLabelStatistics(mask, stats, lookup);
+}
+
+void computeLabelStatistics(cv::Mat mask, vector<LabelStats>& stats, vector<int>& lookup)
+{
+    CV_Assert (mask.type() == CV_8UC1);
+    
+    int area[256] = {0};
+    int minX[256], minY[256], maxX[256], maxY[256];
+    double sumX[256] = {0}, sumY[256] = {0};
+    
+    for (int l = 0; l < 256; l++)
+    {
+        minX[l] = minY[l] = INT_MAX;
+        maxX[l] = maxY[l] = -1;
+    }
+    
+    for (int i = 0; i < mask.rows; i++)
+    {
+        const unsigned char* row = mask.ptr<unsigned char>(i);
+        for (int j = 0; j < mask.cols; j++)
+        {
+            int l = row[j];
+            if (l == 0) continue;
+            
+            area[l]++;
+            sumX[l] += j;
+            sumY[l] += i;
+            if (j < minX[l]) minX[l] = j;
+            if (j > maxX[l]) maxX[l] = j;
+            if (i < minY[l]) minY[l] = i;
+            if (i > maxY[l]) maxY[l] = i;
+        }
+    }
+    
+    stats.clear();
+    lookup.assign(256, -1);
+    
+    for (int l = 1; l < 256; l++)
+    {
+        if (area[l] == 0) continue;
+        
+        LabelStats s;
+        s.label = l;
+        s.area = area[l];
+        s.boundingRect = cv::Rect(minX[l], minY[l], maxX[l] - minX[l] + 1, maxY[l] - minY[l] + 1);
+        s.centroid = cv::Point2f(sumX[l] / area[l], sumY[l] / area[l]);
+        
+        lookup[l] = stats.size();
+        stats.push_back(s);
+    }
+}
+
+void findLabels(cv::Mat mask, vector<int>& labels)
+{
+    CV_Assert (mask.type() == CV_8UC1);
+    
+    bool present[256] = {false};
+    
+    for (int i = 0; i < mask.rows; i++)
+    {
+        const unsigned char* row = mask.ptr<unsigned char>(i);
+        for (int j = 0; j < mask.cols; j++)
+            present[row[j]] = true;
+    }
+    
+    labels.clear();
+    for (int l = 1; l < 256; l++)
+        if (present[l]) labels.push_back(l);
+}
@@ -0,0 +1,37 @@
+//
+//  MaskLabelling.h
+//  segmenthreetion
+//
+//
+
+#ifndef __segmenthreetion__MaskLabelling__
+#define __segmenthreetion__MaskLabelling__
+
+#include <iostream>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+using namespace std;
+
+// Statistics of the pixels sharing a label value in a labelled mask
+struct LabelStats
+{
+    int label;
+    int area; // number of pixels
+    cv::Rect boundingRect;
+    cv::Point2f centroid;
+};
+
+// Computes, in a single sweep over a labelled CV_8UC1 mask, the statistics of every
+// non-zero label. The stats are returned sorted by label value.
+void computeLabelStatistics(cv::Mat mask, vector<LabelStats>& stats);
+
+// Same as above, but also returns a 256-entry lookup table from label value to
+// the position of its stats in the vector (-1 if the label is not present)
+void computeLabelStatistics(cv::Mat mask, vector<LabelStats>& stats, vector<int>& lookup);
+
+// Finds the non-zero label values present in a CV_8UC1 mask (sorted)
+void findLabels(cv::Mat mask, vector<int>& labels);
+
+#endif /* defined(__segmenthreetion__MaskLabelling__) */
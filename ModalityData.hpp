@@ -57,16 +57,9 @@ public:
         return (m_GroundTruthMasks[k] == (m_MasksOffset + subjectId));
     }
     
-    vector<cv::Mat> *getPredictedMasksInScene(int s)
+    vector<cv::Mat> getPredictedMasksInScene(int s)
     {
-        vector<cv::Mat> *sceneMasks = new vector<cv::Mat>;
-        
-        for(int k = m_SceneLimits[s].first; k <= (m_SceneLimits[s].second); k++ )
-        {
-            sceneMasks->push_back(m_PredictedMasks[k]);
-        }
-        
-        return sceneMasks;
+        return vector<cv::Mat>(m_PredictedMasks.begin() + m_SceneLimits[s].first, m_PredictedMasks.begin() + m_SceneLimits[s].second + 1);
     }
     
     cv::Mat getPredictedMaskInScene(int s, int k)
@@ -80,16 +73,9 @@ public:
     }
     
     
-    vector<cv::Mat> *getFramesInScene(int s)
+    vector<cv::Mat> getFramesInScene(int s)
     {
-        vector<cv::Mat> *sceneFrames = new vector<cv::Mat>;
-        
-        for(int k = m_SceneLimits[s].first; k <= (m_SceneLimits[s].second); k++ )
-        {
-            sceneFrames->push_back(m_Frames[k]);
-        }
-        
-        return sceneFrames;
+        return vector<cv::Mat>(m_Frames.begin() + m_SceneLimits[s].first, m_Frames.begin() + m_SceneLimits[s].second + 1);
     }
     
     cv::Mat getFrameInScene(int s, int k)
@@ -102,16 +88,9 @@ public:
         return m_RegFrames[m_SceneLimits[s].first + k];
     }
     
-    vector<cv::Mat> *getGroundTruthMasksInScene(int s)
+    vector<cv::Mat> getGroundTruthMasksInScene(int s)
     {
-        vector<cv::Mat> *gtMasks = new vector<cv::Mat>;
-        
-        for(int k = m_SceneLimits[s].first; k <= (m_SceneLimits[s].second); k++ )
-        {
-            gtMasks->push_back(m_GroundTruthMasks[k]);
-        }
-        
-        return gtMasks;
+        return vector<cv::Mat>(m_GroundTruthMasks.begin() + m_SceneLimits[s].first, m_GroundTruthMasks.begin() + m_SceneLimits[s].second + 1);
     }
     
     cv::Mat getGroundTruthMaskInScene(int s, int k)
@@ -124,16 +103,9 @@ public:
         return m_PredictedBoundingRects[k];
     }
     
-    vector<vector<cv::Rect> > *getPredictedBoundingRectsInScene(int s)
+    vector<vector<cv::Rect> > getPredictedBoundingRectsInScene(int s)
     {
-        vector<vector<cv::Rect> > *bbScene = new vector<vector<cv::Rect> >;
-        
-        for(int k = m_SceneLimits[s].first; k <= (m_SceneLimits[s].second); k++ )
-        {
-            bbScene->push_back(m_PredictedBoundingRects[k]);
-        }
-        
-        return bbScene;
+        return vector<vector<cv::Rect> >(m_PredictedBoundingRects.begin() + m_SceneLimits[s].first, m_PredictedBoundingRects.begin() + m_SceneLimits[s].second + 1);
     }
     
     vector<cv::Rect> getGroundTruthBoundingRectsInFrame(int k)
@@ -157,16 +129,9 @@ public:
         return m_Tags[k];
     }
     
-    vector<vector<int> > *getTagsInScene(int s)
+    vector<vector<int> > getTagsInScene(int s)
     {
-        vector<vector<int> > *tagsScene = new vector<vector<int> >;
-        
-        for(int k = m_SceneLimits[s].first; k <= (m_SceneLimits[s].second); k++ )
-        {
-            tagsScene->push_back(m_Tags[k]);
-        }
-        
-        return tagsScene;
+        return vector<vector<int> >(m_Tags.begin() + m_SceneLimits[s].first, m_Tags.begin() + m_SceneLimits[s].second + 1);
     }
     
     vector<cv::Mat>& getFrames()
@@ -225,16 +190,9 @@ public:
         return m_FramesIndices;
     }
     
-    vector<string> *getFramesIndicesInScene(int s)
+    vector<string> getFramesIndicesInScene(int s)
     {
-        vector<string> *indices = new vector<string>;
-        
-        for(int k = m_SceneLimits[s].first; k <= (m_SceneLimits[s].second); k++ )
-        {
-            indices->push_back(m_FramesIndices[k]);
-        }
-        
-        return indices;
+        return vector<string>(m_FramesIndices.begin() + m_SceneLimits[s].first, m_FramesIndices.begin() + m_SceneLimits[s].second + 1);
     }
     
     bool isFilled()
@@ -250,7 +208,7 @@ public:
         m_ModalityName = name;
     }
     
-    void setFrames(vector<cv::Mat> frames)
+    void setFrames(const vector<cv::Mat>& frames)
     {
         m_Frames = frames;
         m_FramesResolutions.create(m_Frames.size(), 2, cv::DataType<int>::type);
@@ -261,17 +219,17 @@ public:
         }
     }
     
-    void setRegFrames(vector<cv::Mat> regFrames)
+    void setRegFrames(const vector<cv::Mat>& regFrames)
     {
         m_RegFrames = regFrames;
     }
     
-    void setGroundTruthMasks(vector<cv::Mat> masks)
+    void setGroundTruthMasks(const vector<cv::Mat>& masks)
     {
         m_GroundTruthMasks = masks;
     }
     
-    void setPredictedMasks(vector<cv::Mat> masks)
+    void setPredictedMasks(const vector<cv::Mat>& masks)
     {
         m_PredictedMasks = masks;
     }
@@ -283,17 +241,17 @@ public:
     }
      */
     
-    void setPredictedBoundingRects(vector< vector<cv::Rect> > rects)
+    void setPredictedBoundingRects(const vector< vector<cv::Rect> >& rects)
     {
         m_PredictedBoundingRects = rects;
     }
     
-    void setGroundTruthBoundingRects(vector< vector<cv::Rect> > groundTruthBoundingRects)
+    void setGroundTruthBoundingRects(const vector< vector<cv::Rect> >& groundTruthBoundingRects)
     {
         m_GroundTruthBoundingRects = groundTruthBoundingRects;
     }
     
-    void setTags(vector< vector<int> > tags)
+    void setTags(const vector< vector<int> >& tags)
     {
         m_Tags = tags;
     }
@@ -303,21 +261,39 @@ public:
         m_MasksOffset = masksOffset;
     }
     
-    void setCalibVarsDirs(vector<string> calibVarsDirs)
+    void setCalibVarsDirs(const vector<string>& calibVarsDirs)
     {
         m_CalibVarsDirs = calibVarsDirs;
     }
     
-    void setFramesIndices(vector<string> framesIndices)
+    void setFramesIndices(const vector<string>& framesIndices)
     {
         m_FramesIndices = framesIndices;
     }
     
-    void setSceneLimits(vector< pair<int, int> > sceneLimits)
+    void setSceneLimits(const vector< pair<int, int> >& sceneLimits)
     {
         m_SceneLimits = sceneLimits;
     }
     
+    // Moves other into this one, without copying the vectors
+    void swap(ModalityData& other)
+    {
+        m_ModalityName.swap(other.m_ModalityName);
+        m_Frames.swap(other.m_Frames);
+        m_RegFrames.swap(other.m_RegFrames);
+        m_PredictedMasks.swap(other.m_PredictedMasks);
+        m_GroundTruthMasks.swap(other.m_GroundTruthMasks);
+        m_FramesIndices.swap(other.m_FramesIndices);
+        m_PredictedBoundingRects.swap(other.m_PredictedBoundingRects);
+        m_GroundTruthBoundingRects.swap(other.m_GroundTruthBoundingRects);
+        m_Tags.swap(other.m_Tags);
+        m_CalibVarsDirs.swap(other.m_CalibVarsDirs);
+        std::swap(m_FramesResolutions, other.m_FramesResolutions);
+        m_SceneLimits.swap(other.m_SceneLimits);
+        std::swap(m_MasksOffset, other.m_MasksOffset);
+    }
+    
     
 private:
     string m_ModalityName;
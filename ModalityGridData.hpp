@@ -11,26 +11,38 @@
 
 #include <iostream>
 #include <vector>
+#include <map>
+#include <limits>
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include <boost/shared_ptr.hpp>
+
 #include "GridMat.h"
 
 using namespace std;
 
+/*
+ * The grids of a modality: their frames, masks, metadata, and descriptions.
+ * The metadata columns are shared by the copies and copied on write, so that
+ * passing a ModalityGridData by value costs the copy of a few handles.
+ * The GridMat members (descriptions, validnesses) are shallow copies as usual.
+ */
 class ModalityGridData
 {
 public:
     ModalityGridData()
-    : m_ModalityName(""), m_hp(0), m_wp(0)
+    : m_ModalityName(""), m_hp(0), m_wp(0), m_pColumns(new Columns)
     {
         m_MinVal = std::numeric_limits<double>::max();
         m_MaxVal = std::numeric_limits<double>::min();
     }
     
+    // Subset of the grids of other indicated by logicals (int), gathered column by column
     ModalityGridData(ModalityGridData& other, cv::Mat logicals)
+    : m_pColumns(new Columns)
     {
         m_ModalityName = other.m_ModalityName;
         
@@ -40,51 +52,56 @@ public:
         m_MinVal = other.m_MinVal;
         m_MaxVal = other.m_MaxVal;
         
-        for (int k = 0; k < other.getTags().size(); k++)
+        const Columns& src = *other.m_pColumns;
+        Columns& dst = *m_pColumns;
+        
+        dst.scenesPaths = src.scenesPaths;
+        dst.paths = src.paths;
+        dst.pathsIndex = src.pathsIndex;
+        dst.filenames = src.filenames;
+        dst.filenamesIndex = src.filenamesIndex;
+        dst.resolutions = src.resolutions;
+        
+        vector<int> indices;
+        for (int k = 0; k < src.tags.size(); k++)
         {
             unsigned char logical = (logicals.rows > 1) ? logicals.at<int>(k,0) : logicals.at<int>(0,k);
-            if (logical)
-            {
-                if (!other.isMock())
-                {
-                    addGridFrame(other.getGridFrame(k));
-                    addGridMask(other.getGridMask(k));
-                }
-                addGridMaskOffset(other.getGridMaskOffset(k));
-                addGridFrameID(other.getGridFrameID(k));
-                addFramePath(other.getFramePath(k));
-                addFrameFilename(other.getFrameFilename(k));
-                addMaskFilename(other.getMaskFilename(k));
-                addFrameResolution(other.getFrameResolution(k));
-                addGridBoundingRect(other.getGridBoundingRect(k));
-                addTag(other.getTag(k));
-                addValidnesses(other.getValidnesses(k));
-                for (int i = 0; i < m_hp; i++) for (int j = 0; j < m_wp; j++)
-                {
-                    addDescriptor(other.getDescriptor(i, j, k), i, j);
-                    addDescriptorMirrored(other.getDescriptorMirrored(i, j, k), i, j);
-                }
-                addElementPartition(other.getElementPartition(k));
-            }
+            if (logical) indices.push_back(k);
+        }
+        
+        if (!other.isMock())
+        {
+            gather(src.gframes, indices, dst.gframes);
+            gather(src.gmasks, indices, dst.gmasks);
         }
+        gather(src.masksOffsets, indices, dst.masksOffsets);
+        gather(src.frameIDs, indices, dst.frameIDs);
+        gather(src.sceneIDs, indices, dst.sceneIDs);
+        gather(src.framePathIDs, indices, dst.framePathIDs);
+        gather(src.frameFilenameIDs, indices, dst.frameFilenameIDs);
+        gather(src.maskFilenameIDs, indices, dst.maskFilenameIDs);
+        gather(src.frameResolutionIDs, indices, dst.frameResolutionIDs);
+        gather(src.gboundingRects, indices, dst.gboundingRects);
+        gather(src.tags, indices, dst.tags);
+        gather(src.partitions, indices, dst.partitions);
+        
+        gather(other.m_Validnesses, indices, m_Validnesses);
+        gather(other.m_ValidnessesMirrored, indices, m_ValidnessesMirrored);
+        gather(other.m_Descriptors, indices, m_Descriptors);
+        gather(other.m_DescriptorsMirrored, indices, m_DescriptorsMirrored);
     }
-
+    
 	void clear()
 	{
-		m_GFrames.clear();
-		m_GMasks.clear();
-        m_MasksOffsets.clear();
-		m_FrameIDs.clear();
-        m_FramesPaths.clear();
-        m_FramesFilenames.clear();
-		m_FramesResolutions.clear();
-		m_GBoundingRects.clear();
-		m_Tags.clear();
+        // the scenes are kept, so that the ones added next are numbered after them
+        boost::shared_ptr<Columns> pColumns (new Columns);
+        pColumns->scenesPaths = m_pColumns->scenesPaths;
+        m_pColumns = pColumns;
+        
         m_Descriptors.release();
         m_DescriptorsMirrored.release();
         m_Validnesses.release();
         m_ValidnessesMirrored.release();
-        m_Partitions.clear();
 	}
     
     ModalityGridData(const ModalityGridData& other)
@@ -99,77 +116,83 @@ public:
             m_hp = other.m_hp;
             m_wp = other.m_wp;
             m_ModalityName = other.m_ModalityName;
-            m_GFrames = other.m_GFrames;
-            m_GMasks = other.m_GMasks;
-            m_MasksOffsets = other.m_MasksOffsets;
-            m_FrameIDs = other.m_FrameIDs;
-            m_FramesPaths = other.m_FramesPaths;
-            m_FramesFilenames = other.m_FramesFilenames;
-            m_FramesResolutions = other.m_FramesResolutions;
-            m_GBoundingRects = other.m_GBoundingRects;
-            m_Tags = other.m_Tags;
+            m_pColumns = other.m_pColumns;
             m_Descriptors = other.m_Descriptors;
             m_DescriptorsMirrored = other.m_DescriptorsMirrored;
             m_Validnesses = other.m_Validnesses;
             m_ValidnessesMirrored = other.m_ValidnessesMirrored;
             m_MinVal = other.m_MinVal;
             m_MaxVal = other.m_MaxVal;
-            m_Partitions = other.m_Partitions;
         }
         
         return *this;
     }
     
+    // Exchanges the contents with other without copying the columns
+    void swap(ModalityGridData& other)
+    {
+        std::swap(m_hp, other.m_hp);
+        std::swap(m_wp, other.m_wp);
+        m_ModalityName.swap(other.m_ModalityName);
+        m_pColumns.swap(other.m_pColumns);
+        std::swap(m_Descriptors, other.m_Descriptors);
+        std::swap(m_DescriptorsMirrored, other.m_DescriptorsMirrored);
+        std::swap(m_Validnesses, other.m_Validnesses);
+        std::swap(m_ValidnessesMirrored, other.m_ValidnessesMirrored);
+        std::swap(m_MinVal, other.m_MinVal);
+        std::swap(m_MaxVal, other.m_MaxVal);
+    }
+    
     // Getters
     
     GridMat getGridFrame(int k)
     {
-        return m_GFrames[k];
+        return m_pColumns->gframes[k];
     }
     
     GridMat getGridMask(int k)
     {
-        return m_GMasks[k];
+        return m_pColumns->gmasks[k];
     }
     
     unsigned char getGridMaskOffset(int k)
     {
-        return m_MasksOffsets[k];
+        return m_pColumns->masksOffsets[k];
     }
     
     int getGridFrameID(int k)
     {
-        return m_FrameIDs[k];
+        return m_pColumns->frameIDs[k];
     }
     
     string getFramePath(int k)
     {
-        return m_FramesPaths[k];
+        return m_pColumns->paths[m_pColumns->framePathIDs[k]];
     }
     
     string getFrameFilename(int k)
     {
-        return m_FramesFilenames[k];
+        return m_pColumns->filenames[m_pColumns->frameFilenameIDs[k]];
     }
     
     string getMaskFilename(int k)
     {
-        return m_MasksFilenames[k];
+        return m_pColumns->filenames[m_pColumns->maskFilenameIDs[k]];
     }
     
     cv::Point2d getFrameResolution(int k)
     {
-        return m_FramesResolutions[k];
+        return m_pColumns->resolutions[m_pColumns->frameResolutionIDs[k]];
     }
     
     cv::Rect getGridBoundingRect(int k)
     {
-        return m_GBoundingRects[k];
+        return m_pColumns->gboundingRects[k];
     }
     
     int getTag(int k)
     {
-        return m_Tags[k];
+        return m_pColumns->tags[k];
     }
     
     cv::Mat getValidnesses(int k)
@@ -229,65 +252,75 @@ public:
 //    {
 //        return GridMat(m_Descriptors, m_Validnesses);
 //    }
-
+    
     int getElementPartition(int k)
     {
-        return m_Partitions[k];
+        return m_pColumns->partitions[k];
     }
     
     int getNumOfScenes()
     {
-        return m_ScenesPaths.size();
+        return m_pColumns->scenesPaths.size();
     }
     
-    vector<GridMat>& getGridsFrames()
+    // The columns are shared with the copies, so they are read-only. Use the setters to modify them
+    
+    const vector<GridMat>& getGridsFrames()
     {
-        return m_GFrames;
+        return m_pColumns->gframes;
     }
     
-    vector<GridMat>& getGridsMasks()
+    const vector<GridMat>& getGridsMasks()
     {
-        return m_GMasks;
+        return m_pColumns->gmasks;
     }
     
-    vector<int>& getSceneIDs()
+    const vector<int>& getSceneIDs()
     {
-        return m_SceneIDs;
+        return m_pColumns->sceneIDs;
     }
     
-    vector<int>& getFrameIDs()
+    const vector<int>& getFrameIDs()
     {
-        return m_FrameIDs;
+        return m_pColumns->frameIDs;
     }
     
-    vector<string>& getFramesPaths()
+    vector<string> getFramesPaths()
     {
-        return m_FramesPaths;
+        vector<string> paths;
+        gather(m_pColumns->paths, m_pColumns->framePathIDs, paths);
+        return paths;
     }
     
-    vector<string>& getFramesFilenames()
+    vector<string> getFramesFilenames()
     {
-        return m_FramesFilenames;
+        vector<string> filenames;
+        gather(m_pColumns->filenames, m_pColumns->frameFilenameIDs, filenames);
+        return filenames;
     }
     
-    vector<string>& getMasksFilenames()
+    vector<string> getMasksFilenames()
     {
-        return m_MasksFilenames;
+        vector<string> filenames;
+        gather(m_pColumns->filenames, m_pColumns->maskFilenameIDs, filenames);
+        return filenames;
     }
-
-    vector<cv::Point2d>& getFramesResolutions()
+    
+    vector<cv::Point2d> getFramesResolutions()
     {
-        return m_FramesResolutions;
+        vector<cv::Point2d> resolutions;
+        gather(m_pColumns->resolutions, m_pColumns->frameResolutionIDs, resolutions);
+        return resolutions;
     }
     
-    vector<cv::Rect>& getGridsBoundingRects()
+    const vector<cv::Rect>& getGridsBoundingRects()
     {
-        return m_GBoundingRects;
+        return m_pColumns->gboundingRects;
     }
     
-    vector<int>& getTags()
+    const vector<int>& getTags()
     {
-        return m_Tags;
+        return m_pColumns->tags;
     }
     
     GridMat& getValidnesses()
@@ -319,20 +352,22 @@ public:
     {
         return m_DescriptorsMirrored;
     }
-
+    
+    // The *Mat getters wrap the columns without copying them, not to be written
+    
     cv::Mat getSceneIDsMat()
     {
-		return cv::Mat(m_SceneIDs.size(), 1, cv::DataType<int>::type, m_SceneIDs.data());
+		return wrap(m_pColumns->sceneIDs);
     }
     
 	cv::Mat getFrameIDsMat()
     {
-		return cv::Mat(m_FrameIDs.size(), 1, cv::DataType<int>::type, m_FrameIDs.data());
+		return wrap(m_pColumns->frameIDs);
     }
     
 	cv::Mat getTagsMat()
     {
-		return cv::Mat(m_Tags.size(), 1, cv::DataType<int>::type, m_Tags.data());
+		return wrap(m_pColumns->tags);
     }
     
     GridMat getValidTags()
@@ -344,7 +379,7 @@ public:
             for (int k = 0; k < getValidnesses(i,j).rows; k++)
             {
                 if (m_Validnesses.at<unsigned char>(i,j,k,0))
-                    gValidTags.at(i,j).push_back(m_Tags[k]);
+                    gValidTags.at(i,j).push_back(m_pColumns->tags[k]);
             }
         }
         
@@ -353,7 +388,7 @@ public:
     
     cv::Mat getPartitions()
     {
-		return cv::Mat(m_Partitions.size(), 1, cv::DataType<int>::type, m_Partitions.data());
+		return wrap(m_pColumns->partitions);
     }
     
     
@@ -369,7 +404,7 @@ public:
     
     bool isMock()
     {
-        return m_GFrames.size() == 0 && m_GMasks.size() == 0 && m_Tags.size() > 0;
+        return m_pColumns->gframes.size() == 0 && m_pColumns->gmasks.size() == 0 && m_pColumns->tags.size() > 0;
     }
     
     bool isDescribed()
@@ -419,54 +454,65 @@ public:
         return m_ModalityName;
     }
     
-    void setGridsFrames(vector<GridMat> gframes)
+    void setGridsFrames(const vector<GridMat>& gframes)
     {
-        m_GFrames = gframes;
+        columns().gframes = gframes;
     }
     
-    void setGridsMasks(vector<GridMat> gmasks)
+    void setGridsMasks(const vector<GridMat>& gmasks)
     {
-        m_GMasks = gmasks;
+        columns().gmasks = gmasks;
     }
     
-    void setGridMasksOffsets(vector<unsigned char> gmasksoffsets)
+    void setGridMasksOffsets(const vector<unsigned char>& gmasksoffsets)
     {
-        m_MasksOffsets = gmasksoffsets;
+        columns().masksOffsets = gmasksoffsets;
     }
     
-    void setGridsFrameIDs(vector<int> gframeids)
+    void setGridsFrameIDs(const vector<int>& gframeids)
     {
-        m_FrameIDs = gframeids;
+        columns().frameIDs = gframeids;
     }
     
-    void setFramesPaths(vector<string> paths)
+    void setFramesPaths(const vector<string>& paths)
     {
-        m_FramesPaths = paths;
+        Columns& c = columns();
+        c.framePathIDs.clear();
+        for (int k = 0; k < paths.size(); k++)
+            c.framePathIDs.push_back(intern(paths[k], c.paths, c.pathsIndex));
     }
     
-    void setFramesFilenames(vector<string> filenames)
+    void setFramesFilenames(const vector<string>& filenames)
     {
-        m_FramesFilenames = filenames;
+        Columns& c = columns();
+        c.frameFilenameIDs.clear();
+        for (int k = 0; k < filenames.size(); k++)
+            c.frameFilenameIDs.push_back(intern(filenames[k], c.filenames, c.filenamesIndex));
     }
     
-    void setMasksFilenames(vector<string> filenames)
+    void setMasksFilenames(const vector<string>& filenames)
     {
-        m_MasksFilenames = filenames;
+        Columns& c = columns();
+        c.maskFilenameIDs.clear();
+        for (int k = 0; k < filenames.size(); k++)
+            c.maskFilenameIDs.push_back(intern(filenames[k], c.filenames, c.filenamesIndex));
     }
     
-    void setFramesResolutions(vector<cv::Point2d> resolutions)
+    void setFramesResolutions(const vector<cv::Point2d>& resolutions)
     {
-        m_FramesResolutions = resolutions;
+        columns().frameResolutionIDs.clear();
+        for (int k = 0; k < resolutions.size(); k++)
+            addFrameResolution(resolutions[k]);
     }
     
-    void setGridsBoundingRects(vector<cv::Rect> gboundingrects)
+    void setGridsBoundingRects(const vector<cv::Rect>& gboundingrects)
     {
-        m_GBoundingRects = gboundingrects;
+        columns().gboundingRects = gboundingrects;
     }
     
-    void setTags(vector<int> tags)
+    void setTags(const vector<int>& tags)
     {
-        m_Tags = tags;
+        columns().tags = tags;
     }
     
     void setValidnesses(GridMat validnesses)
@@ -511,70 +557,85 @@ public:
 //    {
 //        gvalidnesses.at<unsigned char>(i,j,k,0) = validness ? 255 : 0;
 //    }
-
+    
     void addGridFrame(GridMat gframe)
     {
-        m_GFrames.push_back(gframe);
+        columns().gframes.push_back(gframe);
     }
     
     void addGridMask(GridMat gmask)
     {
-		m_GMasks.push_back(gmask);
+		columns().gmasks.push_back(gmask);
     }
     
     void addGridMaskOffset(unsigned char offset)
     {
-        m_MasksOffsets.push_back(offset);
+        columns().masksOffsets.push_back(offset);
     }
     
     void addSceneID(int id)
     {
-        m_SceneIDs.push_back(id);
+        columns().sceneIDs.push_back(id);
     }
     
     void addScenePath(string scenePath)
     {
-        m_ScenesPaths.push_back(scenePath);
+        columns().scenesPaths.push_back(scenePath);
     }
     
     void addGridFrameID(int id)
     {
-        m_FrameIDs.push_back(id);
+        columns().frameIDs.push_back(id);
     }
     
     void addFramePath(string path)
     {
-        m_FramesPaths.push_back(path);
+        Columns& c = columns();
+        c.framePathIDs.push_back(intern(path, c.paths, c.pathsIndex));
     }
     
     void addFrameFilename(string filename)
     {
-        m_FramesFilenames.push_back(filename);
+        Columns& c = columns();
+        c.frameFilenameIDs.push_back(intern(filename, c.filenames, c.filenamesIndex));
     }
     
     void addMaskFilename(string filename)
     {
-        m_MasksFilenames.push_back(filename);
+        Columns& c = columns();
+        c.maskFilenameIDs.push_back(intern(filename, c.filenames, c.filenamesIndex));
     }
     
     void addFrameResolution(int x, int y)
     {
-        m_FramesResolutions.push_back(cv::Point2d(x,y));
+        addFrameResolution(cv::Point2d(x,y));
     }
     
     void addFrameResolution(cv::Point2d res)
     {
-        m_FramesResolutions.push_back(res);
+        Columns& c = columns();
+        
+        int id = c.resolutions.size() - 1; // a few of them, mostly the last one again
+        while (id >= 0 && c.resolutions[id] != res)
+            id--;
+        
+        if (id < 0)
+        {
+            id = c.resolutions.size();
+            c.resolutions.push_back(res);
+        }
+        
+        c.frameResolutionIDs.push_back(id);
     }
     
     void addGridBoundingRect(cv::Rect gboundingrect)
     {
-        m_GBoundingRects.push_back(gboundingrect);
+        columns().gboundingRects.push_back(gboundingrect);
     }
     
     void addTag(int tag)
     {
-        m_Tags.push_back(tag);
+        columns().tags.push_back(tag);
     }
     
     void addValidnesses(cv::Mat validnesses)
@@ -588,7 +649,7 @@ public:
     
     void addElementPartition(int fold)
     {
-        m_Partitions.push_back(fold);
+        columns().partitions.push_back(fold);
     }
     
     void addDescriptors(GridMat descriptors)
@@ -669,22 +730,89 @@ public:
 
 
 private:
+    struct Columns
+    {
+        // An element per grid
+        vector<GridMat> gframes;
+        vector<GridMat> gmasks;
+        vector<unsigned char> masksOffsets;
+        vector<int> frameIDs;
+        vector<int> sceneIDs;
+        vector<int> framePathIDs; // in paths
+        vector<int> frameFilenameIDs, maskFilenameIDs; // in filenames
+        vector<int> frameResolutionIDs; // in resolutions
+        vector<cv::Rect> gboundingRects;
+        vector<int> tags;
+        vector<int> partitions;
+        
+        // Interned metadata, shared by the grids
+        vector<string> scenesPaths;
+        vector<string> paths;
+        map<string,int> pathsIndex;
+        vector<string> filenames;
+        map<string,int> filenamesIndex;
+        vector<cv::Point2d> resolutions;
+    };
+    
+    // The columns to be modified, copied first if shared with other ModalityGridData
+    Columns& columns()
+    {
+        if (!m_pColumns.unique())
+            m_pColumns.reset(new Columns(*m_pColumns));
+        
+        return *m_pColumns;
+    }
+    
+    static cv::Mat wrap(const vector<int>& column)
+    {
+        return cv::Mat(column.size(), 1, cv::DataType<int>::type, const_cast<int*>(column.data()));
+    }
+    
+    // Index of s in the table, added if not there yet
+    static int intern(string s, vector<string>& table, map<string,int>& index)
+    {
+        if (!table.empty() && table.back() == s) // the grids of a frame come in a row
+            return table.size() - 1;
+        
+        map<string,int>::iterator it = index.find(s);
+        if (it != index.end())
+            return it->second;
+        
+        index[s] = table.size();
+        table.push_back(s);
+        
+        return table.size() - 1;
+    }
+    
+    template<typename T>
+    static void gather(const vector<T>& src, const vector<int>& indices, vector<T>& dst)
+    {
+        dst.resize(indices.size());
+        for (int r = 0; r < indices.size(); r++)
+            dst[r] = src[indices[r]];
+    }
+    
+    static void gather(GridMat src, const vector<int>& indices, GridMat& dst)
+    {
+        dst = GridMat(src.crows(), src.ccols());
+        
+        for (int i = 0; i < src.crows(); i++) for (int j = 0; j < src.ccols(); j++)
+        {
+            cv::Mat cell = src.at(i,j);
+            if (cell.empty()) continue;
+            
+            cv::Mat gathered (indices.size(), cell.cols, cell.type());
+            for (int r = 0; r < indices.size(); r++)
+                cell.row(indices[r]).copyTo(gathered.row(r));
+            
+            dst.assign(gathered, i, j);
+        }
+    }
+    
     int m_hp, m_wp;
     string m_ModalityName;
     
-    vector<GridMat> m_GFrames;
-    vector<GridMat> m_GMasks;
-    vector<unsigned char> m_MasksOffsets;
-    vector<int> m_FrameIDs;
-    vector<int> m_SceneIDs;
-    vector<string> m_ScenesPaths;
-    vector<string> m_FramesPaths;
-    vector<string> m_FramesFilenames;
-    vector<string> m_MasksFilenames;
-    vector<cv::Point2d> m_FramesResolutions;
-    vector<cv::Rect> m_GBoundingRects;
-    vector<int> m_Tags;
-    vector<int> m_Partitions;
+    boost::shared_ptr<Columns> m_pColumns;
     
     GridMat m_Validnesses, m_ValidnessesMirrored; // whether cells in the grids are valid to be described
     GridMat m_Descriptors, m_DescriptorsMirrored;
@@ -694,3 +822,4 @@ private:
 
 
 #endif /* defined(__segmenthreetion__ModalityGridData__) */
+    
\ No newline at end of file
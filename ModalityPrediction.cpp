@@ -11,6 +11,7 @@
 #include "StatTools.h"
 #include "CvExtraTools.h"
 #include "em.h" // hack
+#include "Trace.h"
 
 #include <boost/timer.hpp>
 #include <boost/bind.hpp>
@@ -28,11 +29,11 @@ ModalityPredictionBase<PredictorT>::ModalityPredictionBase()
 }
 
 template<typename PredictorT>
-void ModalityPredictionBase<PredictorT>::setData(ModalityGridData &data)
+void ModalityPredictionBase<PredictorT>::setData(const ModalityGridData& data)
 {
     m_data = data;
-    m_hp = data.getHp();
-    m_wp = data.getWp();
+    m_hp = m_data.getHp();
+    m_wp = m_data.getWp();
 }
 
 template<typename PredictorT>
@@ -83,94 +84,15 @@ template<typename PredictorT>
 void ModalityPredictionBase<PredictorT>::computeGridConsensusPredictions(cv::Mat& consensusPredictions,
                                                                          cv::Mat& consensusDistsToMargin)
 {
-    cv::Mat tags = m_data.getTagsMat();
-    
-    consensusPredictions.create(tags.rows, 1, cv::DataType<int>::type);
-    consensusDistsToMargin.create(tags.rows, 1, cv::DataType<float>::type);
-    
-//    cv::Mat partitions;
-//    cvpartition(tags, m_testK, m_seed, partitions);
-    
-    for (int r = 0; r < tags.rows; r++)
-    {
-        int pos = 0;
-        int neg = 0;
-        float accPosDists = 0;
-        float accNegDists = 0;
-        for (int i = 0; i < m_data.getHp(); i++) for (int j = 0; j < m_data.getWp(); j++)
-        {
-            if (m_PredictionsGrid.at<int>(i,j,r,0) == 0)
-            {
-                neg++;
-                accNegDists += m_DistsToMarginGrid.at<float>(i,j,r,0);
-            }
-            else if (m_PredictionsGrid.at<int>(i,j,r,0) == 1)
-            {
-                pos++;
-                accPosDists += m_DistsToMarginGrid.at<float>(i,j,r,0);
-            }
-        }
-        
-        if (pos > neg)
-        {
-            consensusPredictions.at<int>(r,0) = 1;
-            consensusDistsToMargin.at<float>(r,0) = accPosDists / pos;
-        }
-        else if (pos < neg)
-        {
-            consensusPredictions.at<int>(r,0) = 0;
-            consensusDistsToMargin.at<float>(r,0) = accNegDists / neg;
-        }
-        else // pos == neg
-        {
-            if (accPosDists > abs(accNegDists)) // most confident towards positive classification
-            {
-                consensusPredictions.at<int>(r,0) = 1;
-                consensusDistsToMargin.at<float>(r,0) = accPosDists / pos;
-            }
-            else
-            {
-                consensusPredictions.at<int>(r,0) = 0;
-                consensusDistsToMargin.at<float>(r,0) = accNegDists / neg;
-            }
-        }
-    }
-    
-//    cv::Mat tags = m_data.getTagsMat();
-//    cv::Mat consensus (tags.rows, tags.cols, tags.type(), cv::Scalar(0));
-//    int ncells = m_hp * m_wp;
-//    
-//    // Assume cells in the grid of individual predictions have all the same size
-//    // so it is possible to accumulate the values in an element-wise fashion
-//    cv::Mat votes = predictions.accumulate(); // accumulation expresses #"cells vote for subject"
-//    
-//    consensus.setTo(1, votes > (ncells / 2)); // if majority of cells vote for subject, it is
-//    
-//    // Deal with draws
-//    // that is, the same number of cells voting positively and negatively
-//    
-//    GridMat drawIndices;
-//    drawIndices.setTo(votes == (ncells / 2));
-//    
-//    GridMat drawnPredictions (predictions, drawIndices); // index the subset of draws
-//    GridMat drawnDists (distsToMargin, drawIndices); // and their corresponding distances to margin
-//    
-//    GridMat negPredictions = (drawnPredictions == 0) / 255;
-//    GridMat posPredictions = (drawnPredictions == 1) / 255;
-//    
-//    GridMat negDists, posDists;
-//    drawnDists.copyTo(negDists, negPredictions);
-//    drawnDists.copyTo(posDists, posPredictions);
-//    
-//    cv::Mat_<float> avgNegDists, avgPosDists;
-//    avgNegDists = negDists.accumulate() / (ncells / 2);
-//    avgPosDists = posDists.accumulate() / (ncells / 2);
-//    
-//    cv::Mat aux = (avgPosDists > cv::abs(avgNegDists));
-//    cvx::setMat(aux / 255, consensus, votes == (ncells / 2));
-//    
-//    // When consensuated, all the cells in the grid of consensus are exactly the same
-//    consensusPredictions.setTo(consensus);
+    computeGridConsensusPredictions(m_PredictionsGrid, m_DistsToMarginGrid, consensusPredictions, consensusDistsToMargin);
+}
+
+template<typename PredictorT>
+void ModalityPredictionBase<PredictorT>::computeGridConsensusPredictions(GridMat predictionsGrid, GridMat distsToMarginGrid,
+                                                                         cv::Mat& consensusPredictions,
+                                                                         cv::Mat& consensusDistsToMargin)
+{
+    vote(predictionsGrid, distsToMarginGrid, consensusPredictions, consensusDistsToMargin);
 }
 
 template<typename PredictorT>
@@ -202,7 +124,7 @@ ModalityPrediction<PredictorT>::ModalityPrediction()
 //
 
 ModalityPrediction<cv::EM40>::ModalityPrediction()
-: ModalityPredictionBase<cv::EM40>()
+: ModalityPredictionBase<cv::EM40>(), m_bModelsReuse(false)
 {
 }
 
@@ -239,9 +161,16 @@ void ModalityPrediction<cv::EM40>::setLoglikelihoodThresholds(vector<float> t)
     m_logthresholds = t;
 }
 
+void ModalityPrediction<cv::EM40>::setModelsReuse(bool flag)
+{
+    m_bModelsReuse = flag;
+}
+
 void ModalityPrediction<cv::EM40>::predict(GridMat& predictionsGrid, GridMat& loglikelihoodsGrid, GridMat& distsToMarginGrid)
 {
     cv::Mat tags = m_data.getTagsMat();
+    TRACE_SCOPE("ModalityPrediction<EM40>::predict (" + m_data.getModality() + ")");
+    TRACE_ITEMS(tags.rows);
     
     GridMat tagsGrid;
     tagsGrid.setTo(tags);
@@ -399,7 +328,15 @@ void ModalityPrediction<cv::EM40>::predict(GridMat& predictionsGrid, GridMat& lo
             validSbjDescriptorsTrainGrid.vconcat(validSbjDescriptorsMirroredTrainGrid);
         }
         
-        predictor.train(validSbjDescriptorsTrainGrid);
+        // Trained models are kept on disk, reload them if requested
+        std::stringstream modelsss;
+        modelsss << m_data.getModality() << "_models_" << k << (m_bTrainMirrored ? "m" : "") << ".bin";
+        
+        if (!m_bModelsReuse || !predictor.load(modelsss.str()))
+        {
+            predictor.train(validSbjDescriptorsTrainGrid);
+            predictor.save(modelsss.str());
+        }
         
         // Predict phase
         
@@ -434,6 +371,8 @@ void ModalityPrediction<cv::EM40>::modelSelection(GridMat descriptors, GridMat t
                                                   vector<vector<T> > gridExpandedParams,
                                                   GridMat& goodnesses)
 {
+    TRACE_SCOPE("ModalityPrediction<EM40>::modelSelection");
+    
     GridMat partitions;
     cvpartition(tags, m_modelSelecK, m_seed, partitions);
     
@@ -475,6 +414,9 @@ void ModalityPrediction<cv::EM40>::modelSelection(GridMat descriptors, GridMat t
 template<typename T>
 void ModalityPrediction<cv::EM40>::_modelSelection(GridMat descriptorsSbjTrainGrid, GridMat descriptorsSbjObjValGrid, GridMat tagsSbjObjValGrid, int k, vector<vector<T> > gridExpandedParams, GridMat& accs)
 {
+    TRACE_SCOPE("ModalityPrediction<EM40>::_modelSelection");
+    TRACE_ITEMS(gridExpandedParams.size());
+    
     GridMat accsFold; // results
 
     for (int i = 0; i < m_data.getHp(); i++) for (int j = 0; j < m_data.getWp(); j++)
@@ -677,6 +619,8 @@ void ModalityPrediction<cv::Mat>::setScoreThresholds(vector<float> t)
 void ModalityPrediction<cv::Mat>::predict(GridMat& predictionsGrid, GridMat& ramananScoresGrid, GridMat& distsToMarginGrid)
 {
     cv::Mat tags = m_data.getTagsMat();
+    TRACE_SCOPE("ModalityPrediction<Mat>::predict (" + m_data.getModality() + ")");
+    TRACE_ITEMS(tags.rows);
     
     GridMat gtags;
     gtags.setTo(tags);
@@ -881,7 +825,7 @@ void ModalityPrediction<cv::Mat>::modelSelection(cv::Mat indices, cv::Mat tags,
 
 // Instantiation of template member functions
 // -----------------------------------------------------------------------------
-template void ModalityPredictionBase<cv::EM40>::setData(ModalityGridData &data);
+template void ModalityPredictionBase<cv::EM40>::setData(const ModalityGridData& data);
 template void ModalityPredictionBase<cv::EM40>::setPredictions(GridMat predictionsGrid);
 template void ModalityPredictionBase<cv::EM40>::setDistsToMargin(GridMat distsToMarginGrid);
 template void ModalityPredictionBase<cv::EM40>::setModelSelection(bool flag);
@@ -893,6 +837,9 @@ template void ModalityPredictionBase<cv::EM40>::getAccuracy(cv::Mat predictions,
 template void ModalityPredictionBase<cv::EM40>::getAccuracy(GridMat predictions, GridMat &accuracies);
 template void ModalityPredictionBase<cv::EM40>::computeGridConsensusPredictions(cv::Mat& consensusPredictions,
                                                                               cv::Mat& consensusDistsToMargin);
+template void ModalityPredictionBase<cv::EM40>::computeGridConsensusPredictions(GridMat predictionsGrid, GridMat distsToMarginGrid,
+                                                                              cv::Mat& consensusPredictions,
+                                                                              cv::Mat& consensusDistsToMargin);
 template void ModalityPrediction<cv::EM40>::modelSelection<int>(GridMat descriptors, GridMat tags, vector<vector<int> > params, GridMat& goodness);
 template void ModalityPrediction<cv::EM40>::modelSelection<float>(GridMat descriptors, GridMat tags, vector<vector<float> > params, GridMat& goodness);
 template void ModalityPrediction<cv::EM40>::modelSelection<double>(GridMat descriptors, GridMat tags, vector<vector<double> > params, GridMat& goodness);
@@ -901,7 +848,7 @@ template void ModalityPrediction<cv::EM40>::_modelSelection<int>(GridMat descrip
 template void ModalityPrediction<cv::EM40>::_modelSelection<float>(GridMat descriptorsSbjTrainGrid, GridMat descriptorsSbjObjValGrid, GridMat tagsSbjObjValGrid, int k, vector<vector<float> > gridExpandedParams, GridMat& accs);
 template void ModalityPrediction<cv::EM40>::_modelSelection<double>(GridMat descriptorsSbjTrainGrid, GridMat descriptorsSbjObjValGrid, GridMat tagsSbjObjValGrid, int k, vector<vector<double> > gridExpandedParams, GridMat& accs);
 
-template void ModalityPredictionBase<cv::Mat>::setData(ModalityGridData &data);
+template void ModalityPredictionBase<cv::Mat>::setData(const ModalityGridData& data);
 template void ModalityPredictionBase<cv::Mat>::setPredictions(GridMat predictionsGrid);
 template void ModalityPredictionBase<cv::Mat>::setDistsToMargin(GridMat distsToMarginGrid);
 template void ModalityPredictionBase<cv::Mat>::setModelSelection(bool flag);
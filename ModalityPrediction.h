@@ -31,7 +31,7 @@ class ModalityPredictionBase
 public:
     ModalityPredictionBase();
     
-    void setData(ModalityGridData& data);
+    void setData(const ModalityGridData& data);
     
     void setModelSelection(bool flag);
     void setModelSelectionParameters(int k, bool bGlobalBest = false);
@@ -43,6 +43,9 @@ public:
     void setTrainMirrored(bool flag);
     
     void computeGridConsensusPredictions(cv::Mat& consensusPredictions, cv::Mat& consensusDistsToMargin);
+    // Majority vote of the cells' predictions of each element, the tie broken by the most confident side
+    static void computeGridConsensusPredictions(GridMat predictionsGrid, GridMat distsToMarginGrid,
+                                                cv::Mat& consensusPredictions, cv::Mat& consensusDistsToMargin);
 
     void getAccuracy(cv::Mat predictions, cv::Mat& accuracies);
     void getAccuracy(GridMat predictions, GridMat& accuracies);
@@ -103,6 +106,8 @@ public:
     void setLoglikelihoodThresholds(float t);
     void setLoglikelihoodThresholds(vector<float> t);
     
+    void setModelsReuse(bool flag); // load the trained models of a previous run instead of training them
+    
     template<typename T>
     void modelSelection(GridMat descriptors, GridMat tags,
                         vector<vector<T> > params,
@@ -124,6 +129,8 @@ private:
     vector<float> m_epsilons;
     vector<float> m_logthresholds;
     
+    bool m_bModelsReuse; // files would be named: <modality>_models_1.bin, ..., <modality>_models_N.bin
+    
     GridMat m_LoglikelihoodsGrid;
 
 };
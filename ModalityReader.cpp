@@ -22,6 +22,19 @@ using namespace std;
 #include "GridMat.h"
 #include "MotionFeatureExtractor.h"
 #include "StatTools.h"
+#include "Trace.h"
+
+namespace
+{
+    // Size of a file for the trace, 0 if it cannot be told (a missing frame or mask
+    // is left for the reader to report, not thrown by the tracing)
+    inline boost::uintmax_t fileSizeOrZero(const path& p)
+    {
+        boost::system::error_code ec;
+        boost::uintmax_t size = file_size(p, ec);
+        return ec ? 0 : size;
+    }
+}
 
 
 ModalityReader::ModalityReader() : m_MasksOffset(200), m_MaxOffset(8)
@@ -192,6 +205,8 @@ void ModalityReader::readAllScenesData(string modality, const char* filetype, in
 
 void ModalityReader::readSceneData(string scenePath, string modality, const char* filetype, int hp, int wp, ModalityGridData& mgd)
 {
+    TRACE_SCOPE("ModalityReader::readSceneData (" + modality + ")");
+    
     if (mgd.getModality().compare("") == 0)
         mgd.setModality(modality);
     else
@@ -293,11 +308,14 @@ void ModalityReader::readSceneData(string scenePath, string modality, const char
 //            frame = cvx::matlabread<double>(framePath); // ramanan maps are matlab matrices of doubles
         
 		cv::Mat mask  = cv::imread(maskPath, CV_LOAD_IMAGE_ANYDEPTH | CV_LOAD_IMAGE_ANYCOLOR);
+        TRACE_ITEMS(1);
+        TRACE_BYTES(fileSizeOrZero(framePath) + fileSizeOrZero(maskPath));
 
         // (Motion modality) load also a second color frame to compute the actual motion frame
         // --------------------------------------------------------------------------------------
         if (modality.compare("Motion") == 0)
         {
+            TRACE_SCOPE("MotionFeatureExtractor::computeOpticalFlow");
             cv::Mat currFrame = cv::imread(scenePath + "Frames/Color/" + framesFilenames[f] + "." + filetype, CV_LOAD_IMAGE_ANYDEPTH | CV_LOAD_IMAGE_ANYCOLOR);;
             
             if (prevFrame.empty()) currFrame.copyTo(prevFrame);
@@ -417,6 +435,8 @@ void ModalityReader::readAllScenesMetadata(string modality, const char* filetype
 
 void ModalityReader::readSceneMetadata(string scenePath, string modality, const char* filetype, int hp, int wp, ModalityGridData& mgd)
 {
+    TRACE_SCOPE("ModalityReader::readSceneMetadata (" + modality + ")");
+    
     if (mgd.getModality().compare("") == 0)
         mgd.setModality(modality);
     else
@@ -643,6 +663,72 @@ void ModalityReader::overlapreadScene(string predictionType, string modality, st
     gtMasksFilenames.clear();
 }
 
+void ModalityReader::overlapreadSceneFilenames(string predictionType, string modality, string scenePath, const char* filetype,
+                                               vector<string>& predictionFiles, vector<string>& masksFiles, vector<string>& gtMasksFiles)
+{
+    string predictionsDir = scenePath + "Maps/" +  predictionType + "/Predictions/";
+    string masksDir = scenePath + "Masks/" + modality + "/";
+    string gtMasksDir = scenePath + "GroundTruth/" + modality + "/";
+    
+    vector<string> predictionFilenames, bsMasksFilenames, gtMasksFilenames;
+    loadFilenames(predictionsDir, filetype, predictionFilenames);
+    loadFilenames(masksDir, filetype, bsMasksFilenames);
+    loadFilenames(gtMasksDir, filetype, gtMasksFilenames);
+    
+    assert(bsMasksFilenames.size() == gtMasksFilenames.size());
+    
+    predictionFiles.clear();
+    masksFiles.clear();
+    gtMasksFiles.clear();
+    
+    // Same pairing as in overlapreadScene
+    int predictionsIndex = 0;
+    for(int i = 0; i < bsMasksFilenames.size(); i++)
+    {
+        masksFiles.push_back(masksDir + bsMasksFilenames[i] + "." + filetype);
+        gtMasksFiles.push_back(gtMasksDir + gtMasksFilenames[i] + "." + filetype);
+        
+        if(predictionsIndex < predictionFilenames.size() && bsMasksFilenames[i].compare(predictionFilenames[predictionsIndex]) == 0)
+        {
+            predictionFiles.push_back(predictionsDir + predictionFilenames[predictionsIndex] + "." + filetype);
+            predictionsIndex++;
+        }
+        else
+        {
+            predictionFiles.push_back("");
+        }
+    }
+}
+
+void ModalityReader::overlapreadFrame(string predictionFile, string maskFile, string gtMaskFile, cv::Mat& predictedMask, cv::Mat& gtMask)
+{
+    TRACE_SCOPE("ModalityReader::overlapreadFrame");
+    TRACE_BYTES(fileSizeOrZero(maskFile) + fileSizeOrZero(gtMaskFile) + (predictionFile.empty() ? 0 : fileSizeOrZero(predictionFile)));
+    
+    cv::Mat bsMask = cv::imread(maskFile, CV_LOAD_IMAGE_ANYDEPTH | CV_LOAD_IMAGE_ANYCOLOR);
+    cv::Mat gtMaskAux = cv::imread(gtMaskFile, CV_LOAD_IMAGE_ANYDEPTH | CV_LOAD_IMAGE_ANYCOLOR);
+    
+    if(gtMaskAux.channels() > 1)
+    {
+        vector<cv::Mat> auxGt;
+        split(gtMaskAux, auxGt);
+        gtMask = auxGt[0];
+    } else {
+        gtMask = gtMaskAux;
+    }
+    
+    predictedMask.release();
+    if(!predictionFile.empty())
+    {
+        cv::Mat prediction = cv::imread(predictionFile, CV_LOAD_IMAGE_ANYDEPTH | CV_LOAD_IMAGE_ANYCOLOR);
+        bsMask.copyTo(predictedMask, prediction);
+    }
+    else
+    {
+        predictedMask = cv::Mat::zeros(bsMask.rows, bsMask.cols, CV_8UC1);
+    }
+}
+
 void ModalityReader::overlapreadShotton(string scenePath, const char *filetype, ModalityData &md)
 {
     
@@ -730,6 +816,7 @@ void ModalityReader::loadFilenames(string dir, const char* filetype, vector<stri
  */
 void ModalityReader::loadDataToMats(string dir, const char* filetype, vector<cv::Mat> & frames)
 {
+    TRACE_SCOPE("ModalityReader::loadDataToMats");
     const char* path = dir.c_str();
     string extension = "." + string(filetype);
 
@@ -744,6 +831,8 @@ void ModalityReader::loadDataToMats(string dir, const char* filetype, vector<cv:
 			{
                 //cout << iter->path().string() << endl; //debug
 				cv::Mat img = cv::imread( iter->path().string(), CV_LOAD_IMAGE_ANYDEPTH | CV_LOAD_IMAGE_ANYCOLOR );
+                TRACE_ITEMS(1);
+                TRACE_BYTES(fileSizeOrZero(iter->path()));
 				frames.push_back(img);
             }
 		}
@@ -757,6 +846,7 @@ void ModalityReader::loadDataToMats(string dir, const char* filetype, vector<cv:
  */
 void ModalityReader::loadDataToMats(string dir, const char* filetype, vector<cv::Mat> & frames, vector<string>& indices)
 {
+    TRACE_SCOPE("ModalityReader::loadDataToMats");
     const char* path = dir.c_str();
     string extension = "." + string(filetype);
     
@@ -771,6 +861,8 @@ void ModalityReader::loadDataToMats(string dir, const char* filetype, vector<cv:
 			{
                 //cout << iter->path().string() << endl; //debug
 				cv::Mat img = cv::imread( iter->path().string(), CV_LOAD_IMAGE_ANYDEPTH | CV_LOAD_IMAGE_ANYCOLOR);
+                TRACE_ITEMS(1);
+                TRACE_BYTES(fileSizeOrZero(iter->path()));
 				frames.push_back(img);
                 
                 string filename =iter->path().filename().string();
@@ -54,6 +54,10 @@ public:
     //Read only predicted and gt mask for computing overlap
     void overlapreadScene(string predictionType, string modality, string scenePath, const char* filetype, ModalityData& md);
     void overlapreadShotton(string scenePath, const char* filetype, ModalityData& md);
+    // Streamed alternative: list the masks' files of a scene (no prediction for a frame: empty file), and read a frame's pair of masks
+    void overlapreadSceneFilenames(string predictionType, string modality, string scenePath, const char* filetype,
+                                   vector<string>& predictionFiles, vector<string>& masksFiles, vector<string>& gtMasksFiles);
+    void overlapreadFrame(string predictionFile, string maskFile, string gtMaskFile, cv::Mat& predictedMask, cv::Mat& gtMask);
 //    void overlapreadScene(string predictionType, string modality, string dataPath, string scenePath, const char* filetype, ModalityData& md);
     
     void agreement(vector<ModalityGridData*> mgds);
@@ -61,16 +61,16 @@ void ModalityWriter::write(string modality, ModalityData& md)
     {
         saveMats(m_ScenesPaths[i] + "/Masks/" + modality + "/",
                  ".png",
-                 *md.getPredictedMasksInScene(i),
-                 *md.getFramesIndicesInScene(i));
+                 md.getPredictedMasksInScene(i),
+                 md.getFramesIndicesInScene(i));
         
         saveMats(m_ScenesPaths[i] + "/GroundTruth/" + modality + "/",
                  ".png",
-                 *md.getGroundTruthMasksInScene(i),
-                 *md.getFramesIndicesInScene(i));
+                 md.getGroundTruthMasksInScene(i),
+                 md.getFramesIndicesInScene(i));
         saveBoundingRects(m_ScenesPaths[i] + "/Masks/" + modality + ".yml",
-                          *md.getPredictedBoundingRectsInScene(i),
-                          *md.getTagsInScene(i));
+                          md.getPredictedBoundingRectsInScene(i),
+                          md.getTagsInScene(i));
 
     }
     
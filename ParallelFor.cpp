@@ -0,0 +1,127 @@
+//
+//  ParallelFor.cpp
+//  segmenthreetion
+//
+//
+
+#include "ParallelFor.h"
+#include "TaskGraph.h"
+
+#include <exception>
+#include <stdexcept>
+
+#include <boost/bind.hpp>
+
+//
+// ParallelError
+//
+
+ParallelError::ParallelError()
+: m_bFailed(false), m_bCvException(false)
+{ }
+
+void ParallelError::capture()
+{
+    boost::mutex::scoped_lock lock (m_Mutex);
+    if (m_bFailed) return;
+
+    m_bFailed = true;
+    try
+    {
+        throw;
+    }
+    catch (cv::Exception& e)
+    {
+        m_bCvException = true;
+        m_CvException = e;
+    }
+    catch (std::exception& e)
+    {
+        m_What = e.what();
+    }
+    catch (...)
+    {
+        m_What = "unknown exception";
+    }
+}
+
+bool ParallelError::hasFailed()
+{
+    boost::mutex::scoped_lock lock (m_Mutex);
+    return m_bFailed;
+}
+
+void ParallelError::rethrow()
+{
+    boost::mutex::scoped_lock lock (m_Mutex);
+    if (!m_bFailed) return;
+
+    if (m_bCvException)
+        throw m_CvException;
+    throw std::runtime_error(m_What);
+}
+
+//
+// parallelFor
+//
+
+namespace
+{
+    struct LoopJobs
+    {
+        int n;
+        int next;
+        boost::function<void (int)> job;
+
+        ParallelError error;
+        boost::mutex mutex;
+    };
+
+    void loopWorker(LoopJobs& jobs)
+    {
+        while (true)
+        {
+            int i;
+            {
+                boost::mutex::scoped_lock lock (jobs.mutex);
+                if (jobs.error.hasFailed() || jobs.next >= jobs.n) return;
+                i = jobs.next++;
+            }
+
+            try
+            {
+                jobs.job(i);
+            }
+            catch (...)
+            {
+                jobs.error.capture();
+            }
+        }
+    }
+}
+
+void parallelFor(int n, boost::function<void (int)> job)
+{
+    LoopJobs jobs;
+    jobs.n = n;
+    jobs.next = 0;
+    jobs.job = job;
+
+    // The calling thread is one of the workers
+    {
+        BorrowedThreads helpers (n - 1);
+        try
+        {
+            for (int w = 0; w < helpers.size(); w++)
+                helpers.run( boost::bind(&loopWorker, boost::ref(jobs)) );
+        }
+        catch (...)
+        {
+            jobs.error.capture(); // the helpers already running stop, and are joined
+        }
+
+        loopWorker(jobs);
+    }
+
+    jobs.error.rethrow();
+}
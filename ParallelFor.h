@@ -0,0 +1,53 @@
+//
+//  ParallelFor.h
+//  segmenthreetion
+//
+//
+
+#ifndef __segmenthreetion__ParallelFor__
+#define __segmenthreetion__ParallelFor__
+
+#include <string>
+
+#include <opencv2/core/core.hpp>
+
+#include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
+
+/*
+ * First exception thrown by the threads of a parallel loop, kept to be rethrown on
+ * the calling thread once they are joined (escaping a thread, it would terminate the
+ * program). cv::Exception keeps its type, any other one is rethrown as a
+ * std::runtime_error with its message:
+ *
+ *   try { job(i); } catch (...) { error.capture(); }
+ *   ...
+ *   threads.join_all();
+ *   error.rethrow();
+ */
+class ParallelError
+{
+public:
+    ParallelError();
+
+    void capture(); // within a catch block, unless an exception was kept already
+    bool hasFailed(); // for the other threads to stop taking jobs
+
+    void rethrow(); // if an exception was kept
+
+private:
+    bool m_bFailed;
+    bool m_bCvException;
+    cv::Exception m_CvException;
+    std::string m_What;
+
+    boost::mutex m_Mutex;
+};
+
+// Parallel loop: runs job(i) for i in [0,n) on the calling thread and as many helper
+// threads as are free in the ThreadBudget, each one taking the next pending i as soon
+// as it is done with the previous one. If a job throws, the pending ones are not run,
+// and the first exception is rethrown once all the threads are joined
+void parallelFor(int n, boost::function<void (int)> job);
+
+#endif /* defined(__segmenthreetion__ParallelFor__) */
@@ -0,0 +1,417 @@
+//
+//  PipelineConfiguration.cpp
+//  segmenthreetion
+//
+//
+
+#include "PipelineConfiguration.h"
+
+#include <algorithm>
+#include <sstream>
+
+#include <boost/algorithm/string.hpp>
+
+#include <pcl/console/parse.h>
+
+namespace
+{
+    // Entries not in the file leave the values as they were
+
+    cv::FileNode child(cv::FileNode node, const char* name)
+    {
+        return node.isMap() ? node[name] : cv::FileNode(); // an empty node looks its name up in the root
+    }
+
+    template<typename T>
+    void readNumber(cv::FileNode node, T& value)
+    {
+        if (!node.empty())
+            value = (T) (double) node;
+    }
+
+    template<typename T>
+    void readNumbers(cv::FileNode node, std::vector<T>& values)
+    {
+        if (node.empty()) return;
+
+        values.clear();
+        for (cv::FileNodeIterator it = node.begin(); it != node.end(); ++it)
+            values.push_back((T) (double) *it);
+    }
+
+    void readString(cv::FileNode node, std::string& value)
+    {
+        if (node.isString())
+            value = (std::string) node;
+    }
+
+    void readStrings(cv::FileNode node, std::vector<std::string>& values)
+    {
+        if (node.empty()) return;
+
+        values.clear();
+        for (cv::FileNodeIterator it = node.begin(); it != node.end(); ++it)
+        {
+            if ((*it).isString())
+            {
+                values.push_back((std::string) *it);
+            }
+            else
+            {
+                std::stringstream ss;
+                ss << (double) *it;
+                values.push_back(ss.str());
+            }
+        }
+    }
+
+    template<typename T>
+    void describeNumbers(std::stringstream& ss, const char* name, const std::vector<T>& values)
+    {
+        ss << name << ":";
+        for (int i = 0; i < values.size(); i++)
+            ss << (i > 0 ? "," : "") << values[i];
+        ss << ";";
+    }
+
+    // Comma-separated list of a program argument
+    std::vector<std::string> parseList(int argc, char** argv, const char* argument)
+    {
+        std::string valStr;
+        pcl::console::parse(argc, argv, argument, valStr);
+
+        std::vector<std::string> valStrL;
+        if (!valStr.empty())
+            boost::split(valStrL, valStr, boost::is_any_of(","));
+
+        return valStrL;
+    }
+}
+
+PipelineConfiguration::PipelineConfiguration()
+{
+#ifdef __APPLE__ // Xcode
+    dataPath = "../../Sequences/";
+#else
+    dataPath = "../Sequences/";
+#endif
+    masksOffset = 200;
+    numOfThreads = 0;
+    cacheDir = "Cache/";
+
+    int nftl[] = {35,200,80}; // frames needed to learn the background models for each sequence
+    fParam.numFramesToLearn = std::vector<int>(nftl, nftl + 3);
+    fParam.boundingBoxMinArea = 0.001;
+    fParam.otsuMinArea = 0.02;
+    fParam.otsuMinVariance1 = 8.3;
+    fParam.otsuMinVariance2 = 12;
+    // depthThreshold and depthLearningStep, as defaulted by ForegroundParametrization
+
+    hp = 2;
+    wp = 2;
+
+    cParam.winSizeX = 64;
+    cParam.winSizeY = 128;
+    cParam.blockSizeX = 32;
+    cParam.blockSizeY = 32;
+    cParam.cellSizeX = 16;
+    cParam.cellSizeY = 16;
+    cParam.nbins = 9;
+    cParam.hogbins = 288; // total feature vector length
+
+    mParam.hoofbins = 8;
+    mParam.pyr_scale = 0.5;
+    mParam.levels = 3;
+    mParam.winsize = 15;
+    mParam.iterations = 3;
+    mParam.poly_n = 5;
+    mParam.poly_sigma = 1.2;
+    mParam.flags = 0;
+
+    dParam.thetaBins = 8;
+    dParam.phiBins = 8;
+    dParam.normalsRadius = 0.04;
+
+    tParam.ibins = 8;
+    tParam.oribins = 8;
+
+    int nm[] = {2, 4, 6, 8, 10, 12};
+    nmixtures.assign(nm, nm + sizeof(nm)/sizeof(int));
+    float lc[] = {-3, -2.5, -2, -1.5, -1.25, -1, -0.75, -0.5, -0.4, -0.3, -0.2, -0.1, 0, 0.1, 0.2, 0.3, 0.4, 0.5, 0.75, 1, 1.25, 1.5, 2, 2.5, 3};
+    likelicuts.assign(lc, lc + sizeof(lc)/sizeof(float));
+    float eps[] = {1e-2, 1e-3, 1e-4, 1e-5};
+    epsilons.assign(eps, eps + sizeof(eps)/sizeof(float));
+    colorVariance = 0.9;
+
+    float c[] = {1e-7, 1e-6, 1e-5, 1e-4, 1e-3, 1e-2, 1e-1, 1e0, 1e1, 1e2, 1e3, 1e4};
+    cs.assign(c, c + sizeof(c)/sizeof(float));
+    float g[] = {1e-7, 1e-6, 1e-5, 1e-4, 1e-3, 1e-2, 1e-1, 1e0, 1e1, 1e2};
+    gammas.assign(g, g + sizeof(g)/sizeof(float));
+
+    float nw[] = {10, 20, 50, 100, 200, 500, 1000};
+    numOfWeaks.assign(nw, nw + sizeof(nw)/sizeof(float));
+    float wtr[] = {0, 0.70, 0.75, 0.80, 0.85, 0.90, 0.95, 0.99};
+    weightTrimRates.assign(wtr, wtr + sizeof(wtr)/sizeof(float));
+
+    float hls[] = {2, 5, 10, 15, 20, 25, 30, 35, 40, 45, 50, 60, 70, 80, 90, 100};
+    hiddenLayerSizes.assign(hls, hls + sizeof(hls)/sizeof(float));
+
+    float md[] = {2, 4, 8, 16, 32, 64};
+    maxDepths.assign(md, md + sizeof(md)/sizeof(float));
+    float mnt[] = {1, 2, 4, 8, 16, 32, 64, 128};
+    maxNoTrees.assign(mnt, mnt + sizeof(mnt)/sizeof(float));
+    float nv[] = {0.05, 0.1, 0.2, 0.4, 0.8, 1};
+    noVars.assign(nv, nv + sizeof(nv)/sizeof(float));
+
+    kTest = 10;
+    kModelSelec = kTest - 1;
+    seed = 42;
+
+    int dcr[] = {1, 2, 3, 4, 5, 6, 7, 8};
+    dontCareRange.assign(dcr, dcr + sizeof(dcr)/sizeof(int));
+}
+
+bool PipelineConfiguration::load(std::string file)
+{
+    cv::FileStorage fs;
+    try
+    {
+        fs.open(file, cv::FileStorage::READ);
+    }
+    catch (cv::Exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return false;
+    }
+
+    if (!fs.isOpened())
+    {
+        std::cerr << "Could not open the configuration " << file << std::endl;
+        return false;
+    }
+
+    readString(fs["dataPath"], dataPath);
+    readStrings(fs["sequences"], sequences);
+    readString(fs["outputDir"], outputDir);
+    readNumber(fs["masksOffset"], masksOffset);
+    readNumber(fs["threads"], numOfThreads);
+    readString(fs["cacheDir"], cacheDir);
+
+    cv::FileNode stages = fs["stages"];
+    if (!stages.empty())
+    {
+        m_Stages.clear();
+        for (cv::FileNodeIterator it = stages.begin(); it != stages.end(); ++it)
+        {
+            std::vector<std::string> options;
+            readStrings(*it, options);
+            m_Stages[(*it).name()] = options;
+        }
+    }
+
+    cv::FileNode foreground = fs["foreground"];
+    readNumbers(child(foreground, "numFramesToLearn"), fParam.numFramesToLearn);
+    readNumber(child(foreground, "boundingBoxMinArea"), fParam.boundingBoxMinArea);
+    readNumber(child(foreground, "otsuMinArea"), fParam.otsuMinArea);
+    readNumber(child(foreground, "otsuMinVariance1"), fParam.otsuMinVariance1);
+    readNumber(child(foreground, "otsuMinVariance2"), fParam.otsuMinVariance2);
+    readNumber(child(foreground, "depthThreshold"), fParam.depthThreshold);
+    readNumber(child(foreground, "depthLearningStep"), fParam.depthLearningStep);
+
+    cv::FileNode features = fs["features"];
+    readNumber(child(features, "hp"), hp);
+    readNumber(child(features, "wp"), wp);
+
+    cv::FileNode color = child(features, "color");
+    readNumber(child(color, "winSizeX"), cParam.winSizeX);
+    readNumber(child(color, "winSizeY"), cParam.winSizeY);
+    readNumber(child(color, "blockSizeX"), cParam.blockSizeX);
+    readNumber(child(color, "blockSizeY"), cParam.blockSizeY);
+    readNumber(child(color, "cellSizeX"), cParam.cellSizeX);
+    readNumber(child(color, "cellSizeY"), cParam.cellSizeY);
+    readNumber(child(color, "nbins"), cParam.nbins);
+    readNumber(child(color, "hogbins"), cParam.hogbins);
+
+    cv::FileNode motion = child(features, "motion");
+    readNumber(child(motion, "hoofbins"), mParam.hoofbins);
+    readNumber(child(motion, "pyr_scale"), mParam.pyr_scale);
+    readNumber(child(motion, "levels"), mParam.levels);
+    readNumber(child(motion, "winsize"), mParam.winsize);
+    readNumber(child(motion, "iterations"), mParam.iterations);
+    readNumber(child(motion, "poly_n"), mParam.poly_n);
+    readNumber(child(motion, "poly_sigma"), mParam.poly_sigma);
+    readNumber(child(motion, "flags"), mParam.flags);
+
+    cv::FileNode depth = child(features, "depth");
+    readNumber(child(depth, "thetaBins"), dParam.thetaBins);
+    readNumber(child(depth, "phiBins"), dParam.phiBins);
+    readNumber(child(depth, "normalsRadius"), dParam.normalsRadius);
+
+    cv::FileNode thermal = child(features, "thermal");
+    readNumber(child(thermal, "ibins"), tParam.ibins);
+    readNumber(child(thermal, "oribins"), tParam.oribins);
+
+    cv::FileNode prediction = fs["prediction"];
+    readNumbers(child(prediction, "nmixtures"), nmixtures);
+    readNumbers(child(prediction, "likelicuts"), likelicuts);
+    readNumbers(child(prediction, "epsilons"), epsilons);
+    readNumber(child(prediction, "colorVariance"), colorVariance);
+
+    cv::FileNode fusion = fs["fusion"];
+    readNumbers(child(fusion, "cs"), cs);
+    readNumbers(child(fusion, "gammas"), gammas);
+    readNumbers(child(fusion, "numOfWeaks"), numOfWeaks);
+    readNumbers(child(fusion, "weightTrimRates"), weightTrimRates);
+    readNumbers(child(fusion, "hiddenLayerSizes"), hiddenLayerSizes);
+    readNumbers(child(fusion, "maxDepths"), maxDepths);
+    readNumbers(child(fusion, "maxNoTrees"), maxNoTrees);
+    readNumbers(child(fusion, "noVars"), noVars);
+
+    cv::FileNode validation = fs["validation"];
+    readNumber(child(validation, "kTest"), kTest);
+    if (!child(validation, "kTest").empty() && child(validation, "kModelSelec").empty())
+        kModelSelec = kTest - 1;
+    readNumber(child(validation, "kModelSelec"), kModelSelec);
+    readNumber(child(validation, "seed"), seed);
+    readNumbers(child(validation, "dontCareRange"), dontCareRange);
+
+    fs.release();
+
+    return true;
+}
+
+void PipelineConfiguration::parse(int argc, char** argv)
+{
+    if (pcl::console::find_argument(argc, argv, "-S") > 0)
+        sequences = parseList(argc, argv, "-S");
+
+    if (pcl::console::find_argument(argc, argv, "-o") > 0)
+        pcl::console::parse(argc, argv, "-o", outputDir);
+
+    if (pcl::console::find_argument(argc, argv, "-j") > 0)
+        pcl::console::parse(argc, argv, "-j", numOfThreads);
+
+    if (pcl::console::find_argument(argc, argv, "-P") > 0)
+        setStage("partitions");
+
+    if (pcl::console::find_argument(argc, argv, "-B") > 0)
+        setStage("background");
+
+    if (pcl::console::find_argument(argc, argv, "-D") > 0)
+        setStage("description", parseList(argc, argv, "-D"));
+
+    if (pcl::console::find_argument(argc, argv, "-I") > 0)
+        setStage("individual", getOptions("individual"));
+
+    if (pcl::console::find_argument(argc, argv, "-It") > 0)
+        setStage("individual", parseList(argc, argv, "-It"));
+
+    if (pcl::console::find_argument(argc, argv, "-f") > 0)
+        setStage("simpleFusion");
+
+    if (pcl::console::find_argument(argc, argv, "-F") > 0)
+        setStage("learningFusion", getOptions("learningFusion"));
+
+    if (pcl::console::find_argument(argc, argv, "-Ft") > 0)
+        setStage("learningFusion", parseList(argc, argv, "-Ft"));
+
+    if (pcl::console::find_argument(argc, argv, "-M") > 0)
+        setStage("maps", parseList(argc, argv, "-M"));
+
+    if (pcl::console::find_argument(argc, argv, "-O") > 0)
+        setStage("overlaps", parseList(argc, argv, "-O"));
+}
+
+bool PipelineConfiguration::isStage(std::string stage)
+{
+    return m_Stages.count(stage) > 0;
+}
+
+bool PipelineConfiguration::hasOption(std::string stage, std::string option)
+{
+    std::vector<std::string> options = getOptions(stage);
+    return std::find(options.begin(), options.end(), option) != options.end();
+}
+
+std::vector<std::string> PipelineConfiguration::getOptions(std::string stage)
+{
+    std::map<std::string, std::vector<std::string> >::iterator it = m_Stages.find(stage);
+    if (it == m_Stages.end())
+        return std::vector<std::string>();
+
+    return it->second;
+}
+
+void PipelineConfiguration::setStage(std::string stage, std::vector<std::string> options)
+{
+    m_Stages[stage] = options;
+}
+
+std::string PipelineConfiguration::describe(std::string section)
+{
+    std::stringstream ss;
+    ss.precision(17); // doubles' round trip, so different values are not described the same
+
+    if (section == "foreground")
+    {
+        describeNumbers(ss, "numFramesToLearn", fParam.numFramesToLearn);
+        ss << "boundingBoxMinArea:" << fParam.boundingBoxMinArea << ";";
+        ss << "otsuMinArea:" << fParam.otsuMinArea << ";";
+        ss << "otsuMinVariance1:" << fParam.otsuMinVariance1 << ";";
+        ss << "otsuMinVariance2:" << fParam.otsuMinVariance2 << ";";
+        ss << "depthThreshold:" << fParam.depthThreshold << ";";
+        ss << "depthLearningStep:" << fParam.depthLearningStep << ";";
+    }
+    else if (section == "features.color")
+    {
+        ss << "winSizeX:" << cParam.winSizeX << ";" << "winSizeY:" << cParam.winSizeY << ";";
+        ss << "blockSizeX:" << cParam.blockSizeX << ";" << "blockSizeY:" << cParam.blockSizeY << ";";
+        ss << "cellSizeX:" << cParam.cellSizeX << ";" << "cellSizeY:" << cParam.cellSizeY << ";";
+        ss << "nbins:" << cParam.nbins << ";" << "hogbins:" << cParam.hogbins << ";";
+    }
+    else if (section == "features.motion")
+    {
+        ss << "hoofbins:" << mParam.hoofbins << ";" << "pyr_scale:" << mParam.pyr_scale << ";";
+        ss << "levels:" << mParam.levels << ";" << "winsize:" << mParam.winsize << ";";
+        ss << "iterations:" << mParam.iterations << ";" << "poly_n:" << mParam.poly_n << ";";
+        ss << "poly_sigma:" << mParam.poly_sigma << ";" << "flags:" << mParam.flags << ";";
+    }
+    else if (section == "features.depth")
+    {
+        ss << "thetaBins:" << dParam.thetaBins << ";" << "phiBins:" << dParam.phiBins << ";";
+        ss << "normalsRadius:" << dParam.normalsRadius << ";";
+    }
+    else if (section == "features.thermal")
+    {
+        ss << "ibins:" << tParam.ibins << ";" << "oribins:" << tParam.oribins << ";";
+    }
+    else if (section == "prediction")
+    {
+        describeNumbers(ss, "nmixtures", nmixtures);
+        describeNumbers(ss, "likelicuts", likelicuts);
+        describeNumbers(ss, "epsilons", epsilons);
+        ss << "colorVariance:" << colorVariance << ";";
+    }
+    else if (section == "fusion")
+    {
+        describeNumbers(ss, "cs", cs);
+        describeNumbers(ss, "gammas", gammas);
+        describeNumbers(ss, "numOfWeaks", numOfWeaks);
+        describeNumbers(ss, "weightTrimRates", weightTrimRates);
+        describeNumbers(ss, "hiddenLayerSizes", hiddenLayerSizes);
+        describeNumbers(ss, "maxDepths", maxDepths);
+        describeNumbers(ss, "maxNoTrees", maxNoTrees);
+        describeNumbers(ss, "noVars", noVars);
+    }
+    else if (section == "validation")
+    {
+        ss << "kTest:" << kTest << ";" << "kModelSelec:" << kModelSelec << ";" << "seed:" << seed << ";";
+        describeNumbers(ss, "dontCareRange", dontCareRange);
+    }
+    else
+    {
+        std::cerr << "No parameters section " << section << std::endl;
+    }
+
+    return ss.str();
+}
@@ -0,0 +1,115 @@
+//
+//  PipelineConfiguration.h
+//  segmenthreetion
+//
+//
+
+#ifndef __segmenthreetion__PipelineConfiguration__
+#define __segmenthreetion__PipelineConfiguration__
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <string>
+
+#include <opencv2/core/core.hpp>
+
+#include "ForegroundParametrization.hpp"
+#include "ColorParametrization.hpp"
+#include "MotionParametrization.hpp"
+#include "DepthParametrization.hpp"
+#include "ThermalParametrization.hpp"
+
+/*
+ * What main runs and with which parameters. The defaults are overriden by the
+ * configuration files (cv::FileStorage's YAML or XML) loaded, in the given order,
+ * and these by the program arguments. Entries not in a file are left as they were,
+ * so a file can sweep a few parameters on top of a base one. Example:
+ *
+ *  %YAML:1.0
+ *  dataPath: "../Sequences/"
+ *  sequences: [ "Scene1/", "Scene2/", "Scene3/" ]
+ *  outputDir: "runs/nmixtures-2-4/"
+ *  threads: 32
+ *  cacheDir: "Cache/"
+ *  stages:
+ *     description: [ 0, 1, 2 ]     # -D, the scenes to describe
+ *     individual: [ "c", "C" ]     # -I/-It, the model selections to perform
+ *     simpleFusion: []             # -f
+ *     learningFusion: [ "ada" ]    # -F/-Ft
+ *     maps: [ "hog", "ada" ]       # -M
+ *     overlaps: [ "hog" ]          # -O
+ *  prediction:
+ *     nmixtures: [ 2, 4 ]
+ *  validation:
+ *     kTest: 5
+ *
+ * A stage is run if it is in "stages" (the partitions and background subtraction
+ * ones as well, "partitions" and "background"), with the options listed in it.
+ * A file's "stages" replaces the previous ones, the program arguments add to them.
+ * The parameters are in "foreground", "features" (hp, wp, and the "color", "motion",
+ * "depth" and "thermal" parametrizations), "prediction", "fusion" and "validation",
+ * by the names of the members below. The stages' outputs are kept in the cacheDir's
+ * ArtifactCache, and restored rather than recomputed if their inputs and parameters
+ * did not change ("" to disable it).
+ */
+class PipelineConfiguration
+{
+public:
+    PipelineConfiguration();
+
+    bool load(std::string file);
+
+    // -S scenes, -D -I -It -f -F -Ft -M -O -P -B stages, -o outputDir, -j threads
+    void parse(int argc, char** argv);
+
+    bool isStage(std::string stage);
+    bool hasOption(std::string stage, std::string option);
+    std::vector<std::string> getOptions(std::string stage);
+    void setStage(std::string stage, std::vector<std::string> options = std::vector<std::string>());
+
+    // Canonical text of the parameters of a section ("foreground", "features.color", "prediction", ...),
+    // to key the artifacts computed with them
+    std::string describe(std::string section);
+
+    // Data
+    std::string dataPath;
+    std::vector<std::string> sequences; // the scenes' directories, within dataPath
+    std::string outputDir; // where the results (predictions, models, ...) are saved, the working directory if empty
+    unsigned char masksOffset;
+    int numOfThreads; // ThreadBudget's size, 0 for the hardware concurrency
+    std::string cacheDir; // ArtifactCache's directory, within outputDir, none if empty
+
+    // Background subtraction
+    ForegroundParametrization fParam;
+
+    // Feature extraction
+    unsigned int hp, wp; // partitions in height and width
+    ColorParametrization cParam;
+    MotionParametrization mParam;
+    DepthParametrization dParam;
+    ThermalParametrization tParam;
+
+    // Individual prediction
+    std::vector<int> nmixtures;
+    std::vector<float> likelicuts;
+    std::vector<float> epsilons;
+    double colorVariance; // variance to keep in PCA's dim reduction in ColorModality
+
+    // Learning fusion
+    std::vector<float> cs, gammas; // svm
+    std::vector<float> numOfWeaks, weightTrimRates; // boost
+    std::vector<float> hiddenLayerSizes; // mlp
+    std::vector<float> maxDepths, maxNoTrees, noVars; // rf
+
+    // Validation
+    int kTest; // number of folds in the outer cross-validation
+    int kModelSelec;
+    int seed;
+    std::vector<int> dontCareRange; // overlap
+
+private:
+    std::map<std::string, std::vector<std::string> > m_Stages;
+};
+
+#endif /* defined(__segmenthreetion__PipelineConfiguration__) */
@@ -0,0 +1,354 @@
+//
+//  SegmentationEngine.cpp
+//  segmenthreetion
+//
+//
+
+#include "SegmentationEngine.h"
+#include "ModalityPrediction.h"
+#include "FusionPrediction.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <iomanip>
+
+//
+// LatencyWindow
+//
+
+LatencyWindow::LatencyWindow(int size)
+: m_Size(size > 0 ? size : 1), m_Next(0)
+{ }
+
+void LatencyWindow::add(double ms)
+{
+    if (m_Samples.size() < m_Size)
+        m_Samples.push_back(ms);
+    else
+        m_Samples[m_Next] = ms; // overwrite the oldest
+
+    m_Next = (m_Next + 1) % m_Size;
+}
+
+int LatencyWindow::count() const
+{
+    return m_Samples.size();
+}
+
+double LatencyWindow::percentile(float p) const
+{
+    if (m_Samples.empty())
+        return std::numeric_limits<double>::quiet_NaN();
+
+    vector<double> samples (m_Samples);
+    int idx = std::min((int) samples.size() - 1, std::max(0, (int) std::ceil(p / 100.f * samples.size()) - 1));
+    std::nth_element(samples.begin(), samples.begin() + idx, samples.end());
+
+    return samples[idx];
+}
+
+//
+// SegmentationEngine
+//
+
+SegmentationEngine::SegmentationEngine(unsigned int hp, unsigned int wp)
+: m_hp(hp), m_wp(wp), m_MasksOffset(200), m_Partitioner(hp, wp), m_bStackPredictions(false),
+  m_LatencyWindowSize(1000), m_LatencyTarget(0), m_LatencyTargetPercentile(99)
+{
+    m_pExtractors.resize(NUM_OF_MODALITIES);
+    m_pExtractors[MOTION] = &m_MotionFE;
+    m_pExtractors[DEPTH] = &m_DepthFE;
+    m_pExtractors[THERMAL] = &m_ThermalFE;
+    m_pExtractors[COLOR] = &m_ColorFE;
+
+    m_pPredictors.resize(NUM_OF_MODALITIES, NULL);
+}
+
+SegmentationEngine::~SegmentationEngine()
+{
+    for (int m = 0; m < NUM_OF_MODALITIES; m++)
+        delete m_pPredictors[m];
+}
+
+void SegmentationEngine::setMasksOffset(unsigned char offset)
+{
+    m_MasksOffset = offset;
+}
+
+void SegmentationEngine::setColorParam(ColorParametrization param)
+{
+    m_ColorFE.setParam(param);
+}
+
+void SegmentationEngine::setMotionParam(MotionParametrization param)
+{
+    m_MotionFE.setParam(param);
+}
+
+void SegmentationEngine::setDepthParam(DepthParametrization param)
+{
+    m_DepthFE.setParam(param);
+}
+
+void SegmentationEngine::setThermalParam(ThermalParametrization param)
+{
+    m_ThermalFE.setParam(param);
+}
+
+bool SegmentationEngine::loadModels(int modality, std::string file)
+{
+    GridPredictor<cv::EM40>* pPredictor = new GridPredictor<cv::EM40>(m_hp, m_wp);
+    if (!pPredictor->load(file))
+    {
+        delete pPredictor;
+        return false;
+    }
+
+    delete m_pPredictors[modality];
+    m_pPredictors[modality] = pPredictor;
+
+    return true;
+}
+
+void SegmentationEngine::setFusionClassifier(boost::function<float (cv::Mat)> classify, bool bStackPredictions)
+{
+    m_FusionClassifier = classify;
+    m_bStackPredictions = bStackPredictions;
+}
+
+void SegmentationEngine::process(const SynchronizedFrame& frame, cv::Mat& predictions, cv::Mat& distsToMargin)
+{
+    int64 start = cv::getTickCount();
+
+    int n = frame.colorRects.size();
+    CV_Assert (frame.depthRects.size() == n && frame.thermalRects.size() == n);
+
+    // Motion frame, the optical flow from the previous color frame
+    cv::Mat motionFrame;
+    if (m_pPredictors[MOTION] != NULL)
+    {
+        int64 t = cv::getTickCount();
+
+        if (m_PrevColorFrame.empty())
+            frame.color.copyTo(m_PrevColorFrame);
+
+        MotionFeatureExtractor::computeOpticalFlow(pair<cv::Mat,cv::Mat>(m_PrevColorFrame, frame.color), motionFrame);
+        frame.color.copyTo(m_PrevColorFrame);
+
+        addLatency("flow", t);
+    }
+
+    cv::Mat frames[NUM_OF_MODALITIES] = { motionFrame, frame.depth, frame.thermal, frame.color };
+    cv::Mat masks[NUM_OF_MODALITIES] = { frame.colorMask, frame.depthMask, frame.thermalMask, frame.colorMask };
+    const vector<cv::Rect>* rects[NUM_OF_MODALITIES] = { &frame.colorRects, &frame.depthRects, &frame.thermalRects, &frame.colorRects };
+
+    // Individual predictions of the modalities, and the people gridded in all of them
+    vector<cv::Mat> allPredictions, allDistsToMargin;
+    vector<GridMat> allDistsToMarginGrids;
+    cv::Mat gridded (n, 1, cv::DataType<unsigned char>::type, cv::Scalar(1));
+
+    for (int m = 0; m < NUM_OF_MODALITIES; m++)
+    {
+        if (m_pPredictors[m] == NULL)
+            continue;
+
+        GridMat predictionsGrid, distsToMarginGrid;
+        cv::Mat modalityGridded;
+        predict(m, frames[m], masks[m], *(rects[m]), predictionsGrid, distsToMarginGrid, modalityGridded);
+
+        cv::Mat consensusPredictions, consensusDistsToMargin;
+        ModalityPredictionBase<cv::EM40>::computeGridConsensusPredictions(predictionsGrid, distsToMarginGrid,
+                                                                          consensusPredictions, consensusDistsToMargin);
+
+        allPredictions.push_back(consensusPredictions);
+        allDistsToMargin.push_back(consensusDistsToMargin);
+        allDistsToMarginGrids.push_back(distsToMarginGrid);
+
+        cv::bitwise_and(gridded, modalityGridded, gridded);
+    }
+
+    CV_Assert (!allPredictions.empty()); // models of some modality were loaded
+
+    predictions.create(n, 1, cv::DataType<int>::type);
+    predictions.setTo(-1);
+    distsToMargin.create(n, 1, cv::DataType<float>::type);
+    distsToMargin.setTo(0);
+
+    if (n > 0)
+    {
+        int64 t = cv::getTickCount();
+
+        cv::Mat fusionPredictions, fusionDistsToMargin;
+        SimpleFusionPrediction simpleFusion;
+        simpleFusion.predict(allPredictions, allDistsToMargin, fusionPredictions, fusionDistsToMargin);
+
+        if (!m_FusionClassifier.empty())
+        {
+            // The same data as ClassifierFusionPrediction's
+            cv::Mat data;
+            for (int i = 0; i < allDistsToMarginGrids.size(); i++)
+            {
+                cv::Mat serialMat;
+                allDistsToMarginGrids[i].hserial(serialMat);
+
+                if (data.cols == 0)
+                    data = serialMat;
+                else
+                    cv::hconcat(data, serialMat, data);
+
+                if (m_bStackPredictions)
+                {
+                    cv::Mat_<float> normPredictions = 2 * allPredictions[i] - 1;
+                    cv::hconcat(data, normPredictions, data);
+                }
+            }
+
+            for (int r = 0; r < n; r++)
+                fusionPredictions.at<int>(r,0) = cvRound(m_FusionClassifier(data.row(r)));
+        }
+
+        fusionPredictions.copyTo(predictions, gridded);
+        fusionDistsToMargin.copyTo(distsToMargin, gridded);
+
+        addLatency("fusion", t);
+    }
+
+    addLatency("total", start);
+}
+
+/*
+ * Cells' predictions (n x 1 in every cell, 0 where not valid) of the people in a modality's frame
+ */
+void SegmentationEngine::predict(int modality, cv::Mat frame, cv::Mat mask, const vector<cv::Rect>& rects,
+                                 GridMat& predictionsGrid, GridMat& distsToMarginGrid, cv::Mat& gridded)
+{
+    std::string name = getModalityName(modality);
+    int n = rects.size();
+
+    // Description
+
+    int64 t = cv::getTickCount();
+
+    vector<GridMat> gframes, gmasks;
+    vector<int> indices;
+    m_Partitioner.grid(frame, mask, rects, m_MasksOffset, gframes, gmasks, indices);
+
+    gridded = cv::Mat::zeros(n, 1, cv::DataType<unsigned char>::type);
+
+    // descriptors of the valid cells, and the people they belong to
+    GridMat descriptors (m_hp, m_wp);
+    vector<vector<int> > owners (m_hp * m_wp);
+
+    for (int g = 0; g < gframes.size(); g++)
+    {
+        cv::Mat gvalidness = gmasks[g].findNonZero<unsigned char>();
+
+        GridMat gdescriptors;
+        m_pExtractors[modality]->describe(gframes[g], gmasks[g], gvalidness, gdescriptors);
+
+        for (int i = 0; i < m_hp; i++) for (int j = 0; j < m_wp; j++)
+        {
+            if (gvalidness.at<unsigned char>(i,j))
+            {
+                descriptors.at(i,j).push_back(gdescriptors.at(i,j));
+                owners[i * m_wp + j].push_back(indices[g]);
+            }
+        }
+
+        gridded.at<unsigned char>(indices[g],0) = 1;
+    }
+
+    addLatency(name + " description", t);
+
+    // Prediction
+
+    t = cv::getTickCount();
+
+    GridMat predictions, loglikelihoods, distsToMargin;
+    m_pPredictors[modality]->predictOnline(descriptors, predictions, loglikelihoods, distsToMargin);
+
+    predictionsGrid.create<int>(m_hp, m_wp, n, 1);
+    distsToMarginGrid.create<float>(m_hp, m_wp, n, 1);
+
+    for (int i = 0; i < m_hp; i++) for (int j = 0; j < m_wp; j++)
+    {
+        predictionsGrid.at(i,j).setTo(0);
+        distsToMarginGrid.at(i,j).setTo(0);
+
+        const vector<int>& cellOwners = owners[i * m_wp + j];
+        for (int k = 0; k < cellOwners.size(); k++)
+        {
+            predictionsGrid.at<int>(i,j,cellOwners[k],0) = predictions.at<int>(i,j,k,0);
+            distsToMarginGrid.at<float>(i,j,cellOwners[k],0) = distsToMargin.at<float>(i,j,k,0);
+        }
+    }
+
+    addLatency(name + " prediction", t);
+}
+
+void SegmentationEngine::reset()
+{
+    m_PrevColorFrame.release();
+    m_Latencies.clear();
+}
+
+void SegmentationEngine::setLatencyWindow(int frames)
+{
+    m_LatencyWindowSize = frames;
+    m_Latencies.clear();
+}
+
+void SegmentationEngine::setLatencyTarget(double ms, float percentile)
+{
+    m_LatencyTarget = ms;
+    m_LatencyTargetPercentile = percentile;
+}
+
+double SegmentationEngine::getLatency(std::string stage, float percentile)
+{
+    map<std::string, LatencyWindow>::iterator it = m_Latencies.find(stage);
+    if (it == m_Latencies.end())
+        return std::numeric_limits<double>::quiet_NaN();
+
+    return it->second.percentile(percentile);
+}
+
+bool SegmentationEngine::isOnLatencyTarget()
+{
+    return !(getLatency("total", m_LatencyTargetPercentile) > m_LatencyTarget); // no frames yet is on target
+}
+
+void SegmentationEngine::printLatencies(std::ostream& os)
+{
+    os << std::left << std::setw(24) << "stage" << std::right << std::setw(8) << "frames"
+       << std::setw(10) << "p50 (ms)" << std::setw(10) << "p99 (ms)" << std::endl;
+
+    os << std::fixed << std::setprecision(2);
+    for (map<std::string, LatencyWindow>::iterator it = m_Latencies.begin(); it != m_Latencies.end(); ++it)
+    {
+        os << std::left << std::setw(24) << it->first << std::right << std::setw(8) << it->second.count()
+           << std::setw(10) << it->second.percentile(50) << std::setw(10) << it->second.percentile(99) << std::endl;
+    }
+
+    if (m_LatencyTarget > 0)
+        os << "p" << m_LatencyTargetPercentile << " target " << m_LatencyTarget << " ms: "
+           << (isOnLatencyTarget() ? "met" : "missed") << std::endl;
+}
+
+std::string SegmentationEngine::getModalityName(int modality)
+{
+    static const char* names[NUM_OF_MODALITIES] = { "Motion", "Depth", "Thermal", "Color" };
+    return names[modality];
+}
+
+void SegmentationEngine::addLatency(std::string stage, int64 start)
+{
+    double ms = (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency();
+
+    map<std::string, LatencyWindow>::iterator it = m_Latencies.find(stage);
+    if (it == m_Latencies.end())
+        it = m_Latencies.insert(std::pair<std::string, LatencyWindow>(stage, LatencyWindow(m_LatencyWindowSize))).first;
+
+    it->second.add(ms);
+}
@@ -0,0 +1,143 @@
+//
+//  SegmentationEngine.h
+//  segmenthreetion
+//
+//
+
+#ifndef __segmenthreetion__SegmentationEngine__
+#define __segmenthreetion__SegmentationEngine__
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <string>
+
+#include <opencv2/core/core.hpp>
+
+#include <boost/function.hpp>
+
+#include "em.h"
+#include "GridMat.h"
+#include "GridPartitioner.h"
+#include "GridPredictor.h"
+
+#include "ColorFeatureExtractor.h"
+#include "MotionFeatureExtractor.h"
+#include "DepthFeatureExtractor.h"
+#include "ThermalFeatureExtractor.h"
+
+using namespace std;
+
+/*
+ * One synchronized frame: the frames of the modalities, their people masks (the
+ * pixels of the r-th person labelled masksOffset + r, as in the dataset) and the
+ * bounding rects of the people, the same people in the same order in the three
+ * of them. Motion is computed from the color frames.
+ */
+struct SynchronizedFrame
+{
+    cv::Mat color, depth, thermal;
+    cv::Mat colorMask, depthMask, thermalMask;
+    vector<cv::Rect> colorRects, depthRects, thermalRects;
+};
+
+/*
+ * Latencies (ms) of the last frames processed by a stage
+ */
+class LatencyWindow
+{
+public:
+    LatencyWindow(int size = 1000);
+
+    void add(double ms);
+    int count() const;
+    double percentile(float p) const; // p in [0,100]
+
+private:
+    vector<double> m_Samples;
+    int m_Size;
+    int m_Next;
+};
+
+/*
+ * Online inference: the people in a synchronized frame are predicted as subjects (1)
+ * or objects (0) as soon as the frame arrives, with the models trained offline and
+ * saved by GridPredictor<cv::EM40>::save, instead of cross-validating a whole sequence.
+ *
+ * In every modality with models, the people are gridded, their valid cells described
+ * by the modality's FeatureExtractor and predicted by the cells' GMMs, and the cells'
+ * predictions put to a consensus (as in ModalityPrediction). The modalities are fused
+ * by SimpleFusionPrediction or, if set, by a fusion classifier trained on the cells'
+ * distances to the margin (as in ClassifierFusionPrediction).
+ *
+ * The latency of every stage is kept for the last frames, to track its percentiles:
+ * "flow", "<Modality> description", "<Modality> prediction", "fusion" and "total".
+ */
+class SegmentationEngine
+{
+public:
+    // In the order the fusion classifiers are trained (see main)
+    enum { MOTION = 0, DEPTH = 1, THERMAL = 2, COLOR = 3, NUM_OF_MODALITIES = 4 };
+
+    SegmentationEngine(unsigned int hp = 2, unsigned int wp = 2);
+    ~SegmentationEngine();
+
+    void setMasksOffset(unsigned char offset);
+
+    void setColorParam(ColorParametrization param);
+    void setMotionParam(MotionParametrization param);
+    void setDepthParam(DepthParametrization param);
+    void setThermalParam(ThermalParametrization param);
+
+    // Modalities without models are left out
+    bool loadModels(int modality, std::string file);
+
+    // classify(x) returns the class (0 or 1) of a row of cells' distances to the margin of the
+    // modalities (followed by their consensus predictions in {-1,1} if bStackPredictions).
+    // An empty classify falls back to the simple fusion.
+    void setFusionClassifier(boost::function<float (cv::Mat)> classify, bool bStackPredictions = false);
+
+    // predictions: 1 subject, 0 object, or -1 if a person could not be gridded in all the modalities.
+    // distsToMargin: the ones of the simple fusion.
+    void process(const SynchronizedFrame& frame, cv::Mat& predictions, cv::Mat& distsToMargin);
+    void reset(); // forget the previous frame and the latencies
+
+    void setLatencyWindow(int frames);
+    void setLatencyTarget(double ms, float percentile = 99);
+    double getLatency(std::string stage, float percentile);
+    bool isOnLatencyTarget();
+    void printLatencies(std::ostream& os);
+
+    static std::string getModalityName(int modality);
+
+private:
+    void predict(int modality, cv::Mat frame, cv::Mat mask, const vector<cv::Rect>& rects,
+                 GridMat& predictionsGrid, GridMat& distsToMarginGrid, cv::Mat& gridded);
+
+    void addLatency(std::string stage, int64 start);
+
+    unsigned int m_hp, m_wp;
+    unsigned char m_MasksOffset;
+
+    GridPartitioner m_Partitioner;
+
+    ColorFeatureExtractor m_ColorFE;
+    MotionFeatureExtractor m_MotionFE;
+    DepthFeatureExtractor m_DepthFE;
+    ThermalFeatureExtractor m_ThermalFE;
+    vector<FeatureExtractor*> m_pExtractors;
+
+    vector<GridPredictor<cv::EM40>*> m_pPredictors; // NULL if no models
+
+    boost::function<float (cv::Mat)> m_FusionClassifier;
+    bool m_bStackPredictions;
+
+    cv::Mat m_PrevColorFrame;
+
+    map<std::string, LatencyWindow> m_Latencies;
+    int m_LatencyWindowSize;
+    double m_LatencyTarget;
+    float m_LatencyTargetPercentile;
+};
+
+#endif /* defined(__segmenthreetion__SegmentationEngine__) */
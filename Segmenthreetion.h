@@ -0,0 +1,57 @@
+//
+//  Segmenthreetion.h
+//  segmenthreetion
+//
+//
+
+#ifndef __segmenthreetion__Segmenthreetion__
+#define __segmenthreetion__Segmenthreetion__
+
+/*
+ * libsegmenthreetion's API, for the programs linking it (the segmenthreetion
+ * command line and bench, or a service's own). The headers are installed to
+ * include/segmenthreetion/, and the version is the shared library's: the minor
+ * version grows with additions, the major one when a declared signature changes.
+ */
+
+#define SEGMENTHREETION_VERSION_MAJOR 1 // as in CMakeLists.txt
+#define SEGMENTHREETION_VERSION_MINOR 0
+
+// Data and grids
+#include "GridMat.h"
+#include "GridPartitioner.h"
+#include "ModalityData.hpp"
+#include "ModalityGridData.hpp"
+#include "ModalityReader.h"
+#include "ModalityWriter.h"
+
+// Background subtraction and registration
+#include "ForegroundParametrization.hpp"
+#include "ColorBackgroundSubtractor.h"
+#include "DepthBackgroundSubtractor.h"
+#include "ThermalBackgroundSubtractor.h"
+#include "registrator.h"
+
+// Description
+#include "ColorFeatureExtractor.h"
+#include "MotionFeatureExtractor.h"
+#include "DepthFeatureExtractor.h"
+#include "ThermalFeatureExtractor.h"
+
+// Prediction, fusion and validation
+#include "em.h"
+#include "GridPredictor.h"
+#include "ModalityPrediction.h"
+#include "FusionPrediction.h"
+#include "SegmentationEngine.h"
+#include "GridMapWriter.h"
+#include "Validation.h"
+
+// Pipeline
+#include "PipelineConfiguration.h"
+#include "TaskGraph.h"
+#include "ParallelFor.h"
+#include "ArtifactCache.h"
+#include "Trace.h"
+
+#endif /* defined(__segmenthreetion__Segmenthreetion__) */
@@ -8,6 +8,7 @@
 
 #include "StatTools.h"
 #include "CvExtraTools.h"
+#include "FoldPlan.h"
 
 #include <opencv2/opencv.hpp>
 
@@ -120,34 +121,8 @@ cv::Mat shuffledVector(int n)
  */
 void cvpartition(int n, int k, int seed, cv::Mat& partitions)
 {
-    int foldElems = std::floorf(n/k);
-    int extraElems = n - (k * std::floorf(n/k));
-
-    cv::Mat indices = shuffledVector(n, cv::RNG(seed));
-    
-    partitions.release();
-    partitions.create(indices.rows, indices.cols, cv::DataType<int>::type);
-
-    cv::Mat tmp = shuffledVector(k);
-    cv::Mat tmp2 = tmp(cv::Range(0, extraElems), cv::Range::all());
-
-    unsigned int c = 0;
-    unsigned int i, j;
-    for (i = 0; i < k; i++)
-    {
-        int ifoldElems;
-        if (cv::sum(tmp2 == i).val[0] > 0)
-            ifoldElems = (foldElems + 1);
-        else
-            ifoldElems = foldElems;
-        
-        for (j = 0; j < ifoldElems; j++)
-        {
-            partitions.at<int>(indices.at<int>(c+j,0),0) = i;
-        }
-        
-        c += ifoldElems;
-    }
+    // a single class
+    FoldPartition::get(n, k, seed)->getPartitions().copyTo(partitions);
 }
 
 
@@ -157,7 +132,7 @@ void cvpartition(GridMat gclasses, int k, int seed, GridMat& gpartitions)
     gpartitions.create(gclasses.crows(), gclasses.ccols());
     for (int i = 0; i < gclasses.crows(); i++) for (int j = 0; j < gclasses.ccols(); j++)
     {
-        cvpartition(gclasses.at(i,j), k, seed, gpartitions.at(i,j));
+        cvpartition(gclasses.at(i,j), k, seed, gpartitions.at(i,j)); // the cells' labels are often the same, partitioned once
     }
 }
 
@@ -166,37 +141,8 @@ void cvpartition(GridMat gclasses, int k, int seed, GridMat& gpartitions)
  */
 void cvpartition(cv::Mat classes, int k, int seed, cv::Mat& partitions)
 {
-    double minVal, maxVal; // labels do not need to be between [0, #classes - 1]
-    cv::minMaxIdx(classes, &minVal, &maxVal); // but, suppose continuous numeration of labels
-    
-    // separate the indices in a different vector for each class
-
-    std::vector<std::vector<int> > classesIndices(maxVal - minVal + 1);
-    int m = (classes.rows > 1) ? classes.rows : classes.cols;
-    for (int i = 0; i < m; i++)
-    {
-        int l = (classes.rows > 1) ? classes.at<int>(i,0) : classes.at<int>(0,i);
-        classesIndices[l - minVal].push_back(i);
-    }
-    
-    // perform partitions separately in the classes' indices vectors
-    // and then merge the separate partitions into one
-    
-    std::vector<cv::Mat> classesPartitions(maxVal - minVal + 1);
-    
-    partitions.release();
-    partitions.create(classes.rows, classes.cols, cv::DataType<int>::type);
-    
-    for (int i = 0; i < classesIndices.size(); i++)
-    {
-        cvpartition(classesIndices[i].size(), k, seed, classesPartitions[i]);
-        for (int j = 0; j < classesIndices[i].size(); j++)
-        {
-            (partitions.rows > 1) ?
-                partitions.at<int>(classesIndices[i][j], 0) = classesPartitions[i].at<int>(j,0) :
-                partitions.at<int>(0, classesIndices[i][j]) = classesPartitions[i].at<int>(j,0);
-        }
-    }
+    boost::shared_ptr<const FoldPartition> pPartition = FoldPartition::get(classes, k, seed);
+    pPartition->getPartitions().reshape(1, classes.rows).copyTo(partitions);
 }
 
 
@@ -518,29 +464,102 @@ void selectBestParameterCombination(GridMat parameters, vector<cv::Mat>& selecte
 //}
 
 
-float accuracy(cv::Mat actuals, cv::Mat predictions)
+namespace
 {
-    actuals.convertTo(actuals, cv::DataType<int>::type);
-    predictions.convertTo(predictions, cv::DataType<int>::type);
+    // A vector (row or column) as a continuous one of ints, not copied if it is already
+    cv::Mat intVector(cv::Mat m)
+    {
+        cv::Mat v = m;
+        if (v.type() != cv::DataType<int>::type)
+            m.convertTo(v, cv::DataType<int>::type);
+        if (!v.isContinuous())
+            v = v.clone();
+        
+        return v;
+    }
+    
+    // The hits of the objects (0) and the subjects (> 0), to average their accuracies
+    struct HitCounts
+    {
+        int nobj, nsbj, objHits, sbjHits;
+        
+        HitCounts() : nobj(0), nsbj(0), objHits(0), sbjHits(0) { }
+        
+        void add(int actual, int prediction)
+        {
+            if (actual == 0)
+            {
+                nobj++;
+                if (prediction == actual) objHits++;
+            }
+            else if (actual > 0)
+            {
+                nsbj++;
+                if (prediction == actual) sbjHits++;
+            }
+        }
+        
+        float accuracy() const
+        {
+            float objAcc = ((double) objHits) / nobj;
+            float sbjAcc = ((double) sbjHits) / nsbj;
+            
+            if (nobj > 0 && nsbj > 0)
+                return (objAcc + sbjAcc) / 2.f;
+            else if (nobj > 0)
+                return objAcc;
+            else if (nsbj > 0)
+                return sbjAcc;
+            else
+                return 0.f;
+        }
+    };
+    
+    // The number of distinct folds, the partitions being labelled 0 to #folds - 1
+    int numOfFolds(cv::Mat partitions)
+    {
+        const int* p = partitions.ptr<int>(0);
+        
+        std::vector<bool> bFound;
+        int nfolds = 0;
+        for (int i = 0; i < partitions.total(); i++)
+        {
+            if (p[i] < 0) continue;
+            if (p[i] >= bFound.size()) bFound.resize(p[i] + 1, false);
+            if (!bFound[p[i]])
+            {
+                bFound[p[i]] = true;
+                nfolds++;
+            }
+        }
+        
+        return nfolds;
+    }
     
-    cv::Mat objects  = (actuals == 0) / 255;
-    cv::Mat subjects = (actuals > 0) / 255;
-    cv::Mat hits = (actuals == predictions) / 255;
+    void countHits(const int* actuals, const int* predictions, const int* partitions, int n, std::vector<HitCounts>& counts)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            if (partitions[i] >= 0 && partitions[i] < counts.size())
+                counts[partitions[i]].add(actuals[i], predictions[i]);
+        }
+    }
+}
+
+float accuracy(cv::Mat actuals, cv::Mat predictions)
+{
+    actuals = intVector(actuals);
+    predictions = intVector(predictions);
+    CV_Assert (actuals.total() == predictions.total());
     
-    int nobj = cv::sum(objects).val[0];
-    int nsbj = cv::sum(subjects).val[0];
+    const int* a = actuals.ptr<int>(0);
+    const int* p = predictions.ptr<int>(0);
     
-    float objAcc = cv::sum(objects & hits).val[0] / nobj;
-    float sbjAcc = cv::sum(subjects & hits).val[0] / nsbj;
+    HitCounts counts;
+    for (int i = 0; i < actuals.total(); i++)
+        counts.add(a[i], p[i]);
     
-    if (nobj > 0 && nsbj > 0)
-        return (objAcc + sbjAcc) / 2.f;
-    else if (nobj > 0)
-        return objAcc;
-    else if (nsbj > 0)
-        return sbjAcc;
-    else
-        return 0.f;
+    return counts.accuracy();
 }
 
 void accuracy(GridMat actuals, GridMat predictions, cv::Mat& accuracies)
@@ -580,32 +599,39 @@ float accuracy(cv::Mat actuals, GridMat predictions)
 
 void accuracy(cv::Mat actuals, cv::Mat predictions, cv::Mat partitions, cv::Mat& accuracies)
 {
-    cv::Mat aux = partitions.t();
-    std::set<int> set (aux.ptr<int>(0), aux.ptr<int>(0) + aux.cols);
-    std::vector<int> labels (set.begin(), set.end());
+    actuals = intVector(actuals);
+    predictions = intVector(predictions);
+    partitions = intVector(partitions);
+    
+    std::vector<HitCounts> counts (numOfFolds(partitions));
+    countHits(actuals.ptr<int>(0), predictions.ptr<int>(0), partitions.ptr<int>(0), partitions.total(), counts);
     
-    accuracies.create(labels.size(), 1, cv::DataType<float>::type);
-    for (int k = 0; k < labels.size(); k++)
+    accuracies.create(counts.size(), 1, cv::DataType<float>::type);
+    for (int k = 0; k < counts.size(); k++)
     {
-        accuracies.at<float>(k,0) = accuracy(cvx::indexMat(actuals, partitions == k),
-                                             cvx::indexMat(predictions, partitions == k));
+        accuracies.at<float>(k,0) = counts[k].accuracy();
     }
 }
 
 void accuracy(cv::Mat actuals, GridMat predictions, cv::Mat partitions, GridMat& accuracies)
 {
-    cv::Mat aux = partitions.t();
-    std::set<int> set (aux.ptr<int>(0), aux.ptr<int>(0) + aux.cols);
-    std::vector<int> labels (set.begin(), set.end());
+    actuals = intVector(actuals);
+    partitions = intVector(partitions);
+    
+    std::vector<HitCounts> counts (numOfFolds(partitions));
     
     accuracies.create(predictions.crows(), predictions.ccols());
     for (int i = 0; i < predictions.crows(); i++) for (int j = 0; j < predictions.ccols(); j++)
     {
-        cv::Mat cellAccuracies (labels.size(), 1, cv::DataType<float>::type);
-        for (int k = 0; k < labels.size(); k++)
+        cv::Mat cellPredictions = intVector(predictions.at(i,j));
+        
+        std::fill(counts.begin(), counts.end(), HitCounts());
+        countHits(actuals.ptr<int>(0), cellPredictions.ptr<int>(0), partitions.ptr<int>(0), partitions.total(), counts);
+        
+        cv::Mat cellAccuracies (counts.size(), 1, cv::DataType<float>::type);
+        for (int k = 0; k < counts.size(); k++)
         {
-            cellAccuracies.at<float>(k,0) = accuracy(cvx::indexMat(actuals, partitions == k),
-                                                     cvx::indexMat(predictions.at(i,j), partitions == k));
+            cellAccuracies.at<float>(k,0) = counts[k].accuracy();
         }
         accuracies.assign(cellAccuracies, i, j);
     }
@@ -705,4 +731,111 @@ void computeConfidenceInterval(GridMat values, cv::Mat& means, cv::Mat& confiden
 float computeF1Score(int tp, int fp, int fn)
 {
     return (2.f * tp) / (2.f * tp + fp + fn);
-}
\ No newline at end of file
+}
+
+// Contiguous column c of m, copied only when it is not already
+static cv::Mat voterColumn(cv::Mat m, int c)
+{
+    cv::Mat column = m.col(c);
+    return (m.cols == 1 && m.isContinuous()) ? column : column.clone();
+}
+
+void vote(const vector<cv::Mat>& predictions, const vector<cv::Mat>& distsToMargin,
+          cv::Mat& votedPredictions, cv::Mat& votedDistsToMargin, int flags)
+{
+    CV_Assert (!distsToMargin.empty());
+    CV_Assert (predictions.empty() || predictions.size() == distsToMargin.size());
+    
+    int n = distsToMargin[0].rows;
+    
+    // Votes and distances of either side per element, the voters added in turn
+    cv::Mat pos = cv::Mat::zeros(n, 1, cv::DataType<int>::type);
+    cv::Mat neg = cv::Mat::zeros(n, 1, cv::DataType<int>::type);
+    cv::Mat accPos = cv::Mat::zeros(n, 1, cv::DataType<float>::type);
+    cv::Mat accNeg = cv::Mat::zeros(n, 1, cv::DataType<float>::type);
+    
+    int* pPos = pos.ptr<int>();
+    int* pNeg = neg.ptr<int>();
+    float* pAccPos = accPos.ptr<float>();
+    float* pAccNeg = accNeg.ptr<float>();
+    
+    bool bNonzeroPositive = (flags & VOTE_NONZERO_POSITIVE) != 0;
+    
+    for (int v = 0; v < distsToMargin.size(); v++)
+    {
+        CV_Assert (distsToMargin[v].rows == n && distsToMargin[v].type() == cv::DataType<float>::type);
+        
+        for (int c = 0; c < distsToMargin[v].cols; c++)
+        {
+            cv::Mat d = voterColumn(distsToMargin[v], c);
+            const float* pD = d.ptr<float>();
+            
+            // The votes are branchless so that these loops vectorize
+            if (predictions.empty())
+            {
+                const int* pSign = d.ptr<int>(); // a float's sign bit is its int's one
+                for (int k = 0; k < n; k++)
+                {
+                    int bNeg = pSign[k] < 0;
+                    pNeg[k] += bNeg;
+                    pPos[k] += 1 - bNeg;
+                    pAccNeg[k] += bNeg ? pD[k] : 0.f;
+                    pAccPos[k] += bNeg ? 0.f : pD[k];
+                }
+            }
+            else
+            {
+                CV_Assert (predictions[v].rows == n && predictions[v].type() == cv::DataType<int>::type);
+                
+                cv::Mat p = voterColumn(predictions[v], c);
+                const int* pP = p.ptr<int>();
+                for (int k = 0; k < n; k++)
+                {
+                    int bNeg = pP[k] == 0;
+                    int bPos = bNonzeroPositive ? (1 - bNeg) : (pP[k] == 1);
+                    pNeg[k] += bNeg;
+                    pPos[k] += bPos;
+                    pAccNeg[k] += bNeg ? pD[k] : 0.f;
+                    pAccPos[k] += bPos ? pD[k] : 0.f;
+                }
+            }
+        }
+    }
+    
+    votedPredictions.create(n, 1, cv::DataType<int>::type);
+    votedDistsToMargin.create(n, 1, cv::DataType<float>::type);
+    
+    int* pVoted = votedPredictions.ptr<int>();
+    float* pVotedDists = votedDistsToMargin.ptr<float>();
+    
+    bool bTiePositive = (flags & VOTE_TIE_POSITIVE) != 0;
+    
+    for (int k = 0; k < n; k++)
+    {
+        float meanPos = pAccPos[k] / pPos[k];
+        float meanNeg = pAccNeg[k] / pNeg[k];
+        
+        bool bPositive;
+        if (pPos[k] != pNeg[k])
+            bPositive = pPos[k] > pNeg[k];
+        else if (bTiePositive) // most confident side, as the modality fusion did (a NaN mean breaks positive)
+            bPositive = !(meanPos < fabs(meanNeg));
+        else // most confident side
+            bPositive = meanPos > fabs(meanNeg);
+        
+        pVoted[k] = bPositive ? 1 : 0;
+        pVotedDists[k] = bPositive ? meanPos : meanNeg;
+    }
+}
+
+void vote(GridMat predictions, GridMat distsToMargin, cv::Mat& votedPredictions, cv::Mat& votedDistsToMargin, int flags)
+{
+    vector<cv::Mat> cellsPredictions, cellsDistsToMargin;
+    for (int i = 0; i < predictions.crows(); i++) for (int j = 0; j < predictions.ccols(); j++)
+    {
+        cellsPredictions.push_back(predictions.at(i,j));
+        cellsDistsToMargin.push_back(distsToMargin.at(i,j));
+    }
+    
+    vote(cellsPredictions, cellsDistsToMargin, votedPredictions, votedDistsToMargin, flags);
+}
@@ -92,5 +92,17 @@ void computeConfidenceInterval(GridMat values, cv::Mat& mean, cv::Mat& confidenc
 
 float computeF1Score(int tp, int fp, int fn);
 
+// Majority vote of the voters (modalities, grid cells, or both) on each of the n elements:
+// the side with more votes and its mean distance to the margin, the tie broken by the most
+// confident side. The voters are n x 1 columns (or the columns of n x c matrices), and are
+// accumulated one column at a time in a single pass. Predictions 0 vote negative, 1 positive,
+// others abstain. With no predictions, the distances vote by their sign
+enum { VOTE_NONZERO_POSITIVE = 1, // predictions other than 0 vote positive
+       VOTE_TIE_POSITIVE = 2 }; // equally confident sides (or a NaN mean) are broken positive
+void vote(const vector<cv::Mat>& predictions, const vector<cv::Mat>& distsToMargin,
+          cv::Mat& votedPredictions, cv::Mat& votedDistsToMargin, int flags = 0);
+void vote(GridMat predictions, GridMat distsToMargin, // the grid cells as voters
+          cv::Mat& votedPredictions, cv::Mat& votedDistsToMargin, int flags = 0);
+
 
 #endif /* defined(__segmenthreetion__StatTools__) */
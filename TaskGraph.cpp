@@ -0,0 +1,234 @@
+//
+//  TaskGraph.cpp
+//  segmenthreetion
+//
+//
+
+#include "TaskGraph.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cassert>
+#include <exception>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+//
+// ThreadBudget
+//
+
+ThreadBudget::ThreadBudget()
+: m_Size(std::max(1, (int) boost::thread::hardware_concurrency())), m_Busy(0)
+{ }
+
+ThreadBudget& ThreadBudget::getInstance()
+{
+    static ThreadBudget budget;
+    return budget;
+}
+
+void ThreadBudget::setSize(int n)
+{
+    boost::mutex::scoped_lock lock (m_Mutex);
+    m_Size = std::max(1, n);
+    m_Released.notify_all();
+}
+
+int ThreadBudget::getSize()
+{
+    boost::mutex::scoped_lock lock (m_Mutex);
+    return m_Size;
+}
+
+void ThreadBudget::acquire()
+{
+    boost::mutex::scoped_lock lock (m_Mutex);
+    while (m_Busy >= m_Size)
+        m_Released.wait(lock);
+
+    m_Busy++;
+}
+
+int ThreadBudget::tryAcquire(int n)
+{
+    boost::mutex::scoped_lock lock (m_Mutex);
+    int acquired = std::max(0, std::min(n, m_Size - m_Busy));
+    m_Busy += acquired;
+
+    return acquired;
+}
+
+void ThreadBudget::release(int n)
+{
+    boost::mutex::scoped_lock lock (m_Mutex);
+    m_Busy -= n;
+    m_Released.notify_all();
+}
+
+//
+// BorrowedThreads
+//
+
+BorrowedThreads::BorrowedThreads(int n)
+: m_NumOfThreads(ThreadBudget::getInstance().tryAcquire(n)), m_bJoined(false)
+{ }
+
+BorrowedThreads::~BorrowedThreads()
+{
+    join();
+    ThreadBudget::getInstance().release(m_NumOfThreads);
+}
+
+int BorrowedThreads::size() const
+{
+    return m_NumOfThreads;
+}
+
+void BorrowedThreads::run(boost::function<void ()> f)
+{
+    assert (m_Threads.size() < m_NumOfThreads);
+    m_Threads.create_thread(f);
+}
+
+void BorrowedThreads::join()
+{
+    if (m_bJoined) return;
+
+    m_Threads.join_all();
+    m_bJoined = true;
+}
+
+//
+// TaskGraph
+//
+
+TaskGraph::TaskGraph()
+: m_NumOfUnfinished(0), m_bSuccess(true)
+{ }
+
+int TaskGraph::addTask(std::string name, boost::function<void ()> task, std::vector<int> dependencies)
+{
+    int id = m_Tasks.size();
+
+    Task t;
+    t.name = name;
+    t.function = task;
+    t.numOfPendingDependencies = dependencies.size();
+    t.bFailed = false;
+    m_Tasks.push_back(t);
+
+    // dependencies are added before, so the graph is acyclic by construction
+    for (int i = 0; i < dependencies.size(); i++)
+    {
+        assert (dependencies[i] >= 0 && dependencies[i] < id);
+        m_Tasks[dependencies[i]].dependents.push_back(id);
+    }
+
+    return id;
+}
+
+int TaskGraph::addTask(std::string name, boost::function<void ()> task, int dependency)
+{
+    return addTask(name, task, std::vector<int>(1, dependency));
+}
+
+bool TaskGraph::run()
+{
+    m_Ready.clear();
+    for (int i = m_Tasks.size() - 1; i >= 0; i--) // the ready ones are taken from the back
+    {
+        if (m_Tasks[i].numOfPendingDependencies == 0)
+            m_Ready.push_back(i);
+    }
+
+    m_NumOfUnfinished = m_Tasks.size();
+    m_bSuccess = true;
+
+    boost::thread_group workers;
+    int nWorkers = std::min((int) m_Tasks.size(), ThreadBudget::getInstance().getSize());
+    for (int w = 0; w < nWorkers; w++)
+        workers.create_thread( boost::bind(&TaskGraph::worker, this) );
+    workers.join_all();
+
+    return m_bSuccess;
+}
+
+void TaskGraph::worker()
+{
+    while (true)
+    {
+        int id;
+        {
+            boost::mutex::scoped_lock lock (m_Mutex);
+            while (m_Ready.empty() && m_NumOfUnfinished > 0)
+                m_Changed.wait(lock);
+
+            if (m_NumOfUnfinished == 0) return;
+
+            id = m_Ready.back();
+            m_Ready.pop_back();
+        }
+
+        Task& task = m_Tasks[id];
+        if (task.bFailed)
+        {
+            std::cerr << "[TaskGraph] " << task.name << " skipped" << std::endl;
+            finish(id, false);
+            continue;
+        }
+
+        ThreadBudget::getInstance().acquire();
+
+        boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+        bool bSuccess = true;
+        try
+        {
+            TRACE_SCOPE(task.name);
+            task.function();
+        }
+        catch (std::exception& e)
+        {
+            std::cerr << "[TaskGraph] " << task.name << " failed: " << e.what() << std::endl;
+            bSuccess = false;
+        }
+        catch (...)
+        {
+            std::cerr << "[TaskGraph] " << task.name << " failed" << std::endl;
+            bSuccess = false;
+        }
+
+        ThreadBudget::getInstance().release();
+
+        if (bSuccess)
+        {
+            boost::posix_time::time_duration elapsed = boost::posix_time::microsec_clock::local_time() - start;
+            std::cout << "[TaskGraph] " << task.name << " done (" << elapsed.total_milliseconds() / 1000.0 << " s)" << std::endl;
+        }
+
+        finish(id, bSuccess);
+    }
+}
+
+void TaskGraph::finish(int id, bool bSuccess)
+{
+    boost::mutex::scoped_lock lock (m_Mutex);
+
+    const std::vector<int>& dependents = m_Tasks[id].dependents;
+    for (int i = 0; i < dependents.size(); i++)
+    {
+        Task& dependent = m_Tasks[dependents[i]];
+        if (!bSuccess)
+            dependent.bFailed = true;
+
+        if (--dependent.numOfPendingDependencies == 0)
+            m_Ready.push_back(dependents[i]);
+    }
+
+    if (!bSuccess)
+        m_bSuccess = false;
+
+    m_NumOfUnfinished--;
+    m_Changed.notify_all();
+}
@@ -0,0 +1,110 @@
+//
+//  TaskGraph.h
+//  segmenthreetion
+//
+//
+
+#ifndef __segmenthreetion__TaskGraph__
+#define __segmenthreetion__TaskGraph__
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+/*
+ * Process-wide budget of busy threads (by default, the hardware concurrency),
+ * shared by the tasks of a TaskGraph and the parallel loops they run, so that
+ * nested parallelism takes the cores idle at the moment instead of
+ * oversubscribing them. A running task holds one thread of the budget, and
+ * a parallel loop within it borrows as many free ones as it can use.
+ */
+class ThreadBudget
+{
+public:
+    static ThreadBudget& getInstance();
+
+    void setSize(int n);
+    int getSize();
+
+    void acquire(); // blocks until a thread is free
+    int tryAcquire(int n); // up to n threads without blocking, returns how many
+    void release(int n = 1);
+
+private:
+    ThreadBudget();
+
+    int m_Size;
+    int m_Busy;
+
+    boost::mutex m_Mutex;
+    boost::condition_variable m_Released;
+};
+
+/*
+ * Threads borrowed from the ThreadBudget by a parallel loop. They are joined and
+ * given back to the budget when it goes out of scope, also when the loop throws.
+ */
+class BorrowedThreads
+{
+public:
+    BorrowedThreads(int n); // up to n threads, as many as free in the budget at the moment
+    ~BorrowedThreads();
+
+    int size() const;
+
+    void run(boost::function<void ()> f); // on one more thread, up to size() of them
+    void join();
+
+private:
+    int m_NumOfThreads;
+    bool m_bJoined;
+
+    boost::thread_group m_Threads;
+};
+
+/*
+ * Directed acyclic graph of tasks. A task runs once all the tasks it depends on
+ * are done, concurrently with any other ready task, within the ThreadBudget.
+ * If a task fails (throws), the tasks depending on it are not run.
+ */
+class TaskGraph
+{
+public:
+    TaskGraph();
+
+    // Returns the id of the task, to be used in the dependencies of the following ones
+    int addTask(std::string name, boost::function<void ()> task, std::vector<int> dependencies = std::vector<int>());
+    int addTask(std::string name, boost::function<void ()> task, int dependency);
+
+    // Runs all the tasks, returns whether all of them succeeded
+    bool run();
+
+private:
+    struct Task
+    {
+        std::string name;
+        boost::function<void ()> function;
+        std::vector<int> dependents;
+        int numOfPendingDependencies;
+        bool bFailed;
+    };
+
+    void worker();
+    void finish(int id, bool bSuccess);
+
+    std::vector<Task> m_Tasks;
+
+    std::vector<int> m_Ready;
+    int m_NumOfUnfinished;
+    bool m_bSuccess;
+
+    boost::mutex m_Mutex;
+    boost::condition_variable m_Changed;
+};
+
+#endif /* defined(__segmenthreetion__TaskGraph__) */
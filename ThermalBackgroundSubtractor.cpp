@@ -11,6 +11,7 @@
 #include "ThermalBackgroundSubtractor.h"
 
 #include "StatTools.h"
+#include "MaskLabelling.h"
 #include "DebugTools.h"
 
 #include <opencv2/opencv.hpp>
@@ -35,6 +36,7 @@ void ThermalBackgroundSubtractor::getMasks(ModalityData& mdInput, ModalityData&
         minReg.loadMinCalibrationVars(calibVarDirs[scene]);
         minReg.toggleUndistortion(false);
         minReg.setUsePrevDepthPoint(true);
+        minReg.loadRegistrationTables(); // cached next to the calibration file
     
         //Duplicate depth frames (one duplicated frame per item in that frame, minimum 1 frame -if no item-)
         vector<cv::Mat> replicatedDepthFrames, depthMasksCollection;
@@ -44,20 +46,22 @@ void ThermalBackgroundSubtractor::getMasks(ModalityData& mdInput, ModalityData&
         for(unsigned int f = 0; f < mdInput.getSceneSize(scene) ; f++) {
             
             cv::Mat depthFrame = mdInput.getRegFrameInScene(scene,f);
+            cv::Mat depthMask = mdInput.getPredictedMaskInScene(scene, f);
             
-            vector<int> uniqueValues;
-            findUniqueValues(mdInput.getPredictedMaskInScene(scene, f), uniqueValues);
+            vector<LabelStats> labelsStats;
+            computeLabelStatistics(depthMask, labelsStats);
             
             nMasksPerFrame[f] = 0;
             
-            for(unsigned int m = 0; m < uniqueValues.size(); m++) {
+            for(unsigned int m = 0; m < labelsStats.size(); m++) {
                 replicatedDepthFrames.push_back(depthFrame);
-                depthMasksCollection.push_back(mdInput.getPredictedMaskInScene(scene, f, m));
+                depthMasksCollection.push_back(depthMask == labelsStats[m].label);
                 nMasksPerFrame[f]++;
             }
             
             if(nMasksPerFrame[f] == 0) {
                 replicatedDepthFrames.push_back(depthFrame);
+                depthMasksCollection.push_back(cv::Mat::zeros(depthMask.size(), CV_8UC1));
                 nMasksPerFrame[f] = 1;
             }
             
@@ -85,35 +89,9 @@ void ThermalBackgroundSubtractor::getMasks(ModalityData& mdInput, ModalityData&
                 
                 nItem++;
                 index++;
-                
-                //Debug purposes - show mask unique values
-                vector<int> uniqueValues;
-                findUniqueValues(mask, uniqueValues);
-                //for (auto c : uniqueValues)
-                //    cout << c << ' ';
-                
-                findUniqueValues(valuedMask, uniqueValues);
-                //for (auto c : uniqueValues)
-                //    cout << c << ' ';
-                
-                //Debug -  visualization purposes
-                cv::imshow("output", mask);
-                cv::waitKey(10);
             }
             
-            
             masks.push_back(valuedMask);
-            
-            //Debug - visualization purposes
-            cv::imshow("final mask", valuedMask);
-            
-            //Debug purposes - show mask unique values
-            vector<int> uniqueValues;
-            findUniqueValues(valuedMask, uniqueValues);
-            //for (auto c : uniqueValues)
-            //    cout << c << ' ';
-            
-            cout << endl;
         }
     
     }
@@ -132,18 +110,23 @@ void ThermalBackgroundSubtractor::getBoundingRects(ModalityData& mdInput, Modali
     
     for(unsigned int f = 0; f < mdOutput.getFrames().size(); f++) {
         
-        vector<int> uniqueValuesDepthMask;
         cv::Mat predMask = mdInput.getPredictedMask(f);
-        findUniqueValues(predMask, uniqueValuesDepthMask);
-        uniqueValuesDepthMask.erase(std::remove(uniqueValuesDepthMask.begin(), uniqueValuesDepthMask.end(), 0), uniqueValuesDepthMask.end());
+        
+        // Labels in the depth mask, and their registered regions in the thermal one
+        vector<LabelStats> depthLabelsStats, thermalLabelsStats;
+        vector<int> thermalLookup;
+        computeLabelStatistics(predMask, depthLabelsStats);
+        computeLabelStatistics(mdOutput.getPredictedMask(f), thermalLabelsStats, thermalLookup);
         
         vector<cv::Rect> bbDepth = mdInput.getPredictedBoundingRectsInFrame(f);
                 
-        for(unsigned int i = 0; i < uniqueValuesDepthMask.size(); i++)
+        for(unsigned int i = 0; i < depthLabelsStats.size(); i++)
         {
             cv::Rect bigBoundingBox;
             vector<cv::Rect> maskBoundingBoxes;
-            this->getMaskBoundingBoxes(mdOutput.getPredictedMask(f,i), maskBoundingBoxes);
+            int t = thermalLookup[(this->getMasksOffset() + i) & 0xFF];
+            if (t >= 0)
+                maskBoundingBoxes.push_back(thermalLabelsStats[t].boundingRect);
             
             if(!maskBoundingBoxes.empty())
             {
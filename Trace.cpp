@@ -0,0 +1,253 @@
+//
+//  Trace.cpp
+//  segmenthreetion
+//
+//
+
+#include "Trace.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#ifdef SEGMENTHREETION_TRACE
+#include "AllocationCounter.h"
+#endif
+
+namespace
+{
+    boost::posix_time::ptime g_Epoch = boost::posix_time::microsec_clock::universal_time();
+
+    std::string escape(std::string s)
+    {
+        std::string escaped;
+        for (int i = 0; i < s.size(); i++)
+        {
+            if (s[i] == '"' || s[i] == '\\') escaped += '\\';
+            escaped += s[i];
+        }
+        return escaped;
+    }
+
+    struct ScopeSummary
+    {
+        std::string name;
+        long calls;
+        long long duration, selfDuration; // microseconds
+        long items, bytes;
+        long allocations, allocatedBytes;
+
+        bool operator<(const ScopeSummary& other) const { return duration > other.duration; } // longest first
+    };
+}
+
+Trace::Trace()
+: m_pThreadTrace(&Trace::keepThreadTrace)
+{ }
+
+Trace::~Trace()
+{
+    if (m_OutputFile.empty())
+        return;
+
+    if (save(m_OutputFile))
+        std::cout << "[Trace] Saved to " << m_OutputFile << std::endl;
+    summarize(std::cout);
+}
+
+Trace& Trace::getInstance()
+{
+    static Trace trace;
+    return trace;
+}
+
+void Trace::setOutputFile(std::string file)
+{
+    boost::mutex::scoped_lock lock (m_Mutex);
+    m_OutputFile = file;
+}
+
+long long Trace::now()
+{
+    return (boost::posix_time::microsec_clock::universal_time() - g_Epoch).total_microseconds();
+}
+
+Trace::ThreadTrace& Trace::getThreadTrace()
+{
+    ThreadTrace* pThreadTrace = m_pThreadTrace.get();
+    if (pThreadTrace == NULL)
+    {
+        boost::mutex::scoped_lock lock (m_Mutex);
+
+        boost::shared_ptr<ThreadTrace> pNew (new ThreadTrace);
+        pNew->id = m_Threads.size();
+        m_Threads.push_back(pNew);
+
+        pThreadTrace = pNew.get();
+        m_pThreadTrace.reset(pThreadTrace);
+    }
+
+    return *pThreadTrace;
+}
+
+void Trace::begin(std::string name)
+{
+    ThreadTrace& thread = getThreadTrace();
+
+    Event e;
+    e.name = name;
+    e.duration = -1;
+    e.items = e.bytes = 0;
+    e.depth = thread.open.size();
+
+    thread.open.push_back(thread.events.size());
+    thread.events.push_back(e);
+
+    // Last, so that the trace's own bookkeeping is left out
+    Event& event = thread.events.back();
+#ifdef SEGMENTHREETION_TRACE
+    event.allocations = AllocationCounter::getThreadNumOfAllocations();
+    event.allocatedBytes = AllocationCounter::getThreadAllocatedBytes();
+#else
+    event.allocations = event.allocatedBytes = 0;
+#endif
+    event.start = now();
+}
+
+void Trace::end()
+{
+    long long t = now();
+
+    ThreadTrace& thread = getThreadTrace();
+    if (thread.open.empty())
+        return;
+
+    Event& event = thread.events[thread.open.back()];
+    thread.open.pop_back();
+
+    event.duration = t - event.start;
+#ifdef SEGMENTHREETION_TRACE
+    event.allocations = AllocationCounter::getThreadNumOfAllocations() - event.allocations;
+    event.allocatedBytes = AllocationCounter::getThreadAllocatedBytes() - event.allocatedBytes;
+#endif
+}
+
+void Trace::addItems(long n)
+{
+    ThreadTrace& thread = getThreadTrace();
+    if (!thread.open.empty())
+        thread.events[thread.open.back()].items += n;
+}
+
+void Trace::addBytes(long n)
+{
+    ThreadTrace& thread = getThreadTrace();
+    if (!thread.open.empty())
+        thread.events[thread.open.back()].bytes += n;
+}
+
+bool Trace::save(std::string file)
+{
+    std::ofstream ofs (file.c_str());
+    if (!ofs.is_open())
+    {
+        std::cerr << "[Trace] Could not open " << file << std::endl;
+        return false;
+    }
+
+    boost::mutex::scoped_lock lock (m_Mutex);
+
+    ofs << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << std::endl;
+
+    bool bFirst = true;
+    for (int t = 0; t < m_Threads.size(); t++)
+    {
+        const std::vector<Event>& events = m_Threads[t]->events;
+        for (int i = 0; i < events.size(); i++)
+        {
+            const Event& e = events[i];
+            if (e.duration < 0) continue; // still open
+
+            ofs << (bFirst ? "" : ",\n")
+                << "{\"name\": \"" << escape(e.name) << "\", \"cat\": \"segmenthreetion\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << m_Threads[t]->id
+                << ", \"ts\": " << e.start << ", \"dur\": " << e.duration
+                << ", \"args\": {\"items\": " << e.items << ", \"bytes\": " << e.bytes
+                << ", \"allocations\": " << e.allocations << ", \"allocated_bytes\": " << e.allocatedBytes << "}}";
+            bFirst = false;
+        }
+    }
+
+    ofs << std::endl << "]}" << std::endl;
+
+    return true;
+}
+
+void Trace::summarize(std::ostream& os)
+{
+    boost::mutex::scoped_lock lock (m_Mutex);
+
+    std::map<std::string, ScopeSummary> summaries;
+
+    for (int t = 0; t < m_Threads.size(); t++)
+    {
+        const std::vector<Event>& events = m_Threads[t]->events;
+
+        // The self time of a scope is its time minus its children's (the scopes one level deeper within it)
+        std::vector<long long> childrenDurations (events.size(), 0);
+        std::vector<int> parents;
+        for (int i = 0; i < events.size(); i++)
+        {
+            while (parents.size() > events[i].depth) parents.pop_back();
+            if (!parents.empty() && events[i].duration >= 0)
+                childrenDurations[parents.back()] += events[i].duration;
+            parents.push_back(i);
+        }
+
+        for (int i = 0; i < events.size(); i++)
+        {
+            const Event& e = events[i];
+            if (e.duration < 0) continue;
+
+            std::map<std::string, ScopeSummary>::iterator it = summaries.find(e.name);
+            if (it == summaries.end())
+            {
+                ScopeSummary s = { e.name, 0, 0, 0, 0, 0, 0, 0 };
+                it = summaries.insert(std::make_pair(e.name, s)).first;
+            }
+
+            ScopeSummary& s = it->second;
+            s.calls++;
+            s.duration += e.duration;
+            s.selfDuration += e.duration - childrenDurations[i];
+            s.items += e.items;
+            s.bytes += e.bytes;
+            s.allocations += e.allocations;
+            s.allocatedBytes += e.allocatedBytes;
+        }
+    }
+
+    std::vector<ScopeSummary> sorted;
+    for (std::map<std::string, ScopeSummary>::iterator it = summaries.begin(); it != summaries.end(); ++it)
+        sorted.push_back(it->second);
+    std::sort(sorted.begin(), sorted.end());
+
+    double elapsed = now() / 1e6;
+
+    char line[256];
+    snprintf(line, sizeof(line), "%-40s %8s %12s %12s %6s %12s %12s %10s %12s %10s",
+             "Scope", "Calls", "Total (s)", "Self (s)", "Run %", "Items", "Items/s", "Read (MB)", "Allocs", "Alloc (MB)");
+    os << "[Trace] " << elapsed << " s since the start" << std::endl << line << std::endl;
+
+    for (int i = 0; i < sorted.size(); i++)
+    {
+        const ScopeSummary& s = sorted[i];
+        double seconds = s.duration / 1e6;
+        snprintf(line, sizeof(line), "%-40s %8ld %12.3f %12.3f %6.1f %12ld %12.1f %10.1f %12ld %10.1f",
+                 s.name.substr(0, 40).c_str(), s.calls, seconds, s.selfDuration / 1e6, 100 * seconds / elapsed,
+                 s.items, seconds > 0 ? s.items / seconds : 0.0, s.bytes / 1e6, s.allocations, s.allocatedBytes / 1e6);
+        os << line << std::endl;
+    }
+}
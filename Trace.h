@@ -0,0 +1,107 @@
+//
+//  Trace.h
+//  segmenthreetion
+//
+//
+
+#ifndef __segmenthreetion__Trace__
+#define __segmenthreetion__Trace__
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+
+/*
+ * Hierarchical trace of the hot stages. A scope records its wall time, the thread
+ * running it, the items it processed and the bytes it read (as told by the scope),
+ * and the heap allocations made meanwhile by the thread (see AllocationCounter).
+ * The scopes nest, so a stage's time can be broken down by its sub-stages:
+ *
+ *   void FeatureExtractor::describe(ModalityGridData& data)
+ *   {
+ *       TRACE_SCOPE("FeatureExtractor::describe");
+ *       TRACE_ITEMS(data.getGridsFrames().size());
+ *       ...
+ *   }
+ *
+ * At exit, the trace is saved as a Chrome trace (chrome://tracing, Perfetto) to
+ * the file given to TRACE_OUTPUT, and summarized per scope name in a table.
+ *
+ * The macros are compiled out unless SEGMENTHREETION_TRACE is defined (and
+ * AllocationCounter.cpp linked), so that the untraced builds pay nothing.
+ */
+class Trace
+{
+public:
+    static Trace& getInstance();
+
+    void setOutputFile(std::string file); // saved at exit, none if empty
+
+    void begin(std::string name);
+    void end();
+
+    // To the innermost scope open in the calling thread
+    void addItems(long n);
+    void addBytes(long n);
+
+    bool save(std::string file);
+    void summarize(std::ostream& os);
+
+private:
+    Trace();
+    ~Trace();
+
+    struct Event
+    {
+        std::string name;
+        long long start, duration; // microseconds since the trace began
+        long items, bytes;
+        long allocations, allocatedBytes;
+        int depth;
+    };
+
+    struct ThreadTrace
+    {
+        int id;
+        std::vector<Event> events;
+        std::vector<int> open; // indices of the events not ended yet
+    };
+
+    ThreadTrace& getThreadTrace();
+    static void keepThreadTrace(ThreadTrace*) {} // the threads' traces are owned by the Trace, not by the threads
+    long long now();
+
+    std::string m_OutputFile;
+
+    // The threads' traces outlive them, until saved at exit
+    std::vector<boost::shared_ptr<ThreadTrace> > m_Threads;
+    boost::thread_specific_ptr<ThreadTrace> m_pThreadTrace;
+    boost::mutex m_Mutex;
+};
+
+class TraceScope
+{
+public:
+    TraceScope(std::string name) { Trace::getInstance().begin(name); }
+    ~TraceScope() { Trace::getInstance().end(); }
+};
+
+#ifdef SEGMENTHREETION_TRACE
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__) (name)
+#define TRACE_ITEMS(n) Trace::getInstance().addItems(n)
+#define TRACE_BYTES(n) Trace::getInstance().addBytes(n)
+#define TRACE_OUTPUT(file) Trace::getInstance().setOutputFile(file)
+#else
+#define TRACE_SCOPE(name)
+#define TRACE_ITEMS(n)
+#define TRACE_BYTES(n)
+#define TRACE_OUTPUT(file)
+#endif
+
+#endif /* defined(__segmenthreetion__Trace__) */
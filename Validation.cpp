@@ -9,9 +9,15 @@
 #include "Validation.h"
 #include "StatTools.h"
 #include "CvExtraTools.h"
+#include "MaskLabelling.h"
+#include "ParallelFor.h"
+#include "Trace.h"
 
 #include <iomanip>
 
+#include <boost/bind.hpp>
+#include <boost/thread/mutex.hpp>
+
 
 using namespace std;
 
@@ -47,6 +53,8 @@ void Validation::getOverlap(ModalityData& md, cv::Mat& overlapIDs)
 }
 
 void Validation::getOverlap(vector<cv::Mat>& predictedMasks, vector<cv::Mat>& gtMasks, vector<int>& dcRange, cv::Mat& overlapIDs) {
+    TRACE_SCOPE("Validation::getOverlap");
+    TRACE_ITEMS(predictedMasks.size());
     
     for(int f = 0; f < predictedMasks.size(); f++)
     {
@@ -62,18 +70,11 @@ void Validation::getOverlap(vector<cv::Mat>& predictedMasks, vector<cv::Mat>& gt
             if((cv::countNonZero(gtMasks[f]) == 0 && cv::countNonZero(predictedMasks[f]) > 0)
                || cv::countNonZero(gtMasks[f]) > 0)
             {
-                cv::Mat emptyDontCare;
-                overlapIDs.at<float>(f,0) = getMaskOverlap(predictedMasks[f], gtMasks[f], emptyDontCare);
+                vector<float> overlaps;
+                getMaskOverlaps(predictedMasks[f], gtMasks[f], dcRange, overlaps);
                 
-                for(int dc = 0; dc < dcRange.size(); dc++)
-                {
-                    cv::Mat dontCare;
-                    createDontCareRegion(gtMasks[f], dontCare, dcRange[dc]);
-                    //threshold(dontCare, dontCare, 128, 255, CV_THRESH_BINARY);
-                    
-                    overlapIDs.at<float>(f,dc+1) = getMaskOverlap(predictedMasks[f], gtMasks[f], dontCare);
-                    dontCare.release();
-                }
+                for(int i = 0; i < overlaps.size(); i++)
+                    overlapIDs.at<float>(f,i) = overlaps[i];
             }
             //debug
             /*cout << "overlap f: " << f << " : ";
@@ -135,6 +136,108 @@ void Validation::createOverlapPartitions(cv::Mat& partitions, cv::Mat& overlapID
 }
 
 
+/*
+ * Frames to evaluate and per-fold accumulators, shared by the threads of the overlap loop
+ */
+struct Validation::OverlapJobs
+{
+    vector<string> predictionFiles, masksFiles, gtMasksFiles; // all the scenes, in partitions' order
+    vector<int> folds, positionsInFold;
+    
+    vector<cv::Mat> partitionedOverlapIDs; // (frames in fold) x (dcRange + 1)
+    vector<vector<double> > overlapSums;
+    vector<vector<int> > validCounts;
+    
+    boost::mutex mutex; // for the accumulators
+};
+
+void Validation::getPartitionedOverlap(ModalityReader& reader, string predictionType, string modality, vector<string> scenePaths, const char* filetype,
+                                       cv::Mat& partitions, vector<cv::Mat>& partitionedOverlapIDs, cv::Mat& partitionedMeanOverlap)
+{
+    TRACE_SCOPE("Validation::getPartitionedOverlap (" + modality + ")");
+    
+    OverlapJobs jobs;
+    
+    for (int s = 0; s < scenePaths.size(); s++)
+    {
+        vector<string> predictionFiles, masksFiles, gtMasksFiles;
+        reader.overlapreadSceneFilenames(predictionType, modality, scenePaths[s], filetype, predictionFiles, masksFiles, gtMasksFiles);
+        
+        jobs.predictionFiles.insert(jobs.predictionFiles.end(), predictionFiles.begin(), predictionFiles.end());
+        jobs.masksFiles.insert(jobs.masksFiles.end(), masksFiles.begin(), masksFiles.end());
+        jobs.gtMasksFiles.insert(jobs.gtMasksFiles.end(), gtMasksFiles.begin(), gtMasksFiles.end());
+    }
+    
+    CV_Assert (jobs.masksFiles.size() == partitions.rows);
+    
+    // Place of every frame within its fold
+    int nFolds = 0;
+    for (int m = 0; m < partitions.rows; m++)
+        nFolds = max(nFolds, partitions.at<int>(m,0) + 1);
+    
+    vector<int> foldSizes (nFolds, 0);
+    for (int m = 0; m < partitions.rows; m++)
+    {
+        jobs.folds.push_back(partitions.at<int>(m,0));
+        jobs.positionsInFold.push_back(foldSizes[jobs.folds.back()]++);
+    }
+    
+    int nConfigs = m_DontCareRange.size() + 1;
+    for (int f = 0; f < nFolds; f++)
+    {
+        jobs.partitionedOverlapIDs.push_back(cv::Mat(foldSizes[f], nConfigs, CV_32FC1, NAN));
+        jobs.overlapSums.push_back(vector<double>(nConfigs, 0.0));
+        jobs.validCounts.push_back(vector<int>(nConfigs, 0));
+    }
+    
+    // The first error of the frames (e.g. a missing mask) is rethrown here
+    parallelFor(partitions.rows, boost::bind(&Validation::overlapFrame, this, boost::ref(reader), boost::ref(jobs), _1));
+    
+    partitionedOverlapIDs = jobs.partitionedOverlapIDs;
+    
+    partitionedMeanOverlap = cv::Mat(nFolds, nConfigs, CV_32FC1);
+    for (int p = 0; p < nFolds; p++)
+    {
+        for (int c = 0; c < nConfigs; c++)
+            partitionedMeanOverlap.at<float>(p,c) = jobs.overlapSums[p][c] / jobs.validCounts[p][c];
+        
+        cout << "Mean overlap partition " << p << ":";
+        for(int i = 0; i < partitionedMeanOverlap.cols; i++)
+        {
+            cout << std::setprecision(6) << partitionedMeanOverlap.at<float>(p,i) << " ";
+        }
+        cout << endl;
+    }
+}
+
+void Validation::overlapFrame(ModalityReader& reader, OverlapJobs& jobs, int i)
+{
+    TRACE_SCOPE("Validation::overlapFrame");
+    
+    cv::Mat predictedMask, gtMask;
+    reader.overlapreadFrame(jobs.predictionFiles[i], jobs.masksFiles[i], jobs.gtMasksFiles[i], predictedMask, gtMask);
+    TRACE_ITEMS(1);
+    
+    if (cv::countNonZero(gtMask) == 0 && cv::countNonZero(predictedMask) == 0)
+        return; // nothing to evaluate, the row stays NaN
+    
+    vector<float> overlaps;
+    getMaskOverlaps(predictedMask, gtMask, m_DontCareRange, overlaps);
+    
+    boost::mutex::scoped_lock lock (jobs.mutex);
+    
+    int fold = jobs.folds[i];
+    for (int c = 0; c < overlaps.size(); c++)
+    {
+        jobs.partitionedOverlapIDs[fold].at<float>(jobs.positionsInFold[i], c) = overlaps[c];
+        if (cv::checkRange(overlaps[c]))
+        {
+            jobs.overlapSums[fold][c] += overlaps[c];
+            jobs.validCounts[fold][c]++;
+        }
+    }
+}
+
 void Validation::getMeanOverlap(vector<cv::Mat> partitionedOverlapIDs, cv::Mat& partitionedMeanOverlap)
 {
     partitionedMeanOverlap.release();
@@ -176,286 +279,221 @@ void Validation::getMeanOverlap(vector<cv::Mat> partitionedOverlapIDs, cv::Mat&
 }
 
 /*
- * Get overlap value between predicted mask and ground truth mask based on Jaccard Similarity/Index
+ * Disjoint-set forest over the labels of the predicted (0-255) and ground truth (256-511) masks
  */
-float Validation::getMaskOverlap(cv::Mat& predictedMask, cv::Mat& gtMask, cv::Mat& dontCareRegion)
+class LabelUnionFind
 {
+public:
+    LabelUnionFind() { for (int i = 0; i < 512; i++) m_Parent[i] = i; }
+    
+    int find(int i)
+    {
+        while (m_Parent[i] != i)
+            i = m_Parent[i] = m_Parent[m_Parent[i]];
+        return i;
+    }
     
-    // imshow("gtMask", gtMask);
-    // imshow("predictedMask", predictedMask);
-    cv::waitKey(10);
+    void join(int i, int j) { m_Parent[find(i)] = find(j); }
     
-    bool useDontCare = false;
-    if(!dontCareRegion.empty()) useDontCare = true;
+private:
+    int m_Parent[512];
+};
+
+/*
+ * Get overlap values between predicted mask and ground truth mask based on Jaccard Similarity/Index. The first value
+ * is computed on the whole masks, and the following ones outside the don't care region of each dcRange value.
+ *
+ * The masks are swept once to build the contingency table of (predicted label, ground truth label, don't care level)
+ * pixel counts, where the level of a pixel is the number of dcRange values for which it is not don't care, i.e. smaller
+ * than its distance to the ground truth boundary. A pixel thus counts for the i-th smallest range iff its level is greater than i.
+ * Ground truth persons and predicted blobs that overlap are then merged into regions by union-find over the table,
+ * and every region contributes with its intersection over union, computed from the same table for every dcRange value.
+ */
+void Validation::getMaskOverlaps(cv::Mat& predictedMask, cv::Mat& gtMask, vector<int>& dcRange, vector<float>& overlaps)
+{
+    CV_Assert (predictedMask.type() == CV_8UC1 && gtMask.type() == CV_8UC1 && predictedMask.size() == gtMask.size());
     
-    float overlap = 0.0;
-    int nBB = 0;
-    vector<float> overlapIDs;
+    int nConfigs = dcRange.size() + 1;
     
-    vector<int> gtMaskPersonID;
-    findUniqueValues(gtMask, gtMaskPersonID);
-    gtMaskPersonID.erase(std::remove(gtMaskPersonID.begin(), gtMaskPersonID.end(), 0), gtMaskPersonID.end());
+    // Levels of the pixels, looked up from their distance to the boundary, and position of every range in ascending order
+    cv::Mat distance, absDistance, levels;
+    createBoundaryDistance(gtMask, distance);
+    cv::Mat(cv::abs(distance)).convertTo(absDistance, CV_8UC1); // saturated, farther pixels are never don't care
     
-    //labeled_result_mask: we already have one label per blob (200, 201, 202....)
-    vector<int> predictedMaskPersonID;
-    findUniqueValues(predictedMask, predictedMaskPersonID);
-    predictedMaskPersonID.erase(std::remove(predictedMaskPersonID.begin(), predictedMaskPersonID.end(), 0), predictedMaskPersonID.end());
+    cv::Mat levelsLUT (1, 256, CV_8UC1);
+    for (int d = 0; d < 256; d++)
+    {
+        int level = 0;
+        for (int dc = 0; dc < dcRange.size(); dc++)
+            if (d > dcRange[dc]) level++;
+        levelsLUT.at<unsigned char>(0,d) = level;
+    }
+    cv::LUT(absDistance, levelsLUT, levels);
     
-    if(!predictedMaskPersonID.empty())
+    vector<int> rank (dcRange.size());
+    for (int dc = 0; dc < dcRange.size(); dc++)
     {
-        std::vector<int>::iterator gtID = gtMaskPersonID.begin();
-        while (gtID != gtMaskPersonID.end())
+        rank[dc] = 0;
+        for (int other = 0; other < dcRange.size(); other++)
+            if (dcRange[other] < dcRange[dc] || (dcRange[other] == dcRange[dc] && other < dc)) rank[dc]++;
+    }
+    
+    // 1. Single sweep: pixel counts per (predicted, ground truth) pair and level
+    vector<int> pairIndices (256 * 256, -1);
+    vector<int> pairs; // (predicted << 8) | ground truth
+    vector<int> levelCounts;
+    
+    for (int r = 0; r < gtMask.rows; r++)
+    {
+        const unsigned char* pPtr = predictedMask.ptr<unsigned char>(r);
+        const unsigned char* gPtr = gtMask.ptr<unsigned char>(r);
+        const unsigned char* lPtr = levels.ptr<unsigned char>(r);
+        
+        for (int c = 0; c < gtMask.cols; c++)
         {
-            int id  = *gtID;
-            cv::Mat person = (gtMask == id);
-            //threshold(person, person, 128, 255, CV_THRESH_BINARY);
-            //imshow("person", person);
-            
-            vector<int> personsInBlob;
-            personsInBlob.push_back(id);
-            
-            vector<int> labelsOverlap;
-            cv::Mat resultRegionMask;
-            
-            bool allChecked = false;
-            while(!allChecked)
-            {
-                
-                vector<int> personsGt;
-                personsGt.insert(personsGt.end(), personsInBlob.begin(), personsInBlob.end());
-                
-                /* 1. Check if there is more than one person inside a region.
-                 *    Check to which blob id corresponds that person id.
-                 */
-                bool gtChecked = false;
-                while(!gtChecked)
-                {
-                    vector<int> regionIDs;
-                    cv::Mat maskedLabeledGtMask;
-                    gtMask.copyTo(maskedLabeledGtMask, person);
-                    findUniqueValues(maskedLabeledGtMask, regionIDs);
-                    regionIDs.erase(std::remove(regionIDs.begin(), regionIDs.end(), 0), regionIDs.end());
-                    
-                    for(int i = 0 ; i < regionIDs.size(); i++)
-                    {
-                        vector<int> uniqueIDs;
-                        cv::Mat gtMaskContainingID = (gtMask == regionIDs[i]);
-                        
-                        for(int r = 0; r < gtMaskContainingID.rows; r++) for(int c = 0; c < gtMaskContainingID.cols; c++)
-                        {
-                            if(gtMaskContainingID.at<uchar>(r,c) == 255)
-                                gtMaskContainingID.at<uchar>(r,c) = regionIDs[i];
-                        }
-                        
-                        findUniqueValues(gtMaskContainingID, uniqueIDs);
-                        uniqueIDs.erase(std::remove(uniqueIDs.begin(), uniqueIDs.end(), 0), uniqueIDs.end());
-                        personsInBlob.insert(personsInBlob.end(), uniqueIDs.begin(), uniqueIDs.end());
-                    }
-                    
-                    findUniqueValues(personsInBlob, personsInBlob);
-                    
-                    if(personsGt.size() != personsInBlob.size())
-                    {
-                        person.release();
-                        person = cv::Mat::zeros(gtMask.rows, gtMask.cols, CV_8UC1);
-                        for(int i = 0; i < personsInBlob.size(); i++)
-                        {
-                            add(person, gtMask == personsInBlob[i], person);
-                        }
-                        //threshold(person, person, 128, 255, CV_THRESH_BINARY);
-                        //imshow("person", person);
-                        cv::waitKey(10);
-                        
-                        personsGt.clear();
-                        personsGt.insert(personsGt.end(), personsInBlob.begin(), personsInBlob.end());
-                    }
-                    else {
-                        gtChecked = true;
-                    }
-                    
-                }
-                
-                /*
-                 * 2. Check if result region corresponds to > 1 person id in GT
-                 */
-                cv::Mat overlap;
-                predictedMask.copyTo(overlap, person);
-                
-                labelsOverlap.clear();
-                findUniqueValues(overlap, labelsOverlap);
-                labelsOverlap.erase(remove(labelsOverlap.begin(), labelsOverlap.end(), 0), labelsOverlap.end());
-                
-                resultRegionMask.release();
-                resultRegionMask = cv::Mat::zeros(gtMask.rows, gtMask.cols, CV_8UC1);
-                for(int i = 0; i < labelsOverlap.size(); i++)
-                {
-                    add(resultRegionMask, predictedMask == labelsOverlap[i], resultRegionMask);
-                }
-                //threshold(resultRegionMask,resultRegionMask,128,255,CV_THRESH_BINARY);
-                //imshow("resultRegionMask", resultRegionMask);
-                cv::waitKey(10);
-                
-                cv::Mat gtRegionsOverlap;
-                gtMask.copyTo(gtRegionsOverlap,resultRegionMask);
-                
-                vector<int> gtPersonsOverlap;
-                findUniqueValues(gtRegionsOverlap, gtPersonsOverlap);
-                gtPersonsOverlap.erase(remove(gtPersonsOverlap.begin(), gtPersonsOverlap.end(), 0), gtPersonsOverlap.end());
-                
-                if (gtPersonsOverlap.empty() || gtPersonsOverlap.size() == personsInBlob.size())
-                {
-                    allChecked = true;
-                }
-                else
-                {
-                    set<int> s_gtPersonsOverlap (gtPersonsOverlap.begin(), gtPersonsOverlap.end());
-                    set<int> s_personsInBlob (personsInBlob.begin(), personsInBlob.end());
-                    vector<int> newPersons;
-                    
-                    set_difference(s_gtPersonsOverlap.begin(), s_gtPersonsOverlap.end(), s_personsInBlob.begin(), s_personsInBlob.end(), back_inserter(newPersons));
-                    
-                    //person.release();
-                    //person = cv::Mat::zeros(gtMask.rows, gtMask.cols, CV_8UC1);
-                    for(int i = 0; i < newPersons.size(); i++)
-                    {
-                        add(person, gtMask == newPersons[i], person);
-                    }
-                    //threshold(person, person, 128, 255, CV_THRESH_BINARY);
-                    //imshow("person2", person);
-                    cv::waitKey(10);
-                    
-                    personsInBlob.insert(personsInBlob.end(), newPersons.begin(), newPersons.end());
-                    
-                    overlap.release();
-                    predictedMask.copyTo(overlap, person);
-                    
-                }
-            }
-            
-            cv::Mat auxOverlap;
-            predictedMask.copyTo(auxOverlap, person);
-            if (cv::countNonZero(auxOverlap) > 0)
-            {
-                std::vector<int>::iterator it;
-                for(int i = 0; i < labelsOverlap.size(); i++)
-                {
-                    it = find(predictedMaskPersonID.begin(), predictedMaskPersonID.end(), labelsOverlap[i]);
-                    predictedMaskPersonID.erase(it);
-                    
-                }
-                
-                std::vector<int>::iterator it2;
-                for(int i = 0; i < personsInBlob.size(); i++)
-                {
-                    it2 = find(gtMaskPersonID.begin(), gtMaskPersonID.end(), personsInBlob[i]);
-                    gtMaskPersonID.erase(it2);
-                }
-                
-                if(useDontCare)
-                {
-                    person = person & dontCareRegion;
-                    resultRegionMask = resultRegionMask & dontCareRegion;
-                    
-                }
-                //debug
-                //   cv::imshow("person after dontcare", person);
-                //   cv::imshow("resultRegionMask after dontcare", resultRegionMask);
-                cv::waitKey(10);
-                
-                //Compute intersection and union
-                float intersectArea = 0.0, unionArea = 0.0;
-                
-                cv::Mat intersection, unio;
-                cv::bitwise_and(person, resultRegionMask, intersection);
-                cv::bitwise_or(person, resultRegionMask, unio);
-                
-                //debug
-                //cv::imshow("intersection", intersection);
-                //cv::imshow("union", unio);
-                cv::waitKey(10);
-                
-                intersectArea = cv::countNonZero(intersection);
-                unionArea = cv::countNonZero(unio);
-                
-                if(unionArea > 0) {
-                    nBB++;
-                    overlapIDs.push_back(float(intersectArea/unionArea));
-                }
-                
-                person.release();
-                resultRegionMask.release();
-                intersection.release();
-                unio.release();
-                auxOverlap.release();
-            }
-            else
+            int key = (pPtr[c] << 8) | gPtr[c];
+            if (pairIndices[key] < 0)
             {
-                nBB++;
-                overlapIDs.push_back(0.0);
-                
-                std::vector<int>::iterator it2;
-                for(int i = 0; i < personsInBlob.size(); i++)
-                {
-                    it2 = find(gtMaskPersonID.begin(), gtMaskPersonID.end(), personsInBlob[i]);
-                    gtMaskPersonID.erase(it2);
-                }
+                pairIndices[key] = pairs.size();
+                pairs.push_back(key);
+                levelCounts.resize(levelCounts.size() + nConfigs, 0);
             }
-            
-            cv::destroyAllWindows();
+            levelCounts[pairIndices[key] * nConfigs + lPtr[c]]++;
         }
+    }
+    
+    // Counts per configuration (0: whole masks, dc+1: outside the don't care region of dcRange[dc]),
+    // from the suffix sums of the level counts
+    int nPairs = pairs.size();
+    vector<int> counts (nPairs * nConfigs);
+    
+    for (int i = 0; i < nPairs; i++)
+    {
+        vector<int> suffix (nConfigs + 1, 0);
+        for (int l = nConfigs - 1; l >= 0; l--)
+            suffix[l] = suffix[l+1] + levelCounts[i * nConfigs + l];
         
-        int nUnassignedRegions = predictedMaskPersonID.size();
+        counts[i * nConfigs] = suffix[0];
+        for (int dc = 0; dc < dcRange.size(); dc++)
+            counts[i * nConfigs + dc + 1] = suffix[rank[dc] + 1];
+    }
+    
+    // Areas of every label in every configuration
+    vector<int> predictedAreas (256 * nConfigs, 0), gtAreas (256 * nConfigs, 0);
+    vector<bool> bPredictedPresent (256, false), bGtPresent (256, false);
+    
+    for (int i = 0; i < nPairs; i++)
+    {
+        int p = pairs[i] >> 8;
+        int g = pairs[i] & 0xFF;
         
-        if(nUnassignedRegions > 0)
+        bPredictedPresent[p] = bGtPresent[g] = true;
+        for (int k = 0; k < nConfigs; k++)
         {
-            vector<int> unassignedRegions (nUnassignedRegions);
-            std::fill(unassignedRegions.begin(), unassignedRegions.end(), 0.0);
-            
-            overlapIDs.insert(overlapIDs.end(), unassignedRegions.begin(), unassignedRegions.end());
-            
-            nBB = nBB + nUnassignedRegions;
-            
-        }
-        
-        if(nBB > 0) {
-            overlap = std::accumulate(overlapIDs.begin(), overlapIDs.end(), 0.0)/nBB;
-        } else {
-            overlap = NAN;
+            predictedAreas[p * nConfigs + k] += counts[i * nConfigs + k];
+            gtAreas[g * nConfigs + k] += counts[i * nConfigs + k];
         }
     }
     
-    cv::destroyAllWindows();
-    overlapIDs.clear();
-    gtMaskPersonID.clear();
-    predictedMaskPersonID.clear();
+    overlaps.assign(nConfigs, 0.0);
     
-    return overlap;
-}
-
-void Validation::createDontCareRegion(cv::Mat& inputMask, cv::Mat& outputMask, int size)
-{
-    cv::Mat mask1, mask2;
-    inputMask.copyTo(mask1);
-    inputMask.copyTo(mask2);
-    
-    /*if(size < 1) {
-     size = 1;
-     }*/
-    
-    cv::Mat element = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(2*size+1, 2*size+1));
+    // Nothing predicted (the labels 0 are background)
+    bool bAnyPredicted = false;
+    for (int p = 1; p < 256; p++) bAnyPredicted |= bPredictedPresent[p];
+    if (!bAnyPredicted) return;
     
-    cv::morphologyEx(mask1, mask1, cv::MORPH_DILATE, element);
-    
-    cv::morphologyEx(mask2, mask2, cv::MORPH_ERODE, element);
+    // 2. Merge the overlapping persons and blobs
+    LabelUnionFind regions;
+    for (int i = 0; i < nPairs; i++)
+    {
+        int p = pairs[i] >> 8;
+        int g = pairs[i] & 0xFF;
+        if (p > 0 && g > 0) regions.join(p, 256 + g);
+    }
     
-    subtract(mask1, mask2, outputMask);
+    // 3. Intersection and union of every region containing some person
+    vector<double> overlapsSum (nConfigs, 0.0);
+    vector<int> nBB (nConfigs, 0);
+    vector<bool> bRegionDone (512, false);
+    vector<bool> bPredictedAssigned (256, false);
     
-    threshold(outputMask, outputMask, 128, 255, CV_THRESH_BINARY_INV);
+    for (int g = 1; g < 256; g++)
+    {
+        int region = regions.find(256 + g);
+        if (!bGtPresent[g] || bRegionDone[region]) continue;
+        bRegionDone[region] = true;
+        
+        vector<int> regionPersons, regionBlobs;
+        for (int l = 1; l < 256; l++)
+        {
+            if (bGtPresent[l] && regions.find(256 + l) == region) regionPersons.push_back(l);
+            if (bPredictedPresent[l] && regions.find(l) == region) regionBlobs.push_back(l);
+        }
+        
+        if (regionBlobs.empty())
+        {
+            for (int k = 0; k < nConfigs; k++) nBB[k]++; // missed person(s), zero overlap
+            continue;
+        }
+        
+        vector<int> intersectArea (nConfigs, 0), unionArea (nConfigs, 0);
+        for (int i = 0; i < regionBlobs.size(); i++)
+        {
+            bPredictedAssigned[regionBlobs[i]] = true;
+            for (int k = 0; k < nConfigs; k++)
+                unionArea[k] += predictedAreas[regionBlobs[i] * nConfigs + k];
+        }
+        for (int i = 0; i < regionPersons.size(); i++)
+        {
+            for (int k = 0; k < nConfigs; k++)
+                unionArea[k] += gtAreas[regionPersons[i] * nConfigs + k];
+        }
+        for (int i = 0; i < nPairs; i++)
+        {
+            int p = pairs[i] >> 8;
+            int l = pairs[i] & 0xFF;
+            if (p > 0 && l > 0 && regions.find(p) == region)
+            {
+                for (int k = 0; k < nConfigs; k++)
+                    intersectArea[k] += counts[i * nConfigs + k];
+            }
+        }
+        
+        for (int k = 0; k < nConfigs; k++)
+        {
+            unionArea[k] -= intersectArea[k];
+            if (unionArea[k] > 0)
+            {
+                nBB[k]++;
+                overlapsSum[k] += float(intersectArea[k]) / float(unionArea[k]);
+            }
+        }
+    }
     
-    mask1.release();
-    mask2.release();
-    element.release();
+    // Predicted blobs not overlapping any person count as zero overlap
+    int nUnassignedRegions = 0;
+    for (int p = 1; p < 256; p++)
+    {
+        if (bPredictedPresent[p] && !bPredictedAssigned[p]) nUnassignedRegions++;
+    }
     
+    for (int k = 0; k < nConfigs; k++)
+    {
+        nBB[k] += nUnassignedRegions;
+        overlaps[k] = (nBB[k] > 0) ? float(overlapsSum[k] / nBB[k]) : NAN;
+    }
+}
+
+/*
+ * Signed chessboard distance of every pixel to the boundary of the ground truth persons: the distance to the
+ * nearest background pixel inside the persons (positive), and to the nearest person pixel outside (negative)
+ */
+void Validation::createBoundaryDistance(cv::Mat& inputMask, cv::Mat& distance)
+{
+    cv::Mat inside, outside;
+    cv::distanceTransform(inputMask != 0, inside, CV_DIST_C, 3);
+    cv::distanceTransform(inputMask == 0, outside, CV_DIST_C, 3);
     
+    cv::subtract(inside, outside, distance);
 }
 
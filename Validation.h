@@ -20,6 +20,7 @@
 
 #include "ModalityData.hpp"
 #include "ModalityGridData.hpp"
+#include "ModalityReader.h"
 
 using namespace std;
 
@@ -43,15 +44,23 @@ public:
     
     void createOverlapPartitions(cv::Mat& partitions, cv::Mat& overlapIDs, vector<cv::Mat>& partitionedOverlapIDs);
     
+    // Headless equivalent of reading the scenes, getOverlap, createOverlapPartitions and getMeanOverlap: the masks are
+    // streamed from disk and evaluated in parallel, reducing every frame directly into the accumulators of its fold
+    void getPartitionedOverlap(ModalityReader& reader, string predictionType, string modality, vector<string> scenePaths, const char* filetype,
+                               cv::Mat& partitions, vector<cv::Mat>& partitionedOverlapIDs, cv::Mat& partitionedMeanOverlap);
+    
     void save(vector<cv::Mat> overlapIDs, cv::Mat meanOverlap, string filename);
     
 private:
   
     vector<int> m_DontCareRange;
     
-    float getMaskOverlap(cv::Mat& predictedMask, cv::Mat& gtMask, cv::Mat& dontCareRegion);
+    void getMaskOverlaps(cv::Mat& predictedMask, cv::Mat& gtMask, vector<int>& dcRange, vector<float>& overlaps);
+    
+    void createBoundaryDistance(cv::Mat& inputMask, cv::Mat& distance);
     
-    void createDontCareRegion(cv::Mat& inputMask, cv::Mat& outputMask, int dcRange);
+    struct OverlapJobs;
+    void overlapFrame(ModalityReader& reader, OverlapJobs& jobs, int i);
 };
 
 
@@ -0,0 +1,452 @@
+//
+//  bench.cpp
+//  segmenthreetion
+//
+//
+
+#include "AllocationCounter.h"
+#include "GridMat.h"
+#include "CvExtraTools.h"
+
+#include "ColorFeatureExtractor.h"
+#include "MotionFeatureExtractor.h"
+#include "DepthFeatureExtractor.h"
+#include "ThermalFeatureExtractor.h"
+
+#include "PipelineConfiguration.h"
+#include "FusionPrediction.h"
+#include "Validation.h"
+#include "registrator.h"
+#include "em.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+
+#include <pcl/console/parse.h>
+
+using namespace std;
+
+// =============================================================================
+//  Micro- and macro-benchmarks of the hot stages, on synthetic data
+// =============================================================================
+//
+//    -o  , the JSON file where the results are saved (bench.json by default)
+//    -n  , the timed repetitions of every benchmark (after a warm-up one)
+//    -f  , only runs the benchmarks whose name contains the given text
+//    -r  , the calibration file of the registration (calibVars.yml), which
+//      is skipped otherwise, since it cannot be synthesized
+//
+// The inputs are generated from a fixed seed, so that the results of different
+// builds are comparable. Every benchmark reports the median time of a repetition,
+// the throughput in the benchmark's items (grids, samples, frames, ...) per second,
+// and the heap allocations and allocated bytes per repetition (see AllocationCounter).
+//
+
+#ifndef SEGMENTHREETION_REVISION
+#define SEGMENTHREETION_REVISION "unknown"
+#endif
+
+//
+// Runner
+//
+
+struct BenchResult
+{
+    string name;
+    string unit; // of the items
+    int items; // processed per repetition
+    int repetitions;
+    double seconds, minSeconds; // median and minimum per repetition
+    double allocations, allocatedBytes; // per repetition
+};
+
+class BenchRunner
+{
+public:
+    BenchRunner(int repetitions, string filter) : m_Repetitions(repetitions), m_Filter(filter) {}
+
+    void run(string name, string unit, int items, boost::function<void ()> f)
+    {
+        if (!m_Filter.empty() && name.find(m_Filter) == string::npos)
+            return;
+
+        f(); // warm-up, lazy initializations and buffers are not measured
+
+        vector<double> seconds (m_Repetitions);
+        size_t allocations = AllocationCounter::getNumOfAllocations();
+        size_t allocatedBytes = AllocationCounter::getAllocatedBytes();
+
+        for (int r = 0; r < m_Repetitions; r++)
+        {
+            int64 t = cv::getTickCount();
+            f();
+            seconds[r] = (cv::getTickCount() - t) / cv::getTickFrequency();
+        }
+
+        BenchResult result;
+        result.name = name;
+        result.unit = unit;
+        result.items = items;
+        result.repetitions = m_Repetitions;
+        result.allocations = (double) (AllocationCounter::getNumOfAllocations() - allocations) / m_Repetitions;
+        result.allocatedBytes = (double) (AllocationCounter::getAllocatedBytes() - allocatedBytes) / m_Repetitions;
+
+        std::sort(seconds.begin(), seconds.end());
+        result.seconds = seconds[seconds.size() / 2];
+        result.minSeconds = seconds[0];
+
+        printf("%-32s %12.3f ms %14.1f %s/s %12.1f allocs %14.0f bytes\n", name.c_str(),
+               1000 * result.seconds, items / result.seconds, unit.c_str(), result.allocations, result.allocatedBytes);
+
+        m_Results.push_back(result);
+    }
+
+    void skip(string name, string reason)
+    {
+        if (!m_Filter.empty() && name.find(m_Filter) == string::npos)
+            return;
+
+        printf("%-32s skipped (%s)\n", name.c_str(), reason.c_str());
+    }
+
+    bool save(string file, int seed)
+    {
+        std::ofstream ofs (file.c_str());
+        if (!ofs.is_open())
+        {
+            cerr << "Could not open " << file << endl;
+            return false;
+        }
+
+        char timestamp[32];
+        time_t now = time(NULL);
+        strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+        ofs.precision(9);
+        ofs << "{" << endl;
+        ofs << "  \"revision\": \"" << SEGMENTHREETION_REVISION << "\"," << endl;
+        ofs << "  \"timestamp\": \"" << timestamp << "\"," << endl;
+        ofs << "  \"seed\": " << seed << "," << endl;
+        ofs << "  \"benchmarks\": [" << endl;
+        for (int i = 0; i < m_Results.size(); i++)
+        {
+            const BenchResult& r = m_Results[i];
+            ofs << "    { \"name\": \"" << r.name << "\", \"unit\": \"" << r.unit << "\", \"items\": " << r.items
+                << ", \"repetitions\": " << r.repetitions << ", \"seconds\": " << r.seconds << ", \"min_seconds\": " << r.minSeconds
+                << ", \"throughput\": " << r.items / r.seconds << ", \"allocations\": " << r.allocations
+                << ", \"allocated_bytes\": " << r.allocatedBytes << " }" << (i < m_Results.size() - 1 ? "," : "") << endl;
+        }
+        ofs << "  ]" << endl;
+        ofs << "}" << endl;
+
+        return true;
+    }
+
+private:
+    int m_Repetitions;
+    string m_Filter;
+    vector<BenchResult> m_Results;
+};
+
+//
+// Synthetic data
+//
+
+// Bounding boxes' crops of a person-sized blob, in every modality
+struct SyntheticGrids
+{
+    vector<GridMat> colorGrids, motionGrids, depthGrids, thermalGrids, gmasks;
+    cv::Mat gvalidness;
+};
+
+void synthesizeGrids(cv::RNG& rng, int n, int hp, int wp, SyntheticGrids& grids)
+{
+    cv::Size size (96, 192);
+
+    cv::Mat mask = cv::Mat::zeros(size, CV_8UC1);
+    cv::ellipse(mask, cv::Point(size.width/2, size.height/2), cv::Size(size.width/3, size.height/2 - 8), 0, 0, 360, cv::Scalar(255), -1);
+
+    for (int k = 0; k < n; k++)
+    {
+        cv::Mat color (size, CV_8UC3), thermal (size, CV_8UC1), flow (size, CV_32FC2), depth (size, CV_16UC1);
+        rng.fill(color, cv::RNG::UNIFORM, 0, 256);
+        cv::GaussianBlur(color, color, cv::Size(5,5), 0);
+        rng.fill(thermal, cv::RNG::UNIFORM, 0, 256);
+        cv::GaussianBlur(thermal, thermal, cv::Size(5,5), 0);
+        rng.fill(flow, cv::RNG::NORMAL, 0, 2);
+
+        // A slanted surface at 2-3 m with some noise, in Kinect's raw units (mm << 3)
+        for (int y = 0; y < size.height; y++) for (int x = 0; x < size.width; x++)
+            depth.at<unsigned short>(y,x) = (unsigned short) ((2000 + 5 * x + rng.uniform(0, 8)) << 3);
+
+        grids.colorGrids.push_back(GridMat(color, hp, wp));
+        grids.thermalGrids.push_back(GridMat(thermal, hp, wp));
+        grids.motionGrids.push_back(GridMat(flow, hp, wp));
+        grids.depthGrids.push_back(GridMat(depth, hp, wp));
+        grids.gmasks.push_back(GridMat(mask.clone(), hp, wp));
+    }
+
+    grids.gvalidness = cv::Mat::ones(hp, wp, CV_8UC1);
+}
+
+// Frames' masks of two subjects, the predicted ones displaced from the groundtruth ones
+void synthesizeMasks(cv::RNG& rng, int n, unsigned char masksOffset, vector<cv::Mat>& predictedMasks, vector<cv::Mat>& gtMasks)
+{
+    for (int f = 0; f < n; f++)
+    {
+        cv::Mat gtMask = cv::Mat::zeros(480, 640, CV_8UC1);
+        cv::Mat predictedMask = cv::Mat::zeros(480, 640, CV_8UC1);
+        for (int s = 0; s < 2; s++)
+        {
+            cv::Point center (160 + 320 * s + rng.uniform(-40, 40), 240 + rng.uniform(-40, 40));
+            cv::ellipse(gtMask, center, cv::Size(50, 150), 0, 0, 360, cv::Scalar(masksOffset + s), -1);
+            center += cv::Point(rng.uniform(-10, 10), rng.uniform(-10, 10));
+            cv::ellipse(predictedMask, center, cv::Size(55, 145), 0, 0, 360, cv::Scalar(masksOffset + s), -1);
+        }
+        gtMasks.push_back(gtMask);
+        predictedMasks.push_back(predictedMask);
+    }
+}
+
+// Samples of a mixture of nclusters gaussians
+void synthesizeSamples(cv::RNG& rng, int n, int dim, int nclusters, cv::Mat& samples)
+{
+    samples.create(n, dim, CV_64FC1);
+    rng.fill(samples, cv::RNG::NORMAL, 0, 1);
+    for (int i = 0; i < n; i++)
+        samples.row(i) += cv::Scalar(4 * (i % nclusters));
+}
+
+// Modalities' predictions {-1,0,+1} and distances to the margin
+void synthesizeVotes(cv::RNG& rng, int n, int nmodalities, int hp, int wp,
+                     vector<cv::Mat>& predictions, vector<cv::Mat>& distsToMargin,
+                     vector<GridMat>& gpredictions, vector<GridMat>& gdistsToMargin)
+{
+    for (int m = 0; m < nmodalities; m++)
+    {
+        GridMat gp (hp, wp), gd (hp, wp);
+        for (int i = 0; i < hp; i++) for (int j = 0; j < wp; j++)
+        {
+            cv::Mat d (n, 1, cv::DataType<float>::type);
+            rng.fill(d, cv::RNG::NORMAL, 0, 1);
+            cv::Mat p = (d > 0) / 255;
+            p.convertTo(p, cv::DataType<int>::type);
+            gp.assign(p, i, j);
+            gd.assign(d, i, j);
+        }
+        gpredictions.push_back(gp);
+        gdistsToMargin.push_back(gd);
+        predictions.push_back(gp.at(0,0));
+        distsToMargin.push_back(gd.at(0,0));
+    }
+}
+
+//
+// Benchmarks
+//
+
+void benchDescribe(FeatureExtractor* pFE, vector<GridMat>& grids, vector<GridMat>& gmasks, cv::Mat gvalidness)
+{
+    GridMat gdescriptors;
+    for (int k = 0; k < grids.size(); k++)
+        pFE->describe(grids[k], gmasks[k], gvalidness, gdescriptors);
+}
+
+// Exposes the E-step on the given samples
+class EStepEM40 : public cv::EM40
+{
+public:
+    EStepEM40(int nclusters) : cv::EM40(nclusters) {}
+
+    void eStep(const cv::Mat& samples)
+    {
+        trainSamples = samples;
+        cv::EM40::eStep();
+    }
+};
+
+void benchEMPredict(EStepEM40& em, cv::Mat samples)
+{
+    for (int i = 0; i < samples.rows; i++)
+        em.predict(samples.row(i));
+}
+
+void benchEMEStep(EStepEM40& em, cv::Mat samples)
+{
+    em.eStep(samples);
+}
+
+void benchIndexMat(cv::Mat src, cv::Mat indices, bool logical)
+{
+    cv::Mat dst;
+    cvx::indexMat(src, dst, indices, logical);
+}
+
+void benchGridMatVconcat(GridMat row, int n)
+{
+    GridMat concatenation;
+    for (int k = 0; k < n; k++)
+        concatenation.vconcat(row);
+}
+
+void benchGetOverlap(Validation& validation, vector<cv::Mat>& predictedMasks, vector<cv::Mat>& gtMasks, vector<int>& dcRange)
+{
+    cv::Mat overlapIDs (predictedMasks.size(), dcRange.size() + 1, cv::DataType<float>::type, cv::Scalar(-1));
+    validation.getOverlap(predictedMasks, gtMasks, dcRange, overlapIDs);
+}
+
+void benchRegistration(Registrator& registrator, vector<cv::Mat>& masks, vector<cv::Mat>& depths)
+{
+    vector<cv::Mat> thermalMasks;
+    registrator.loadRegSaveContours(masks, masks, thermalMasks, depths);
+}
+
+void benchSimpleFusion(SimpleFusionPrediction& fusion, vector<cv::Mat>& predictions, vector<cv::Mat>& distsToMargin)
+{
+    cv::Mat fusionPredictions, fusionDistsToMargin;
+    fusion.predict(predictions, distsToMargin, fusionPredictions, fusionDistsToMargin);
+}
+
+void benchSimpleGridFusion(SimpleFusionPrediction& fusion, vector<GridMat>& predictions, vector<GridMat>& distsToMargin)
+{
+    cv::Mat fusionPredictions, fusionDistsToMargin;
+    fusion.predict(predictions, distsToMargin, fusionPredictions, fusionDistsToMargin);
+}
+
+int main(int argc, char** argv)
+{
+    string output = "bench.json";
+    int repetitions = 5;
+    string filter, calibFile;
+
+    pcl::console::parse(argc, argv, "-o", output);
+    pcl::console::parse(argc, argv, "-n", repetitions);
+    pcl::console::parse(argc, argv, "-f", filter);
+    pcl::console::parse(argc, argv, "-r", calibFile);
+
+    PipelineConfiguration config; // the default parametrization
+    const int seed = config.seed;
+
+    cv::RNG rng (seed);
+    BenchRunner runner (std::max(repetitions, 1), filter);
+
+    // Feature extraction
+
+    const int numOfGrids = 32;
+    SyntheticGrids grids;
+    synthesizeGrids(rng, numOfGrids, config.hp, config.wp, grids);
+
+    ColorFeatureExtractor cFE (config.cParam);
+    MotionFeatureExtractor mFE (config.mParam);
+    DepthFeatureExtractor dFE (config.dParam);
+    ThermalFeatureExtractor tFE (config.tParam);
+
+    runner.run("describeColorHog", "grids", numOfGrids,
+               boost::bind(&benchDescribe, &cFE, boost::ref(grids.colorGrids), boost::ref(grids.gmasks), grids.gvalidness));
+    runner.run("describeMotionOrientedFlow", "grids", numOfGrids,
+               boost::bind(&benchDescribe, &mFE, boost::ref(grids.motionGrids), boost::ref(grids.gmasks), grids.gvalidness));
+    runner.run("describeNormalsOrients", "grids", numOfGrids,
+               boost::bind(&benchDescribe, &dFE, boost::ref(grids.depthGrids), boost::ref(grids.gmasks), grids.gvalidness));
+    runner.run("describeThermalGradOrients", "grids", numOfGrids,
+               boost::bind(&benchDescribe, &tFE, boost::ref(grids.thermalGrids), boost::ref(grids.gmasks), grids.gvalidness));
+
+    // Individual prediction
+
+    const int numOfSamples = 4000;
+    const int nclusters = 4;
+    cv::Mat samples;
+    synthesizeSamples(rng, numOfSamples, config.tParam.ibins + config.tParam.oribins, nclusters, samples);
+
+    EStepEM40 em (nclusters);
+    em.train(samples);
+
+    runner.run("EM40::predict", "samples", numOfSamples, boost::bind(&benchEMPredict, boost::ref(em), samples));
+    runner.run("EM40::eStep", "samples", numOfSamples, boost::bind(&benchEMEStep, boost::ref(em), samples));
+
+    // Data handling
+
+    const int numOfRows = 20000;
+    cv::Mat descriptors (numOfRows, config.cParam.hogbins, CV_32FC1);
+    rng.fill(descriptors, cv::RNG::UNIFORM, 0, 1);
+    cv::Mat logicals (numOfRows, 1, CV_8UC1);
+    rng.fill(logicals, cv::RNG::UNIFORM, 0, 2);
+    cv::Mat positions;
+    cv::findNonZero(logicals, positions); // (0,y) points
+    positions = positions.reshape(1, positions.rows).col(1).clone();
+
+    runner.run("cvx::indexMat (logical)", "rows", numOfRows, boost::bind(&benchIndexMat, descriptors, logicals, true));
+    runner.run("cvx::indexMat (positional)", "rows", positions.rows, boost::bind(&benchIndexMat, descriptors, positions, false));
+
+    const int numOfConcatenations = 2000;
+    GridMat gdescriptorsRow (config.hp, config.wp);
+    for (int i = 0; i < config.hp; i++) for (int j = 0; j < config.wp; j++)
+        gdescriptorsRow.assign(descriptors.row(i * config.wp + j).clone(), i, j);
+
+    runner.run("GridMat::vconcat", "rows", numOfConcatenations,
+               boost::bind(&benchGridMatVconcat, gdescriptorsRow, numOfConcatenations));
+
+    // Validation
+
+    const int numOfFrames = 16;
+    vector<cv::Mat> predictedMasks, gtMasks;
+    synthesizeMasks(rng, numOfFrames, config.masksOffset, predictedMasks, gtMasks);
+    vector<int> dontCareRange = config.dontCareRange;
+    Validation validation (dontCareRange);
+
+    runner.run("Validation::getOverlap", "frames", numOfFrames,
+               boost::bind(&benchGetOverlap, boost::ref(validation), boost::ref(predictedMasks), boost::ref(gtMasks), boost::ref(dontCareRange)));
+
+    // Registration
+
+    if (calibFile.empty())
+    {
+        runner.skip("Registrator::loadRegSaveContours", "no calibration, -r");
+    }
+    else
+    {
+        Registrator registrator;
+        registrator.loadMinCalibrationVars(calibFile);
+        registrator.toggleUndistortion(false);
+        registrator.setUsePrevDepthPoint(true);
+        registrator.loadRegistrationTables();
+
+        vector<cv::Mat> masks, depths;
+        for (int f = 0; f < numOfFrames; f++)
+        {
+            cv::Mat depth (480, 640, CV_16UC1);
+            for (int y = 0; y < depth.rows; y++) for (int x = 0; x < depth.cols; x++)
+                depth.at<unsigned short>(y,x) = (unsigned short) ((2000 + 2 * x) << 3);
+            depths.push_back(depth);
+            masks.push_back(gtMasks[f] == config.masksOffset);
+        }
+
+        runner.run("Registrator::loadRegSaveContours", "frames", numOfFrames,
+                   boost::bind(&benchRegistration, boost::ref(registrator), boost::ref(masks), boost::ref(depths)));
+    }
+
+    // Fusion
+
+    const int numOfVotes = 20000;
+    vector<cv::Mat> predictions, distsToMargin;
+    vector<GridMat> gpredictions, gdistsToMargin;
+    synthesizeVotes(rng, numOfVotes, 4, config.hp, config.wp, predictions, distsToMargin, gpredictions, gdistsToMargin);
+
+    SimpleFusionPrediction simpleFusion;
+
+    runner.run("SimpleFusionPrediction", "rows", numOfVotes,
+               boost::bind(&benchSimpleFusion, boost::ref(simpleFusion), boost::ref(predictions), boost::ref(distsToMargin)));
+    runner.run("SimpleFusionPrediction (grid)", "rows", numOfVotes,
+               boost::bind(&benchSimpleGridFusion, boost::ref(simpleFusion), boost::ref(gpredictions), boost::ref(gdistsToMargin)));
+
+    return runner.save(output, seed) ? 0 : -1;
+}
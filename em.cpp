@@ -87,6 +87,27 @@ namespace cv
     }
   
     Vec3d EM40::computeProbabilities(const Mat& sample, Mat* probs) const
+    {
+        AutoBuffer<double> buffer(nclusters + 2 * sample.cols);
+        return (this->*getProbabilitiesKernel())(sample, probs, buffer);
+    }
+    
+    EM40::ProbabilitiesKernel EM40::getProbabilitiesKernel() const
+    {
+        // By covMatType (COV_MAT_SPHERICAL, COV_MAT_DIAGONAL, COV_MAT_GENERIC)
+        static const ProbabilitiesKernel kernels[] =
+        {
+            &EM40::computeProbabilities<EM40::COV_MAT_SPHERICAL>,
+            &EM40::computeProbabilities<EM40::COV_MAT_DIAGONAL>,
+            &EM40::computeProbabilities<EM40::COV_MAT_GENERIC>
+        };
+        
+        CV_Assert(covMatType >= EM40::COV_MAT_SPHERICAL && covMatType <= EM40::COV_MAT_GENERIC);
+        return kernels[covMatType];
+    }
+    
+    template<int CovMatType>
+    Vec3d EM40::computeProbabilities(const Mat& sample, Mat* probs, double* buffer) const
     {
         // L_ik = log(weight_k) - 0.5 * log(|det(cov_k)|) - 0.5 *(x_i - mean_k)' cov_k^(-1) (x_i - mean_k)]
         // q = arg(max_k(L_ik))
@@ -98,44 +119,85 @@ namespace cv
         CV_Assert(sample.type() == CV_64FC1);
         CV_Assert(sample.rows == 1);
         CV_Assert(sample.cols == means.cols);
+        CV_DbgAssert(!logWeightDivDet.empty());
         
         int dim = sample.cols;
+        const double* x = sample.ptr<double>(0);
+        const double* logWeightsDivDets = logWeightDivDet.ptr<double>(0);
+        
+        double* L = buffer; // nclusters
+        double* centeredSample = buffer + nclusters; // dim, COV_MAT_GENERIC only
+        double* rotatedCenteredSample = centeredSample + dim; // dim, COV_MAT_GENERIC only
         
-        Mat L(1, nclusters, CV_64FC1);
         int label = 0;
         for(int clusterIndex = 0; clusterIndex < nclusters; clusterIndex++)
         {
-            const Mat centeredSample = sample - means.row(clusterIndex);
-            
-            Mat rotatedCenteredSample = covMatType != EM40::COV_MAT_GENERIC ?
-            centeredSample : centeredSample * covsRotateMats[clusterIndex];
+            const double* mean = means.ptr<double>(clusterIndex);
+            CV_DbgAssert(invCovsEigenValues[clusterIndex].isContinuous());
+            const double* w = invCovsEigenValues[clusterIndex].ptr<double>(0); // 1 x dim (or dim x 1), 1 x 1 if spherical
             
             double Lval = 0;
-            for(int di = 0; di < dim; di++)
+            if(CovMatType == EM40::COV_MAT_SPHERICAL)
+            {
+                double w0 = w[0];
+                for(int di = 0; di < dim; di++)
+                {
+                    double val = x[di] - mean[di];
+                    Lval += w0 * val * val;
+                }
+            }
+            else if(CovMatType == EM40::COV_MAT_DIAGONAL)
+            {
+                for(int di = 0; di < dim; di++)
+                {
+                    double val = x[di] - mean[di];
+                    Lval += w[di] * val * val;
+                }
+            }
+            else
             {
-                double w = invCovsEigenValues[clusterIndex].at<double>(covMatType != EM40::COV_MAT_SPHERICAL ? di : 0);
-                double val = rotatedCenteredSample.at<double>(di);
-                Lval += w * val * val;
+                // (x - mean_k) * rotation_k, accumulated row by row of the rotation
+                const Mat& rotation = covsRotateMats[clusterIndex];
+                for(int di = 0; di < dim; di++)
+                {
+                    centeredSample[di] = x[di] - mean[di];
+                    rotatedCenteredSample[di] = 0;
+                }
+                for(int di = 0; di < dim; di++)
+                {
+                    const double* r = rotation.ptr<double>(di);
+                    double c = centeredSample[di];
+                    for(int dj = 0; dj < dim; dj++)
+                        rotatedCenteredSample[dj] += c * r[dj];
+                }
+                for(int di = 0; di < dim; di++)
+                {
+                    double val = rotatedCenteredSample[di];
+                    Lval += w[di] * val * val;
+                }
             }
-            CV_DbgAssert(!logWeightDivDet.empty());
-            L.at<double>(clusterIndex) = logWeightDivDet.at<double>(clusterIndex) - 0.5 * Lval;
             
-            if(L.at<double>(clusterIndex) > L.at<double>(label))
+            L[clusterIndex] = logWeightsDivDets[clusterIndex] - 0.5 * Lval;
+            
+            if(L[clusterIndex] > L[label])
                 label = clusterIndex;
         }
         
-        double maxLVal = L.at<double>(label);
-        Mat expL_Lmax = L; // exp(L_ij - L_iq)
-        for(int i = 0; i < L.cols; i++)
-            expL_Lmax.at<double>(i) = std::exp(L.at<double>(i) - maxLVal);
-        double expDiffSum = sum(expL_Lmax)[0]; // sum_j(exp(L_ij - L_iq))
+        double maxLVal = L[label];
+        double expDiffSum = 0; // sum_j(exp(L_ij - L_iq))
+        for(int i = 0; i < nclusters; i++)
+        {
+            L[i] = std::exp(L[i] - maxLVal); // exp(L_ij - L_iq)
+            expDiffSum += L[i];
+        }
         
         if(probs)
         {
             probs->create(1, nclusters, CV_64FC1);
+            double* p = probs->ptr<double>(0);
             double factor = 1./expDiffSum;
-            expL_Lmax *= factor;
-            expL_Lmax.copyTo(*probs);
+            for(int i = 0; i < nclusters; i++)
+                p[i] = L[i] * factor;
         }
         
         Vec3d res;
@@ -158,15 +220,265 @@ namespace cv
         CV_DbgAssert(trainSamples.type() == CV_64FC1);
         CV_DbgAssert(means.type() == CV_64FC1);
         
+        ProbabilitiesKernel kernel = getProbabilitiesKernel();
+        AutoBuffer<double> buffer(nclusters + 2 * trainSamples.cols);
+        
         for(int sampleIndex = 0; sampleIndex < trainSamples.rows; sampleIndex++)
         {
             Mat sampleProbs = trainProbs.row(sampleIndex);
-            Vec3d res = computeProbabilities(trainSamples.row(sampleIndex), &sampleProbs);
+            Vec3d res = (this->*kernel)(trainSamples.row(sampleIndex), &sampleProbs, buffer);
             trainLogLikelihoods.at<double>(sampleIndex) = res[0];
             trainLabels.at<int>(sampleIndex) = static_cast<int>(res[2]);
         }
     }
     
+    void EM40::initStatistics(InputArray _samples)
+    {
+        CV_Assert(isTrained());
+        
+        releaseStatistics();
+        
+        int dim = means.cols;
+        
+        sumProbs = Mat::zeros(1, nclusters, CV_64FC1);
+        sumSamples = Mat::zeros(nclusters, dim, CV_64FC1);
+        sumSquares.resize(nclusters);
+        for(int clusterIndex = 0; clusterIndex < nclusters; clusterIndex++)
+        {
+            if(covMatType == EM40::COV_MAT_GENERIC)
+                sumSquares[clusterIndex] = Mat::zeros(dim, dim, CV_64FC1);
+            else
+                sumSquares[clusterIndex] = Mat::zeros(1, dim, CV_64FC1);
+        }
+        
+        Mat samples = _samples.getMat();
+        accumulateStatistics(samples);
+    }
+    
+    void EM40::initStatistics(double numOfSamples)
+    {
+        CV_Assert(isTrained() && numOfSamples > 0);
+        
+        releaseStatistics();
+        
+        int dim = means.cols;
+        
+        // the inverse of mStepFromStatistics
+        sumProbs = weights.reshape(1, 1) * numOfSamples;
+        sumSamples.create(nclusters, dim, CV_64FC1);
+        sumSquares.resize(nclusters);
+        for(int clusterIndex = 0; clusterIndex < nclusters; clusterIndex++)
+        {
+            double w = sumProbs.at<double>(clusterIndex);
+            
+            Mat clusterMean = means.row(clusterIndex);
+            Mat clusterSumSamples = sumSamples.row(clusterIndex);
+            clusterMean.convertTo(clusterSumSamples, CV_64FC1, w);
+            
+            if(covMatType == EM40::COV_MAT_GENERIC)
+            {
+                sumSquares[clusterIndex] = (covs[clusterIndex] + clusterMean.t() * clusterMean) * w;
+            }
+            else
+            {
+                Mat variances;
+                if(covMatType == EM40::COV_MAT_SPHERICAL)
+                    variances = Mat(1, dim, CV_64FC1, Scalar(covsEigenValues[clusterIndex].at<double>(0)));
+                else
+                    variances = covsEigenValues[clusterIndex].reshape(1, 1);
+                
+                sumSquares[clusterIndex] = (variances + clusterMean.mul(clusterMean)) * w;
+            }
+        }
+    }
+    
+    bool EM40::update(InputArray _samples, double forgettingFactor)
+    {
+        CV_Assert(hasStatistics());
+        
+        Mat samples = _samples.getMat();
+        if(samples.empty())
+            return false;
+        
+        if(forgettingFactor < 1)
+        {
+            sumProbs *= forgettingFactor;
+            sumSamples *= forgettingFactor;
+            for(int clusterIndex = 0; clusterIndex < nclusters; clusterIndex++)
+                sumSquares[clusterIndex] *= forgettingFactor;
+        }
+        
+        // E-step on the new samples (responsibilities under the current parameters)
+        accumulateStatistics(samples);
+        
+        // M-step on all the statistics
+        mStepFromStatistics();
+        
+        return true;
+    }
+    
+    bool EM40::hasStatistics() const
+    {
+        return !sumProbs.empty();
+    }
+    
+    void EM40::releaseStatistics()
+    {
+        sumProbs.release();
+        sumSamples.release();
+        sumSquares.clear();
+    }
+
+    void EM40::getPredictionParams(Mat& _weights, Mat& _means, Mat& _logWeightDivDet,
+                                   vector<Mat>& _invCovsEigenValues, vector<Mat>& _covsRotateMats) const
+    {
+        CV_Assert(isTrained());
+
+        _weights = weights;
+        _means = means;
+        _logWeightDivDet = logWeightDivDet;
+        _invCovsEigenValues = invCovsEigenValues;
+        _covsRotateMats = covsRotateMats;
+    }
+
+    void EM40::setPredictionParams(int _covMatType, const Mat& _weights, const Mat& _means, const Mat& _logWeightDivDet,
+                                   const vector<Mat>& _invCovsEigenValues, const vector<Mat>& _covsRotateMats)
+    {
+        CV_Assert(_means.type() == CV_64FC1 && _weights.type() == CV_64FC1 && _logWeightDivDet.type() == CV_64FC1);
+        CV_Assert((int)_invCovsEigenValues.size() == _means.rows);
+        CV_Assert(_covMatType != EM40::COV_MAT_GENERIC || _covsRotateMats.size() == _invCovsEigenValues.size());
+
+        clear();
+        releaseStatistics();
+
+        nclusters = _means.rows;
+        covMatType = _covMatType;
+
+        weights = _weights;
+        means = _means;
+        logWeightDivDet = _logWeightDivDet;
+        invCovsEigenValues = _invCovsEigenValues;
+        covsRotateMats = _covsRotateMats;
+
+        // the covariances are not needed to predict, but the incremental updates rely on them
+        int dim = means.cols;
+        covsEigenValues.resize(nclusters);
+        covs.resize(nclusters);
+        for(int clusterIndex = 0; clusterIndex < nclusters; clusterIndex++)
+        {
+            covsEigenValues[clusterIndex] = 1./invCovsEigenValues[clusterIndex];
+
+            if(covMatType == EM40::COV_MAT_GENERIC)
+                covs[clusterIndex] = covsRotateMats[clusterIndex] * Mat::diag(covsEigenValues[clusterIndex])
+                                        * covsRotateMats[clusterIndex].t();
+            else if(covMatType == EM40::COV_MAT_SPHERICAL)
+                covs[clusterIndex] = Mat::eye(dim, dim, CV_64FC1) * covsEigenValues[clusterIndex].at<double>(0);
+            else
+                covs[clusterIndex] = Mat::diag(covsEigenValues[clusterIndex]);
+        }
+    }
+
+    void EM40::accumulateStatistics(const Mat& _samples)
+    {
+        Mat samples = _samples;
+        if(samples.type() != CV_64FC1)
+            _samples.convertTo(samples, CV_64FC1);
+        
+        CV_Assert(samples.cols == means.cols);
+        
+        int dim = samples.cols;
+        
+        ProbabilitiesKernel kernel = getProbabilitiesKernel();
+        AutoBuffer<double> buffer(nclusters + 2 * dim);
+        
+        Mat probs(1, nclusters, CV_64FC1);
+        for(int sampleIndex = 0; sampleIndex < samples.rows; sampleIndex++)
+        {
+            Mat sample = samples.row(sampleIndex);
+            (this->*kernel)(sample, &probs, buffer);
+            
+            const double* x = sample.ptr<double>(0);
+            for(int clusterIndex = 0; clusterIndex < nclusters; clusterIndex++)
+            {
+                double p = probs.at<double>(clusterIndex);
+                if(p <= 0) continue;
+                
+                sumProbs.at<double>(clusterIndex) += p;
+                
+                double* s1 = sumSamples.ptr<double>(clusterIndex);
+                for(int di = 0; di < dim; di++)
+                    s1[di] += p * x[di];
+                
+                Mat& s2 = sumSquares[clusterIndex];
+                if(covMatType == EM40::COV_MAT_GENERIC)
+                {
+                    for(int di = 0; di < dim; di++)
+                    {
+                        double* s2row = s2.ptr<double>(di);
+                        double px = p * x[di];
+                        for(int dj = 0; dj < dim; dj++)
+                            s2row[dj] += px * x[dj];
+                    }
+                }
+                else
+                {
+                    double* s2row = s2.ptr<double>(0);
+                    for(int di = 0; di < dim; di++)
+                        s2row[di] += p * x[di] * x[di];
+                }
+            }
+        }
+    }
+    
+    void EM40::mStepFromStatistics()
+    {
+        int dim = means.cols;
+        
+        double n = sum(sumProbs)[0];
+        const double minPosWeight = n * DBL_EPSILON;
+        
+        for(int clusterIndex = 0; clusterIndex < nclusters; clusterIndex++)
+        {
+            double w = sumProbs.at<double>(clusterIndex);
+            if(w <= minPosWeight)
+                continue; // keeps its previous parameters
+            
+            Mat clusterMean = means.row(clusterIndex);
+            sumSamples.row(clusterIndex).convertTo(clusterMean, CV_64FC1, 1./w);
+            
+            // covariance as E[xx'] - mean mean'
+            if(covMatType == EM40::COV_MAT_GENERIC)
+            {
+                Mat cov = sumSquares[clusterIndex] / w - clusterMean.t() * clusterMean;
+                covs[clusterIndex] = cov;
+                
+                SVD svd(cov, SVD::FULL_UV);
+                covsEigenValues[clusterIndex] = svd.w;
+                covsRotateMats[clusterIndex] = svd.u;
+            }
+            else
+            {
+                Mat variances = sumSquares[clusterIndex] / w - clusterMean.mul(clusterMean);
+                if(covMatType == EM40::COV_MAT_SPHERICAL)
+                    covsEigenValues[clusterIndex] = Mat(1, 1, CV_64FC1, Scalar(sum(variances)[0] / dim));
+                else
+                    covsEigenValues[clusterIndex] = variances;
+            }
+            
+            max(covsEigenValues[clusterIndex], DBL_EPSILON, covsEigenValues[clusterIndex]);
+            invCovsEigenValues[clusterIndex] = 1./covsEigenValues[clusterIndex];
+            
+            if(covMatType == EM40::COV_MAT_SPHERICAL)
+                setIdentity(covs[clusterIndex], Scalar(covsEigenValues[clusterIndex].at<double>(0)));
+            else if(covMatType == EM40::COV_MAT_DIAGONAL)
+                covs[clusterIndex] = Mat::diag(covsEigenValues[clusterIndex]);
+        }
+        
+        sumProbs.convertTo(weights, CV_64FC1, 1./n);
+        
+        computeLogWeightDivDet();
+    }
+    
 } // namespace cvx
 
 /* End of file. */
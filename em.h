@@ -32,11 +32,49 @@ namespace cv
         CV_WRAP cv::Vec3d predict(cv::InputArray sample,
                               cv::OutputArray probs=cv::noArray()) const;
         
+        // Incremental EM. The sufficient statistics of each cluster (the sums of the
+        // responsibilities, of the weighted samples and of the weighted squared samples)
+        // are accumulated sample by sample, and update() re-estimates the parameters
+        // from them after one E-step on the new samples only. The statistics have to
+        // be initialized with the samples the model was trained on, and released
+        // whenever the model is trained again. A forgetting factor < 1 weighs down the
+        // statistics accumulated so far before adding the new ones.
+        CV_WRAP void initStatistics(cv::InputArray samples);
+        // Statistics rebuilt from the current parameters, as if they had been estimated on
+        // numOfSamples samples (e.g. for a restored model, whose training samples are gone)
+        CV_WRAP void initStatistics(double numOfSamples);
+        CV_WRAP bool update(cv::InputArray samples, double forgettingFactor = 1.0);
+        CV_WRAP bool hasStatistics() const;
+        CV_WRAP void releaseStatistics();
+
+        // Parameters needed to predict, to store a trained model and restore it without
+        // training again. The restored matrices are shared, not copied, so they can wrap
+        // an external buffer (e.g. a model file read or mapped in memory).
+        CV_WRAP void getPredictionParams(cv::Mat& weights, cv::Mat& means, cv::Mat& logWeightDivDet,
+                                         vector<cv::Mat>& invCovsEigenValues, vector<cv::Mat>& covsRotateMats) const;
+        CV_WRAP void setPredictionParams(int covMatType, const cv::Mat& weights, const cv::Mat& means, const cv::Mat& logWeightDivDet,
+                                         const vector<cv::Mat>& invCovsEigenValues, const vector<cv::Mat>& covsRotateMats);
+
     protected:
         
         virtual void eStep();
         
         cv::Vec3d computeProbabilities(const cv::Mat& sample, cv::Mat* probs) const;
+        
+        // computeProbabilities of a covariance type known at compile time, so that the
+        // per-dimension loops do not branch on it. Chosen once per call, or per batch of
+        // samples, from getProbabilitiesKernel(). The buffer holds nclusters + 2 * dim doubles.
+        typedef cv::Vec3d (EM40::*ProbabilitiesKernel)(const cv::Mat& sample, cv::Mat* probs, double* buffer) const;
+        template<int CovMatType>
+        cv::Vec3d computeProbabilities(const cv::Mat& sample, cv::Mat* probs, double* buffer) const;
+        ProbabilitiesKernel getProbabilitiesKernel() const;
+        
+        void accumulateStatistics(const cv::Mat& samples);
+        void mStepFromStatistics();
+        
+        cv::Mat sumProbs; // 1 x nclusters
+        cv::Mat sumSamples; // nclusters x dim
+        vector<cv::Mat> sumSquares; // dim x dim (COV_MAT_GENERIC) or 1 x dim per cluster
     };
 } // namespace cv
 
@@ -38,13 +38,21 @@
 
 #include "StatTools.h"
 
+#include "TaskGraph.h"
+#include "PipelineConfiguration.h"
+#include "ArtifactCache.h"
+#include "Trace.h"
+
 #include <opencv2/opencv.hpp>
 
 #include <iostream>
+#include <sstream>
 
 #include <boost/assign/std/vector.hpp>
+#include <boost/bind.hpp>
 #include <boost/timer.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
 
 #include <pcl/console/parse.h>
 
@@ -53,6 +61,176 @@
 using namespace boost::assign;
 using namespace std;
 
+//
+// Modality chains (see main)
+//
+
+// Describe the frames of the scenes to describe, saving the descriptions to <modality>.yml within each scene's directory.
+// A scene's descriptions are restored from the cache if its frames' masks and the parametrization (in key) did not change
+void describeModality(ModalityReader& reader, ArtifactCache& cache, ArtifactKey key, std::vector<std::string> scenesPaths,
+                      std::string modality, const char* filetype, unsigned int hp, unsigned int wp, FeatureExtractor* pFE)
+{
+    ModalityGridData gridData;
+    
+    std::string masksModality = (modality == "Motion") ? "Color" : modality; // see ModalityReader
+    
+    for (int s = 0; s < scenesPaths.size(); s++)
+    {
+        ArtifactKey sceneKey = key;
+        sceneKey << scenesPaths[s] << hp << wp; // the raw frames are not hashed, these are not supposed to change
+        sceneKey.addFile(scenesPaths[s] + "Masks/" + masksModality + "/");
+        sceneKey.addFile(scenesPaths[s] + "Masks/" + masksModality + ".yml");
+        
+        std::vector<std::string> outputs;
+        outputs += scenesPaths[s] + "Description/" + modality + ".yml", scenesPaths[s] + "Description/Mirrored" + modality + ".yml";
+        
+        if (cache.restore(sceneKey, outputs))
+            continue;
+        
+        gridData.clear();
+        cout << "Reading " << modality << " frames in scene " << s << " ..." << endl;
+        reader.readSceneData(scenesPaths[s], modality, filetype, hp, wp, gridData);
+        cout << "Describing " << modality << " ..." << endl;
+        pFE->describe(gridData);
+        gridData.saveDescription(scenesPaths[s], modality + ".yml");
+        
+        cache.store(sceneKey, outputs);
+    }
+}
+
+void readModalityMetadata(ModalityReader& reader, std::string modality, const char* filetype, unsigned int hp, unsigned int wp,
+                          ModalityGridData& gridMetadata)
+{
+    reader.readAllScenesMetadata(modality, filetype, hp, wp, gridMetadata);
+    reader.loadDescription(modality + ".yml", gridMetadata);
+}
+
+// Individual prediction of the cells, trained on the normal and the mirrored data. The results are saved
+// to <prefix>Predictions.yml, <prefix>Loglikelihoods.yml, <prefix>DistsToMargin.yml, and their "Mirrored" versions.
+// These, and the goodnesses of the model selections, are restored from the cache if the descriptions, the tags,
+// the partitions of the scenes and the parametrization (in key) did not change
+void predictModality(ModalityPrediction<cv::EM40>& prediction, ModalityGridData& gridMetadata, std::string prefix,
+                     bool bModelSelection, bool bMirrModelSelection,
+                     ArtifactCache& cache, ArtifactKey key, std::vector<std::string> scenesPaths, int kTest)
+{
+    std::string modality = gridMetadata.getModality();
+    std::string masksModality = (modality == "Motion") ? "Color" : modality; // see ModalityReader
+    
+    key << prefix << (int) bModelSelection << (int) bMirrModelSelection;
+    for (int s = 0; s < scenesPaths.size(); s++)
+    {
+        key.addFile(scenesPaths[s] + "Description/" + modality + ".yml");
+        key.addFile(scenesPaths[s] + "Description/Mirrored" + modality + ".yml");
+        key.addFile(scenesPaths[s] + "Masks/" + masksModality + ".yml");
+        key.addFile(scenesPaths[s] + "Partition.yml");
+    }
+    
+    std::vector<std::string> outputs;
+    outputs += prefix + "Predictions.yml", prefix + "Loglikelihoods.yml", prefix + "DistsToMargin.yml";
+    outputs += prefix + "PredictionsMirrored.yml", prefix + "LoglikelihoodsMirrored.yml", prefix + "DistsToMarginMirrored.yml";
+    
+    // The goodnesses are the model selections' outputs, or the inputs of the predictions without these
+    for (int k = 0; k < kTest; k++)
+    {
+        std::stringstream ss;
+        ss << modality << "_models_goodnesses_" << k;
+        
+        if (bModelSelection) outputs += ss.str() + ".yml";
+        else key.addFile(ss.str() + ".yml");
+        
+        if (bMirrModelSelection) outputs += ss.str() + "m.yml";
+        else key.addFile(ss.str() + "m.yml");
+    }
+    
+    if (cache.restore(key, outputs))
+        return;
+    
+    GridMat predictions, loglikelihoods, distsToMargin;
+    GridMat predictionsMirrored, loglikelihoodsMirrored, distsToMarginMirrored;
+    
+    GridMat accuraciesGrid;
+    cv::Mat means, confs;
+    
+    cout << gridMetadata.getModality() << " (individual prediction)" << endl;
+    
+    prediction.setData(gridMetadata);
+    
+    prediction.setModelSelection(bModelSelection);
+    prediction.setTrainMirrored(false);
+    
+    prediction.predict(predictions, loglikelihoods, distsToMargin);
+    prediction.getAccuracy(predictions, accuraciesGrid);
+    computeConfidenceInterval(accuraciesGrid, means, confs);
+    cout << means << endl;
+    cout << confs << endl;
+    
+    predictions.save(prefix + "Predictions.yml");
+    loglikelihoods.save(prefix + "Loglikelihoods.yml");
+    distsToMargin.save(prefix + "DistsToMargin.yml");
+    
+    prediction.setModelSelection(bMirrModelSelection);
+    prediction.setTrainMirrored(true);
+    
+    prediction.predict(predictionsMirrored, loglikelihoodsMirrored, distsToMarginMirrored);
+    prediction.getAccuracy(predictionsMirrored, accuraciesGrid);
+    computeConfidenceInterval(accuraciesGrid, means, confs);
+    cout << means << endl;
+    cout << confs << endl;
+    
+    predictionsMirrored.save(prefix + "PredictionsMirrored.yml");
+    loglikelihoodsMirrored.save(prefix + "LoglikelihoodsMirrored.yml");
+    distsToMarginMirrored.save(prefix + "DistsToMarginMirrored.yml");
+    
+    cache.store(key, outputs);
+}
+
+// Load the individual predictions of the cells and, if bConsensus, put them to a consensus.
+// The consensus are saved to <prefix>GridConsensusPredictions.yml, etc. (predictions map generation purposes)
+void computeModalityConsensus(ModalityPrediction<cv::EM40>& prediction, ModalityGridData& gridMetadata, std::string prefix, bool bConsensus,
+                              GridMat& predictions, GridMat& distsToMargin, GridMat& predictionsMirrored, GridMat& distsToMarginMirrored)
+{
+    predictions.load(prefix + "Predictions.yml");
+    distsToMargin.load(prefix + "DistsToMargin.yml");
+    predictionsMirrored.load(prefix + "PredictionsMirrored.yml");
+    distsToMarginMirrored.load(prefix + "DistsToMarginMirrored.yml");
+    
+    if (!bConsensus)
+        return;
+    
+    cv::Mat consensusPredictions, consensusDistsToMargin;
+    cv::Mat consensusPredictionsMirrored, consensusDistsToMarginMirrored;
+    
+    GridMat aux;
+    cv::Mat accuracies;
+    float mean, conf;
+    
+    prediction.setData(gridMetadata);
+    
+    prediction.setPredictions(predictions);
+    prediction.setDistsToMargin(distsToMargin);
+    prediction.computeGridConsensusPredictions(consensusPredictions, consensusDistsToMargin);
+    prediction.getAccuracy(consensusPredictions, accuracies);
+    computeConfidenceInterval(accuracies, &mean, &conf);
+    cout << gridMetadata.getModality() << " modality (c): " << mean << " ± " << conf << endl;
+    
+    aux.setTo(consensusPredictions);
+    aux.save(prefix + "GridConsensusPredictions.yml");
+    aux.setTo(consensusDistsToMargin);
+    aux.save(prefix + "GridConsensusDistsToMargin.yml");
+    
+    prediction.setPredictions(predictionsMirrored);
+    prediction.setDistsToMargin(distsToMarginMirrored);
+    prediction.computeGridConsensusPredictions(consensusPredictionsMirrored, consensusDistsToMarginMirrored);
+    prediction.getAccuracy(consensusPredictionsMirrored, accuracies);
+    computeConfidenceInterval(accuracies, &mean, &conf);
+    cout << gridMetadata.getModality() << " mirrored modality (c): " << mean << " ± " << conf << endl;
+    
+    aux.setTo(consensusPredictionsMirrored);
+    aux.save(prefix + "GridConsensusPredictionsMirrored.yml");
+    aux.setTo(consensusDistsToMarginMirrored);
+    aux.save(prefix + "GridConsensusDistsToMarginMirrored.yml");
+}
+
 int main(int argc, char** argv)
 {
 // =============================================================================
@@ -77,405 +255,109 @@ int main(int argc, char** argv)
 //    -M  , generate prediction maps on the specified
 //    -O  , compute overlaps on the specified
 //
-//    
+//    -P  , creates the partitions files of the scenes
+//    -B  , subtracts the background
+//
     
 // =============================================================================
 //  Parametrization
 // =============================================================================
+//
+//    -C  , loads the specified configuration files, in the given order, on top
+//      of the default parametrization (see PipelineConfiguration). Example:
+//          -C "base.yml,nmixtures-sweep.yml"
+//
+//    -S  , the scenes (within the data path)
+//    -o  , the directory where the results are saved
+//    -j  , the number of threads
+//
     
-    // Dataset handling, create a reader pointing the data streams
-    
-#ifdef _WIN32 // Visual Studio
-	string dataPath = "../Sequences/";
-#elif __APPLE__ // Xcode
-	string dataPath = "../../Sequences/";
-#endif
-	
-    
-	const unsigned char masksOffset = 200;
-    
-	// Background subtraction parametrization
-    
-    ForegroundParametrization fParam;
-    
-    int nftl[] = {35,200,80}; //frames needed to learn the background models for each sequence
-    const std::vector<int> nFramesToLearn(nftl, nftl + 3);
-    
-    fParam.numFramesToLearn = nFramesToLearn;
-    fParam.boundingBoxMinArea = 0.001;
-    fParam.otsuMinArea = 0.02;
-    fParam.otsuMinVariance1 = 8.3;
-    fParam.otsuMinVariance2 = 12;
-    
-    vector<vector<int> > validBoundBoxes;
-    
-    // Feature extraction parametrization
-    
-    const unsigned int hp = 2; // partitions in height
-    const unsigned int wp = 2; // partitions in width
-    
-    ColorParametrization cParam;
-    cParam.winSizeX = 64;
-    cParam.winSizeY = 128;
-    cParam.blockSizeX = 32;
-    cParam.blockSizeY = 32;
-    cParam.cellSizeX = 16;
-    cParam.cellSizeY = 16;
-    cParam.nbins = 9;
-    cParam.hogbins = 288; // total feature vector length
-    
-    MotionParametrization mParam;
-    mParam.hoofbins = 8;
-    mParam.pyr_scale = 0.5;
-    mParam.levels = 3;
-    mParam.winsize = 15;
-    mParam.iterations = 3;
-    mParam.poly_n = 5;
-    mParam.poly_sigma = 1.2;
-    mParam.flags = 0;
-    
-    DepthParametrization dParam;
-    dParam.thetaBins        = 8;
-    dParam.phiBins          = 8;
-    dParam.normalsRadius    = 0.04;
-    
-    ThermalParametrization tParam;
-    tParam.ibins    = 8;
-    tParam.oribins  = 8;
-    
-    // Leraning algorithms' parametrization
-    
-    vector<float> tmp;
-    
-    // all modalities, except for ramanan
-	vector<int> nmixtures;
-    nmixtures += 2, 4, 6, 8, 10, 12;//, 8, 10; // classification parameter (training step)
-    tmp = cvx::linspace(-2, 2, 12);//, 32); // -1, -0.8, -0.6, ..., 0.8
-    vector<float> likelicuts;//; (tmp.begin()+1, tmp.end()-1);
-    likelicuts += -3, -2.5, -2, -1.5, -1.25, -1, -0.75, -0.5, -0.4, -0.3, -0.2, -0.1, 0, 0.1, 0.2, 0.3, 0.4, 0.5, 0.75, 1, 1.25, 1.5, 2, 2.5, 3;
-    vector<float> epsilons;
-    epsilons += 1e-2, 1e-3, 1e-4, 1e-5;
-    
-    // ramanan
-    tmp = cvx::linspace(0, 1.0, 30.0);
-    vector<float> ratios (tmp.begin()+1, tmp.end()-1);
-    tmp = cvx::linspace(0, 1.0, 30.0);
-    vector<float> scoreThresholds (tmp.begin()+1, tmp.end()-1);
-    
-    double colorVariance = 0.9; // variance to keep in PCA's dim reduction in ColorModality
-    
-    // fusion strategies
-
-    // ... svm params
-    vector<float> cs, gammas;
-    cs += 1e-7, 1e-6, 1e-5, 1e-4, 1e-3, 1e-2, 1e-1, 1e0, 1e1, 1e2, 1e3, 1e4;
-    gammas += 1e-7, 1e-6, 1e-5, 1e-4, 1e-3, 1e-2, 1e-1, 1e0, 1e1, 1e2;
-    
-    // ... boost params
-    
-    vector<float> numOfWeaks, weightTrimRates;
-    numOfWeaks += 10, 20, 50, 100, 200, 500, 1000;
-    weightTrimRates += 0, 0.70, 0.75, 0.80, 0.85, 0.90, 0.95, 0.99;
-    
-    // ... mlp params
-    
-    vector<float> hiddenLayerSizes; //, decayWeights, momentWeights;
-    hiddenLayerSizes += 2, 5, 10, 15, 20, 25, 30, 35, 40, 45, 50, 60, 70, 80, 90, 100;
-    //numOfWeaks += 10, 20, 50, 100, 200, 500, 1000;
-    //weightTrimRates += 0, 0.70, 0.75, 0.80, 0.85, 0.90, 0.95, 0.99;
-    
-    // ... RF params
-    vector<float> maxDepths, maxNoTrees, noVars;
-    maxDepths += 2, 4, 8, 16, 32, 64;
-    maxNoTrees += 1, 2, 4, 8, 16, 32, 64, 128;
-    noVars += 0.05, 0.1, 0.2, 0.4, 0.8, 1;
-    
-    // Validation procedure
-    int kTest = 10; // number of folds in the outer cross-validation
-    int kModelSelec = kTest - 1;
-    int seed = 42;
- 
-    // Overlap params
-    vector<int> dontCareRange;
-    dontCareRange += 1, 2, 3, 4, 5, 6, 7, 8;
-    //dontCareRange += 1;
+    PipelineConfiguration config;
     
-    std::vector<std::string> sequencesPaths;
-    if (pcl::console::find_argument(argc, argv, "-S") > 0)
+    if (pcl::console::find_argument(argc, argv, "-C") > 0)
     {
         std::string valStr;
-        pcl::console::parse(argc, argv, "-S", valStr);
+        pcl::console::parse(argc, argv, "-C", valStr);
         
         std::vector<std::string> valStrL;
         boost::split(valStrL, valStr, boost::is_any_of(","));
         
         std::vector<std::string>::iterator it;
         for (it = valStrL.begin(); it != valStrL.end(); it++)
-            sequencesPaths += dataPath + (*it);
+            if (!config.load(*it)) return -1;
     }
     
-    std::vector<int> descriptions;
-    if (pcl::console::find_argument(argc, argv, "-D") > 0)
+    config.parse(argc, argv); // the program arguments override the configuration files
+    
+    // Dataset handling, create a reader pointing the data streams
+    
+    string dataPath = config.dataPath;
+    
+    if (!config.outputDir.empty())
     {
-        std::string valStr;
-        pcl::console::parse(argc, argv, "-D", valStr);
-        
-        std::vector<std::string> valStrL;
-        boost::split(valStrL, valStr, boost::is_any_of(","));
+        // the data path is relative to where the program was run
+        dataPath = boost::filesystem::absolute(dataPath).string();
+        if (*dataPath.rbegin() != '/') dataPath += "/";
         
-        std::vector<std::string>::iterator it;
-        for (it = valStrL.begin(); it != valStrL.end(); it++)
-            descriptions += stoi(*it);
+        boost::filesystem::create_directories(config.outputDir);
+        boost::filesystem::current_path(config.outputDir);
     }
     
-    bool bIndividualPredictions = false;
+    if (config.numOfThreads > 0)
+        ThreadBudget::getInstance().setSize(config.numOfThreads);
     
-    bool bColorTraining = false; // normal
-    bool bMotionTraining = false;
-    bool bDepthTraining = false;
-    bool bThermalTraining = false;
-    bool bColorMirrTraining = false; // mirrored
-    bool bMotionMirrTraining = false;
-    bool bDepthMirrTraining = false;
-    bool bThermalMirrTraining = false;
+    // Traced builds (SEGMENTHREETION_TRACE) save the stages' timings here at exit
+    TRACE_OUTPUT("trace.json");
     
-    if (pcl::console::find_argument(argc, argv, "-I") > 0)
-    {
-        bIndividualPredictions = true;
-    }
+	const unsigned char masksOffset = config.masksOffset;
     
-    if (pcl::console::find_argument(argc, argv, "-It") > 0)
-    {
-        bIndividualPredictions = true;
-        
-        std::string valStr;
-        pcl::console::parse(argc, argv, "-It", valStr);
-        
-        std::vector<std::string> valStrL;
-        boost::split(valStrL, valStr, boost::is_any_of(","));
-        
-        std::vector<std::string>::iterator it;
-        for (it = valStrL.begin(); it != valStrL.end(); it++)
-        {
-            if (*it == "c") bColorTraining = true; // normal
-            if (*it == "m") bMotionTraining = true;
-            if (*it == "d") bDepthTraining = true;
-            if (*it == "t") bThermalTraining = true;
-            if (*it == "C") bColorMirrTraining = true; // mirrored
-            if (*it == "M") bMotionMirrTraining = true;
-            if (*it == "D") bDepthMirrTraining = true;
-            if (*it == "T") bThermalMirrTraining = true;
-        }
-    }
+	// Background subtraction parametrization
     
-    bool bSimpleFusion = (pcl::console::find_argument(argc, argv, "-f") > 0);
+    ForegroundParametrization fParam = config.fParam;
     
-    bool bLearningFusion = false;
+    vector<vector<int> > validBoundBoxes;
     
-    bool bAdaboostTraining = false; // normal
-    bool bMlpSigmoidTraining = false;
-    bool bMlpGaussianTraining = false;
-    bool bSvmLinearTraining = false;
-    bool bSvmRBFTraining = false;
-    bool bRFTraining = false;
+    // Feature extraction parametrization
     
-    bool bAdaboostMirrTraining = false; // mirrored
-    bool bMlpSigmoidMirrTraining = false;
-    bool bMlpGaussianMirrTraining = false;
-    bool bSvmLinearMirrTraining = false;
-    bool bSvmRBFMirrTraining = false;
-    bool bRFMirrTraining = false;
+    const unsigned int hp = config.hp; // partitions in height
+    const unsigned int wp = config.wp; // partitions in width
     
-    if (pcl::console::find_argument(argc, argv, "-F") > 0)
-    {
-        bLearningFusion = true;
-    }
+    ColorParametrization cParam = config.cParam;
+    MotionParametrization mParam = config.mParam;
+    DepthParametrization dParam = config.dParam;
+    ThermalParametrization tParam = config.tParam;
     
-    if (pcl::console::find_argument(argc, argv, "-Ft") > 0)
-    {
-        bLearningFusion = true;
-        
-        std::string valStr;
-        pcl::console::parse(argc, argv, "-Ft", valStr);
-        
-        std::vector<std::string> valStrL;
-        boost::split(valStrL, valStr, boost::is_any_of(","));
-        
-        std::vector<std::string>::iterator it;
-        for (it = valStrL.begin(); it != valStrL.end(); it++)
-        {
-            // normal
-            if (*it == "ada") bAdaboostTraining = true;
-            if (*it == "mlpsig") bMlpSigmoidTraining = true;
-            if (*it == "mlpgau") bMlpGaussianTraining = true;
-            if (*it == "svmlin") bSvmLinearTraining = true;
-            if (*it == "svmrbf") bSvmRBFTraining = true;
-            if (*it == "rf") bRFTraining = true;
-            // mirrored
-            if (*it == "ADA") bAdaboostMirrTraining = true;
-            if (*it == "MLPsig") bMlpSigmoidMirrTraining = true;
-            if (*it == "MLPgau") bMlpGaussianMirrTraining = true;
-            if (*it == "SVMlin") bSvmLinearMirrTraining = true;
-            if (*it == "SVMrbf") bSvmRBFMirrTraining = true;
-            if (*it == "RF") bRFMirrTraining = true;
-        }
-    }
+    // Leraning algorithms' parametrization
     
-    bool bMapGeneration = false;
-    
-    bool bHogMapGeneration = false;
-    bool bHoofMapGeneration = false;
-    bool bHonMapGeneration = false;
-    bool bHiogMapGeneration = false;
-    
-    bool bPreconsensusMapGeneration = false;
-    bool bPostconsensusMapGeneration = false;
-    bool bDistBasedConsensusMapGeneration = false;
-    
-    bool bAdaboostMapGeneration = false; // normal
-    bool bMlpSigmoidMapGeneration = false;
-    bool bMlpGaussianMapGeneration = false;
-    bool bSvmLinearMapGeneration = false;
-    bool bSvmRBFMapGeneration = false;
-    bool bRFMapGeneration = false;
-    
-    bool bHogMirrMapGeneration = false;
-    bool bHoofMirrMapGeneration = false;
-    bool bHonMirrMapGeneration = false;
-    bool bHiogMirrMapGeneration = false;
-    
-    bool bPreconsensusMirrMapGeneration = false;
-    bool bPostconsensusMirrMapGeneration = false;
-    bool bDistBasedConsensusMirrMapGeneration = false;
-    
-    bool bAdaboostMirrMapGeneration = false; // mirrored
-    bool bMlpSigmoidMirrMapGeneration = false;
-    bool bMlpGaussianMirrMapGeneration = false;
-    bool bSvmLinearMirrMapGeneration = false;
-    bool bSvmRBFMirrMapGeneration = false;
-    bool bRFMirrMapGeneration = false;
-    
-    if (pcl::console::find_argument(argc, argv, "-M") > 0)
-    {
-        std::string valStr;
-        pcl::console::parse(argc, argv, "-M", valStr);
-        
-        std::vector<std::string> valStrL;
-        boost::split(valStrL, valStr, boost::is_any_of(","));
-        
-        std::vector<std::string>::iterator it;
-        for (it = valStrL.begin(); it != valStrL.end(); it++)
-        {
-            // normal
-            if (*it == "hog") bHogMapGeneration = true;
-            if (*it == "hoof") bHoofMapGeneration = true;
-            if (*it == "hon") bHonMapGeneration = true;
-            if (*it == "hiog") bHiogMapGeneration = true;
-            if (*it == "precons") bPreconsensusMapGeneration = true;
-            if (*it == "postcons") bPostconsensusMapGeneration = true;
-            if (*it == "distcons") bDistBasedConsensusMapGeneration = true;
-            if (*it == "ada") bAdaboostMapGeneration = true;
-            if (*it == "mlpsig") bMlpSigmoidMapGeneration = true;
-            if (*it == "mlpgau") bMlpGaussianMapGeneration = true;
-            if (*it == "svmlin") bSvmLinearMapGeneration = true;
-            if (*it == "svmrbf") bSvmRBFMapGeneration = true;
-            if (*it == "rf") bRFMapGeneration = true;
-            // mirrored
-            if (*it == "HOG") bHogMirrMapGeneration = true;
-            if (*it == "HOOF") bHoofMirrMapGeneration = true;
-            if (*it == "HON") bHonMirrMapGeneration = true;
-            if (*it == "HIOG") bHiogMirrMapGeneration = true;
-            if (*it == "PRECONS") bPreconsensusMirrMapGeneration = true;
-            if (*it == "POSTCONS") bPostconsensusMirrMapGeneration = true;
-            if (*it == "DISTCONS") bDistBasedConsensusMirrMapGeneration = true;
-            if (*it == "ADA") bAdaboostMirrMapGeneration = true;
-            if (*it == "MLPsig") bMlpSigmoidMirrMapGeneration = true;
-            if (*it == "MLPgau") bMlpGaussianMirrMapGeneration = true;
-            if (*it == "SVMlin") bSvmLinearMirrMapGeneration = true;
-            if (*it == "SVMrbf") bSvmRBFMirrMapGeneration = true;
-            if (*it == "RF") bRFMirrMapGeneration = true;
-        }
-    }
+	vector<int> nmixtures = config.nmixtures;
+    vector<float> likelicuts = config.likelicuts;
+    vector<float> epsilons = config.epsilons;
     
-    bool bComputeOverlaps = false;
-    
-    bool bHogOverlap = false;
-    bool bHoofOverlap = false;
-    bool bHonOverlap = false;
-    bool bHiogOverlap = false;
-    
-    bool bPreconsensusOverlap = false;
-    bool bPostconsensusOverlap = false;
-    bool bDistBasedConsensusOverlap = false;
-    
-    bool bAdaboostOverlap = false; // normal
-    bool bMlpSigmoidOverlap = false;
-    bool bMlpGaussianOverlap = false;
-    bool bSvmLinearOverlap = false;
-    bool bSvmRBFOverlap = false;
-    bool bRFOverlap = false;
-    
-    bool bHogMirrOverlap = false;
-    bool bHoofMirrOverlap = false;
-    bool bHonMirrOverlap = false;
-    bool bHiogMirrOverlap = false;
-    
-    bool bPreconsensusMirrOverlap = false;
-    bool bPostconsensusMirrOverlap = false;
-    bool bDistBasedConsensusMirrOverlap = false;
-    
-    bool bAdaboostMirrOverlap = false; // mirrored
-    bool bMlpSigmoidMirrOverlap = false;
-    bool bMlpGaussianMirrOverlap = false;
-    bool bSvmLinearMirrOverlap = false;
-    bool bSvmRBFMirrOverlap = false;
-    bool bRFMirrOverlap = false;
-    
-    if (pcl::console::find_argument(argc, argv, "-M") > 0)
-    {
-        std::string valStr;
-        pcl::console::parse(argc, argv, "-M", valStr);
-        
-        std::vector<std::string> valStrL;
-        boost::split(valStrL, valStr, boost::is_any_of(","));
-        
-        std::vector<std::string>::iterator it;
-        for (it = valStrL.begin(); it != valStrL.end(); it++)
-        {
-            // normal
-            if (*it == "hog") bHogOverlap = true;
-            if (*it == "hoof") bHoofOverlap = true;
-            if (*it == "hon") bHonOverlap = true;
-            if (*it == "hiog") bHiogOverlap = true;
-            if (*it == "precons") bPreconsensusOverlap = true;
-            if (*it == "postcons") bPostconsensusOverlap = true;
-            if (*it == "distcons") bDistBasedConsensusOverlap = true;
-            if (*it == "ada") bAdaboostOverlap = true;
-            if (*it == "mlpsig") bMlpSigmoidOverlap = true;
-            if (*it == "mlpgau") bMlpGaussianOverlap = true;
-            if (*it == "svmlin") bSvmLinearOverlap = true;
-            if (*it == "svmrbf") bSvmRBFOverlap = true;
-            if (*it == "rf") bRFOverlap = true;
-            // mirrored
-            if (*it == "HOG") bHogMirrOverlap = true;
-            if (*it == "HOOF") bHoofMirrOverlap = true;
-            if (*it == "HON") bHonMirrOverlap = true;
-            if (*it == "HIOG") bHiogMirrOverlap = true;
-            if (*it == "PRECONS") bPreconsensusMirrOverlap = true;
-            if (*it == "POSTCONS") bPostconsensusMirrOverlap = true;
-            if (*it == "DISTCONS") bDistBasedConsensusMirrOverlap = true;
-            if (*it == "ADA") bAdaboostMirrOverlap = true;
-            if (*it == "MLPsig") bMlpSigmoidMirrOverlap = true;
-            if (*it == "MLPgau") bMlpGaussianMirrOverlap = true;
-            if (*it == "SVMlin") bSvmLinearMirrOverlap = true;
-            if (*it == "SVMrbf") bSvmRBFMirrOverlap = true;
-            if (*it == "RF") bRFMirrOverlap = true;
-        }
-    }
+    double colorVariance = config.colorVariance; // variance to keep in PCA's dim reduction in ColorModality
+    
+    // fusion strategies
+    
+    vector<float> cs = config.cs, gammas = config.gammas; // svm
+    vector<float> numOfWeaks = config.numOfWeaks, weightTrimRates = config.weightTrimRates; // boost
+    vector<float> hiddenLayerSizes = config.hiddenLayerSizes; // mlp
+    vector<float> maxDepths = config.maxDepths, maxNoTrees = config.maxNoTrees, noVars = config.noVars; // rf
+    
+    // Validation procedure
+    int kTest = config.kTest; // number of folds in the outer cross-validation
+    int kModelSelec = config.kModelSelec;
+    int seed = config.seed;
+    
+    // Overlap params
+    vector<int> dontCareRange = config.dontCareRange;
     
-    bool bComputePartitions = (pcl::console::find_argument(argc, argv, "-P") > 0);
+    std::vector<std::string> sequencesPaths;
+    for (int s = 0; s < config.sequences.size(); s++)
+        sequencesPaths += dataPath + config.sequences[s];
     
-    bool bSubtractBackground = (pcl::console::find_argument(argc, argv, "-B") > 0);
+    std::vector<int> descriptions;
+    std::vector<std::string> scenesToDescribe = config.getOptions("description");
+    for (int s = 0; s < scenesToDescribe.size(); s++)
+        descriptions += stoi(scenesToDescribe[s]);
 
 // =============================================================================
 //  Execution
@@ -485,7 +367,7 @@ int main(int argc, char** argv)
     reader.setSequences(sequencesPaths);
     reader.setMasksOffset(masksOffset);
     
-//    if (bComputePartitions)
+//    if (config.isStage("partitions"))
 //    {
 //        //
 //        // Create partitions
@@ -513,7 +395,7 @@ int main(int argc, char** argv)
 //        }
 //    }
     
-    if (bComputePartitions)
+    if (config.isStage("partitions"))
     {
         //
         // Create partitions
@@ -542,7 +424,7 @@ int main(int argc, char** argv)
         fs.release();
     }
     
-    if (bSubtractBackground)
+    if (config.isStage("background"))
     {
         // Background subtraction
         // ----------------------
@@ -598,420 +480,142 @@ int main(int argc, char** argv)
     }
     
     //
-    // Feature extraction
+    // Modality chains
     //
-    
-    cout << "Feature extraction ... " << endl;
-
-    // Color description
-
-    ModalityGridData cGridData;
-
-    ColorFeatureExtractor cFE(cParam);
-	for (int s = 0; s < descriptions.size(); s++)
-	{
-        cGridData.clear();
-        cout << "Reading color frames in scene " << s << " ..." << endl;
-		reader.readSceneData(sequencesPaths[descriptions[s]], "Color", "jpg", hp, wp, cGridData);
-        cout << "Describing color..." << endl;
-		cFE.describe(cGridData);
-        cGridData.saveDescription(sequencesPaths[s], "Color.yml");
-    }
-    cGridData.clear();
-
-    // Motion description
-    
-    ModalityGridData mGridData;
-
-    MotionFeatureExtractor mFE(mParam);
-	for (int s = 0; s < descriptions.size(); s++)
-	{
-        mGridData.clear();
-        cout << "Computing motion (from read color) frames in scene " << s << ".." << endl;
-		reader.readSceneData(sequencesPaths[descriptions[s]], "Motion", "jpg", hp, wp, mGridData);
-        cout << "Describing motion..." << endl;
-        mFE.describe(mGridData);
-        mGridData.saveDescription(sequencesPaths[s], "Motion.yml");
-	}
-    mGridData.clear();
-
-    // Thermal description
-    
-    ModalityGridData tGridData;
-
-    ThermalFeatureExtractor tFE(tParam);
-	for (int s = 0; s < descriptions.size(); s++)
-	{
-        tGridData.clear();
-        cout << "Reading thermal frames in scene " << s << ".." << endl;
-		reader.readSceneData(sequencesPaths[descriptions[s]], "Thermal", "jpg", hp, wp, tGridData);
-        cout << "Describing thermal..." << endl;
-		tFE.describe(tGridData);
-        tGridData.saveDescription(sequencesPaths[s], "Thermal.yml");
-	}
-    tGridData.clear();
-    
-    // Depth description
-    
-    ModalityGridData dGridData;
-
-    DepthFeatureExtractor dFE(dParam);
-	for (int s = 0; s < descriptions.size(); s++)
-	{
-        dGridData.clear();
-        cout << "Reading depth frames in scene " << s << ".." << endl;
-		reader.readSceneData(sequencesPaths[descriptions[s]], "Depth", "png", hp, wp, dGridData);
-        cout << "Describing depth..." << endl;
-		dFE.describe(dGridData);
-        dGridData.saveDescription(sequencesPaths[s], "Depth.yml");
-	}
-    dGridData.clear();
-
-
-    //
-    // Cells predictions
+    // Every modality is read, described, predicted and its cells' predictions put to a
+    // consensus independently of the others. The chains of the four modalities are the
+    // tasks of a graph, run concurrently within the ThreadBudget, and joined by the fusion.
     //
     
     ///////////////
     GridMat aux; // several purposes
     ///////////////
     
-    ModalityPrediction<cv::EM40> prediction;
     float mean, conf;
-    cv::Mat means, confs;
-    
-    cv::Mat accuracies;
-    GridMat accuraciesGrid;
-
-    prediction.setNumOfMixtures(nmixtures);
-    prediction.setEpsilons(epsilons);
-    prediction.setLoglikelihoodThresholds(likelicuts);
-
-    prediction.setValidationParameters(kTest);
-    prediction.setModelSelectionParameters(kModelSelec, true);
-
-    // Motion
-    ModalityGridData mGridMetadata;
     
-    reader.readAllScenesMetadata("Motion", "jpg", hp, wp, mGridMetadata);
-    reader.loadDescription("Motion.yml", mGridMetadata);
+    ColorFeatureExtractor cFE(cParam);
+    MotionFeatureExtractor mFE(mParam);
+    ThermalFeatureExtractor tFE(tParam);
+    DepthFeatureExtractor dFE(dParam);
     
-    GridMat mPredictions, mPredictionsMirrored;
-    GridMat mLoglikelihoods, mLoglikelihoodsMirrored;
-    GridMat mDistsToMargin, mDistsToMarginMirrored;
+    ModalityPrediction<cv::EM40> mPrediction, dPrediction, tPrediction, cPrediction;
     
-    if (bIndividualPredictions)
+    ModalityPrediction<cv::EM40>* pPredictions[] = { &mPrediction, &dPrediction, &tPrediction, &cPrediction };
+    for (int i = 0; i < 4; i++)
     {
-        cout << "Prediction of individual cells ... " << endl;
-
-        cout << "Motion (individual prediction)" << endl;
-
-        prediction.setData(mGridMetadata);
-
-//        prediction.setModelSelection(bMotionTraining);
-//        prediction.setTrainMirrored(false);
-//
-//        prediction.predict(mPredictions, mLoglikelihoods, mDistsToMargin);
-//        prediction.getAccuracy(mPredictions, accuraciesGrid);
-//        computeConfidenceInterval(accuraciesGrid, means, confs);
-//        cout << means << endl;
-//        cout << confs << endl;
-//
-//        mPredictions.save("mPredictions.yml");
-//        mLoglikelihoods.save("mLoglikelihoods.yml");
-//        mDistsToMargin.save("mDistsToMargin.yml");
+        pPredictions[i]->setNumOfMixtures(nmixtures);
+        pPredictions[i]->setEpsilons(epsilons);
+        pPredictions[i]->setLoglikelihoodThresholds(likelicuts);
         
-//        prediction.setModelSelection(bMotionMirrTraining);
-//        prediction.setTrainMirrored(true);
-//        
-//        prediction.predict(mPredictionsMirrored, mLoglikelihoodsMirrored, mDistsToMarginMirrored);
-//        prediction.getAccuracy(mPredictionsMirrored, accuraciesGrid);
-//        computeConfidenceInterval(accuraciesGrid, means, confs);
-//        cout << means << endl;
-//        cout << confs << endl;
-//        
-//        mPredictionsMirrored.save("mPredictionsMirrored.yml");
-//        mLoglikelihoodsMirrored.save("mLoglikelihoodsMirrored.yml");
-//        mDistsToMarginMirrored.save("mDistsToMarginMirrored.yml");
+        pPredictions[i]->setValidationParameters(kTest);
+        pPredictions[i]->setModelSelectionParameters(kModelSelec, true);
     }
-
-    // Depth
-    ModalityGridData dGridMetadata;
+    cPrediction.setDimensionalityReduction(colorVariance);
     
-    reader.readAllScenesMetadata("Depth", "png", hp, wp, dGridMetadata);
-    reader.loadDescription("Depth.yml", dGridMetadata);
+    ModalityGridData mGridMetadata, dGridMetadata, tGridMetadata, cGridMetadata;
     
-    GridMat dPredictions, dPredictionsMirrored;
-    GridMat dLoglikelihoods, dLoglikelihoodsMirrored;
-    GridMat dDistsToMargin, dDistsToMarginMirrored;
-
-    if (bIndividualPredictions)
-    {
-        cout << "Depth (individual prediction)" << endl;
+    GridMat mPredictions, mPredictionsMirrored, mDistsToMargin, mDistsToMarginMirrored;
+    GridMat dPredictions, dPredictionsMirrored, dDistsToMargin, dDistsToMarginMirrored;
+    GridMat tPredictions, tPredictionsMirrored, tDistsToMargin, tDistsToMarginMirrored;
+    GridMat cPredictions, cPredictionsMirrored, cDistsToMargin, cDistsToMarginMirrored;
     
-        prediction.setData(dGridMetadata);
-
-//        prediction.setModelSelection(bDepthTraining);
-//        prediction.setTrainMirrored(false);
-//        
-//        prediction.predict(dPredictions, dLoglikelihoods, dDistsToMargin);
-//        prediction.getAccuracy(dPredictions, accuraciesGrid);
-//        computeConfidenceInterval(accuraciesGrid, means, confs);
-//        cout << means << endl;
-//        cout << confs << endl;
-//        
-//        dPredictions.save("dPredictions.yml");
-//        dLoglikelihoods.save("dLoglikelihoods.yml");
-//        dDistsToMargin.save("dDistsToMargin.yml");
-//    
-//        prediction.setModelSelection(bDepthMirrTraining);
-//        prediction.setTrainMirrored(true);
-//        
-//        prediction.predict(dPredictionsMirrored, dLoglikelihoodsMirrored, dDistsToMarginMirrored);
-//        prediction.getAccuracy(dPredictionsMirrored, accuraciesGrid);
-//        computeConfidenceInterval(accuraciesGrid, means, confs);
-//        cout << means << endl;
-//        cout << confs << endl;
-//        
-//        dPredictionsMirrored.save("dPredictionsMirrored.yml");
-//        dLoglikelihoodsMirrored.save("dLoglikelihoodsMirrored.yml");
-//        dDistsToMarginMirrored.save("dDistsToMarginMirrored.yml");
-    }
-
-    // Thermal
-    ModalityGridData tGridMetadata;
+    // The descriptions and the individual predictions are keyed by their parametrizations, and by
+    // the files these are computed from (see describeModality and predictModality)
     
-    reader.readAllScenesMetadata("Thermal", "jpg", hp, wp,tGridMetadata);
-    reader.loadDescription("Thermal.yml", tGridMetadata);
+    ArtifactCache cache (config.cacheDir);
     
-    GridMat tPredictions, tPredictionsMirrored;
-    GridMat tLoglikelihoods, tLoglikelihoodsMirrored;
-    GridMat tDistsToMargin, tDistsToMarginMirrored;
-
-    if (bIndividualPredictions)
-    {
-        cout << "Thermal (individual prediction)" << endl;
-        
-        prediction.setData(tGridMetadata);
-
-//        prediction.setModelSelection(bThermalTraining);
-//        prediction.setTrainMirrored(false);
-//        
-//        prediction.predict(tPredictions, tLoglikelihoods, tDistsToMargin);
-//        prediction.getAccuracy(tPredictions, accuraciesGrid);
-//        computeConfidenceInterval(accuraciesGrid, means, confs);
-//        cout << means << endl;
-//        cout << confs << endl;
-//        
-//        tPredictions.save("tPredictions.yml");
-//        tLoglikelihoods.save("tLoglikelihoods.yml");
-//        tDistsToMargin.save("tDistsToMargin.yml");
-//
-//        prediction.setModelSelection(bThermalMirrTraining);
-//        prediction.setTrainMirrored(true);
-//        
-//        prediction.predict(tPredictionsMirrored, tLoglikelihoodsMirrored, tDistsToMarginMirrored);
-//        prediction.getAccuracy(tPredictionsMirrored, accuraciesGrid);
-//        computeConfidenceInterval(accuraciesGrid, means, confs);
-//        cout << means << endl;
-//        cout << confs << endl;
-//        
-//        tPredictionsMirrored.save("tPredictionsMirrored.yml");
-//        tLoglikelihoodsMirrored.save("tLoglikelihoodsMirrored.yml");
-//        tDistsToMarginMirrored.save("tDistsToMarginMirrored.yml");
-    }
-
-    // Color
-    ModalityGridData cGridMetadata;
+    std::vector<std::string> scenesPathsToDescribe;
+    for (int s = 0; s < descriptions.size(); s++)
+        scenesPathsToDescribe += sequencesPaths[descriptions[s]];
     
-    reader.readAllScenesMetadata("Color", "jpg", hp, wp, cGridMetadata);
-    reader.loadDescription("Color.yml", cGridMetadata);
+    ArtifactKey mDescriptionKey ("Motion description"), dDescriptionKey ("Depth description");
+    ArtifactKey tDescriptionKey ("Thermal description"), cDescriptionKey ("Color description");
+    mDescriptionKey << config.describe("features.motion") << (int) masksOffset;
+    dDescriptionKey << config.describe("features.depth") << (int) masksOffset;
+    tDescriptionKey << config.describe("features.thermal") << (int) masksOffset;
+    cDescriptionKey << config.describe("features.color") << (int) masksOffset;
+    
+    ArtifactKey mPredictionKey ("Motion prediction"), dPredictionKey ("Depth prediction");
+    ArtifactKey tPredictionKey ("Thermal prediction"), cPredictionKey ("Color prediction");
+    ArtifactKey* pPredictionKeys[] = { &mPredictionKey, &dPredictionKey, &tPredictionKey, &cPredictionKey };
+    for (int i = 0; i < 4; i++)
+        *pPredictionKeys[i] << config.describe("prediction") << config.describe("validation");
+    
+    cout << "Feature extraction, prediction of individual cells and consensus of the grid cells ... " << endl;
+    
+    TaskGraph graph;
+    
+    // Motion
     
-    GridMat cPredictions, cPredictionsMirrored;
-    GridMat cLoglikelihoods, cLoglikelihoodsMirrored;
-    GridMat cDistsToMargin, cDistsToMarginMirrored;
+    int mDescriptionTask = graph.addTask("Motion description",
+        boost::bind(&describeModality, boost::ref(reader), boost::ref(cache), mDescriptionKey, scenesPathsToDescribe, "Motion", "jpg", hp, wp, &mFE));
+    int mMetadataTask = graph.addTask("Motion metadata",
+        boost::bind(&readModalityMetadata, boost::ref(reader), "Motion", "jpg", hp, wp, boost::ref(mGridMetadata)), mDescriptionTask);
+    int mPredictionTask = mMetadataTask;
+//    if (config.isStage("individual"))
+//        mPredictionTask = graph.addTask("Motion prediction",
+//            boost::bind(&predictModality, boost::ref(mPrediction), boost::ref(mGridMetadata), "m", config.hasOption("individual", "m"), config.hasOption("individual", "M"),
+//                        boost::ref(cache), mPredictionKey, sequencesPaths, kTest), mMetadataTask);
+    graph.addTask("Motion consensus",
+        boost::bind(&computeModalityConsensus, boost::ref(mPrediction), boost::ref(mGridMetadata), "m", config.isStage("individual"),
+                    boost::ref(mPredictions), boost::ref(mDistsToMargin), boost::ref(mPredictionsMirrored), boost::ref(mDistsToMarginMirrored)), mPredictionTask);
     
-    if (bIndividualPredictions)
+    // Depth
+    
+    int dDescriptionTask = graph.addTask("Depth description",
+        boost::bind(&describeModality, boost::ref(reader), boost::ref(cache), dDescriptionKey, scenesPathsToDescribe, "Depth", "png", hp, wp, &dFE));
+    int dMetadataTask = graph.addTask("Depth metadata",
+        boost::bind(&readModalityMetadata, boost::ref(reader), "Depth", "png", hp, wp, boost::ref(dGridMetadata)), dDescriptionTask);
+    int dPredictionTask = dMetadataTask;
+//    if (config.isStage("individual"))
+//        dPredictionTask = graph.addTask("Depth prediction",
+//            boost::bind(&predictModality, boost::ref(dPrediction), boost::ref(dGridMetadata), "d", config.hasOption("individual", "d"), config.hasOption("individual", "D"),
+//                        boost::ref(cache), dPredictionKey, sequencesPaths, kTest), dMetadataTask);
+    graph.addTask("Depth consensus",
+        boost::bind(&computeModalityConsensus, boost::ref(dPrediction), boost::ref(dGridMetadata), "d", config.isStage("individual"),
+                    boost::ref(dPredictions), boost::ref(dDistsToMargin), boost::ref(dPredictionsMirrored), boost::ref(dDistsToMarginMirrored)), dPredictionTask);
+    
+    // Thermal
+    
+    int tDescriptionTask = graph.addTask("Thermal description",
+        boost::bind(&describeModality, boost::ref(reader), boost::ref(cache), tDescriptionKey, scenesPathsToDescribe, "Thermal", "jpg", hp, wp, &tFE));
+    int tMetadataTask = graph.addTask("Thermal metadata",
+        boost::bind(&readModalityMetadata, boost::ref(reader), "Thermal", "jpg", hp, wp, boost::ref(tGridMetadata)), tDescriptionTask);
+    int tPredictionTask = tMetadataTask;
+//    if (config.isStage("individual"))
+//        tPredictionTask = graph.addTask("Thermal prediction",
+//            boost::bind(&predictModality, boost::ref(tPrediction), boost::ref(tGridMetadata), "t", config.hasOption("individual", "t"), config.hasOption("individual", "T"),
+//                        boost::ref(cache), tPredictionKey, sequencesPaths, kTest), tMetadataTask);
+    graph.addTask("Thermal consensus",
+        boost::bind(&computeModalityConsensus, boost::ref(tPrediction), boost::ref(tGridMetadata), "t", config.isStage("individual"),
+                    boost::ref(tPredictions), boost::ref(tDistsToMargin), boost::ref(tPredictionsMirrored), boost::ref(tDistsToMarginMirrored)), tPredictionTask);
+    
+    // Color
+    
+    int cDescriptionTask = graph.addTask("Color description",
+        boost::bind(&describeModality, boost::ref(reader), boost::ref(cache), cDescriptionKey, scenesPathsToDescribe, "Color", "jpg", hp, wp, &cFE));
+    int cMetadataTask = graph.addTask("Color metadata",
+        boost::bind(&readModalityMetadata, boost::ref(reader), "Color", "jpg", hp, wp, boost::ref(cGridMetadata)), cDescriptionTask);
+    int cPredictionTask = cMetadataTask;
+    if (config.isStage("individual"))
+        cPredictionTask = graph.addTask("Color prediction",
+            boost::bind(&predictModality, boost::ref(cPrediction), boost::ref(cGridMetadata), "c", config.hasOption("individual", "c"), config.hasOption("individual", "C"),
+                        boost::ref(cache), cPredictionKey, sequencesPaths, kTest), cMetadataTask);
+    graph.addTask("Color consensus",
+        boost::bind(&computeModalityConsensus, boost::ref(cPrediction), boost::ref(cGridMetadata), "c", config.isStage("individual"),
+                    boost::ref(cPredictions), boost::ref(cDistsToMargin), boost::ref(cPredictionsMirrored), boost::ref(cDistsToMarginMirrored)), cPredictionTask);
+    
+    if (!graph.run())
     {
-        cout << "Color (individual prediction)" << endl;
-        
-        prediction.setData(cGridMetadata);
-        prediction.setDimensionalityReduction(colorVariance);
-        
-        prediction.setModelSelection(bColorTraining);
-        prediction.setTrainMirrored(false);
-        
-        prediction.predict(cPredictions, cLoglikelihoods, cDistsToMargin);
-        prediction.getAccuracy(cPredictions, accuraciesGrid);
-        computeConfidenceInterval(accuraciesGrid, means, confs);
-        cout << means << endl;
-        cout << confs << endl;
-        
-        cPredictions.save("cPredictions.yml");
-        cLoglikelihoods.save("cLoglikelihoods.yml");
-        cDistsToMargin.save("cDistsToMargin.yml");
-
-        prediction.setModelSelection(bColorMirrTraining);
-        prediction.setTrainMirrored(true);
-        
-        prediction.predict(cPredictionsMirrored, cLoglikelihoodsMirrored, cDistsToMarginMirrored);
-        
-        prediction.getAccuracy(cPredictionsMirrored, accuraciesGrid);
-        computeConfidenceInterval(accuraciesGrid, means, confs);
-        cout << means << endl;
-        cout << confs << endl;
-        
-        cPredictionsMirrored.save("cPredictionsMirrored.yml");
-        cLoglikelihoodsMirrored.save("cLoglikelihoodsMirrored.yml");
-        cDistsToMarginMirrored.save("cDistsToMarginMirrored.yml");
+        cerr << "Some modality could not be processed" << endl;
+        return -1;
     }
     
-    //
-    // Grid cells consensus
-    //
-    
     cv::Mat mConsensusPredictions, dConsensusPredictions, tConsensusPredictions, cConsensusPredictions;
     cv::Mat mConsensusDistsToMargin, dConsensusDistsToMargin, tConsensusDistsToMargin, cConsensusDistsToMargin;
     
     cv::Mat mConsensusPredictionsMirrored, dConsensusPredictionsMirrored, tConsensusPredictionsMirrored, cConsensusPredictionsMirrored;
     cv::Mat mConsensusDistsToMarginMirrored, dConsensusDistsToMarginMirrored, tConsensusDistsToMarginMirrored, cConsensusDistsToMarginMirrored;
-    
-    cout << "Consensus of the grid cells ... " << endl;
-
-    mPredictions.load("mPredictions.yml");
-    mDistsToMargin.load("mDistsToMargin.yml");
-    mPredictionsMirrored.load("mPredictionsMirrored.yml");
-    mDistsToMarginMirrored.load("mDistsToMarginMirrored.yml");
-    
-    dPredictions.load("dPredictions.yml");
-    dDistsToMargin.load("dDistsToMargin.yml");
-    dPredictionsMirrored.load("dPredictionsMirrored.yml");
-    dDistsToMarginMirrored.load("dDistsToMarginMirrored.yml");
-    
-    tPredictions.load("tPredictions.yml");
-    tDistsToMargin.load("tDistsToMargin.yml");
-    tPredictionsMirrored.load("tPredictionsMirrored.yml");
-    tDistsToMarginMirrored.load("tDistsToMarginMirrored.yml");
-    
-    cPredictions.load("cPredictions.yml");
-    cDistsToMargin.load("cDistsToMargin.yml");
-    cPredictionsMirrored.load("cPredictionsMirrored.yml");
-    cDistsToMarginMirrored.load("cDistsToMarginMirrored.yml");
-
-    if  (bIndividualPredictions)
-    {
-        // Motion
-        
-        prediction.setData(mGridMetadata);
-        
-        prediction.setPredictions(mPredictions);
-        prediction.setDistsToMargin(mDistsToMargin);
-        prediction.computeGridConsensusPredictions(mConsensusPredictions, mConsensusDistsToMargin);
-        prediction.getAccuracy(mConsensusPredictions, accuracies);
-        computeConfidenceInterval(accuracies, &mean, &conf);
-        cout << "Motion modality (c): " << mean << " ± " << conf << endl;
-        
-        aux.setTo(mConsensusPredictions); // predictions map generation purposes
-        aux.save("mGridConsensusPredictions.yml");
-        aux.setTo(mConsensusDistsToMargin);
-        aux.save("mGridConsensusDistsToMargin.yml");
-        
-        prediction.setPredictions(mPredictionsMirrored);
-        prediction.setDistsToMargin(mDistsToMarginMirrored);
-        prediction.computeGridConsensusPredictions(mConsensusPredictionsMirrored, mConsensusDistsToMarginMirrored);
-        prediction.getAccuracy(mConsensusPredictionsMirrored, accuracies);
-        computeConfidenceInterval(accuracies, &mean, &conf);
-        cout << "Motion mirrored modality (c): " << mean << " ± " << conf << endl;
-        
-        aux.setTo(mConsensusPredictionsMirrored); // predictions map generation purposes
-        aux.save("mGridConsensusPredictionsMirrored.yml");
-        aux.setTo(mConsensusDistsToMarginMirrored);
-        aux.save("mGridConsensusDistsToMarginMirrored.yml");
-
-        // Depth
-        
-        prediction.setData(dGridMetadata);
-        
-        prediction.setPredictions(dPredictions);
-        prediction.setDistsToMargin(dDistsToMargin);
-        prediction.computeGridConsensusPredictions(dConsensusPredictions, dConsensusDistsToMargin);
-        prediction.getAccuracy(dConsensusPredictions, accuracies);
-        computeConfidenceInterval(accuracies, &mean, &conf);
-        cout << "Depth modality (c): " << mean << " ± " << conf << endl;
-        
-        aux.setTo(dConsensusPredictions); // predictions map generation purposes
-        aux.save("dGridConsensusPredictions.yml");
-        aux.setTo(dConsensusDistsToMargin);
-        aux.save("dGridConsensusDistsToMargin.yml");
-
-        prediction.setPredictions(dPredictionsMirrored);
-        prediction.setDistsToMargin(dDistsToMarginMirrored);
-        prediction.computeGridConsensusPredictions(dConsensusPredictionsMirrored, dConsensusDistsToMarginMirrored);
-        prediction.getAccuracy(dConsensusPredictionsMirrored, accuracies);
-        computeConfidenceInterval(accuracies, &mean, &conf);
-        cout << "Depth mirrored modality (c): " << mean << " ± " << conf << endl;
-        
-        aux.setTo(dConsensusPredictionsMirrored); // predictions map generation purposes
-        aux.save("dGridConsensusPredictionsMirrored.yml");
-        aux.setTo(dConsensusDistsToMarginMirrored);
-        aux.save("dGridConsensusDistsToMarginMirrored.yml");
-
-        // Thermal
-        
-        prediction.setData(tGridMetadata);
-        
-        prediction.setPredictions(tPredictions);
-        prediction.setDistsToMargin(tDistsToMargin);
-        prediction.computeGridConsensusPredictions(tConsensusPredictions, tConsensusDistsToMargin);
-        prediction.getAccuracy(tConsensusPredictions, accuracies);
-        computeConfidenceInterval(accuracies, &mean, &conf);
-        cout << "Thermal modality (c): " << mean << " ± " << conf << endl;
-        
-        aux.setTo(tConsensusPredictions); // predictions map generation purposes
-        aux.save("tGridConsensusPredictions.yml");
-        aux.setTo(tConsensusDistsToMargin);
-        aux.save("tGridConsensusDistsToMargin.yml");
-        
-        prediction.setPredictions(tPredictionsMirrored);
-        prediction.setDistsToMargin(tDistsToMarginMirrored);
-        prediction.computeGridConsensusPredictions(tConsensusPredictionsMirrored, tConsensusDistsToMarginMirrored);
-        prediction.getAccuracy(tConsensusPredictionsMirrored, accuracies);
-        computeConfidenceInterval(accuracies, &mean, &conf);
-        cout << "Thermal mirrored modality (c): " << mean << " ± " << conf << endl;
-        
-        aux.setTo(tConsensusPredictionsMirrored); // predictions map generation purposes
-        aux.save("tGridConsensusPredictionsMirrored.yml");
-        aux.setTo(tConsensusDistsToMarginMirrored);
-        aux.save("tGridConsensusDistsToMarginMirrored.yml");
-
-        // Color
-        
-        prediction.setData(cGridMetadata);
-        
-        prediction.setPredictions(cPredictions);
-        prediction.setDistsToMargin(cDistsToMargin);
-        prediction.computeGridConsensusPredictions(cConsensusPredictions, cConsensusDistsToMargin);
-        prediction.getAccuracy(cConsensusPredictions, accuracies);
-        computeConfidenceInterval(accuracies, &mean, &conf);
-        cout << "Color modality (c): " << mean << " ± " << conf << endl;
-        
-        aux.setTo(cConsensusPredictions); // predictions map generation purposes
-        aux.save("cGridConsensusPredictions.yml");
-        aux.setTo(cConsensusDistsToMargin);
-        aux.save("cGridConsensusDistsToMargin.yml");
-        
-        prediction.setPredictions(cPredictionsMirrored);
-        prediction.setDistsToMargin(cDistsToMarginMirrored);
-        prediction.computeGridConsensusPredictions(cConsensusPredictionsMirrored, cConsensusDistsToMarginMirrored);
-        prediction.getAccuracy(cConsensusPredictionsMirrored, accuracies);
-        computeConfidenceInterval(accuracies, &mean, &conf);
-        cout << "Color mirrored modality (c): " << mean << " ± " << conf << endl;
-
-        aux.setTo(cConsensusPredictionsMirrored); // predictions map generation purposes
-        aux.save("cGridConsensusPredictionsMirrored.yml");
-        aux.setTo(cConsensusDistsToMarginMirrored);
-        aux.save("cGridConsensusDistsToMarginMirrored.yml");
-    }
 
     //
     // Fusion
@@ -1080,7 +684,7 @@ int main(int argc, char** argv)
  
     // Simple fusion
     
-    if (bSimpleFusion)
+    if (config.isStage("simpleFusion"))
     {
         cout << "... naive approach" << endl;
         
@@ -1142,7 +746,7 @@ int main(int argc, char** argv)
         aux.save("simpleFusionPredictionsMirrored3.yml");
     }
 
-    if (bLearningFusion)
+    if (config.isStage("learningFusion"))
     {
         // Boost
         cout << "... Boost approach" << endl;
@@ -1158,7 +762,7 @@ int main(int argc, char** argv)
         boostFusion.setWeightTrimRate(weightTrimRates);
         
         boostFusion.setData(mgds, distsToMargin, consensuedPredictions);
-        boostFusion.setModelSelection(bAdaboostTraining);
+        boostFusion.setModelSelection(config.hasOption("learningFusion", "ada"));
         boostFusion.setTrainMirrored(false);
         
         boostFusion.predict(boostFusionPredictions);
@@ -1169,7 +773,7 @@ int main(int argc, char** argv)
         aux.save("boostFusionPredictions.yml");
         
         boostFusion.setData(mgds, distsToMarginMirrored, consensuedPredictionsMirrored);
-        boostFusion.setModelSelection(bAdaboostMirrTraining);
+        boostFusion.setModelSelection(config.hasOption("learningFusion", "ADA"));
         boostFusion.setTrainMirrored(true);
 
         boostFusion.predict(boostFusionPredictionsMirrored);
@@ -1197,7 +801,7 @@ int main(int argc, char** argv)
         mlpFusion.setActivationFunctionType(CvANN_MLP::SIGMOID_SYM);
         
         mlpFusion.setData(mgds, distsToMargin, consensuedPredictions);
-        mlpFusion.setModelSelection(bMlpSigmoidTraining);
+        mlpFusion.setModelSelection(config.hasOption("learningFusion", "mlpsig"));
         mlpFusion.setTrainMirrored(false);
 
         mlpFusion.predict(mlpSigmoidFusionPredictions);
@@ -1208,7 +812,7 @@ int main(int argc, char** argv)
         aux.save("mlpSigmoidFusionPredictions.yml");
         
         mlpFusion.setData(mgds, distsToMarginMirrored, consensuedPredictionsMirrored);
-        mlpFusion.setModelSelection(bMlpSigmoidMirrTraining);
+        mlpFusion.setModelSelection(config.hasOption("learningFusion", "MLPsig"));
         mlpFusion.setTrainMirrored(true);
         
         mlpFusion.predict(mlpSigmoidFusionPredictionsMirrored);
@@ -1222,7 +826,7 @@ int main(int argc, char** argv)
         mlpFusion.setActivationFunctionType(CvANN_MLP::GAUSSIAN);
 
         mlpFusion.setData(mgds, distsToMargin, consensuedPredictions);
-        mlpFusion.setModelSelection(bMlpGaussianTraining);
+        mlpFusion.setModelSelection(config.hasOption("learningFusion", "mlpgau"));
         mlpFusion.setTrainMirrored(false);
         
         mlpFusion.predict(mlpGaussianFusionPredictions);
@@ -1233,7 +837,7 @@ int main(int argc, char** argv)
         aux.save("mlpGaussianFusionPredictions.yml");
         
         mlpFusion.setData(mgds, distsToMarginMirrored, consensuedPredictionsMirrored);
-        mlpFusion.setModelSelection(bMlpGaussianMirrTraining);
+        mlpFusion.setModelSelection(config.hasOption("learningFusion", "MLPgau"));
         mlpFusion.setTrainMirrored(true);
         
         mlpFusion.predict(mlpGaussianFusionPredictionsMirrored);
@@ -1261,7 +865,7 @@ int main(int argc, char** argv)
         svmFusion.setKernelType(CvSVM::LINEAR);
 
         svmFusion.setData(mgds, distsToMargin, consensuedPredictions);
-        svmFusion.setModelSelection(bSvmLinearTraining);
+        svmFusion.setModelSelection(config.hasOption("learningFusion", "svmlin"));
         svmFusion.setTrainMirrored(false);
         
         svmFusion.predict(svmLinearFusionPredictions);
@@ -1272,7 +876,7 @@ int main(int argc, char** argv)
         aux.save("svmLinearFusionPredictions.yml");
         
         svmFusion.setData(mgds, distsToMarginMirrored, consensuedPredictionsMirrored);
-        svmFusion.setModelSelection(bSvmLinearMirrTraining);
+        svmFusion.setModelSelection(config.hasOption("learningFusion", "SVMlin"));
         svmFusion.setTrainMirrored(true);
         
         svmFusion.predict(svmLinearFusionPredictionsMirrored);
@@ -1289,7 +893,7 @@ int main(int argc, char** argv)
         svmFusion.setGammas(gammas);
         
         svmFusion.setData(mgds, distsToMargin, consensuedPredictions);
-        svmFusion.setModelSelection(bSvmRBFTraining);
+        svmFusion.setModelSelection(config.hasOption("learningFusion", "svmrbf"));
         svmFusion.setTrainMirrored(false);
         
         svmFusion.predict(svmRBFFusionPredictions);
@@ -1300,7 +904,7 @@ int main(int argc, char** argv)
         aux.save("svmRBFFusionPredictions.yml");
         
         svmFusion.setData(mgds, distsToMarginMirrored, consensuedPredictionsMirrored);
-        svmFusion.setModelSelection(bSvmRBFMirrTraining);
+        svmFusion.setModelSelection(config.hasOption("learningFusion", "SVMrbf"));
         svmFusion.setTrainMirrored(true);
         
         svmFusion.predict(svmRBFFusionPredictionsMirrored);
@@ -1325,7 +929,7 @@ int main(int argc, char** argv)
         rfFusion.setNoVars(noVars);
         
         rfFusion.setData(mgds, distsToMargin, consensuedPredictions);
-        rfFusion.setModelSelection(bRFTraining);
+        rfFusion.setModelSelection(config.hasOption("learningFusion", "rf"));
         rfFusion.setTrainMirrored(false);
         
         rfFusion.predict(rfFusionPredictions);
@@ -1336,7 +940,7 @@ int main(int argc, char** argv)
         aux.save("rfFusionPredictions.yml");
         
         rfFusion.setData(mgds, distsToMarginMirrored, consensuedPredictionsMirrored);
-        rfFusion.setModelSelection(bRFMirrTraining);
+        rfFusion.setModelSelection(config.hasOption("learningFusion", "RF"));
         rfFusion.setTrainMirrored(true);
         
         rfFusion.predict(rfFusionPredictionsMirrored);
@@ -1351,38 +955,38 @@ int main(int argc, char** argv)
     // Map writing
     //
     
-    if (bMapGeneration)
+    if (config.isStage("maps"))
     {
         std::cout << "Generating maps of predictions... " << std::endl;
         
         GridMapWriter mapWriter;
         GridMat g;
         
-        if (bHoofMapGeneration)
+        if (config.hasOption("maps", "hoof"))
         {
             g.load("mGridConsensusPredictions.yml");
             std::cout << "Motion/Predictions/" << std::endl;
             mapWriter.write<unsigned char>(mGridMetadata, g, "Motion/Predictions/");
         }
-        if (bHonMapGeneration)
+        if (config.hasOption("maps", "hon"))
         {
             g.load("dGridConsensusPredictions.yml");
             std::cout << "Depth/Predictions/" << std::endl;
             mapWriter.write<unsigned char>(dGridMetadata, g, "Depth/Predictions/");
         }
-        if (bHiogMapGeneration)
+        if (config.hasOption("maps", "hiog"))
         {
             g.load("tGridConsensusPredictions.yml");
             std::cout << "Thermal/Predictions/"<< std::endl;
             mapWriter.write<unsigned char>(tGridMetadata, g, "Thermal/Predictions/");
         }
-        if (bHogMapGeneration)
+        if (config.hasOption("maps", "hog"))
         {
             g.load("cGridConsensusPredictions.yml");
             std::cout << "Color/Predictions/" << std::endl;
             mapWriter.write<unsigned char>(cGridMetadata, g, "Color/Predictions/");
         }
-        if (bPreconsensusMapGeneration)
+        if (config.hasOption("maps", "precons"))
         {
             g.load("simpleFusionPredictions1.yml");
             std::cout << "Simple_1_fusion/Predictions/" << std::endl;
@@ -1392,7 +996,7 @@ int main(int argc, char** argv)
             std::cout << "Simple_1_fusion/Thermal/Predictions/" << std::endl;
             mapWriter.write<unsigned char>(tGridMetadata, g, "Simple_1_fusion/Thermal/Predictions/");
         }
-        if (bPostconsensusMapGeneration)
+        if (config.hasOption("maps", "postcons"))
         {
             g.load("simpleFusionPredictions2.yml");
             std::cout << "Simple_2_fusion/Predictions/" << std::endl;
@@ -1402,7 +1006,7 @@ int main(int argc, char** argv)
             std::cout << "Simple_2_fusion/Thermal/Predictions/" << std::endl;
             mapWriter.write<unsigned char>(tGridMetadata, g, "Simple_2_fusion/Thermal/Predictions/");
         }
-        if (bDistBasedConsensusMapGeneration)
+        if (config.hasOption("maps", "distcons"))
         {
             g.load("simpleFusionPredictions3.yml");
             std::cout << "Simple_3_fusion/Predictions/" << std::endl;
@@ -1412,7 +1016,7 @@ int main(int argc, char** argv)
             std::cout << "Simple_3_fusion/Thermal/Predictions/" << std::endl;
             mapWriter.write<unsigned char>(tGridMetadata, g, "Simple_3_fusion/Thermal/Predictions/");
         }
-        if (bAdaboostMapGeneration)
+        if (config.hasOption("maps", "ada"))
         {
             g.load("boostFusionPredictions.yml");
             std::cout << "Boost_fusion/Predictions/" << std::endl;
@@ -1422,7 +1026,7 @@ int main(int argc, char** argv)
             std::cout << "Boost_fusion/Thermal/Predictions/" << std::endl;
             mapWriter.write<unsigned char>(tGridMetadata, g, "Boost_fusion/Thermal/Predictions/");
         }
-        if (bMlpSigmoidMapGeneration)
+        if (config.hasOption("maps", "mlpsig"))
         {
             g.load("mlpSigmoidFusionPredictions.yml");
             std::cout << "MLP_sigmoid_fusion/Predictions/" << std::endl;
@@ -1432,7 +1036,7 @@ int main(int argc, char** argv)
             std::cout << "MLP_sigmoid_fusion/Thermal/Predictions/" << std::endl;
             mapWriter.write<unsigned char>(tGridMetadata, g, "MLP_sigmoid_fusion/Thermal/Predictions/");
         }
-        if (bMlpGaussianMapGeneration)
+        if (config.hasOption("maps", "mlpgau"))
         {
             g.load("mlpGaussianFusionPredictions.yml");
             std::cout << "MLP_gaussian_fusion/Predictions/" << std::endl;
@@ -1442,7 +1046,7 @@ int main(int argc, char** argv)
             std::cout << "MLP_gaussian_fusion/Thermal/Predictions/" << std::endl;
             mapWriter.write<unsigned char>(tGridMetadata, g, "MLP_gaussian_fusion/Thermal/Predictions/");
         }
-        if (bSvmLinearMapGeneration)
+        if (config.hasOption("maps", "svmlin"))
         {
             g.load("svmLinearFusionPredictions.yml");
             std::cout << "SVM_linear_fusion/Predictions/" << std::endl;
@@ -1452,7 +1056,7 @@ int main(int argc, char** argv)
             std::cout << "SVM_linear_fusion/Thermal/Predictions/" << std::endl;
             mapWriter.write<unsigned char>(tGridMetadata, g, "SVM_linear_fusion/Thermal/Predictions/");
         }
-        if (bSvmRBFMapGeneration)
+        if (config.hasOption("maps", "svmrbf"))
         {
             g.load("svmRBFFusionPredictions.yml");
             std::cout << "SVM_rbf_fusion/Predictions/" << std::endl;
@@ -1462,7 +1066,7 @@ int main(int argc, char** argv)
             std::cout << "SVM_rbf_fusion/Thermal/Predictions/" << std::endl;
             mapWriter.write<unsigned char>(tGridMetadata, g, "SVM_rbf_fusion/Thermal/Predictions/");
         }
-        if (bRFMapGeneration)
+        if (config.hasOption("maps", "rf"))
         {
             g.load("rfFusionPredictions.yml");
             std::cout << "RF_fusion/Predictions/" << std::endl;
@@ -1478,31 +1082,31 @@ int main(int argc, char** argv)
         // Mirrored
         //
         
-        if (bHogMirrMapGeneration)
+        if (config.hasOption("maps", "HOG"))
         {
             g.load("cGridConsensusPredictionsMirrored.yml");
             std::cout << "Color_mirrored/Predictions/" << std::endl;
             mapWriter.write<unsigned char>(cGridMetadata, g, "Color_mirrored/Predictions/");
         }
-        if (bHoofMirrMapGeneration)
+        if (config.hasOption("maps", "HOOF"))
         {
             g.load("mGridConsensusPredictionsMirrored.yml");
             std::cout << "Motion_mirrored/Predictions/" << std::endl;
             mapWriter.write<unsigned char>(mGridMetadata, g, "Motion_mirrored/Predictions/");
         }
-        if (bHonMirrMapGeneration)
+        if (config.hasOption("maps", "HON"))
         {
             g.load("dGridConsensusPredictionsMirrored.yml");
             std::cout << "Depth_mirrored/Predictions/" << std::endl;
             mapWriter.write<unsigned char>(dGridMetadata, g, "Depth_mirrored/Predictions/");
         }
-        if (bHiogMirrMapGeneration)
+        if (config.hasOption("maps", "HIOG"))
         {
             g.load("tGridConsensusPredictionsMirrored.yml");
             std::cout << "Thermal_mirrored/Predictions/" << std::endl;
             mapWriter.write<unsigned char>(tGridMetadata, g, "Thermal_mirrored/Predictions/");
         }
-        if (bPreconsensusMirrMapGeneration)
+        if (config.hasOption("maps", "PRECONS"))
         {
             g.load("simpleFusionPredictionsMirrored1.yml");
             std::cout << "Simple_1_fusion_mirrored/Predictions/" << std::endl;
@@ -1512,7 +1116,7 @@ int main(int argc, char** argv)
             std::cout << "Simple_1_fusion_mirrored/Thermal/Predictions/" << std::endl;
             mapWriter.write<unsigned char>(tGridMetadata, g, "Simple_1_fusion_mirrored/Thermal/Predictions/");
         }
-        if (bPostconsensusMirrMapGeneration)
+        if (config.hasOption("maps", "POSTCONS"))
         {
             g.load("simpleFusionPredictionsMirrored2.yml");
             std::cout << "Simple_2_fusion_mirrored/Predictions/" << std::endl;
@@ -1522,7 +1126,7 @@ int main(int argc, char** argv)
             std::cout << "Simple_2_fusion_mirrored/Thermal/Predictions/" << std::endl;
             mapWriter.write<unsigned char>(tGridMetadata, g, "Simple_2_fusion_mirrored/Thermal/Predictions/");
         }
-        if (bDistBasedConsensusMirrMapGeneration)
+        if (config.hasOption("maps", "DISTCONS"))
         {
             g.load("simpleFusionPredictionsMirrored3.yml");
             std::cout << "Simple_3_fusion_mirrored/Predictions/" << std::endl;
@@ -1532,7 +1136,7 @@ int main(int argc, char** argv)
             std::cout << "Simple_3_fusion_mirrored/Thermal/Predictions/" << std::endl;
             mapWriter.write<unsigned char>(tGridMetadata, g, "Simple_3_fusion_mirrored/Thermal/Predictions/");
         }
-        if (bAdaboostMirrMapGeneration)
+        if (config.hasOption("maps", "ADA"))
         {
             g.load("boostFusionPredictionsMirrored.yml");
             std::cout << "Boost_fusion_mirrored/Predictions/" << std::endl;
@@ -1542,7 +1146,7 @@ int main(int argc, char** argv)
             std::cout << "Boost_fusion_mirrored/Thermal/Predictions/" << std::endl;
             mapWriter.write<unsigned char>(tGridMetadata, g, "Boost_fusion_mirrored/Thermal/Predictions/");
         }
-        if (bMlpSigmoidMirrMapGeneration)
+        if (config.hasOption("maps", "MLPsig"))
         {
             g.load("mlpSigmoidFusionPredictionsMirrored.yml");
             std::cout << "MLP_sigmoid_fusion_mirrored/Predictions/" << std::endl;
@@ -1552,7 +1156,7 @@ int main(int argc, char** argv)
             std::cout << "MLP_sigmoid_fusion_mirrored/Thermal/Predictions/" << std::endl;
             mapWriter.write<unsigned char>(tGridMetadata, g, "MLP_sigmoid_fusion_mirrored/Thermal/Predictions/");
         }
-        if (bMlpGaussianMirrMapGeneration)
+        if (config.hasOption("maps", "MLPgau"))
         {
             g.load("mlpGaussianFusionPredictionsMirrored.yml");
             std::cout << "MLP_gaussian_fusion_mirrored/Predictions/" << std::endl;
@@ -1562,7 +1166,7 @@ int main(int argc, char** argv)
             std::cout << "MLP_gaussian_fusion_mirrored/Thermal/Predictions/" << std::endl;
             mapWriter.write<unsigned char>(tGridMetadata, g, "MLP_gaussian_fusion_mirrored/Thermal/Predictions/");
         }
-        if (bSvmLinearMirrMapGeneration)
+        if (config.hasOption("maps", "SVMlin"))
         {
             g.load("svmLinearFusionPredictionsMirrored.yml");
             std::cout << "SVM_linear_fusion_mirrored/Predictions/" << std::endl;
@@ -1572,7 +1176,7 @@ int main(int argc, char** argv)
             std::cout << "SVM_linear_fusion_mirrored/Thermal/Predictions/" << std::endl;
             mapWriter.write<unsigned char>(tGridMetadata, g, "SVM_linear_fusion_mirrored/Thermal/Predictions/");
         }
-        if (bSvmRBFMirrMapGeneration)
+        if (config.hasOption("maps", "SVMrbf"))
         {
             g.load("svmRBFFusionPredictionsMirrored.yml");
             std::cout << "SVM_rbf_fusion_mirrored/Predictions/" << std::endl;
@@ -1583,7 +1187,7 @@ int main(int argc, char** argv)
             mapWriter.write<unsigned char>(tGridMetadata, g, "SVM_rbf_fusion_mirrored/Thermal/Predictions/");
 
         }
-        if (bRFMirrMapGeneration)
+        if (config.hasOption("maps", "RF"))
         {
             g.load("rfFusionPredictionsMirrored.yml");
             std::cout << "RF_fusion_mirrored/Predictions/" << std::endl;
@@ -1600,7 +1204,7 @@ int main(int argc, char** argv)
     // Overlap
     //
     
-    if (bComputeOverlaps)
+    if (config.isStage("overlaps"))
     {
         std::cout << "Computing ovelaps ... " << std::endl;
     
@@ -1609,397 +1213,236 @@ int main(int argc, char** argv)
      
         //Individual..
         
-        cv::Mat overlapIDs, partitionedMeanOverlap, partitions = reader.getAllScenesPartition();
+        cv::Mat partitionedMeanOverlap, partitions = reader.getAllScenesPartition();
         vector<cv::Mat> partitionedOverlapIDs;
         
         
         //Motion
         std::cout << "Motion" << std::endl;
-        overlapIDs.release();
-        for (int s = 0; s < sequencesPaths.size(); s++)
         {
             boost::timer t;
-            ModalityData motionData;
-            cout << "Reading motion data in scene " << s << ".." << endl;
-            reader.overlapreadScene("Motion", "Color", sequencesPaths[s], "png", motionData);
-            validate.getOverlap(motionData, overlapIDs);
+            validate.getPartitionedOverlap(reader, "Motion", "Color", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
             cout << "Elapsed time: " << t.elapsed() << endl;
         }
-        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
         validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "mGridConsensusOverlap.yml");
         
         
         //Depth
         std::cout << "Depth" << std::endl;
-        overlapIDs.release();
-        for (int s = 0; s < sequencesPaths.size(); s++)
         {
             boost::timer t;
-            ModalityData depthData;
-            cout << "Reading depth data in scene " << s << ".." << endl;
-            reader.overlapreadScene("Depth", "Depth", sequencesPaths[s], "png", depthData);
-            validate.getOverlap(depthData, overlapIDs);
+            validate.getPartitionedOverlap(reader, "Depth", "Depth", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
             cout << "Elapsed time: " << t.elapsed() << endl;
         }
-        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
         validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "dGridConsensusOverlap.yml");
         
         
         //Thermal
         std::cout << "Thermal" << std::endl;
-        overlapIDs.release();
-        for (int s = 0; s < sequencesPaths.size(); s++)
         {
             boost::timer t;
-            ModalityData thermalData;
-            cout << "Reading thermal data in scene " << s << ".." << endl;
-            reader.overlapreadScene("Thermal", "Thermal", sequencesPaths[s], "png", thermalData);
-            validate.getOverlap(thermalData, overlapIDs);
+            validate.getPartitionedOverlap(reader, "Thermal", "Thermal", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
             cout << "Elapsed time: " << t.elapsed() << endl;
         }
-        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
         validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "tGridConsensusOverlap.yml");
         
         
         //Color
         std::cout << "Color" << std::endl;
-        overlapIDs.release();
-        for (int s = 0; s < sequencesPaths.size(); s++)
         {
             boost::timer t;
-            ModalityData colorData;
-            cout << "Reading color data in scene " << s << ".." << endl;
-            reader.overlapreadScene("Color", "Color", sequencesPaths[s], "png", colorData);
-            validate.getOverlap(colorData, overlapIDs);
+            validate.getPartitionedOverlap(reader, "Color", "Color", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
             cout << "Elapsed time: " << t.elapsed() << endl;
         }
-        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
         validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "cGridConsensusOverlap.yml");
         
         
         //Simple fusion 1 - color
         std::cout << "Simple fusion 1 - color" << std::endl;
-        overlapIDs.release();
-        for (int s = 0; s < sequencesPaths.size(); s++)
         {
             boost::timer t;
-            ModalityData colorData;
-            cout << "Reading color data in scene " << s << ".." << endl;
-            reader.overlapreadScene("Simple_1_fusion", "Color", sequencesPaths[s], "png", colorData);
-            validate.getOverlap(colorData, overlapIDs);
+            validate.getPartitionedOverlap(reader, "Simple_1_fusion", "Color", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
             cout << "Elapsed time: " << t.elapsed() << endl;
         }
-        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
         validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "cSimpleFusionOverlap1.yml");
         
         
         //Simple fusion 1 - thermal
         std::cout << "Simple fusion 1 - thermal" << std::endl;
-        overlapIDs.release();
-        for (int s = 0; s < sequencesPaths.size(); s++)
         {
             boost::timer t;
-            ModalityData thermalData;
-            cout << "Reading thermal data in scene " << s << ".." << endl;
-            reader.overlapreadScene("Simple_1_fusion", "Thermal", sequencesPaths[s], "png", thermalData);
-            validate.getOverlap(thermalData, overlapIDs);
+            validate.getPartitionedOverlap(reader, "Simple_1_fusion", "Thermal", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
             cout << "Elapsed time: " << t.elapsed() << endl;
         }
-        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
         validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "tSimpleFusionOverlap1.yml");
         
         
         //Simple fusion 2 - color
         std::cout << "Simple fusion 2 - color" << std::endl;
-        overlapIDs.release();
-        for (int s = 0; s < sequencesPaths.size(); s++)
         {
             boost::timer t;
-            ModalityData colorData;
-            cout << "Reading color data in scene " << s << ".." << endl;
-            reader.overlapreadScene("Simple_2_fusion", "Color", sequencesPaths[s], "png", colorData);
-            validate.getOverlap(colorData, overlapIDs);
+            validate.getPartitionedOverlap(reader, "Simple_2_fusion", "Color", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
             cout << "Elapsed time: " << t.elapsed() << endl;
         }
-        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
         validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "cSimpleFusionOverlap2.yml");
         
         
         //Simple fusion 3 - color
         std::cout << "Simple fusion 3 - color" << std::endl;
-        overlapIDs.release();
-        for (int s = 0; s < sequencesPaths.size(); s++)
         {
             boost::timer t;
-            ModalityData colorData;
-            cout << "Reading color data in scene " << s << ".." << endl;
-            reader.overlapreadScene("Simple_3_fusion", "Color", sequencesPaths[s], "png", colorData);
-            validate.getOverlap(colorData, overlapIDs);
+            validate.getPartitionedOverlap(reader, "Simple_3_fusion", "Color", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
             cout << "Elapsed time: " << t.elapsed() << endl;
         }
-        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
         validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "cSimpleFusionOverlap3.yml");
         
         
         //Simple fusion 2 - thermal
         std::cout << "Simple fusion 2 - thermal" << std::endl;
-        overlapIDs.release();
-        for (int s = 0; s < sequencesPaths.size(); s++)
         {
             boost::timer t;
-            ModalityData thermalData;
-            cout << "Reading thermal data in scene " << s << ".." << endl;
-            reader.overlapreadScene("Simple_2_fusion/Thermal", "Thermal", sequencesPaths[s], "png", thermalData);
-            validate.getOverlap(thermalData, overlapIDs);
+            validate.getPartitionedOverlap(reader, "Simple_2_fusion/Thermal", "Thermal", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
             cout << "Elapsed time: " << t.elapsed() << endl;
         }
-        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
         validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "tSimpleFusionOverlap2.yml");
         
         
         
         //Simple fusion 1 - thermal
         std::cout << "Simple fusion 1 - thermal" << std::endl;
-        overlapIDs.release();
-        for (int s = 0; s < sequencesPaths.size(); s++)
         {
             boost::timer t;
-            ModalityData thermalData;
-            cout << "Reading thermal data in scene " << s << ".." << endl;
-            reader.overlapreadScene("Simple_1_fusion/Thermal", "Thermal", sequencesPaths[s], "png", thermalData);
-            validate.getOverlap(thermalData, overlapIDs);
+            validate.getPartitionedOverlap(reader, "Simple_1_fusion/Thermal", "Thermal", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
             cout << "Elapsed time: " << t.elapsed() << endl;
         }
-        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
         validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "tSimpleFusionOverlap1.yml");
         
         
         //Simple fusion 3 - thermal
         std::cout << "Simple fusion 3 - thermal" << std::endl;
-        overlapIDs.release();
-        for (int s = 0; s < sequencesPaths.size(); s++)
         {
             boost::timer t;
-            ModalityData thermalData;
-            cout << "Reading thermal data in scene " << s << ".." << endl;
-            reader.overlapreadScene("Simple_3_fusion/Thermal", "Thermal", sequencesPaths[s], "png", thermalData);
-            validate.getOverlap(thermalData, overlapIDs);
+            validate.getPartitionedOverlap(reader, "Simple_3_fusion/Thermal", "Thermal", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
             cout << "Elapsed time: " << t.elapsed() << endl;
         }
-        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
         validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "tSimpleFusionOverlap3.yml");
         
         
         //Boost fusion - color
         std::cout << "Boost fusion - color" << std::endl;
-        overlapIDs.release();
-        for (int s = 0; s < sequencesPaths.size(); s++)
         {
             boost::timer t;
-            ModalityData colorData;
-            cout << "Reading color data in scene " << s << ".." << endl;
-            reader.overlapreadScene("Boost_fusion", "Color", sequencesPaths[s], "png", colorData);
-            validate.getOverlap(colorData, overlapIDs);
+            validate.getPartitionedOverlap(reader, "Boost_fusion", "Color", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
             cout << "Elapsed time: " << t.elapsed() << endl;
         }
-        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
         validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "cBoostFusionOverlap.yml");
         
         
         //Boost fusion - thermal
         std::cout << "Boost fusion - thermal" << std::endl;
-        overlapIDs.release();
-        for (int s = 0; s < sequencesPaths.size(); s++)
         {
             boost::timer t;
-            ModalityData thermalData;
-            cout << "Reading thermal data in scene " << s << ".." << endl;
-            reader.overlapreadScene("Boost_fusion/Thermal", "Thermal", sequencesPaths[s], "png", thermalData);
-            validate.getOverlap(thermalData, overlapIDs);
+            validate.getPartitionedOverlap(reader, "Boost_fusion/Thermal", "Thermal", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
             cout << "Elapsed time: " << t.elapsed() << endl;
         }
-        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
         validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "tBoostFusionOverlap.yml");
         
         
         //SVM linear fusion - color
         std::cout << "SVM linear fusion - color" << std::endl;
-        overlapIDs.release();
-        for (int s = 0; s < sequencesPaths.size(); s++)
         {
             boost::timer t;
-            ModalityData colorData;
-            cout << "Reading color data in scene " << s << ".." << endl;
-            reader.overlapreadScene("SVM_linear_fusion", "Color", sequencesPaths[s], "png", colorData);
-            validate.getOverlap(colorData, overlapIDs);
+            validate.getPartitionedOverlap(reader, "SVM_linear_fusion", "Color", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
             cout << "Elapsed time: " << t.elapsed() << endl;
         }
-        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
         validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "cSvmLinearFusionOverlap.yml");
 //
 //        
 //        //SVM rbf fusion - color
 //        std::cout << "SVM rbf fusion - color" << std::endl;
-//        overlapIDs.release();
-//        for (int s = 0; s < sequencesPaths.size(); s++)
 //        {
 //            boost::timer t;
-//            ModalityData colorData;
-//            cout << "Reading color data in scene " << s << ".." << endl;
-//            reader.overlapreadScene("SVM_rbf_fusion", "Color", sequencesPaths[s], "png", colorData);
-//            validate.getOverlap(colorData, overlapIDs);
+//            validate.getPartitionedOverlap(reader, "SVM_rbf_fusion", "Color", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
 //            cout << "Elapsed time: " << t.elapsed() << endl;
 //        }
-//        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-//        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
 //        validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "cSvmRBFFusionOverlap.yml");
 //        
         
         //MLP gaussian fusion - color
         std::cout << "MLP gaussian fusion - color" << std::endl;
-        overlapIDs.release();
-        for (int s = 0; s < sequencesPaths.size(); s++)
         {
             boost::timer t;
-            ModalityData colorData;
-            cout << "Reading color data in scene " << s << ".." << endl;
-            reader.overlapreadScene("MLP_Gaussian_fusion", "Color", sequencesPaths[s], "png", colorData);
-            validate.getOverlap(colorData, overlapIDs);
+            validate.getPartitionedOverlap(reader, "MLP_Gaussian_fusion", "Color", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
             cout << "Elapsed time: " << t.elapsed() << endl;
         }
-        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
         validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "cMlpGaussianFusionOverlap.yml");
         
         
 //        //MLP sigmoid fusion - color
 //        std::cout << "MLP sigmoid fusion - color" << std::endl;
-//        overlapIDs.release();
-//        for (int s = 0; s < sequencesPaths.size(); s++)
 //        {
 //            boost::timer t;
-//            ModalityData colorData;
-//            cout << "Reading color data in scene " << s << ".." << endl;
-//            reader.overlapreadScene("MLP_sigmoid_fusion", "Color", sequencesPaths[s], "png", colorData);
-//            validate.getOverlap(colorData, overlapIDs);
+//            validate.getPartitionedOverlap(reader, "MLP_sigmoid_fusion", "Color", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
 //            cout << "Elapsed time: " << t.elapsed() << endl;
 //        }
-//        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-//        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
 //        validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "cMlpSigmoidFusionOverlap.yml");
 //
 //        //RF fusion - color
 //        std::cout << "RF fusion - color" << std::endl;
-//        overlapIDs.release();
-//        for (int s = 0; s < sequencesPaths.size(); s++)
 //        {
 //            boost::timer t;
-//            ModalityData colorData;
-//            cout << "Reading color data in scene " << s << ".." << endl;
-//            reader.overlapreadScene("RF_fusion", "Color", sequencesPaths[s], "png", colorData);
-//            validate.getOverlap(colorData, overlapIDs);
+//            validate.getPartitionedOverlap(reader, "RF_fusion", "Color", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
 //            cout << "Elapsed time: " << t.elapsed() << endl;
 //        }
-//        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-//        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
 //        validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "cRFFusionOverlap.yml");
 //  
 //        
         //SVM linear fusion - thermal
         std::cout << "SVM linear fusion - thermal" << std::endl;
-        overlapIDs.release();
-        for (int s = 0; s < sequencesPaths.size(); s++)
         {
             boost::timer t;
-            ModalityData thermalData;
-            cout << "Reading thermal data in scene " << s << ".." << endl;
-            reader.overlapreadScene("SVM_linear_fusion/Thermal", "Thermal", sequencesPaths[s], "png", thermalData);
-            validate.getOverlap(thermalData, overlapIDs);
+            validate.getPartitionedOverlap(reader, "SVM_linear_fusion/Thermal", "Thermal", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
             cout << "Elapsed time: " << t.elapsed() << endl;
         }
-        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
         validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "tSvmLinearFusionOverlap.yml");
 //
 //        
 //        //SVM rbf fusion - thermal
 //        std::cout << "SVM rbf fusion - thermal" << std::endl;
-//        overlapIDs.release();
-//        for (int s = 0; s < sequencesPaths.size(); s++)
 //        {
 //            boost::timer t;
-//            ModalityData thermalData;
-//            cout << "Reading thermal data in scene " << s << ".." << endl;
-//            reader.overlapreadScene("SVM_rbf_fusion/Thermal", "Thermal", sequencesPaths[s], "png", thermalData);
-//            validate.getOverlap(thermalData, overlapIDs);
+//            validate.getPartitionedOverlap(reader, "SVM_rbf_fusion/Thermal", "Thermal", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
 //            cout << "Elapsed time: " << t.elapsed() << endl;
 //        }
-//        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-//        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
 //        validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "tSvmRBFFusionOverlap.yml");
 //        
 //        
         //MLP gaussian fusion - thermal
         std::cout << "MLP gaussian fusion - thermal" << std::endl;
-        overlapIDs.release();
-        for (int s = 0; s < sequencesPaths.size(); s++)
         {
             boost::timer t;
-            ModalityData thermalData;
-            cout << "Reading thermal data in scene " << s << ".." << endl;
-            reader.overlapreadScene("MLP_Gaussian_fusion/Thermal", "Thermal", sequencesPaths[s], "png", thermalData);
-            validate.getOverlap(thermalData, overlapIDs);
+            validate.getPartitionedOverlap(reader, "MLP_Gaussian_fusion/Thermal", "Thermal", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
             cout << "Elapsed time: " << t.elapsed() << endl;
         }
-        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
         validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "tMlpGaussianFusionOverlap.yml");
         
         
 //        //MLP sigmoid fusion - thermal
 //        std::cout << "MLP sigmoid fusion - thermal" << std::endl;
-//        overlapIDs.release();
-//        for (int s = 0; s < sequencesPaths.size(); s++)
 //        {
 //            boost::timer t;
-//            ModalityData thermalData;
-//            cout << "Reading thermal data in scene " << s << ".." << endl;
-//            reader.overlapreadScene("MLP_sigmoid_fusion/Thermal", "Thermal", sequencesPaths[s], "png", thermalData);
-//            validate.getOverlap(thermalData, overlapIDs);
+//            validate.getPartitionedOverlap(reader, "MLP_sigmoid_fusion/Thermal", "Thermal", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
 //            cout << "Elapsed time: " << t.elapsed() << endl;
 //        }
-//        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-//        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
 //        validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "tMlpSigmoidFusionOverlap.yml");
 
 //        //RF fusion - thermal
 //        std::cout << "RF fusion - thermal" << std::endl;
-//        overlapIDs.release();
-//        for (int s = 0; s < sequencesPaths.size(); s++)
 //        {
 //            boost::timer t;
-//            ModalityData thermalData;
-//            cout << "Reading thermal data in scene " << s << ".." << endl;
-//            reader.overlapreadScene("RF_fusion/Thermal", "Thermal", sequencesPaths[s], "png", thermalData);
-//            validate.getOverlap(thermalData, overlapIDs);
+//            validate.getPartitionedOverlap(reader, "RF_fusion/Thermal", "Thermal", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
 //            cout << "Elapsed time: " << t.elapsed() << endl;
 //        }
-//        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-//        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
 //        validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "tRFFusionOverlap.yml");
     
         //
@@ -2008,391 +1451,230 @@ int main(int argc, char** argv)
         
         //Motion
         std::cout << "Motion" << std::endl;
-        overlapIDs.release();
-        for (int s = 0; s < sequencesPaths.size(); s++)
         {
             boost::timer t;
-            ModalityData motionData;
-            cout << "Reading motion data in scene " << s << ".." << endl;
-            reader.overlapreadScene("Motion_mirrored", "Color", sequencesPaths[s], "png", motionData);
-            validate.getOverlap(motionData, overlapIDs);
+            validate.getPartitionedOverlap(reader, "Motion_mirrored", "Color", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
             cout << "Elapsed time: " << t.elapsed() << endl;
         }
-        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
         validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "mGridConsensusOverlapMirrored.yml");
         
         
         //Depth
         std::cout << "Depth" << std::endl;
-        overlapIDs.release();
-        for (int s = 0; s < sequencesPaths.size(); s++)
         {
             boost::timer t;
-            ModalityData depthData;
-            cout << "Reading depth data in scene " << s << ".." << endl;
-            reader.overlapreadScene("Depth_mirrored", "Depth", sequencesPaths[s], "png", depthData);
-            validate.getOverlap(depthData, overlapIDs);
+            validate.getPartitionedOverlap(reader, "Depth_mirrored", "Depth", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
             cout << "Elapsed time: " << t.elapsed() << endl;
         }
-        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
         validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "dGridConsensusOverlapMirrored.yml");
         
         
         //Thermal
         std::cout << "Thermal" << std::endl;
-        overlapIDs.release();
-        for (int s = 0; s < sequencesPaths.size(); s++)
         {
             boost::timer t;
-            ModalityData thermalData;
-            cout << "Reading thermal data in scene " << s << ".." << endl;
-            reader.overlapreadScene("Thermal_mirrored", "Thermal", sequencesPaths[s], "png", thermalData);
-            validate.getOverlap(thermalData, overlapIDs);
+            validate.getPartitionedOverlap(reader, "Thermal_mirrored", "Thermal", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
             cout << "Elapsed time: " << t.elapsed() << endl;
         }
-        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
         validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "tGridConsensusOverlapMirrored.yml");
         
         
         //Color
         std::cout << "Color" << std::endl;
-        overlapIDs.release();
-        for (int s = 0; s < sequencesPaths.size(); s++)
         {
             boost::timer t;
-            ModalityData colorData;
-            cout << "Reading color data in scene " << s << ".." << endl;
-            reader.overlapreadScene("Color_mirrored", "Color", sequencesPaths[s], "png", colorData);
-            validate.getOverlap(colorData, overlapIDs);
+            validate.getPartitionedOverlap(reader, "Color_mirrored", "Color", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
             cout << "Elapsed time: " << t.elapsed() << endl;
         }
-        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
         validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "cGridConsensusOverlapMirrored.yml");
         
         
         //Simple fusion 1 - color
         std::cout << "Simple fusion 1 - color" << std::endl;
-        overlapIDs.release();
-        for (int s = 0; s < sequencesPaths.size(); s++)
         {
             boost::timer t;
-            ModalityData colorData;
-            cout << "Reading color data in scene " << s << ".." << endl;
-            reader.overlapreadScene("Simple_1_fusion_mirrored", "Color", sequencesPaths[s], "png", colorData);
-            validate.getOverlap(colorData, overlapIDs);
+            validate.getPartitionedOverlap(reader, "Simple_1_fusion_mirrored", "Color", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
             cout << "Elapsed time: " << t.elapsed() << endl;
         }
-        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
         validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "cSimpleFusionOverlapMirrored1.yml");
         
         
         //Simple fusion 1 - thermal
         std::cout << "Simple fusion 1 - thermal" << std::endl;
-        overlapIDs.release();
-        for (int s = 0; s < sequencesPaths.size(); s++)
         {
             boost::timer t;
-            ModalityData thermalData;
-            cout << "Reading thermal data in scene " << s << ".." << endl;
-            reader.overlapreadScene("Simple_1_fusion_mirrored", "Thermal", sequencesPaths[s], "png", thermalData);
-            validate.getOverlap(thermalData, overlapIDs);
+            validate.getPartitionedOverlap(reader, "Simple_1_fusion_mirrored", "Thermal", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
             cout << "Elapsed time: " << t.elapsed() << endl;
         }
-        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
         validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "tSimpleFusionOverlapMirrored1.yml");
         
         
         //Simple fusion 2 - color
         std::cout << "Simple fusion 2 - color" << std::endl;
-        overlapIDs.release();
-        for (int s = 0; s < sequencesPaths.size(); s++)
         {
             boost::timer t;
-            ModalityData colorData;
-            cout << "Reading color data in scene " << s << ".." << endl;
-            reader.overlapreadScene("Simple_2_fusion_mirrored", "Color", sequencesPaths[s], "png", colorData);
-            validate.getOverlap(colorData, overlapIDs);
+            validate.getPartitionedOverlap(reader, "Simple_2_fusion_mirrored", "Color", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
             cout << "Elapsed time: " << t.elapsed() << endl;
         }
-        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
         validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "cSimpleFusionOverlapMirrored2.yml");
         
         
         //Simple fusion 3 - color
         std::cout << "Simple fusion 3 - color" << std::endl;
-        overlapIDs.release();
-        for (int s = 0; s < sequencesPaths.size(); s++)
         {
             boost::timer t;
-            ModalityData colorData;
-            cout << "Reading color data in scene " << s << ".." << endl;
-            reader.overlapreadScene("Simple_3_fusion_mirrored", "Color", sequencesPaths[s], "png", colorData);
-            validate.getOverlap(colorData, overlapIDs);
+            validate.getPartitionedOverlap(reader, "Simple_3_fusion_mirrored", "Color", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
             cout << "Elapsed time: " << t.elapsed() << endl;
         }
-        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
         validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "cSimpleFusionOverlapMirrored3.yml");
         
         
         //Simple fusion 2 - thermal
         std::cout << "Simple fusion 2 - thermal" << std::endl;
-        overlapIDs.release();
-        for (int s = 0; s < sequencesPaths.size(); s++)
         {
             boost::timer t;
-            ModalityData thermalData;
-            cout << "Reading thermal data in scene " << s << ".." << endl;
-            reader.overlapreadScene("Simple_2_fusion_mirrored/Thermal", "Thermal", sequencesPaths[s], "png", thermalData);
-            validate.getOverlap(thermalData, overlapIDs);
+            validate.getPartitionedOverlap(reader, "Simple_2_fusion_mirrored/Thermal", "Thermal", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
             cout << "Elapsed time: " << t.elapsed() << endl;
         }
-        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
         validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "tSimpleFusionOverlapMirrored2.yml");
         
         
         
         //Simple fusion 1 - thermal
         std::cout << "Simple fusion 1 - thermal" << std::endl;
-        overlapIDs.release();
-        for (int s = 0; s < sequencesPaths.size(); s++)
         {
             boost::timer t;
-            ModalityData thermalData;
-            cout << "Reading thermal data in scene " << s << ".." << endl;
-            reader.overlapreadScene("Simple_1_fusion_mirrored/Thermal", "Thermal", sequencesPaths[s], "png", thermalData);
-            validate.getOverlap(thermalData, overlapIDs);
+            validate.getPartitionedOverlap(reader, "Simple_1_fusion_mirrored/Thermal", "Thermal", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
             cout << "Elapsed time: " << t.elapsed() << endl;
         }
-        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
         validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "tSimpleFusionOverlapMirrored1.yml");
         
         
         //Simple fusion 3 - thermal
         std::cout << "Simple fusion 3 - thermal" << std::endl;
-        overlapIDs.release();
-        for (int s = 0; s < sequencesPaths.size(); s++)
         {
             boost::timer t;
-            ModalityData thermalData;
-            cout << "Reading thermal data in scene " << s << ".." << endl;
-            reader.overlapreadScene("Simple_3_fusion_mirrored/Thermal", "Thermal", sequencesPaths[s], "png", thermalData);
-            validate.getOverlap(thermalData, overlapIDs);
+            validate.getPartitionedOverlap(reader, "Simple_3_fusion_mirrored/Thermal", "Thermal", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
             cout << "Elapsed time: " << t.elapsed() << endl;
         }
-        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
         validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "tSimpleFusionOverlapMirrored3.yml");
         
         
         //Boost fusion - color
         std::cout << "Boost fusion - color" << std::endl;
-        overlapIDs.release();
-        for (int s = 0; s < sequencesPaths.size(); s++)
         {
             boost::timer t;
-            ModalityData colorData;
-            cout << "Reading color data in scene " << s << ".." << endl;
-            reader.overlapreadScene("Boost_fusion_mirrored", "Color", sequencesPaths[s], "png", colorData);
-            validate.getOverlap(colorData, overlapIDs);
+            validate.getPartitionedOverlap(reader, "Boost_fusion_mirrored", "Color", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
             cout << "Elapsed time: " << t.elapsed() << endl;
         }
-        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
         validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "cBoostFusionOverlapMirrored.yml");
         
         
         //Boost fusion - thermal
         std::cout << "Boost fusion - thermal" << std::endl;
-        overlapIDs.release();
-        for (int s = 0; s < sequencesPaths.size(); s++)
         {
             boost::timer t;
-            ModalityData thermalData;
-            cout << "Reading thermal data in scene " << s << ".." << endl;
-            reader.overlapreadScene("Boost_fusion_mirrored/Thermal", "Thermal", sequencesPaths[s], "png", thermalData);
-            validate.getOverlap(thermalData, overlapIDs);
+            validate.getPartitionedOverlap(reader, "Boost_fusion_mirrored/Thermal", "Thermal", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
             cout << "Elapsed time: " << t.elapsed() << endl;
         }
-        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
         validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "tBoostFusionOverlapMirrored.yml");
         
         
         //SVM linear fusion - color
         std::cout << "SVM linear fusion - color" << std::endl;
-        overlapIDs.release();
-        for (int s = 0; s < sequencesPaths.size(); s++)
         {
             boost::timer t;
-            ModalityData colorData;
-            cout << "Reading color data in scene " << s << ".." << endl;
-            reader.overlapreadScene("SVM_linear_fusion_mirrored", "Color", sequencesPaths[s], "png", colorData);
-            validate.getOverlap(colorData, overlapIDs);
+            validate.getPartitionedOverlap(reader, "SVM_linear_fusion_mirrored", "Color", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
             cout << "Elapsed time: " << t.elapsed() << endl;
         }
-        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
         validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "cSvmLinearFusionOverlapMirrored.yml");
 //
 //        
 //        //SVM rbf fusion - color
 //        std::cout << "SVM rbf fusion - color" << std::endl;
-//        overlapIDs.release();
-//        for (int s = 0; s < sequencesPaths.size(); s++)
 //        {
 //            boost::timer t;
-//            ModalityData colorData;
-//            cout << "Reading color data in scene " << s << ".." << endl;
-//            reader.overlapreadScene("SVM_rbf_fusion_mirrored", "Color", sequencesPaths[s], "png", colorData);
-//            validate.getOverlap(colorData, overlapIDs);
+//            validate.getPartitionedOverlap(reader, "SVM_rbf_fusion_mirrored", "Color", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
 //            cout << "Elapsed time: " << t.elapsed() << endl;
 //        }
-//        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-//        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
 //        validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "cSvmRBFFusionOverlapMirrored.yml");
 //        
 //        
         //MLP gaussian fusion - color
         std::cout << "MLP gaussian fusion - color" << std::endl;
-        overlapIDs.release();
-        for (int s = 0; s < sequencesPaths.size(); s++)
         {
             boost::timer t;
-            ModalityData colorData;
-            cout << "Reading color data in scene " << s << ".." << endl;
-            reader.overlapreadScene("MLP_Gaussian_fusion_mirrored", "Color", sequencesPaths[s], "png", colorData);
-            validate.getOverlap(colorData, overlapIDs);
+            validate.getPartitionedOverlap(reader, "MLP_Gaussian_fusion_mirrored", "Color", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
             cout << "Elapsed time: " << t.elapsed() << endl;
         }
-        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
         validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "cMlpGaussianFusionOverlapMirrored.yml");
         
         
 //        //MLP sigmoid fusion - color
 //        std::cout << "MLP sigmoid fusion - color" << std::endl;
-//        overlapIDs.release();
-//        for (int s = 0; s < sequencesPaths.size(); s++)
 //        {
 //            boost::timer t;
-//            ModalityData colorData;
-//            cout << "Reading color data in scene " << s << ".." << endl;
-//            reader.overlapreadScene("MLP_sigmoid_fusion_mirrored", "Color", sequencesPaths[s], "png", colorData);
-//            validate.getOverlap(colorData, overlapIDs);
+//            validate.getPartitionedOverlap(reader, "MLP_sigmoid_fusion_mirrored", "Color", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
 //            cout << "Elapsed time: " << t.elapsed() << endl;
 //        }
-//        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-//        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
 //        validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "cMlpSigmoidFusionOverlapMirrored.yml");
 
 //        //RF fusion - color
 //        std::cout << "RF fusion - color" << std::endl;
-//        overlapIDs.release();
-//        for (int s = 0; s < sequencesPaths.size(); s++)
 //        {
 //            boost::timer t;
-//            ModalityData colorData;
-//            cout << "Reading color data in scene " << s << ".." << endl;
-//            reader.overlapreadScene("RF_fusion_mirrored", "Color", sequencesPaths[s], "png", colorData);
-//            validate.getOverlap(colorData, overlapIDs);
+//            validate.getPartitionedOverlap(reader, "RF_fusion_mirrored", "Color", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
 //            cout << "Elapsed time: " << t.elapsed() << endl;
 //        }
-//        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-//        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
 //        validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "cRFFusionOverlapMirrored.yml");
 //        
 //        
         //SVM linear fusion - thermal
         std::cout << "SVM linear fusion - thermal" << std::endl;
-        overlapIDs.release();
-        for (int s = 0; s < sequencesPaths.size(); s++)
         {
             boost::timer t;
-            ModalityData thermalData;
-            cout << "Reading thermal data in scene " << s << ".." << endl;
-            reader.overlapreadScene("SVM_linear_fusion_mirrored/Thermal", "Thermal", sequencesPaths[s], "png", thermalData);
-            validate.getOverlap(thermalData, overlapIDs);
+            validate.getPartitionedOverlap(reader, "SVM_linear_fusion_mirrored/Thermal", "Thermal", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
             cout << "Elapsed time: " << t.elapsed() << endl;
         }
-        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
         validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "tSvmLinearFusionOverlapMirrored.yml");
 //
 //        
 //        //SVM rbf fusion - thermal
 //        std::cout << "SVM rbf fusion - thermal" << std::endl;
-//        overlapIDs.release();
-//        for (int s = 0; s < sequencesPaths.size(); s++)
 //        {
 //            boost::timer t;
-//            ModalityData thermalData;
-//            cout << "Reading thermal data in scene " << s << ".." << endl;
-//            reader.overlapreadScene("SVM_rbf_fusion_mirrored/Thermal", "Thermal", sequencesPaths[s], "png", thermalData);
-//            validate.getOverlap(thermalData, overlapIDs);
+//            validate.getPartitionedOverlap(reader, "SVM_rbf_fusion_mirrored/Thermal", "Thermal", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
 //            cout << "Elapsed time: " << t.elapsed() << endl;
 //        }
-//        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-//        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
 //        validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "tSvmRBFFusionOverlapMirrored.yml");
 //        
 //        
         //MLP gaussian fusion - thermal
         std::cout << "MLP gaussian fusion - thermal" << std::endl;
-        overlapIDs.release();
-        for (int s = 0; s < sequencesPaths.size(); s++)
         {
             boost::timer t;
-            ModalityData thermalData;
-            cout << "Reading thermal data in scene " << s << ".." << endl;
-            reader.overlapreadScene("MLP_Gaussian_fusion_mirrored/Thermal", "Thermal", sequencesPaths[s], "png", thermalData);
-            validate.getOverlap(thermalData, overlapIDs);
+            validate.getPartitionedOverlap(reader, "MLP_Gaussian_fusion_mirrored/Thermal", "Thermal", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
             cout << "Elapsed time: " << t.elapsed() << endl;
         }
-        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
         validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "tMlpGaussianFusionOverlapMirrored.yml");
         
         
 //        //MLP sigmoid fusion - thermal
 //        std::cout << "MLP sigmoid fusion - thermal" << std::endl;
-//        overlapIDs.release();
-//        for (int s = 0; s < sequencesPaths.size(); s++)
 //        {
 //            boost::timer t;
-//            ModalityData thermalData;
-//            cout << "Reading thermal data in scene " << s << ".." << endl;
-//            reader.overlapreadScene("MLP_sigmoid_fusion_mirrored/Thermal", "Thermal", sequencesPaths[s], "png", thermalData);
-//            validate.getOverlap(thermalData, overlapIDs);
+//            validate.getPartitionedOverlap(reader, "MLP_sigmoid_fusion_mirrored/Thermal", "Thermal", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
 //            cout << "Elapsed time: " << t.elapsed() << endl;
 //        }
-//        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-//        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
 //        validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "tMlpSigmoidFusionOverlapMirrored.yml");
 
 //        //RF fusion - thermal
 //        std::cout << "RF fusion - thermal" << std::endl;
-//        overlapIDs.release();
-//        for (int s = 0; s < sequencesPaths.size(); s++)
 //        {
 //            boost::timer t;
-//            ModalityData thermalData;
-//            cout << "Reading thermal data in scene " << s << ".." << endl;
-//            reader.overlapreadScene("RF_fusion_mirrored/Thermal", "Thermal", sequencesPaths[s], "png", thermalData);
-//            validate.getOverlap(thermalData, overlapIDs);
+//            validate.getPartitionedOverlap(reader, "RF_fusion_mirrored/Thermal", "Thermal", sequencesPaths, "png", partitions, partitionedOverlapIDs, partitionedMeanOverlap);
 //            cout << "Elapsed time: " << t.elapsed() << endl;
 //        }
-//        validate.createOverlapPartitions(partitions, overlapIDs, partitionedOverlapIDs);
-//        validate.getMeanOverlap(partitionedOverlapIDs, partitionedMeanOverlap);
 //        validate.save(partitionedOverlapIDs, partitionedMeanOverlap, "tRFFusionOverlapMirrored.yml");
         
         
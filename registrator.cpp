@@ -1,9 +1,16 @@
 // registrator.cpp : Defines the entry point for the console application.
 //
 #include "registrator.h"
+#include "Trace.h"
 
 #include <sys/types.h>
 #include <sys/dir.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <fstream>
 
 using namespace std;
 using namespace cv;
@@ -11,9 +18,10 @@ using namespace cv;
 Registrator::Registrator()
 {
 	// Initialize
+	regTables.COMPILED = false;
 }
 
-float Registrator::backProjectPoint(float point, float focalLength, float principalPoint, float zCoord)
+float Registrator::backProjectPoint(float point, float focalLength, float principalPoint, float zCoord) const
 {
 	float projectedPoint;
 
@@ -44,8 +52,14 @@ float Registrator::lookUpDepth(Mat depthImg, Point2f dCoord, bool SCALE_TO_THEOR
 	return depthInMm;
 }
 
-void Registrator::computeCorrespondingRgbPointFromDepth(vector<Point2f> vecDCoord,vector<Point2f> & vecRgbCoord)
+void Registrator::computeCorrespondingRgbPointFromDepth(const vector<Point2f>& vecDCoord,vector<Point2f> & vecRgbCoord)
 {
+	if (regTables.COMPILED)
+	{
+		lookUpRgbPointsFromDepth(vecDCoord, vecRgbCoord);
+		return;
+	}
+
 	vector<Point2f> vecDistRgbCoord,vecUndistRgbCoord,vecRecRgbCoord;
 	Point2f tmpPoint;
 	Point2f prevPoint;
@@ -129,8 +143,14 @@ void Registrator::computeCorrespondingRgbPointFromDepth(vector<Point2f> vecDCoor
 
 }
 
-void Registrator::computeCorrespondingDepthPointFromRgb(vector<Point2f> vecRgbCoord,vector<Point2f> & vecDCoord)
+void Registrator::computeCorrespondingDepthPointFromRgb(const vector<Point2f>& vecRgbCoord,vector<Point2f> & vecDCoord)
 {
+	if (regTables.COMPILED)
+	{
+		lookUpDepthPointsFromRgb(vecRgbCoord, vecDCoord);
+		return;
+	}
+
 	vector<Point2f> vecDistRgbCoord, vecUndistRgbCoord;
 	Point2f tmpPoint;
 	Point2f prevPoint(0, 0);
@@ -219,7 +239,7 @@ void Registrator::computeCorrespondingDepthPointFromRgb(vector<Point2f> vecRgbCo
 
 }
 
-void Registrator::computeCorrespondingThermalPointFromRgb(vector<Point2f> vecRgbCoord, vector<Point2f>& vecTCoord, vector<Point2f> vecDCoord)
+void Registrator::computeCorrespondingThermalPointFromRgb(const vector<Point2f>& vecRgbCoord, vector<Point2f>& vecTCoord, const vector<Point2f>& vecDCoord)
 {
 	vector<int> vecDepthInMm, bestHom;
 	vector<double> minDist;
@@ -232,7 +252,7 @@ void Registrator::computeCorrespondingThermalPointFromRgb(vector<Point2f> vecRgb
 
 }
 
-void Registrator::computeCorrespondingThermalPointFromRgb(vector<Point2f> vecRgbCoord, vector<Point2f>& vecTCoord, vector<Point2f> vecDCoord, 
+void Registrator::computeCorrespondingThermalPointFromRgb(const vector<Point2f>& vecRgbCoord, vector<Point2f>& vecTCoord, const vector<Point2f>& vecDCoord, 
 														  vector<int> &bestHom)
 {
 	vector<int> vecDepthInMm;
@@ -245,8 +265,8 @@ void Registrator::computeCorrespondingThermalPointFromRgb(vector<Point2f> vecRgb
 											bestHom, octantIndices, octantDistances, worldCoordPointVector);
 }
 
-void Registrator::computeCorrespondingThermalPointFromRgb(vector<Point2f> vecRgbCoord, vector<Point2f>& vecTCoord, vector<Point2f> vecDCoord, 
-											vector<int> vecDepthInMm, vector<double>& minDist, vector<int> &bestHom, vector<vector<int> > &octantIndices,
+void Registrator::computeCorrespondingThermalPointFromRgb(const vector<Point2f>& vecRgbCoord, vector<Point2f>& vecTCoord, const vector<Point2f>& vecDCoord, 
+											const vector<int>& vecDepthInMm, vector<double>& minDist, vector<int> &bestHom, vector<vector<int> > &octantIndices,
 											vector<vector<double> > &octantDistances, vector<Point3f> &worldCoordPointVector)
 {
 	vector<Point2f> vecUndistRgbCoord,vecRecRgbCoord,vecDistRgbCoord,vecRecTCoord, vecUndistTCoord;
@@ -328,33 +348,61 @@ void Registrator::computeCorrespondingRgbPointFromThermal(vector<Point2f> vecTCo
 
 }
 
-void Registrator::computeHomographyMapping(vector<Point2f>& vecUndistRgbCoord, vector<Point2f>& vecUndistTCoord, vector<Point2f> vecDCoord,
-		vector<int> vecDepthInMm, vector<double>& minDist, vector<int> &bestHom, vector<vector<int> > &octantIndices,
-		vector<vector<double> > &octantDistances, vector<Point3f> &worldCoordPointVector)
+class Registrator::HomographyMappingInvoker : public ParallelLoopBody
 {
+public:
+	HomographyMappingInvoker(const Registrator* registrator, const vector<Point2f> &undistPoints, const vector<float> &depthsInMm, int MAP_TYPE,
+			vector<Point2f> &estimatedPoints, vector<double> &minDist, vector<int> &bestHom, vector<vector<int> > &octantIndices,
+			vector<vector<double> > &octantDistances, vector<Point3f> &worldCoordPoints)
+		: registrator(registrator), undistPoints(&undistPoints), depthsInMm(&depthsInMm), MAP_TYPE(MAP_TYPE), estimatedPoints(&estimatedPoints),
+		minDist(&minDist), bestHom(&bestHom), octantIndices(&octantIndices), octantDistances(&octantDistances), worldCoordPoints(&worldCoordPoints)
+	{ }
+
+	void operator()(const Range &range) const
+	{
+		for (int i = range.start; i < range.end; i++)
+		{
+			registrator->mapPointWithHomographies((*undistPoints)[i], (*depthsInMm)[i], MAP_TYPE, (*estimatedPoints)[i], (*minDist)[i],
+					(*bestHom)[i], (*octantIndices)[i], (*octantDistances)[i], (*worldCoordPoints)[i]);
+		}
+	}
 
-	double depthInMm, sqDist;
-	Scalar sumOfWeights;
-	vector<double> homDist, homWeights;
-	vector<Point2f> tmpUndistRgbPoint, tmpUndistTPoint, tmpEstimatedPoint;
-	Point2f estimatedPoint;
-	Point tmpIdx;
+private:
+	const Registrator* registrator;
+	const vector<Point2f>* undistPoints;
+	const vector<float>* depthsInMm;
+	int MAP_TYPE;
+
+	vector<Point2f>* estimatedPoints;
+	vector<double>* minDist;
+	vector<int>* bestHom;
+	vector<vector<int> >* octantIndices;
+	vector<vector<double> >* octantDistances;
+	vector<Point3f>* worldCoordPoints;
+};
+
+void Registrator::computeHomographyMapping(vector<Point2f>& vecUndistRgbCoord, vector<Point2f>& vecUndistTCoord, const vector<Point2f>& vecDCoord,
+		const vector<int>& vecDepthInMm, vector<double>& minDist, vector<int> &bestHom, vector<vector<int> > &octantIndices,
+		vector<vector<double> > &octantDistances, vector<Point3f> &worldCoordPointVector)
+{
+	double depthInMm;
 	int MAP_TYPE = 0;
 	int nbrCoordinates;
-	int nbrClusters = int(stereoCalibParam.homDepthCentersRgb.size());
-	int count = 0;
 	int prevDepthInMm = stereoCalibParam.defaultDepth;
+	vector<Point2f> undistPoints;
 
 	// Are we mapping RGB or thermal points?
 	if (vecUndistRgbCoord.size() > 0)
 	{
 		MAP_TYPE = 1;
 		nbrCoordinates = int(vecUndistRgbCoord.size());
+		undistPoints = vecUndistRgbCoord;
 		vecUndistTCoord.clear();
 	} else if (vecUndistTCoord.size() > 0)
 	{
 		MAP_TYPE = 2;
 		nbrCoordinates = int(vecUndistTCoord.size());
+		undistPoints = vecUndistTCoord;
 		vecUndistRgbCoord.clear();
 	} else
 	{
@@ -363,6 +411,9 @@ void Registrator::computeHomographyMapping(vector<Point2f>& vecUndistRgbCoord, v
 		return;
 	}
 
+	// Step 1: Determine the depth of every point. This is done sequentially, as an undefined depth falls back on the previous one
+	vector<float> depthsInMm(nbrCoordinates);
+
 	for (int i = 0; i < nbrCoordinates; i++)
 	{
 		if (vecDepthInMm.size() == 0) // Do we need to look up the depth?
@@ -391,115 +442,293 @@ void Registrator::computeHomographyMapping(vector<Point2f>& vecUndistRgbCoord, v
 		}
 
 		prevDepthInMm = int(depthInMm);
+		depthsInMm[i] = float(depthInMm);
+	}
 
-		// Find the euclidean distances from the point to the homographies
-		Mat worldCoordPoint(1,3,CV_32F,Scalar(0));
-		Point3f tmpWorldCoord;
-		
+	// Step 2: Map the points independently of each other, in parallel
+	vector<Point2f> estimatedPoints(nbrCoordinates);
+	vector<double> minDistTmp(nbrCoordinates);
+	vector<int> bestHomTmp(nbrCoordinates);
+	vector<vector<int> > octantIndicesTmp(nbrCoordinates);
+	vector<vector<double> > octantDistancesTmp(nbrCoordinates);
+	vector<Point3f> worldCoordPointTmp(nbrCoordinates);
 
-		// First, map the image coordinates to world coordinates
-		if (MAP_TYPE == 1){
-			worldCoordPoint.at<float>(0,0) = backProjectPoint(vecUndistRgbCoord[i].x, float(stereoCalibParam.rgbCamMat.at<double>(0,0)), 
-							float(stereoCalibParam.rgbCamMat.at<double>(0,2)), float(depthInMm));
-			worldCoordPoint.at<float>(0,1) = backProjectPoint(vecUndistRgbCoord[i].y, float(stereoCalibParam.rgbCamMat.at<double>(1,1)), 
-							float(stereoCalibParam.rgbCamMat.at<double>(1,2)), float(depthInMm));
-			worldCoordPoint.at<float>(0,2) = float(depthInMm);
-		} else {
-			worldCoordPoint.at<float>(0,0) = backProjectPoint(vecUndistTCoord[i].x, float(stereoCalibParam.tCamMat.at<double>(0,0)), 
-							float(stereoCalibParam.tCamMat.at<double>(0,2)), 1500);
-			worldCoordPoint.at<float>(0,1) = backProjectPoint(vecUndistTCoord[i].y, float(stereoCalibParam.tCamMat.at<double>(1,1)), 
-							float(stereoCalibParam.tCamMat.at<double>(1,2)), 1500);
-			worldCoordPoint.at<float>(0,2) = 1500;
+	parallel_for_(Range(0, nbrCoordinates), HomographyMappingInvoker(this, undistPoints, depthsInMm, MAP_TYPE, estimatedPoints,
+			minDistTmp, bestHomTmp, octantIndicesTmp, octantDistancesTmp, worldCoordPointTmp));
 
-		}
+	if (MAP_TYPE == 1) {
+		vecUndistTCoord = estimatedPoints;
+	} else {
+		vecUndistRgbCoord = estimatedPoints;
+	}
 
-		tmpWorldCoord.x = worldCoordPoint.at<float>(0,0);
-		tmpWorldCoord.y = worldCoordPoint.at<float>(0,1);
-		tmpWorldCoord.z = worldCoordPoint.at<float>(0,2);
-		worldCoordPointVector.push_back(tmpWorldCoord);
+	minDist.insert(minDist.end(), minDistTmp.begin(), minDistTmp.end());
+	bestHom.insert(bestHom.end(), bestHomTmp.begin(), bestHomTmp.end());
+	octantIndices.insert(octantIndices.end(), octantIndicesTmp.begin(), octantIndicesTmp.end());
+	octantDistances.insert(octantDistances.end(), octantDistancesTmp.begin(), octantDistancesTmp.end());
+	worldCoordPointVector.insert(worldCoordPointVector.end(), worldCoordPointTmp.begin(), worldCoordPointTmp.end());
+}
 
-		int bestHomTmp = 0; // Reset parameters
-		double bestDist = 1e6; 
-		homDist.clear(); homWeights.clear(); 
+void Registrator::mapPointWithHomographies(Point2f undistPoint, float depthInMm, int MAP_TYPE, Point2f &estimatedPoint, double &minDist,
+		int &bestHom, vector<int> &octantIndices, vector<double> &octantDistances, Point3f &worldCoordPoint) const
+{
+	// First, map the image coordinates to world coordinates
+	if (MAP_TYPE == 1) {
+		worldCoordPoint.x = backProjectPoint(undistPoint.x, float(stereoCalibParam.rgbCamMat.at<double>(0,0)), 
+						float(stereoCalibParam.rgbCamMat.at<double>(0,2)), depthInMm);
+		worldCoordPoint.y = backProjectPoint(undistPoint.y, float(stereoCalibParam.rgbCamMat.at<double>(1,1)), 
+						float(stereoCalibParam.rgbCamMat.at<double>(1,2)), depthInMm);
+		worldCoordPoint.z = depthInMm;
+	} else {
+		worldCoordPoint.x = backProjectPoint(undistPoint.x, float(stereoCalibParam.tCamMat.at<double>(0,0)), 
+						float(stereoCalibParam.tCamMat.at<double>(0,2)), 1500);
+		worldCoordPoint.y = backProjectPoint(undistPoint.y, float(stereoCalibParam.tCamMat.at<double>(1,1)), 
+						float(stereoCalibParam.tCamMat.at<double>(1,2)), 1500);
+		worldCoordPoint.z = 1500;
+	}
 
-		for (int j = 0; j < nbrClusters; j++)
-		{
-			if (stereoCalibParam.homDepthCentersRgb[j].z >= 0) // Is the current cluster valid? (also applies for thermal clusters)
-			{ 
-				Mat depthCenter(1,3,CV_32F,Scalar(0));
-				// Compute Euclidean distance
-				if (MAP_TYPE == 1)
-				{
-					homDist.push_back(sqrt(pow(worldCoordPoint.at<float>(0,0) - stereoCalibParam.homDepthCentersRgb[j].x, 2) +
-						pow(worldCoordPoint.at<float>(0,1)- stereoCalibParam.homDepthCentersRgb[j].y, 2) +
-						pow(worldCoordPoint.at<float>(0,2) - stereoCalibParam.homDepthCentersRgb[j].z, 2)));  // Euclidean					
-				} else {
-					homDist.push_back(sqrt(pow(worldCoordPoint.at<float>(0,1) - stereoCalibParam.homDepthCentersT[j].x, 2) +
-						pow(worldCoordPoint.at<float>(0,1) - stereoCalibParam.homDepthCentersT[j].y, 2) +
-						pow(worldCoordPoint.at<float>(0,2) - stereoCalibParam.homDepthCentersT[j].z, 2)));  // Euclidean
-				}
+	// Find the nearest homography centre of every octant around the point
+	int nearestInd[8];
+	double nearestDist[8];
 
-				for (size_t k = 0; k < settings.discardedHomographies.size(); ++k) {
-					if (j == settings.discardedHomographies[k]) {
-						homDist[j] = 1e12;
-					}
-				}
+	if (MAP_TYPE == 1) {
+		homIndexRgb.nearestPerOctant(worldCoordPoint, nearestInd, nearestDist);
+	} else {
+		homIndexT.nearestPerOctant(worldCoordPoint, nearestInd, nearestDist);
+	}
 
-				sqDist = homDist[j];
-				if (sqDist < bestDist)
-				{
-					bestDist = sqDist;
-					bestHomTmp = j;
-				}
-	
-			} else {
-				homDist.push_back(1e12);
-			}
-		}
+	// The best homography is the nearest of the octant neighbours
+	bestHom = 0;
+	minDist = 1e6;
 
-		/* Compute the corresponding point in the other modality
-			This includes the weighting of multiple homographies
-		*/
-		tmpUndistRgbPoint.clear(); tmpUndistTPoint.clear();
-		estimatedPoint.x = 0; estimatedPoint.y = 0;
-		if (MAP_TYPE == 1) {
-			tmpUndistRgbPoint.push_back(vecUndistRgbCoord[i]);
-		} else {
-			tmpUndistTPoint.push_back(vecUndistTCoord[i]);
+	for (int i = 0; i < 8; ++i)
+	{
+		if ((nearestInd[i] >= 0) && ((nearestDist[i] < minDist) || ((nearestDist[i] == minDist) && (nearestInd[i] < bestHom))))
+		{
+			minDist = nearestDist[i];
+			bestHom = nearestInd[i];
 		}
+	}
+
+	// Compute the relative weight of the eight surrounding points, and normalize them
+	double sumOfDistances = 0, sumOfWeights = 0;
+	double unNormWeights[8];
+
+	for (int i = 0; i < 8; ++i)
+	{
+		if (nearestInd[i] >= 0)
+			sumOfDistances += nearestDist[i];
+	}
 
-		vector<int> octantIndicesTmp; vector<double> octantDistancesTmp;
+	for (int i = 0; i < 8; ++i)
+	{
+		unNormWeights[i] = (nearestInd[i] >= 0) ? sumOfDistances / nearestDist[i] : 0.;
+		sumOfWeights += unNormWeights[i];
+	}
 
-		if (MAP_TYPE == 1) {
-			trilinearInterpolator(tmpWorldCoord, stereoCalibParam.homDepthCentersRgb, homDist, homWeights, 
-									octantIndicesTmp, octantDistancesTmp);
+	octantIndices.assign(nearestInd, nearestInd + 8);
+	octantDistances.assign(8, 0.);
 
-			weightedHomographyMapper(tmpUndistRgbPoint, tmpEstimatedPoint, stereoCalibParam.planarHom, homWeights);
+	// Apply the weighted homographies in the order of their indices, as the weighted sum is accumulated in single precision
+	vector<pair<int, double> > homWeights;
 
-		} else {
-			trilinearInterpolator(tmpWorldCoord, stereoCalibParam.homDepthCentersT, homDist, homWeights, 
-									octantIndicesTmp, octantDistancesTmp);
+	for (int i = 0; i < 8; ++i)
+	{
+		if (sumOfWeights > 0)
+			octantDistances[i] = unNormWeights[i] / sumOfWeights;
+
+		if ((nearestInd[i] >= 0) && (octantDistances[i] > 0))
+			homWeights.push_back(pair<int, double>(nearestInd[i], octantDistances[i]));
+	}
+
+	std::sort(homWeights.begin(), homWeights.end());
+
+	const vector<Matx33d> &homographies = (MAP_TYPE == 1) ? planarHomMatx : planarHomInvMatx;
+	estimatedPoint = Point2f(0,0);
+
+	for (size_t i = 0; i < homWeights.size(); ++i)
+	{
+		const Matx33d &H = homographies[homWeights[i].first];
+		Point2f tmpEstimatedPoint(0,0);
 
-			weightedHomographyMapper(tmpUndistTPoint, tmpEstimatedPoint, stereoCalibParam.planarHomInv, homWeights);
+		// Same as perspectiveTransform on a single point
+		double w = undistPoint.x*H(2,0) + undistPoint.y*H(2,1) + H(2,2);
+
+		if (fabs(w) > FLT_EPSILON)
+		{
+			w = 1./w;
+			tmpEstimatedPoint.x = float((undistPoint.x*H(0,0) + undistPoint.y*H(0,1) + H(0,2))*w);
+			tmpEstimatedPoint.y = float((undistPoint.x*H(1,0) + undistPoint.y*H(1,1) + H(1,2))*w);
 		}
 
-		octantIndices.push_back(octantIndicesTmp);
-		octantDistances.push_back(octantDistancesTmp);
-		estimatedPoint = tmpEstimatedPoint[0];
+		estimatedPoint.x = estimatedPoint.x + tmpEstimatedPoint.x * float(homWeights[i].second);
+		estimatedPoint.y = estimatedPoint.y + tmpEstimatedPoint.y * float(homWeights[i].second);
+	}
+}
 
-		if (MAP_TYPE == 1) {
-			vecUndistTCoord.push_back(estimatedPoint);
-		} else {
-			vecUndistRgbCoord.push_back(estimatedPoint);
+void Registrator::buildHomographyIndices()
+{
+	// A homography takes part in the mapping if its centre is valid (also applies for thermal clusters) and it has not been discarded
+	vector<bool> active(stereoCalibParam.homDepthCentersRgb.size(), false);
+
+	for (size_t j = 0; j < active.size(); ++j)
+	{
+		active[j] = (stereoCalibParam.homDepthCentersRgb[j].z >= 0);
+	}
+
+	for (size_t k = 0; k < settings.discardedHomographies.size(); ++k)
+	{
+		int j = settings.discardedHomographies[k];
+		if ((j >= 0) && (j < int(active.size())))
+			active[j] = false;
+	}
+
+	homIndexRgb.build(stereoCalibParam.homDepthCentersRgb, active);
+	homIndexT.build(stereoCalibParam.homDepthCentersT, active);
+
+	planarHomMatx.resize(stereoCalibParam.planarHom.size());
+	for (size_t i = 0; i < stereoCalibParam.planarHom.size(); ++i)
+		planarHomMatx[i] = Mat_<double>(stereoCalibParam.planarHom[i]);
+
+	planarHomInvMatx.resize(stereoCalibParam.planarHomInv.size());
+	for (size_t i = 0; i < stereoCalibParam.planarHomInv.size(); ++i)
+		planarHomInvMatx[i] = Mat_<double>(stereoCalibParam.planarHomInv[i]);
+}
+
+namespace
+{
+	// Orders homography centres along one axis, used to split the nodes of the homography index
+	struct AxisLess
+	{
+		AxisLess(const vector<Point3f> &points, int axis) : points(points), axis(axis) { }
+
+		bool operator()(int a, int b) const
+		{
+			if (axis == 0) return points[a].x < points[b].x;
+			if (axis == 1) return points[a].y < points[b].y;
+			return points[a].z < points[b].z;
 		}
 
-		minDist.push_back(bestDist);
-		bestHom.push_back(bestHomTmp);
+		const vector<Point3f> &points;
+		int axis;
+	};
+}
+
+void Registrator::HomographyIndex::build(const vector<Point3f> &centers, const vector<bool> &active)
+{
+	points = centers;
+	nodes.clear();
+
+	vector<int> indices;
+	for (size_t i = 0; i < centers.size(); ++i)
+	{
+		if ((i < active.size()) && active[i])
+			indices.push_back(int(i));
 	}
 
-	if (count > 0) {
-		std::cout << endl;
+	nodes.reserve(indices.size());
+	buildNode(indices, 0, int(indices.size()));
+}
+
+int Registrator::HomographyIndex::buildNode(vector<int> &indices, int begin, int end)
+{
+	if (begin >= end)
+		return -1;
+
+	// Bounding box of the subtree, used for pruning during the search
+	Node node;
+	node.lo = node.hi = points[indices[begin]];
+
+	for (int i = begin+1; i < end; ++i)
+	{
+		const Point3f &p = points[indices[i]];
+		node.lo.x = min(node.lo.x, p.x); node.hi.x = max(node.hi.x, p.x);
+		node.lo.y = min(node.lo.y, p.y); node.hi.y = max(node.hi.y, p.y);
+		node.lo.z = min(node.lo.z, p.z); node.hi.z = max(node.hi.z, p.z);
 	}
+
+	// Split at the median of the axis of largest extent
+	Point3f extent = node.hi - node.lo;
+	int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : ((extent.y >= extent.z) ? 1 : 2);
+	int mid = (begin + end) / 2;
+
+	nth_element(indices.begin() + begin, indices.begin() + mid, indices.begin() + end, AxisLess(points, axis));
+
+	node.index = indices[mid];
+
+	int n = int(nodes.size());
+	nodes.push_back(node);
+
+	int left = buildNode(indices, begin, mid);
+	int right = buildNode(indices, mid+1, end);
+	nodes[n].left = left;
+	nodes[n].right = right;
+
+	return n;
+}
+
+void Registrator::HomographyIndex::nearestPerOctant(Point3f inputPoint, int nearestInd[8], double nearestDist[8]) const
+{
+	for (int i = 0; i < 8; ++i)
+	{
+		nearestInd[i] = -1;
+		nearestDist[i] = 1e6;
+	}
+
+	if (!nodes.empty())
+		search(0, inputPoint, nearestInd, nearestDist);
+}
+
+void Registrator::HomographyIndex::search(int n, Point3f inputPoint, int nearestInd[8], double nearestDist[8]) const
+{
+	/* Octant map (as in trilinearInterpolator):
+	I:		+ + +		V:		+ + -
+	II:		- + +		VI:		- + -
+	III:	- - +		VII:	- - -
+	IV:		+ - +		VIII:	+ - -
+	*/
+	static const int octantXY[2][2] = { {2, 1}, {3, 0} }; // [x positive][y positive]
+
+	const Node &node = nodes[n];
+
+	// Lower bound of the distance to any centre in the subtree. The differences are rounded like the
+	// distances themselves, so that the bound never exceeds them
+	float dx = max(max(node.lo.x - inputPoint.x, inputPoint.x - node.hi.x), 0.f);
+	float dy = max(max(node.lo.y - inputPoint.y, inputPoint.y - node.hi.y), 0.f);
+	float dz = max(max(node.lo.z - inputPoint.z, inputPoint.z - node.hi.z), 0.f);
+	double lowerBound = sqrt(pow(dx, 2) + pow(dy, 2) + pow(dz, 2));
+
+	// Prune the subtree if it cannot improve the nearest centre of any of the octants it overlaps
+	bool xSides[2] = { node.lo.x <= inputPoint.x, node.hi.x > inputPoint.x };
+	bool ySides[2] = { node.lo.y <= inputPoint.y, node.hi.y > inputPoint.y };
+	bool zSides[2] = { node.lo.z <= inputPoint.z, node.hi.z > inputPoint.z };
+	bool bPromising = false;
+
+	for (int x = 0; x < 2 && !bPromising; ++x) for (int y = 0; y < 2 && !bPromising; ++y) for (int z = 0; z < 2 && !bPromising; ++z)
+	{
+		int octant = octantXY[x][y] + (z ? 0 : 4);
+		if (xSides[x] && ySides[y] && zSides[z] && (lowerBound <= nearestDist[octant]) && (lowerBound < 1e6))
+			bPromising = true;
+	}
+
+	if (!bPromising)
+		return;
+
+	// Visit the centre of this node. Ties are broken by the lowest index, as in the linear search
+	const Point3f &p = points[node.index];
+	double dist = sqrt(pow(inputPoint.x - p.x, 2) + pow(inputPoint.y - p.y, 2) + pow(inputPoint.z - p.z, 2));
+	int octant = octantXY[(p.x - inputPoint.x) > 0][(p.y - inputPoint.y) > 0] + (((p.z - inputPoint.z) > 0) ? 0 : 4);
+
+	if ((dist < nearestDist[octant]) || ((dist == nearestDist[octant]) && (nearestInd[octant] >= 0) && (node.index < nearestInd[octant])))
+	{
+		nearestInd[octant] = node.index;
+		nearestDist[octant] = dist;
+	}
+
+	if (node.left >= 0)
+		search(node.left, inputPoint, nearestInd, nearestDist);
+	if (node.right >= 0)
+		search(node.right, inputPoint, nearestInd, nearestDist);
 }
 
 void Registrator::trilinearInterpolator(Point3f inputPoint, vector<Point3f> &sourcePoints, vector<double> &precomputedDistance, vector<double> &weights, 
@@ -925,6 +1154,10 @@ void Registrator::MyDistortPoints(std::vector<cv::Point2f> src, std::vector<cv::
 
 void Registrator::loadMinCalibrationVars(string calFile)
 {
+	// Tables compiled for a previous calibration are no longer valid
+	releaseRegistrationTables();
+	calFilePath = calFile;
+
 	FileStorage fsStereo(calFile, FileStorage::READ);
 
 	if (fsStereo.isOpened())
@@ -970,6 +1203,353 @@ void Registrator::loadMinCalibrationVars(string calFile)
 		fsStereo["discardedHomographies"] >> settings.discardedHomographies;
 	}
 	fsStereo.release();
+
+	// The homography centres are fixed from now on, so index them once for all the subsequent registrations
+	buildHomographyIndices();
+}
+
+void Registrator::compileRegistrationTables(int minDepthInMm, int maxDepthInMm, int depthSliceInMm)
+{
+	// Tabulate the correspondences of every pixel on its own. The previous-point fallback is applied at look-up time
+	bool usePrevDepthPoint = settings.USE_PREV_DEPTH_POINT;
+	settings.USE_PREV_DEPTH_POINT = false;
+	regTables.COMPILED = false;
+
+	int width = stereoCalibParam.WIDTH, height = stereoCalibParam.HEIGHT;
+	vector<Point2f> pixels, correspondences;
+
+	// Step 1: RGB <-> depth. The (1-based) pixels are followed by a point outside the image
+	for (int y = 1; y <= height; ++y)
+		for (int x = 1; x <= width; ++x)
+			pixels.push_back(Point2f(float(x), float(y)));
+
+	computeCorrespondingDepthPointFromRgb(pixels, correspondences);
+	regTables.rgbToD = Mat(correspondences).reshape(2, height).clone();
+
+	pixels.push_back(Point2f(0,0));
+	correspondences.clear();
+	computeCorrespondingRgbPointFromDepth(pixels, correspondences);
+	regTables.dToRgbOutside = correspondences.back();
+	correspondences.pop_back();
+	regTables.dToRgb = Mat(correspondences).reshape(2, height).clone();
+
+	// Step 2: RGB -> thermal at every depth slice. Undistort the pixels once, and map them in blocks of rows to bound the memory
+	// taken by the homography mapping
+	pixels.clear();
+	for (int y = 0; y < height; ++y)
+		for (int x = 0; x < width; ++x)
+			pixels.push_back(Point2f(float(x), float(y)));
+
+	vector<Point2f> undistPixels;
+	if (!settings.UNDISTORT_IMAGES) {
+		undistortPoints(pixels, undistPixels, stereoCalibParam.rgbCamMat, stereoCalibParam.rgbDistCoeff,
+						Mat::eye(3,3,CV_32F), stereoCalibParam.rgbCamMat);
+	} else {
+		undistPixels = pixels;
+	}
+
+	regTables.minDepthInMm = minDepthInMm;
+	regTables.depthSliceInMm = max(depthSliceInMm, 1);
+	regTables.rgbToT.clear();
+
+	const int rowsPerBlock = 32;
+
+	for (int depthInMm = minDepthInMm; depthInMm <= maxDepthInMm; depthInMm += regTables.depthSliceInMm)
+	{
+		Mat slice(height, width, CV_32FC2);
+
+		for (int y = 0; y < height; y += rowsPerBlock)
+		{
+			int n = min(rowsPerBlock, height - y) * width;
+
+			vector<Point2f> undistRgbBlock(undistPixels.begin() + y*width, undistPixels.begin() + y*width + n);
+			vector<Point2f> undistTBlock, tBlock, noDCoords;
+			vector<int> depthBlock(n, depthInMm), bestHom;
+			vector<double> minDist;
+			vector<vector<int> > octantIndices;
+			vector<vector<double> > octantDistances;
+			vector<Point3f> worldCoordPointVector;
+
+			computeHomographyMapping(undistRgbBlock, undistTBlock, noDCoords, depthBlock, minDist, bestHom,
+					octantIndices, octantDistances, worldCoordPointVector);
+
+			if (!settings.UNDISTORT_IMAGES) {
+				MyDistortPoints(undistTBlock, tBlock, stereoCalibParam.tCamMat, stereoCalibParam.tDistCoeff);
+			} else {
+				tBlock = undistTBlock;
+			}
+
+			Mat(tBlock).reshape(2, n / width).copyTo(slice.rowRange(y, y + n / width));
+		}
+
+		regTables.rgbToT.push_back(slice);
+	}
+
+	regTables.UNDISTORT_IMAGES = settings.UNDISTORT_IMAGES;
+	regTables.COMPILED = true;
+	settings.USE_PREV_DEPTH_POINT = usePrevDepthPoint;
+}
+
+void Registrator::loadRegistrationTables()
+{
+	string tablesFile = getRegistrationTablesPath();
+
+	if (!readRegistrationTables(tablesFile))
+	{
+		compileRegistrationTables();
+
+		if (!writeRegistrationTables(tablesFile))
+			cerr << "Could not cache the registration tables in " << tablesFile << endl;
+	}
+}
+
+void Registrator::releaseRegistrationTables()
+{
+	regTables.COMPILED = false;
+	regTables.rgbToD.release();
+	regTables.dToRgb.release();
+	regTables.rgbToT.clear();
+}
+
+string Registrator::getRegistrationTablesPath()
+{
+	// The tables are cached next to the calibration file, e.g. calibVars.yml -> calibVars.tables
+	string tablesFile = calFilePath;
+	size_t dot = tablesFile.find_last_of('.');
+	size_t slash = tablesFile.find_last_of("/\\");
+
+	if ((dot != string::npos) && ((slash == string::npos) || (dot > slash)))
+		tablesFile.erase(dot);
+
+	return tablesFile.append(".tables");
+}
+
+namespace
+{
+	// Header of the cached registration tables. The size and modification time of the calibration file
+	// invalidate the cache when the calibration changes
+	struct RegistrationTablesHeader
+	{
+		char magic[4];
+		int version;
+		int width, height;
+		int undistortImages;
+		int minDepthInMm, depthSliceInMm, nbrSlices;
+		long long calFileSize, calFileTime;
+	};
+
+	bool getCalibrationFileStamp(string calFile, long long &size, long long &time)
+	{
+		struct stat st;
+		if (stat(calFile.c_str(), &st) != 0)
+			return false;
+
+		size = (long long) st.st_size;
+		time = (long long) st.st_mtime;
+		return true;
+	}
+
+	bool readTable(ifstream &ifs, Mat &table, int width, int height)
+	{
+		table.create(height, width, CV_32FC2);
+		ifs.read((char*) table.data, table.total() * table.elemSize());
+		return ifs.good();
+	}
+
+	bool writeTable(ofstream &ofs, const Mat &table)
+	{
+		Mat continuousTable = table.isContinuous() ? table : table.clone();
+		ofs.write((const char*) continuousTable.data, continuousTable.total() * continuousTable.elemSize());
+		return ofs.good();
+	}
+}
+
+bool Registrator::readRegistrationTables(string tablesFile)
+{
+	RegistrationTablesHeader header, expected;
+	if (!getCalibrationFileStamp(calFilePath, expected.calFileSize, expected.calFileTime))
+		return false;
+
+	ifstream ifs(tablesFile.c_str(), ios::in | ios::binary);
+	if (!ifs.is_open())
+		return false;
+
+	ifs.read((char*) &header, sizeof(header));
+
+	if (!ifs.good() || strncmp(header.magic, "S3RT", 4) != 0 || header.version != 1
+		|| header.width != stereoCalibParam.WIDTH || header.height != stereoCalibParam.HEIGHT
+		|| header.undistortImages != int(settings.UNDISTORT_IMAGES) || header.nbrSlices <= 0
+		|| header.calFileSize != expected.calFileSize || header.calFileTime != expected.calFileTime)
+	{
+		return false;
+	}
+
+	Point2f dToRgbOutside;
+	ifs.read((char*) &dToRgbOutside, sizeof(dToRgbOutside));
+
+	Mat rgbToD, dToRgb;
+	vector<Mat> rgbToT(header.nbrSlices);
+
+	bool bSuccess = readTable(ifs, rgbToD, header.width, header.height) && readTable(ifs, dToRgb, header.width, header.height);
+	for (int k = 0; k < header.nbrSlices && bSuccess; ++k)
+		bSuccess = readTable(ifs, rgbToT[k], header.width, header.height);
+
+	if (!bSuccess)
+		return false;
+
+	regTables.rgbToD = rgbToD;
+	regTables.dToRgb = dToRgb;
+	regTables.dToRgbOutside = dToRgbOutside;
+	regTables.rgbToT = rgbToT;
+	regTables.minDepthInMm = header.minDepthInMm;
+	regTables.depthSliceInMm = header.depthSliceInMm;
+	regTables.UNDISTORT_IMAGES = settings.UNDISTORT_IMAGES;
+	regTables.COMPILED = true;
+
+	return true;
+}
+
+bool Registrator::writeRegistrationTables(string tablesFile)
+{
+	RegistrationTablesHeader header;
+	if (!regTables.COMPILED || !getCalibrationFileStamp(calFilePath, header.calFileSize, header.calFileTime))
+		return false;
+
+	ofstream ofs(tablesFile.c_str(), ios::out | ios::binary | ios::trunc);
+	if (!ofs.is_open())
+		return false;
+
+	memcpy(header.magic, "S3RT", 4);
+	header.version = 1;
+	header.width = stereoCalibParam.WIDTH;
+	header.height = stereoCalibParam.HEIGHT;
+	header.undistortImages = int(regTables.UNDISTORT_IMAGES);
+	header.minDepthInMm = regTables.minDepthInMm;
+	header.depthSliceInMm = regTables.depthSliceInMm;
+	header.nbrSlices = int(regTables.rgbToT.size());
+
+	ofs.write((const char*) &header, sizeof(header));
+	ofs.write((const char*) &regTables.dToRgbOutside, sizeof(regTables.dToRgbOutside));
+
+	bool bSuccess = writeTable(ofs, regTables.rgbToD) && writeTable(ofs, regTables.dToRgb);
+	for (size_t k = 0; k < regTables.rgbToT.size() && bSuccess; ++k)
+		bSuccess = writeTable(ofs, regTables.rgbToT[k]);
+
+	return bSuccess;
+}
+
+void Registrator::lookUpDepthPointsFromRgb(const vector<Point2f>& vecRgbCoord, vector<Point2f>& vecDCoord)
+{
+	// Same semantics as computeCorrespondingDepthPointFromRgb: the tables hold (0,0) where the correspondence is undefined,
+	// which is replaced by the previous point if requested
+	Point2f prevPoint(0,0);
+
+	for (size_t i = 0; i < vecRgbCoord.size(); ++i)
+	{
+		Point2f tmpPoint(0,0);
+
+		if ((vecRgbCoord[i].y > 0) && (vecRgbCoord[i].x > 0) && (vecRgbCoord[i].y <= stereoCalibParam.HEIGHT) 
+				&& (vecRgbCoord[i].x <= stereoCalibParam.WIDTH)) {
+			tmpPoint = regTables.rgbToD.at<Point2f>(int(vecRgbCoord[i].y-1), int(vecRgbCoord[i].x-1));
+		}
+
+		if ((tmpPoint.x == 0) && (tmpPoint.y == 0) && this->settings.USE_PREV_DEPTH_POINT) {
+			tmpPoint = prevPoint;
+		}
+
+		vecDCoord.push_back(tmpPoint);
+		prevPoint = tmpPoint;
+	}
+}
+
+void Registrator::lookUpRgbPointsFromDepth(const vector<Point2f>& vecDCoord, vector<Point2f>& vecRgbCoord)
+{
+	vecRgbCoord.clear();
+
+	for (size_t i = 0; i < vecDCoord.size(); ++i)
+	{
+		if ((vecDCoord[i].y > 0) && (vecDCoord[i].x > 0) && (vecDCoord[i].y <= stereoCalibParam.HEIGHT) 
+				&& (vecDCoord[i].x <= stereoCalibParam.WIDTH)) {
+			vecRgbCoord.push_back(regTables.dToRgb.at<Point2f>(int(vecDCoord[i].y-1), int(vecDCoord[i].x-1)));
+		} else {
+			vecRgbCoord.push_back(regTables.dToRgbOutside);
+		}
+	}
+}
+
+void Registrator::lookUpThermalPointsFromRgb(const vector<Point2f>& vecRgbCoord, const vector<int>& vecDepthInMm, vector<Point2f>& vecTCoord)
+{
+	int nbrSlices = int(regTables.rgbToT.size());
+	vector<Point2f> missingRgbCoord;
+	vector<int> missingDepthInMm;
+	vector<size_t> missingIndices;
+
+	vecTCoord.resize(vecRgbCoord.size());
+
+	for (size_t i = 0; i < vecRgbCoord.size(); ++i)
+	{
+		int x = cvRound(vecRgbCoord[i].x);
+		int y = cvRound(vecRgbCoord[i].y);
+		float slice = float(vecDepthInMm[i] - regTables.minDepthInMm) / regTables.depthSliceInMm;
+
+		if ((x < 0) || (y < 0) || (x >= stereoCalibParam.WIDTH) || (y >= stereoCalibParam.HEIGHT) || (slice < 0) || (slice > nbrSlices-1))
+		{
+			missingRgbCoord.push_back(vecRgbCoord[i]);
+			missingDepthInMm.push_back(vecDepthInMm[i]);
+			missingIndices.push_back(i);
+			continue;
+		}
+
+		// Interpolate linearly between the two nearest depth slices
+		int k = min(int(slice), nbrSlices-1);
+		float alpha = slice - k;
+
+		Point2f tPoint = regTables.rgbToT[k].at<Point2f>(y, x);
+		if (alpha > 0) {
+			tPoint = tPoint * (1 - alpha) + regTables.rgbToT[k+1].at<Point2f>(y, x) * alpha;
+		}
+
+		vecTCoord[i] = tPoint;
+	}
+
+	if (missingRgbCoord.size() > 0)
+	{
+		vector<Point2f> missingTCoord, noDCoords;
+		vector<int> bestHom;
+		vector<double> minDist;
+		vector<vector<int> > octantIndices;
+		vector<vector<double> > octantDistances;
+		vector<Point3f> worldCoordPointVector;
+
+		computeCorrespondingThermalPointFromRgb(missingRgbCoord, missingTCoord, noDCoords, missingDepthInMm, minDist, bestHom,
+				octantIndices, octantDistances, worldCoordPointVector);
+
+		for (size_t i = 0; i < missingIndices.size(); ++i)
+			vecTCoord[missingIndices[i]] = missingTCoord[i];
+	}
+}
+
+void Registrator::registerDepthImageToRgb(Mat depthImg, Mat& registeredDepthImg)
+{
+	if (!regTables.COMPILED)
+		loadRegistrationTables();
+
+	// The tables hold 1-based coordinates, which are truncated as in the point-wise registration
+	Mat mapXY(regTables.rgbToD.size(), CV_32FC2);
+
+	for (int r = 0; r < mapXY.rows; ++r)
+	{
+		const Point2f* src = regTables.rgbToD.ptr<Point2f>(r);
+		Point2f* dst = mapXY.ptr<Point2f>(r);
+
+		for (int c = 0; c < mapXY.cols; ++c)
+		{
+			bool bValid = (src[c].x >= 1) && (src[c].x < depthImg.cols) && (src[c].y >= 1) && (src[c].y < depthImg.rows);
+			dst[c] = bValid ? Point2f(float(int(src[c].x - 1)), float(int(src[c].y - 1))) : Point2f(-1,-1);
+		}
+	}
+
+	remap(depthImg, registeredDepthImg, mapXY, Mat(), INTER_NEAREST, BORDER_CONSTANT, Scalar::all(0));
 }
 
 void Registrator::drawRegisteredContours(cv::Mat rgbContourImage, cv::Mat& depthContourImage, cv::Mat& thermalContourImage, cv::Mat depthImg, bool preserveColors)
@@ -1211,7 +1791,6 @@ void Registrator::loadTransformDepth()
 	string rgbImagePath = "P:/Private/Dataset/Annotation-Select/Scene 2/RegDToRgb/";
 
 	buildImageDirectory(depthImagePath, depthIndices,".png");
-	vector<Point2f> dPoints, rgbPoints;
 
 	for (size_t i = 0; i < depthIndices.size(); ++i)
 	{
@@ -1220,23 +1799,9 @@ void Registrator::loadTransformDepth()
 		tmpDepthPath.append(depthIndices[i]);
 		depthImage = imread(tmpDepthPath,CV_LOAD_IMAGE_ANYDEPTH);
 
-		if (i == 0)
-		{
-			for (int y = 1; y <= depthImage.rows; ++y)
-			{
-				for (int x = 1; x <= depthImage.cols; ++x)
-				{
-					Point2f rgbPoint(x,y);	
-					rgbPoints.push_back(rgbPoint);
-				}
-			}
-
-			computeCorrespondingDepthPointFromRgb(rgbPoints, dPoints);
-		}
-
 		// Create a "registered" rgb image as if was captured by the depth camera
-		Mat rgbImage = Mat::zeros(depthImage.rows, depthImage.cols, depthImage.type());
-		transformDepthImageToRgb(depthImage, rgbImage, dPoints, rgbPoints);
+		Mat rgbImage;
+		registerDepthImageToRgb(depthImage, rgbImage);
 
 		saveRegisteredImages(rgbImage, rgbImagePath, depthIndices[i]);
 		std::cout << i << " ";
@@ -1257,6 +1822,9 @@ void Registrator::loadRegSaveContours()
 
 void Registrator::loadRegSaveContours(vector<Mat> masksColor, vector<Mat> masksDepth,
                                       vector<Mat> & masksThermal, vector<Mat> depth) {
+    TRACE_SCOPE("Registrator::loadRegSaveContours");
+    TRACE_ITEMS(masksColor.size());
+    
     //This function uses a list of RGB contours already read and, one by one, registers them
     //in the thermal and depth modalities
     for (size_t i = 0; i < masksColor.size(); i++ ) {
@@ -1270,11 +1838,9 @@ void Registrator::loadRegSaveContours(vector<Mat> masksColor, vector<Mat> masksD
         
         // Register the thermal and depth contours
         drawRegisteredContours(rgbContour, depthContour, thermalContour, depthImage, true);
-        imshow("rgbContour", rgbContour);
+        //imshow("rgbContour", rgbContour);
         //imshow("depthContour",depthContour);
-        imshow("thermalContour",thermalContour);
-        imshow("depthImage", depthImage);
-        if(waitKey(30)>= 0)  {}
+        //imshow("thermalContour",thermalContour);
         //cout << rgbIndices[i] << ",";
         
         masksThermal.push_back(thermalContour);
@@ -1411,8 +1977,12 @@ void Registrator::getRegisteredContours(vector<Point> contour, vector<Point> ero
 
 
 	if (rgbCoords.size() > 0) {
-		this->computeCorrespondingThermalPointFromRgb(rgbCoords, tCoords, dCoords, vecDepthInMm, minDist, 
-												homInd, octantIndices, octantDistances, worldCoordPointVector);
+		if (regTables.COMPILED && (vecDepthInMm.size() == rgbCoords.size())) {
+			this->lookUpThermalPointsFromRgb(rgbCoords, vecDepthInMm, tCoords);
+		} else {
+			this->computeCorrespondingThermalPointFromRgb(rgbCoords, tCoords, dCoords, vecDepthInMm, minDist, 
+													homInd, octantIndices, octantDistances, worldCoordPointVector);
+		}
 	}
 
     for(int j = 0; j < tCoords.size(); j++) {
@@ -1724,12 +2294,16 @@ void Registrator::setDImgPath(string path)
 
 void Registrator::toggleUndistortion(bool undistort)
 {
+	if (regTables.COMPILED && (regTables.UNDISTORT_IMAGES != undistort))
+		releaseRegistrationTables();
+
 	this->settings.UNDISTORT_IMAGES = undistort;
 }
 
 void Registrator::setDiscardedHomographies(vector<int> discardedHomographies) 
 {
 	this->settings.discardedHomographies = discardedHomographies;
+	buildHomographyIndices();
 }
 
 void Registrator::setUsePrevDepthPoint(bool value)
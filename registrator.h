@@ -34,24 +34,24 @@ public:
 	/* computeCorrespondingThermalPointFromRgb handles the registration of RGB points into the corresponding thermal point.
      In order to provide the registration, the function takes as input the corresponding depth coordinate, which might be computed
      from the function computeCorrespondingDepthPointFromRgb */
-	void computeCorrespondingThermalPointFromRgb(std::vector<cv::Point2f> vecRgbCoord, std::vector<cv::Point2f>& vecTCoord, std::vector<cv::Point2f> vecDCoord);
+	void computeCorrespondingThermalPointFromRgb(const std::vector<cv::Point2f>& vecRgbCoord, std::vector<cv::Point2f>& vecTCoord, const std::vector<cv::Point2f>& vecDCoord);
     
-	void computeCorrespondingThermalPointFromRgb(std::vector<cv::Point2f> vecRgbCoord, std::vector<cv::Point2f>& vecTCoord, std::vector<cv::Point2f> vecDCoord,
+	void computeCorrespondingThermalPointFromRgb(const std::vector<cv::Point2f>& vecRgbCoord, std::vector<cv::Point2f>& vecTCoord, const std::vector<cv::Point2f>& vecDCoord,
 												 std::vector<int> &bestHom);
     
 	/* Full overload of computeCorrespondingThermalPointFromRgb containing full information of the internal functions for debugging purposes */
-	void computeCorrespondingThermalPointFromRgb(std::vector<cv::Point2f> vecRgbCoord, std::vector<cv::Point2f>& vecTCoord, std::vector<cv::Point2f> vecDCoord,
-                                                 std::vector<int> vecDepthInMm, std::vector<double>& minDist, std::vector<int> &bestHom,
+	void computeCorrespondingThermalPointFromRgb(const std::vector<cv::Point2f>& vecRgbCoord, std::vector<cv::Point2f>& vecTCoord, const std::vector<cv::Point2f>& vecDCoord,
+                                                 const std::vector<int>& vecDepthInMm, std::vector<double>& minDist, std::vector<int> &bestHom,
                                                  std::vector<std::vector<int> > &octantIndices, std::vector<std::vector<double> > &octantDistances,
                                                  std::vector<cv::Point3f> &worldCoordPointvector);
     
 	/* computeCorrespondingDepthPointFromRgb handles the registration of RGB points into the corresponding point in the depth image
      As the function uses a look-up-table for the registration, only the RGB point needs to be provided */
-	void computeCorrespondingDepthPointFromRgb(std::vector<cv::Point2f> vecRgbCoord,std::vector<cv::Point2f> & vecDCoord);
+	void computeCorrespondingDepthPointFromRgb(const std::vector<cv::Point2f>& vecRgbCoord,std::vector<cv::Point2f> & vecDCoord);
     
 	/* computeCorrespondingDepthPointFromRgb handles the registration of depth points into the corresponding point in the RGB image
      As the function uses a look-up-table for the registration, only the depth point needs to be provided */
-	void computeCorrespondingRgbPointFromDepth(std::vector<cv::Point2f> vecDCoord,std::vector<cv::Point2f> & vecRgbCoord);
+	void computeCorrespondingRgbPointFromDepth(const std::vector<cv::Point2f>& vecDCoord,std::vector<cv::Point2f> & vecRgbCoord);
     
 	/* computeCorrespondingRgbPointFromThermal handles the registration of thermal points (in the thermal modality). The registration is handled without providing any
      depth coordinate, as the thermal camera does not contain any direct connection to the depth information of the Kinect camera*/
@@ -78,6 +78,19 @@ public:
     
 	void loadMinCalibrationVars(std::string calFile);
     
+	/* Dense registration tables. compileRegistrationTables tabulates the RGB <-> depth correspondence of every pixel, and the
+     RGB -> thermal correspondence of every pixel at depth slices of depthSliceInMm. Once compiled, the registration of contours
+     and images is a table look-up: RGB -> thermal is interpolated linearly between the two nearest slices, and points outside the
+     tables fall back on the point-wise registration. The tables depend on the calibration and the undistortion setting only.
+     loadRegistrationTables reads them from a cache next to the calibration file, or compiles and caches them if it is missing or stale */
+	void compileRegistrationTables(int minDepthInMm = 500, int maxDepthInMm = 7000, int depthSliceInMm = 250);
+	void loadRegistrationTables();
+	void releaseRegistrationTables();
+    
+	/* registerDepthImageToRgb warps a depth image into the image plane of the RGB camera by gathering through the RGB -> depth table
+     (compiled if needed). This is the dense equivalent of computeCorrespondingDepthPointFromRgb for every RGB pixel */
+	void registerDepthImageToRgb(cv::Mat depthImg, cv::Mat& registeredDepthImg);
+    
 	void showModalityImages(std::string rgbPath,std::string tPath,std::string dPath,int imgNbr);
 	void initWindows(int imgNbr);
     
@@ -104,10 +117,19 @@ private:
     
 	/* computeHomographyMapping handles the mapping of RGB <-> Thermal.
      It is called inside computeCorrespondingRgbPointFromThermal and computeCorrespondingThermalPointFromRgb */
-	void computeHomographyMapping(std::vector<cv::Point2f>& vecUndistRgbCoord, std::vector<cv::Point2f>& vecUndistTCoord, std::vector<cv::Point2f> vecDCoord,
-                                  std::vector<int> vecDepthInMm, std::vector<double>& minDist, std::vector<int> &bestHom, std::vector<std::vector<int> > &octantIndices,
+	void computeHomographyMapping(std::vector<cv::Point2f>& vecUndistRgbCoord, std::vector<cv::Point2f>& vecUndistTCoord, const std::vector<cv::Point2f>& vecDCoord,
+                                  const std::vector<int>& vecDepthInMm, std::vector<double>& minDist, std::vector<int> &bestHom, std::vector<std::vector<int> > &octantIndices,
                                   std::vector<std::vector<double> > &octantDistances, std::vector<cv::Point3f> &worldCoordPointvector);
     
+	/* mapPointWithHomographies maps a single undistorted point into the other modality (MAP_TYPE 1: RGB -> thermal, 2: thermal -> RGB).
+     The eight octant neighbours of the point are found in the prebuilt homography index, so it may be called concurrently for many points */
+	void mapPointWithHomographies(cv::Point2f undistPoint, float depthInMm, int MAP_TYPE, cv::Point2f &estimatedPoint, double &minDist,
+								  int &bestHom, std::vector<int> &octantIndices, std::vector<double> &octantDistances, cv::Point3f &worldCoordPoint) const;
+    
+	/* buildHomographyIndices (re)builds the spatial indices over the homography centres. It is called when the calibration is loaded
+     and whenever the set of discarded homographies changes */
+	void buildHomographyIndices();
+    
 	/*	TrilinearHomographyInterpolator finds the nearest point for each quadrant in 3D space and calculates weights
      based on trilinear interpolation for the input 3D point. The function returns a list of weights of the points
      used for the interpolation */
@@ -122,13 +144,23 @@ private:
 	void MyDistortPoints(const std::vector<cv::Point2f> src, std::vector<cv::Point2f> & dst,
                          const cv::Mat & cameraMatrix, const cv::Mat &distorsionMatrix);
     
-	float backProjectPoint(float point, float focalLength, float principalPoint, float zCoord);
+	float backProjectPoint(float point, float focalLength, float principalPoint, float zCoord) const;
     
 	float forwardProjectPoint(float point, float focalLength, float principalPoint, float zCoord);
     
 	// lookUpDepth gets the current depth of the point in the depth image
 	float lookUpDepth(cv::Mat depthImg, cv::Point2f dCoord, bool SCALE_TO_THEORETICAL);
     
+	// Table look-ups of the dense registration tables. lookUpThermalPointsFromRgb falls back on computeCorrespondingThermalPointFromRgb
+	// for the points outside the tables
+	void lookUpDepthPointsFromRgb(const std::vector<cv::Point2f>& vecRgbCoord, std::vector<cv::Point2f>& vecDCoord);
+	void lookUpRgbPointsFromDepth(const std::vector<cv::Point2f>& vecDCoord, std::vector<cv::Point2f>& vecRgbCoord);
+	void lookUpThermalPointsFromRgb(const std::vector<cv::Point2f>& vecRgbCoord, const std::vector<int>& vecDepthInMm, std::vector<cv::Point2f>& vecTCoord);
+    
+	std::string getRegistrationTablesPath();
+	bool readRegistrationTables(std::string tablesFile);
+	bool writeRegistrationTables(std::string tablesFile);
+    
 	// Helper functions for the registration of contours:
 	void getRegisteredContours(std::vector<cv::Point> contour, std::vector<cv::Point> erodedContour, std::vector<cv::Point>& dContour,
 							   std::vector<cv::Point>& tContour, cv::Mat depthImg);
@@ -189,6 +221,45 @@ private:
 		cv::Mat rgbToDCalX,rgbToDCalY,dToRgbCalX,dToRgbCalY;
 	} stereoCalibParam;
     
+	/* HomographyIndex is a k-d tree over the 3D centres of the homographies. For a query point it returns, in one traversal, the nearest
+     centre of every octant around the point (the octant numbering and tie-breaking of trilinearInterpolator are preserved) */
+	class HomographyIndex
+	{
+	public:
+		void build(const std::vector<cv::Point3f> &centers, const std::vector<bool> &active);
+		void nearestPerOctant(cv::Point3f inputPoint, int nearestInd[8], double nearestDist[8]) const;
+        
+	private:
+		struct Node {
+			int index; // Index of the centre in the source vector
+			int left, right;
+			cv::Point3f lo, hi; // Bounding box of the subtree
+		};
+        
+		int buildNode(std::vector<int> &indices, int begin, int end);
+		void search(int node, cv::Point3f inputPoint, int nearestInd[8], double nearestDist[8]) const;
+        
+		std::vector<cv::Point3f> points;
+		std::vector<Node> nodes;
+	} homIndexRgb, homIndexT;
+    
+	// Homographies in fixed-size form, to be applied point by point without temporary allocations
+	std::vector<cv::Matx33d> planarHomMatx, planarHomInvMatx;
+    
+	class HomographyMappingInvoker;
+    
+	struct registrationTables {
+		// Compiled by compileRegistrationTables for the current calibration
+		bool COMPILED;
+		bool UNDISTORT_IMAGES; // Setting the tables were compiled with
+        
+		cv::Mat rgbToD, dToRgb; // CV_32FC2. Entry (r,c) is the correspondence of the (1-based) point (c+1,r+1)
+		cv::Point2f dToRgbOutside; // Correspondence of the depth points outside the image
+        
+		int minDepthInMm, depthSliceInMm;
+		std::vector<cv::Mat> rgbToT; // CV_32FC2, one per depth slice. Entry (r,c) is the correspondence of the point (c,r)
+	} regTables;
+    
 	struct registrationSettings {
 		bool UNDISTORT_IMAGES;
 		bool USE_PREV_DEPTH_POINT;
@@ -199,6 +270,7 @@ private:
 	} settings;
     
 	cv::Mat rgbImg, tImg, dImg;
+	std::string calFilePath;
 	std::string rgbImgPath, tImgPath, dImgPath;
 };
 